@@ -3,6 +3,10 @@
 
 import PackageDescription
 
+// Set USE_FAST_IMAGE_HASH in the environment to use a fast hash instead of
+// MD5 to find duplicate images.
+let useFastImageHash = Context.environment["USE_FAST_IMAGE_HASH"] != nil
+
 let package = Package(
     name: "libxlsxwriter",
     products: [
@@ -23,9 +27,10 @@ let package = Package(
                 "third_party/minizip/zip.c",
                 "third_party/minizip/ioapi.c",
                 "third_party/tmpfileplus/tmpfileplus.c",
-                "third_party/md5/md5.c"
-            ],
+                "third_party/dtoa/emyg_dtoa.c"
+            ] + (useFastImageHash ? [] : ["third_party/md5/md5.c"]),
             publicHeadersPath: "include",
+            cSettings: useFastImageHash ? [.define("USE_FAST_IMAGE_HASH")] : [],
             linkerSettings: [
                 .linkedLibrary("z")
             ]),
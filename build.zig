@@ -15,9 +15,11 @@ pub fn build(b: *std.Build) void {
     const shared = b.option(bool, "SHARED_LIBRARY", "Build the Shared Library [default: false]") orelse false;
     const examples = b.option(bool, "BUILD_EXAMPLES", "Build libxlsxwriter examples [default: false]") orelse false;
     const tests = b.option(bool, "BUILD_TESTS", "Build libxlsxwriter tests [default: false]") orelse false;
-    const dtoa = b.option(bool, "USE_DTOA_LIBRARY", "Use the locale independent third party Milo Yip DTOA library [default: off]") orelse false;
+    const stddouble = b.option(bool, "USE_STANDARD_DOUBLE", "Use the standard library sprintf() instead of the Milo Yip DTOA library [default: off]") orelse false;
+    const dtoa = b.option(bool, "USE_DTOA_LIBRARY", "Deprecated and ignored, the Milo Yip DTOA library is now the default");
     const minizip = b.option(bool, "USE_SYSTEM_MINIZIP", "Use system minizip installation [default: off]") orelse false;
     const md5 = b.option(bool, "USE_OPENSSL_MD5", "Build libxlsxwriter with the OpenSSL MD5 lib [default: off]") orelse false;
+    const fasthash = b.option(bool, "USE_FAST_IMAGE_HASH", "Use a fast hash instead of MD5 to find duplicate images [default: off]") orelse false;
     const stdtmpfile = b.option(bool, "USE_STANDARD_TMPFILE", "Use the C standard library's tmpfile() [default: off]") orelse false;
 
     const lib = b.addLibrary(.{
@@ -48,6 +50,7 @@ pub fn build(b: *std.Build) void {
             "src/metadata.c",
             "src/custom.c",
             "src/hash_table.c",
+            "src/thread.c",
             "src/relationships.c",
             "src/drawing.c",
             "src/chart.c",
@@ -83,7 +86,9 @@ pub fn build(b: *std.Build) void {
     lib.installLibraryHeaders(zlib);
 
     // md5
-    if (!md5)
+    if (fasthash)
+        lib.root_module.addCMacro("USE_FAST_IMAGE_HASH", "")
+    else if (!md5)
         lib.addCSourceFile(.{
             .file = b.path("third_party/md5/md5.c"),
             .flags = cflags,
@@ -92,11 +97,16 @@ pub fn build(b: *std.Build) void {
         lib.linkSystemLibrary("crypto");
 
     // dtoa
-    if (dtoa)
+    if (dtoa != null)
+        std.log.warn("USE_DTOA_LIBRARY is deprecated and ignored since the DTOA library is now the default. Use USE_STANDARD_DOUBLE to turn it off.", .{});
+
+    if (!stddouble)
         lib.addCSourceFile(.{
             .file = b.path("third_party/dtoa/emyg_dtoa.c"),
             .flags = cflags,
-        });
+        })
+    else
+        lib.root_module.addCMacro("USE_STANDARD_DOUBLE", "");
 
     // tmpfileplus
     if (stdtmpfile)
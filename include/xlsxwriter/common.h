@@ -188,6 +188,12 @@ enum lxw_custom_property_types {
 /* Size of MD5 byte arrays. */
 #define LXW_MD5_SIZE              16
 
+/* Size of the image digests used to remove duplicate images. */
+#define LXW_IMAGE_DIGEST_SIZE     16
+
+/* Excel string max of 32767 chars. */
+#define LXW_STR_MAX               32767
+
 /* Excel sheetname max of 31 chars. */
 #define LXW_SHEETNAME_MAX         31
 
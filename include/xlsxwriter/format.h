@@ -61,11 +61,13 @@
 #ifndef __LXW_FORMAT_H__
 #define __LXW_FORMAT_H__
 
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include "hash_table.h"
 
 #include "common.h"
+#include "thread.h"
 
 /**
  * @brief The type for RGB colors in libxlsxwriter.
@@ -91,6 +93,16 @@ typedef uint32_t lxw_color_t;
         dst[LXW_FORMAT_FIELD_LEN - 1] = '\0';       \
     } while (0)
 
+/* Set a format property and update the format fingerprint. */
+#define LXW_FORMAT_SET_PROPERTY(format, property, value)            \
+    do {                                                            \
+        lxw_format_update_fingerprint(format,                       \
+                                      offsetof(lxw_format, property), \
+                                      (uint64_t) (format)->property, \
+                                      (uint64_t) (value));          \
+        (format)->property = (value);                               \
+    } while (0)
+
 /** Format underline values for format_set_underline(). */
 enum lxw_format_underlines {
     LXW_UNDERLINE_NONE = 0,
@@ -362,6 +374,7 @@ typedef struct lxw_format {
 
     lxw_hash_table *xf_format_indices;
     lxw_hash_table *dxf_format_indices;
+    lxw_mutex *index_mutex;
     uint16_t *num_xf_formats;
     uint16_t *num_dxf_formats;
 
@@ -438,6 +451,8 @@ typedef struct lxw_format {
 
     uint8_t quote_prefix;
 
+    uint64_t fingerprint;
+
     STAILQ_ENTRY (lxw_format) list_pointers;
 } lxw_format;
 
@@ -494,6 +509,61 @@ typedef struct lxw_fill {
 
 } lxw_fill;
 
+/*
+ * Struct to represent the properties that are compared to check if two
+ * formats are the same. The string properties are compared separately.
+ */
+typedef struct lxw_format_key {
+
+    double font_size;
+    int32_t xf_id;
+    lxw_color_t font_color;
+    lxw_color_t fg_color;
+    lxw_color_t bg_color;
+    lxw_color_t bottom_color;
+    lxw_color_t diag_color;
+    lxw_color_t left_color;
+    lxw_color_t right_color;
+    lxw_color_t top_color;
+    uint16_t num_format_index;
+    int16_t rotation;
+    uint8_t bold;
+    uint8_t italic;
+    uint8_t underline;
+    uint8_t font_strikeout;
+    uint8_t font_outline;
+    uint8_t font_shadow;
+    uint8_t font_script;
+    uint8_t font_family;
+    uint8_t font_charset;
+    uint8_t font_condense;
+    uint8_t font_extend;
+    uint8_t theme;
+    uint8_t hyperlink;
+    uint8_t hidden;
+    uint8_t locked;
+    uint8_t text_h_align;
+    uint8_t text_wrap;
+    uint8_t text_v_align;
+    uint8_t text_justlast;
+    uint8_t pattern;
+    uint8_t bottom;
+    uint8_t diag_border;
+    uint8_t diag_type;
+    uint8_t left;
+    uint8_t right;
+    uint8_t top;
+    uint8_t indent;
+    uint8_t shrink;
+    uint8_t merge_range;
+    uint8_t reading_order;
+    uint8_t just_distrib;
+    uint8_t color_indexed;
+    uint8_t font_only;
+    uint8_t quote_prefix;
+
+} lxw_format_key;
+
 
 /* *INDENT-OFF* */
 #ifdef __cplusplus
@@ -508,6 +578,8 @@ int32_t lxw_format_get_dxf_index(lxw_format *format);
 lxw_font *lxw_format_get_font_key(lxw_format *format);
 lxw_border *lxw_format_get_border_key(lxw_format *format);
 lxw_fill *lxw_format_get_fill_key(lxw_format *format);
+void lxw_format_update_fingerprint(lxw_format *format, size_t offset,
+                                   uint64_t old_value, uint64_t new_value);
 
 /**
  * @brief Set the font used in the cell.
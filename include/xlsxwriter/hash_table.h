@@ -17,35 +17,43 @@
 #define LXW_FOREACH_ORDERED(elem, hash_table) \
     STAILQ_FOREACH((elem), (hash_table)->order_list, lxw_hash_order_pointers)
 
+/* The initial and minimum number of buckets. */
+#define LXW_HASH_MIN_BUCKETS 16
+
 /* List declarations. */
 STAILQ_HEAD(lxw_hash_order_list, lxw_hash_element);
-SLIST_HEAD(lxw_hash_bucket_list, lxw_hash_element);
 
-/* LXW_HASH hash table struct. */
+/*
+ * LXW_HASH hash table struct.
+ *
+ * The buckets are an open addressing table of element pointers with linear
+ * probing. The number of buckets is a power of 2 and it is doubled when the
+ * table becomes half full.
+ */
 typedef struct lxw_hash_table {
     uint32_t num_buckets;
-    uint32_t used_buckets;
     uint32_t unique_count;
     uint8_t free_key;
     uint8_t free_value;
 
     struct lxw_hash_order_list *order_list;
-    struct lxw_hash_bucket_list **buckets;
+    struct lxw_hash_element **buckets;
 } lxw_hash_table;
 
 /*
  * LXW_HASH table element struct.
  *
- * The hash elements contain pointers to allow them to be stored in
- * lists in the the hash table buckets and also pointers to track the
- * insertion order in a separate list.
+ * The hash elements are stored in the hash table buckets and also contain
+ * pointers to track the insertion order in a separate list. The full hash
+ * is stored to avoid key comparisons on collisions and to allow the table
+ * to be resized without rehashing the keys.
  */
 typedef struct lxw_hash_element {
     void *key;
     void *value;
+    uint32_t hash;
 
     STAILQ_ENTRY (lxw_hash_element) lxw_hash_order_pointers;
-    SLIST_ENTRY (lxw_hash_element) lxw_hash_list_pointers;
 } lxw_hash_element;
 
 
@@ -66,6 +74,8 @@ void lxw_hash_free(lxw_hash_table *lxw_hash);
 /* Declarations required for unit testing. */
 #ifdef TESTING
 
+STATIC uint32_t _generate_hash_key(void *data, size_t data_len);
+
 #endif
 
 /* *INDENT-OFF* */
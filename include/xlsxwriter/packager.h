@@ -44,6 +44,14 @@
 
 #define LXW_ZIP_BUFFER_SIZE (16384)
 
+/* Chunk size used when deflating large members in parallel, as in pigz. Each
+ * chunk after the first is primed with the previous 32KB of input. */
+#define LXW_DEFLATE_CHUNK_SIZE (131072)
+#define LXW_DEFLATE_DICT_SIZE  (32768)
+
+/* Largest length passed to crc32_combine(), which fits a 32 bit z_off_t. */
+#define LXW_CRC_COMBINE_STEP (0x40000000)
+
 /* If zip returns a ZIP_XXX error then errno is set and we can trap that in
  * workbook.c. Otherwise return a default libxlsxwriter error. */
 #define RETURN_ON_ZIP_ERROR(err, default_err)       \
@@ -81,6 +89,52 @@ typedef struct lxw_packager {
 } lxw_packager;
 
 
+/*
+ * Struct to represent a worksheet xml file that is assembled and compressed
+ * in a worker thread.
+ */
+typedef struct lxw_worksheet_job {
+
+    lxw_worksheet *worksheet;
+    char filename[LXW_FILENAME_LENGTH];
+
+    FILE *file;
+    char *buffer;
+    size_t buffer_size;
+
+    FILE *deflated_file;
+    char *deflated_buffer;
+    size_t deflated_buffer_size;
+
+    int level;
+    int strategy;
+    uLong crc;
+    ZPOS64_T uncompressed_size;
+    lxw_error error;
+
+} lxw_worksheet_job;
+
+/*
+ * Struct to represent a chunk of a zip member that is deflated independently
+ * in a worker thread.
+ */
+typedef struct lxw_deflate_chunk {
+
+    const unsigned char *data;
+    size_t size;
+    const unsigned char *dict;
+    size_t dict_size;
+    uint8_t is_last;
+    int level;
+    int strategy;
+
+    unsigned char *deflated;
+    size_t deflated_size;
+    uLong crc;
+    lxw_error error;
+
+} lxw_deflate_chunk;
+
 /* *INDENT-OFF* */
 #ifdef __cplusplus
 extern "C" {
@@ -91,6 +145,9 @@ lxw_packager *lxw_packager_new(const char *filename, const char *tmpdir,
                                uint8_t use_zip64);
 void lxw_packager_free(lxw_packager *packager);
 lxw_error lxw_create_package(lxw_packager *self);
+void lxw_packager_get_compression(lxw_workbook *workbook,
+                                  const char *filename, int *level,
+                                  int *strategy);
 
 /* Declarations required for unit testing. */
 #ifdef TESTING
@@ -15,35 +15,54 @@
 #include <stdint.h>
 
 #include "common.h"
+#include "thread.h"
 
-/* Define a tree.h RB structure for storing shared strings. */
-RB_HEAD(sst_rb_tree, sst_element);
+/* Initial number of buckets in the SST hash table. Must be a power of 2.
+ * The array of elements in insertion order starts at half this size. */
+#define LXW_SST_HASH_INITIAL_SIZE 1024
 
-/* Define a queue.h structure for storing shared strings in insertion order. */
-STAILQ_HEAD(sst_order_list, sst_element);
+/* Size of the memory blocks used to store the SST elements and strings. */
+#define LXW_SST_BLOCK_SIZE 65536
 
-/* Wrapper around RB_GENERATE_STATIC from tree.h to avoid unused function
- * warnings and to avoid portability issues with the _unused attribute. */
-#define LXW_RB_GENERATE_ELEMENT(name, type, field, cmp) \
-    RB_GENERATE_INSERT_COLOR(name, type, field, static) \
-    RB_GENERATE_INSERT(name, type, field, cmp, static)  \
-    /* Add unused struct to allow adding a semicolon */ \
-    struct lxw_rb_generate_element{int unused;}
+/* Initial number of slots in the on-disk index of a bounded SST. Must be a
+ * power of 2. */
+#define LXW_SST_INDEX_INITIAL_SIZE 65536
 
 /*
- * Elements of the SST table. They contain pointers to allow them to
- * be stored in a RB tree and also pointers to track the insertion order
- * in a separate list.
+ * Elements of the SST table. They are indexed by the string hash in an
+ * open addressing hash table and are also stored in insertion order in an
+ * array. The element and its string are stored together in the SST memory
+ * blocks.
  */
 struct sst_element {
     uint32_t index;
+    uint32_t hash;
+    size_t length;
     char *string;
     uint8_t is_rich_string;
-
-    STAILQ_ENTRY (sst_element) sst_order_pointers;
-    RB_ENTRY (sst_element) sst_tree_pointers;
+    uint8_t is_spilled;
+    uint8_t is_referenced;
 };
 
+/*
+ * Slot in the on-disk index of a bounded SST. The index is stored plus 1 so
+ * that a zeroed slot is empty.
+ */
+typedef struct lxw_sst_slot {
+    uint32_t hash;
+    uint32_t index;
+} lxw_sst_slot;
+
+/*
+ * A block of memory used to store SST elements and strings contiguously.
+ * The element data follows the block header in the same allocation.
+ */
+typedef struct lxw_sst_block {
+    size_t size;
+    size_t used;
+    struct lxw_sst_block *next;
+} lxw_sst_block;
+
 /*
  * Struct to represent a sst.
  */
@@ -53,8 +72,34 @@ typedef struct lxw_sst {
     uint32_t string_count;
     uint32_t unique_count;
 
-    struct sst_order_list *order_list;
-    struct sst_rb_tree *rb_tree;
+    struct sst_element **elements;
+    uint32_t elements_size;
+    uint32_t num_elements;
+
+    struct sst_element **buckets;
+    uint32_t num_buckets;
+
+    lxw_sst_block *blocks;
+
+    /* Only used when worksheets are written to concurrently. */
+    lxw_mutex *mutex;
+
+    /* Only used in constant_memory mode when the number of strings kept in
+     * memory is bounded. The other strings are stored in temp files. */
+    uint32_t max_strings;
+    const char *tmpdir;
+    FILE *strings_file;
+    FILE *offsets_file;
+    FILE *index_file;
+    uint64_t strings_size;
+    uint32_t index_size;
+    uint32_t index_count;
+    uint8_t files_read;
+    char *read_buffer;
+    size_t read_buffer_size;
+    char *lookup_buffer;
+    size_t lookup_buffer_size;
+    lxw_error file_error;
 
 } lxw_sst;
 
@@ -68,12 +113,21 @@ lxw_sst *lxw_sst_new(void);
 void lxw_sst_free(lxw_sst *sst);
 struct sst_element *lxw_get_sst_index(lxw_sst *sst, const char *string,
                                       uint8_t is_rich_string);
+struct sst_element *lxw_add_sst_string(lxw_sst *sst, const char *string,
+                                       uint8_t is_rich_string);
+lxw_error lxw_get_sst_string_index(lxw_sst *sst, const char *string,
+                                   uint32_t *index);
+lxw_error lxw_check_sst_string(lxw_sst *sst, uint32_t index,
+                               uint8_t *is_empty);
+const char *lxw_get_sst_string(lxw_sst *sst, uint32_t index);
+void lxw_count_sst_string(lxw_sst *sst);
 void lxw_sst_assemble_xml_file(lxw_sst *self);
 
 /* Declarations required for unit testing. */
 #ifdef TESTING
 
 STATIC void _sst_xml_declaration(lxw_sst *self);
+STATIC uint32_t _sst_hash(const char *string, size_t *length);
 
 #endif /* TESTING */
 
@@ -0,0 +1,52 @@
+/*
+ * libxlsxwriter
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ * thread - Minimal portable thread functions for libxlsxwriter.
+ *
+ */
+
+#ifndef __LXW_THREAD_H__
+#define __LXW_THREAD_H__
+
+#include "common.h"
+
+/* Signature of a function run in a worker thread. */
+typedef void (*lxw_thread_func) (void *arg);
+
+/* Opaque thread handle. The platform specific data is kept in thread.c so
+ * that pthread.h/windows.h aren't exposed to the other library files. */
+typedef struct lxw_thread lxw_thread;
+
+/* Opaque mutex handle. A NULL mutex is valid and lock/unlock do nothing so
+ * that callers don't need separate locked and unlocked code paths. */
+typedef struct lxw_mutex lxw_mutex;
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* *INDENT-ON* */
+
+lxw_thread *lxw_thread_new(lxw_thread_func func, void *arg);
+void lxw_thread_join(lxw_thread *thread);
+
+lxw_mutex *lxw_mutex_new(void);
+void lxw_mutex_lock(lxw_mutex *mutex);
+void lxw_mutex_unlock(lxw_mutex *mutex);
+void lxw_mutex_free(lxw_mutex *mutex);
+
+/* Declarations required for unit testing. */
+#ifdef TESTING
+
+#endif
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+}
+#endif
+/* *INDENT-ON* */
+
+#endif /* __LXW_THREAD_H__ */
@@ -286,19 +286,23 @@ uint8_t lxw_str_is_empty(const char *str);
 FILE *lxw_tmpfile(const char *tmpdir);
 FILE *lxw_get_filehandle(char **buf, size_t *size, const char *tmpdir);
 FILE *lxw_fopen(const char *filename, const char *mode);
+int lxw_fseeko(FILE *file, uint64_t offset, int origin);
+int lxw_ftello(FILE *file, uint64_t *offset);
 
-/* Use the third party dtoa function to avoid locale issues with sprintf
- * double formatting. Otherwise we use a simple macro that falls back to the
+/* Use the third party dtoa function, by default, to avoid locale issues with
+ * sprintf double formatting and to get the shortest representation that
+ * round trips. Otherwise we use a simple macro that falls back to the
  * default c-lib sprintf.
  */
-#ifdef USE_DTOA_LIBRARY
-int lxw_sprintf_dbl(char *data, double number);
-#else
+#ifdef USE_STANDARD_DOUBLE
 #define lxw_sprintf_dbl(data, number) \
         lxw_snprintf(data, LXW_ATTR_32, "%.16G", number)
+#else
+int lxw_sprintf_dbl(char *data, double number);
 #endif
 
 uint16_t lxw_hash_password(const char *password);
+void lxw_hash_digest(const void *data, size_t data_len, uint8_t *digest);
 
 /* *INDENT-OFF* */
 #ifdef __cplusplus
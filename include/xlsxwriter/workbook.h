@@ -58,7 +58,6 @@
 /* Define the tree.h RB structs for the red-black head types. */
 RB_HEAD(lxw_worksheet_names, lxw_worksheet_name);
 RB_HEAD(lxw_chartsheet_names, lxw_chartsheet_name);
-RB_HEAD(lxw_image_md5s, lxw_image_md5);
 
 /* Define the queue.h structs for the workbook lists. */
 STAILQ_HEAD(lxw_sheets, lxw_sheet);
@@ -95,14 +94,6 @@ typedef struct lxw_chartsheet_name {
     RB_ENTRY (lxw_chartsheet_name) tree_pointers;
 } lxw_chartsheet_name;
 
-/* Struct to represent an image MD5/ID pair. */
-typedef struct lxw_image_md5 {
-    uint32_t id;
-    char *md5;
-
-    RB_ENTRY (lxw_image_md5) tree_pointers;
-} lxw_image_md5;
-
 /* Wrapper around RB_GENERATE_STATIC from tree.h to avoid unused function
  * warnings and to avoid portability issues with the _unused attribute. */
 #define LXW_RB_GENERATE_WORKSHEET_NAMES(name, type, field, cmp)  \
@@ -127,17 +118,6 @@ typedef struct lxw_image_md5 {
     /* Add unused struct to allow adding a semicolon */          \
     struct lxw_rb_generate_charsheet_names{int unused;}
 
-#define LXW_RB_GENERATE_IMAGE_MD5S(name, type, field, cmp) \
-    RB_GENERATE_INSERT_COLOR(name, type, field, static)          \
-    RB_GENERATE_REMOVE_COLOR(name, type, field, static)          \
-    RB_GENERATE_INSERT(name, type, field, cmp, static)           \
-    RB_GENERATE_REMOVE(name, type, field, static)                \
-    RB_GENERATE_FIND(name, type, field, cmp, static)             \
-    RB_GENERATE_NEXT(name, type, field, static)                  \
-    RB_GENERATE_MINMAX(name, type, field, static)                \
-    /* Add unused struct to allow adding a semicolon */          \
-    struct lxw_rb_generate_image_md5s{int unused;}
-
 /**
  * @brief Macro to loop over all the worksheets in a workbook.
  *
@@ -220,6 +200,63 @@ typedef struct lxw_doc_properties {
 
 } lxw_doc_properties;
 
+/** Compression levels used for the parts of the xlsx file. See the
+ * `compression_level` option of `workbook_new_opt()` and
+ * `workbook_set_compression()`. */
+enum lxw_compression_levels {
+    /** Use the default compression for the part type. This is the zlib
+     *  default level for the XML parts. PNG, JPEG and GIF images, which are
+     *  already compressed, are stored without compression. */
+    LXW_COMPRESSION_DEFAULT = 0,
+
+    /** Fastest compression. This is zlib level 1. The intermediate zlib
+     *  levels 2-8 can also be used. */
+    LXW_COMPRESSION_FASTEST = 1,
+
+    /** Best compression. This is zlib level 9. */
+    LXW_COMPRESSION_BEST = 9,
+
+    /** Store the part in the xlsx file without compression. */
+    LXW_COMPRESSION_STORE = 10
+};
+
+/** Compression strategies used for the parts of the xlsx file. These map to
+ * the zlib deflate strategies. */
+enum lxw_compression_strategies {
+    /** Zlib Z_DEFAULT_STRATEGY. */
+    LXW_COMPRESSION_STRATEGY_DEFAULT = 0,
+
+    /** Zlib Z_FILTERED. */
+    LXW_COMPRESSION_STRATEGY_FILTERED,
+
+    /** Zlib Z_HUFFMAN_ONLY. */
+    LXW_COMPRESSION_STRATEGY_HUFFMAN_ONLY,
+
+    /** Zlib Z_RLE. */
+    LXW_COMPRESSION_STRATEGY_RLE,
+
+    /** Zlib Z_FIXED. */
+    LXW_COMPRESSION_STRATEGY_FIXED
+};
+
+/** The classes of parts in the xlsx file that can have their own compression
+ * settings via `workbook_set_compression()`. */
+enum lxw_compression_parts {
+    /** The worksheet XML files. */
+    LXW_PART_WORKSHEETS = 0,
+
+    /** The shared strings table. */
+    LXW_PART_SHARED_STRINGS,
+
+    /** Images and other media files. */
+    LXW_PART_MEDIA,
+
+    /** All other parts such as styles, charts, drawings and metadata. */
+    LXW_PART_OTHER
+};
+
+#define LXW_PART_COUNT (LXW_PART_OTHER + 1)
+
 /**
  * @brief Workbook options.
  *
@@ -281,6 +318,28 @@ typedef struct lxw_workbook_options {
 
     /** Used with output_buffer to get the size of the created buffer */
     size_t *output_buffer_size;
+
+    /** Number of threads to use when assembling the xlsx file. */
+    uint16_t worker_threads;
+
+    /** Compression level for the xlsx file parts. See
+     *  #lxw_compression_levels. */
+    uint8_t compression_level;
+
+    /** Compression strategy for the xlsx file parts. See
+     *  #lxw_compression_strategies. */
+    uint8_t compression_strategy;
+
+    /** Allow different worksheets to be written to from different
+     *  threads at the same time. */
+    uint8_t concurrent_worksheets;
+
+    /** Number of rows kept in memory in `constant_memory` mode. */
+    uint16_t constant_memory_rows;
+
+    /** Maximum number of shared strings kept in memory in
+     *  `constant_memory` mode. */
+    uint32_t constant_memory_strings;
 } lxw_workbook_options;
 
 /**
@@ -298,10 +357,10 @@ typedef struct lxw_workbook {
     struct lxw_chartsheets *chartsheets;
     struct lxw_worksheet_names *worksheet_names;
     struct lxw_chartsheet_names *chartsheet_names;
-    struct lxw_image_md5s *image_md5s;
-    struct lxw_image_md5s *embedded_image_md5s;
-    struct lxw_image_md5s *header_image_md5s;
-    struct lxw_image_md5s *background_md5s;
+    lxw_hash_table *image_digests;
+    lxw_hash_table *embedded_image_digests;
+    lxw_hash_table *header_image_digests;
+    lxw_hash_table *background_digests;
     struct lxw_charts *charts;
     struct lxw_charts *ordered_charts;
     struct lxw_formats *formats;
@@ -347,6 +406,9 @@ typedef struct lxw_workbook {
 
     lxw_hash_table *used_xf_formats;
     lxw_hash_table *used_dxf_formats;
+    lxw_mutex *format_mutex;
+    lxw_row_store *row_store;
+    lxw_col_name *col_names;
 
     char *vba_project;
     char *vba_project_signature;
@@ -356,6 +418,9 @@ typedef struct lxw_workbook {
 
     lxw_format *default_url_format;
 
+    uint8_t compression_levels[LXW_PART_COUNT];
+    uint8_t compression_strategies[LXW_PART_COUNT];
+
 } lxw_workbook;
 
 
@@ -432,10 +497,68 @@ lxw_workbook *workbook_new(const char *filename);
  * - `output_buffer_size`: Used with output_buffer to get the size of the
  *   created buffer. This option can only be used if filename is `NULL`.
  *
+ * - `worker_threads`: The number of threads used to assemble and compress
+ *   the worksheet XML files in `workbook_close()`. Worksheets are independent
+ *   of each other so they can be serialized in parallel. The parts are still
+ *   added to the xlsx file in the same order as in the default single
+ *   threaded mode. Large parts, such as the shared strings table or a
+ *   single large worksheet, are also split into chunks that are compressed
+ *   in parallel. The default of 0 or 1 means no additional threads are
+ *   used. If the library is compiled with `USE_NO_THREADS` this option is
+ *   ignored.
+ *
+ * - `compression_level`: The zlib compression level used for the parts of
+ *   the xlsx file. A lower level such as #LXW_COMPRESSION_FASTEST makes
+ *   `workbook_close()` faster at the cost of a larger file and
+ *   #LXW_COMPRESSION_BEST does the opposite. #LXW_COMPRESSION_STORE turns
+ *   off compression. The default is #LXW_COMPRESSION_DEFAULT. Images are
+ *   stored uncompressed by default since they are already compressed. See
+ *   also `workbook_set_compression()`.
+ *
+ * - `compression_strategy`: The zlib compression strategy used for the parts
+ *   of the xlsx file. See #lxw_compression_strategies.
+ *
+ * - `concurrent_worksheets`: Allow each worksheet to be filled by a
+ *   different thread at the same time. In this mode each worksheet stores
+ *   its strings in its own string table, which is merged into the workbook
+ *   shared string table, in worksheet order, by `workbook_close()`. The
+ *   format index assignment, which is shared by all the worksheets, is
+ *   protected by a lock. The `worksheet_write_*()` functions can then be
+ *   called concurrently for *different* worksheets. A worksheet must still
+ *   only be used by one thread at a time. Workbook level functions such as
+ *   `workbook_add_worksheet()`, `workbook_add_format()`, the `format_set_*()`
+ *   functions and `workbook_close()` should be called from a single thread
+ *   before the worker threads start, or after they have finished. In
+ *   `constant_memory` mode the format indices depend on the order that the
+ *   threads write rows so the styles in the output file may be ordered
+ *   differently between runs, although the data is the same. This option is
+ *   off by default and has no effect if the library is compiled with
+ *   `USE_NO_THREADS`.
+ *
+ * - `constant_memory_rows`: The number of rows that are kept in memory in
+ *   `constant_memory` mode. A row is only written to disk when a row that is
+ *   this number of rows, or more, below it is started. This allows data that
+ *   is produced slightly out of order, for example by computing the rows in
+ *   parallel, to be written in this mode. The default of 0 or 1 keeps a
+ *   single row in memory.
+ *
+ * - `constant_memory_strings`: By default strings are written inline in
+ *   `constant_memory` mode, which can make the file much larger than it
+ *   would be with a shared string table if strings are repeated. If this
+ *   option is set to a non-zero number the shared string table is used
+ *   instead, with at most this number of strings kept in memory. The strings
+ *   that don't fit are stored in temp files, along with an on-disk index to
+ *   find repeated strings, so the memory use stays constant. When the
+ *   in-memory table is full the strings that have been repeated since they
+ *   were added are kept, up to half of the table, and the others are moved
+ *   to the on-disk index. A larger number makes repeated strings faster to
+ *   look up.
+ *
  * @note In `constant_memory` mode each row of in-memory data is written to
  * disk and then freed when a new row is started via one of the
  * `worksheet_write_*()` functions. Therefore, once this option is active data
- * should be written in sequential row by row order. For this reason
+ * should be written in sequential row by row order, or within the window of
+ * rows set by `constant_memory_rows`. For this reason
  * `worksheet_merge_range()` and some other row based functionality doesn't
  * work in this mode. See @ref ww_mem_constant for more details.
  *
@@ -444,7 +567,10 @@ lxw_workbook *workbook_new(const char *filename);
  * directory into memory since it is possible to consume the "system" memory
  * even though the "process" memory remains constant. In these cases you
  * should use an alternative temp file location by using the `tmpdir` option
- * shown above. See @ref ww_mem_temp for more details.
+ * shown above. See @ref ww_mem_temp for more details. The worksheet rows are
+ * compressed as they are written, so the temp file data is generally much
+ * smaller than the worksheet XML, and they are added to the xlsx file
+ * without being decompressed.
  */
 lxw_workbook *workbook_new_opt(const char *filename,
                                lxw_workbook_options *options);
@@ -1114,6 +1240,78 @@ void workbook_use_1904_epoch(lxw_workbook *workbook);
 void workbook_set_size(lxw_workbook *workbook,
                        uint16_t width, uint16_t height);
 
+/**
+ * @brief Set the compression level and strategy for a class of parts.
+ *
+ * @param workbook Pointer to a lxw_workbook instance.
+ * @param part     The class of parts. See #lxw_compression_parts.
+ * @param level    The compression level. See #lxw_compression_levels.
+ * @param strategy The compression strategy. See #lxw_compression_strategies.
+ *
+ * @return A #lxw_error code.
+ *
+ * The `%workbook_set_compression()` function overrides the workbook
+ * `compression_level` and `compression_strategy` options, see
+ * `workbook_new_opt()`, for one class of parts in the xlsx file. For example
+ * to compress the worksheets quickly and store the media files:
+ *
+ * @code
+ *     workbook_set_compression(workbook, LXW_PART_WORKSHEETS,
+ *                              LXW_COMPRESSION_FASTEST,
+ *                              LXW_COMPRESSION_STRATEGY_DEFAULT);
+ *
+ *     workbook_set_compression(workbook, LXW_PART_MEDIA,
+ *                              LXW_COMPRESSION_STORE,
+ *                              LXW_COMPRESSION_STRATEGY_DEFAULT);
+ * @endcode
+ *
+ * A level of #LXW_COMPRESSION_DEFAULT restores the workbook setting.
+ *
+ * In `constant_memory` mode the worksheet rows are compressed as they are
+ * written using the settings at the time that the worksheet was added. The
+ * worksheet settings should therefore be changed before adding worksheets,
+ * otherwise the rows have to be decompressed and compressed again.
+ */
+lxw_error workbook_set_compression(lxw_workbook *workbook, uint8_t part,
+                                   uint8_t level, uint8_t strategy);
+
+/**
+ * @brief Add strings to the workbook shared string table.
+ *
+ * @param workbook    Pointer to a lxw_workbook instance.
+ * @param strings     An array of UTF-8 strings.
+ * @param num_strings The number of strings in the array.
+ * @param indices     An array, with at least `num_strings` elements, to
+ *                    store the index of each string in.
+ *
+ * @return A #lxw_error code.
+ *
+ * The `%workbook_add_shared_strings()` function adds an array of strings to
+ * the shared string table of the workbook, or finds them if they are already
+ * in the table, and returns their indices. The indices can then be written
+ * to cells with `worksheet_write_shared_string()` without looking up the
+ * strings again. This is useful for data with a small set of repeated
+ * values, such as category labels:
+ *
+ * @code
+ *     const char *regions[] = {"North", "South", "East", "West"};
+ *     uint32_t indices[4];
+ *
+ *     workbook_add_shared_strings(workbook, regions, 4, indices);
+ *
+ *     for (row = 0; row < 1000; row++)
+ *         worksheet_write_shared_string(worksheet, row, 0, indices[row % 4],
+ *                                       NULL);
+ * @endcode
+ *
+ * The strings are copied so the array doesn't need to be kept after the
+ * call.
+ */
+lxw_error workbook_add_shared_strings(lxw_workbook *workbook,
+                                      const char **strings,
+                                      uint32_t num_strings,
+                                      uint32_t *indices);
+
 void lxw_workbook_free(lxw_workbook *workbook);
 void lxw_workbook_assemble_xml_file(lxw_workbook *workbook);
 void lxw_workbook_set_default_xf_indices(lxw_workbook *workbook);
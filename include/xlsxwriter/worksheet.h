@@ -56,6 +56,7 @@
 #include "styles.h"
 #include "utility.h"
 #include "relationships.h"
+#include "hash_table.h"
 
 #define LXW_ROW_MAX                 1048576
 #define LXW_COL_MAX                 16384
@@ -745,9 +746,6 @@ enum lxw_image_position {
 };
 
 /* Define the tree.h RB structs for the red-black head types. */
-RB_HEAD(lxw_table_cells, lxw_cell);
-RB_HEAD(lxw_drawing_rel_ids, lxw_drawing_rel_id);
-RB_HEAD(lxw_vml_drawing_rel_ids, lxw_drawing_rel_id);
 RB_HEAD(lxw_cond_format_hash, lxw_cond_format_hash_element);
 
 /* Define a RB_TREE struct manually to add extra members. */
@@ -761,48 +759,13 @@ struct lxw_table_rows {
  * warnings and to avoid portability issues with the _unused attribute. */
 #define LXW_RB_GENERATE_ROW(name, type, field, cmp)       \
     RB_GENERATE_INSERT_COLOR(name, type, field, static)   \
-    RB_GENERATE_REMOVE_COLOR(name, type, field, static)   \
     RB_GENERATE_INSERT(name, type, field, cmp, static)    \
-    RB_GENERATE_REMOVE(name, type, field, static)         \
     RB_GENERATE_FIND(name, type, field, cmp, static)      \
     RB_GENERATE_NEXT(name, type, field, static)           \
     RB_GENERATE_MINMAX(name, type, field, static)         \
     /* Add unused struct to allow adding a semicolon */   \
     struct lxw_rb_generate_row{int unused;}
 
-#define LXW_RB_GENERATE_CELL(name, type, field, cmp)      \
-    RB_GENERATE_INSERT_COLOR(name, type, field, static)   \
-    RB_GENERATE_REMOVE_COLOR(name, type, field, static)   \
-    RB_GENERATE_INSERT(name, type, field, cmp, static)    \
-    RB_GENERATE_REMOVE(name, type, field, static)         \
-    RB_GENERATE_FIND(name, type, field, cmp, static)      \
-    RB_GENERATE_NEXT(name, type, field, static)           \
-    RB_GENERATE_MINMAX(name, type, field, static)         \
-    /* Add unused struct to allow adding a semicolon */   \
-    struct lxw_rb_generate_cell{int unused;}
-
-#define LXW_RB_GENERATE_DRAWING_REL_IDS(name, type, field, cmp) \
-    RB_GENERATE_INSERT_COLOR(name, type, field, static)         \
-    RB_GENERATE_REMOVE_COLOR(name, type, field, static)         \
-    RB_GENERATE_INSERT(name, type, field, cmp, static)          \
-    RB_GENERATE_REMOVE(name, type, field, static)               \
-    RB_GENERATE_FIND(name, type, field, cmp, static)            \
-    RB_GENERATE_NEXT(name, type, field, static)                 \
-    RB_GENERATE_MINMAX(name, type, field, static)               \
-    /* Add unused struct to allow adding a semicolon */         \
-    struct lxw_rb_generate_drawing_rel_ids{int unused;}
-
-#define LXW_RB_GENERATE_VML_DRAWING_REL_IDS(name, type, field, cmp) \
-    RB_GENERATE_INSERT_COLOR(name, type, field, static)         \
-    RB_GENERATE_REMOVE_COLOR(name, type, field, static)         \
-    RB_GENERATE_INSERT(name, type, field, cmp, static)          \
-    RB_GENERATE_REMOVE(name, type, field, static)               \
-    RB_GENERATE_FIND(name, type, field, cmp, static)            \
-    RB_GENERATE_NEXT(name, type, field, static)                 \
-    RB_GENERATE_MINMAX(name, type, field, static)               \
-    /* Add unused struct to allow adding a semicolon */         \
-    struct lxw_rb_generate_vml_drawing_rel_ids{int unused;}
-
 #define LXW_RB_GENERATE_COND_FORMAT_HASH(name, type, field, cmp) \
     RB_GENERATE_INSERT_COLOR(name, type, field, static)         \
     RB_GENERATE_REMOVE_COLOR(name, type, field, static)         \
@@ -850,6 +813,22 @@ typedef struct lxw_row_col_options {
     uint8_t collapsed;
 } lxw_row_col_options;
 
+/* The size and position, in pixels, of a column used to position objects. */
+typedef struct lxw_col_geometry {
+    uint32_t position;
+    uint32_t pixels;
+    uint8_t hidden;
+} lxw_col_geometry;
+
+/* The size, in pixels, of a row with a non-default size. The sum is the
+ * difference from the default position of the row below it. */
+typedef struct lxw_row_geometry {
+    lxw_row_t row_num;
+    uint32_t pixels;
+    uint8_t hidden;
+    int64_t sum;
+} lxw_row_geometry;
+
 typedef struct lxw_col_options {
     lxw_col_t firstcol;
     lxw_col_t lastcol;
@@ -1810,7 +1789,8 @@ typedef struct lxw_object_properties {
     lxw_chart *chart;
     uint8_t is_duplicate;
     uint8_t is_background;
-    char *md5;
+    uint8_t has_digest;
+    uint8_t digest[LXW_IMAGE_DIGEST_SIZE];
     char *image_position;
     uint8_t decorative;
     lxw_format *format;
@@ -2105,6 +2085,48 @@ typedef struct lxw_rich_string_tuple {
     const char *string;
 } lxw_rich_string_tuple;
 
+/* Struct to cache a column name, like "XFD", for cell references. */
+typedef struct lxw_col_name {
+    char name[LXW_MAX_COL_NAME_LENGTH];
+    uint8_t length;
+} lxw_col_name;
+
+/* Number of items in the first and largest blocks of a worksheet memory
+ * pool. The block size doubles between the two. */
+#define LXW_MEM_POOL_MIN_ITEMS 64
+#define LXW_MEM_POOL_MAX_ITEMS 4096
+
+/*
+ * Temp file, shared by the worksheets of a workbook, that holds the
+ * compressed rows of constant_memory worksheets that have been finished with
+ * worksheet_finish(). This allows the worksheet temp files to be closed.
+ */
+typedef struct lxw_row_store {
+    FILE *file;
+    char *buffer;
+    size_t buffer_size;
+    const char *tmpdir;
+    lxw_mutex *mutex;
+} lxw_row_store;
+
+/*
+ * Pool of fixed size items, such as cells and rows, that are allocated from
+ * large blocks and released together when the worksheet is freed. Items that
+ * are released individually are zeroed and kept in a stack for reuse.
+ */
+typedef struct lxw_mem_pool {
+    size_t item_size;
+    size_t used;
+
+    char **blocks;
+    size_t num_blocks;
+    size_t blocks_size;
+
+    void **free_items;
+    size_t num_free;
+    size_t free_size;
+} lxw_mem_pool;
+
 /**
  * @brief Struct to represent an Excel worksheet.
  *
@@ -2118,10 +2140,26 @@ typedef struct lxw_worksheet {
     FILE *optimize_tmpfile;
     char *optimize_buffer;
     size_t optimize_buffer_size;
+    FILE *optimize_deflated_file;
+    char *optimize_deflated_buffer;
+    size_t optimize_deflated_buffer_size;
+    struct z_stream_s *optimize_stream;
+    unsigned long optimize_crc;
+    uint64_t optimize_data_size;
+    uint64_t optimize_data_offset;
+    uint64_t optimize_deflated_size;
+    uint64_t optimize_store_offset;
+    lxw_row_store *row_store;
+    int optimize_level;
+    int optimize_strategy;
+    uint8_t optimize_deflate;
+    uint8_t optimize_deflated;
+    uint8_t optimize_finished;
+    uint8_t optimize_splice;
+    lxw_xml_buffer *row_buffer;
     struct lxw_table_rows *table;
     struct lxw_table_rows *hyperlinks;
     struct lxw_table_rows *comments;
-    struct lxw_cell **array;
     struct lxw_merged_ranges *merged_ranges;
     struct lxw_selections *selections;
     struct lxw_data_validations *data_validations;
@@ -2129,8 +2167,8 @@ typedef struct lxw_worksheet {
     struct lxw_image_props *image_props;
     struct lxw_image_props *embedded_image_props;
     struct lxw_chart_props *chart_data;
-    struct lxw_drawing_rel_ids *drawing_rel_ids;
-    struct lxw_vml_drawing_rel_ids *vml_drawing_rel_ids;
+    lxw_hash_table *drawing_rel_ids;
+    lxw_hash_table *vml_drawing_rel_ids;
     struct lxw_comment_objs *comment_objs;
     struct lxw_comment_objs *header_image_objs;
     struct lxw_comment_objs *button_objs;
@@ -2143,6 +2181,9 @@ typedef struct lxw_worksheet {
     lxw_col_t dim_colmax;
 
     lxw_sst *sst;
+    lxw_sst *workbook_sst;
+    uint32_t *sst_remap;
+    uint8_t local_sst;
     const char *name;
     const char *quoted_name;
     const char *tmpdir;
@@ -2166,8 +2207,25 @@ typedef struct lxw_worksheet {
 
     uint8_t col_size_changed;
     uint8_t row_size_changed;
+    struct lxw_col_geometry *col_geometry;
+    lxw_col_t col_geometry_count;
+    uint8_t col_geometry_valid;
+    struct lxw_row_geometry *row_geometry;
+    uint32_t row_geometry_count;
+    uint8_t row_geometry_valid;
     uint8_t optimize;
-    struct lxw_row *optimize_row;
+    struct lxw_row *optimize_rows;
+    lxw_row_t optimize_first_row;
+    uint16_t optimize_num_rows;
+
+    const lxw_col_name *col_names;
+    char row_name[LXW_MAX_ROW_NAME_LENGTH];
+    uint8_t row_name_length;
+    lxw_row_t row_name_num;
+
+    lxw_mem_pool cell_pool;
+    lxw_mem_pool cell_extra_pool;
+    lxw_mem_pool row_pool;
 
     uint16_t fit_height;
     uint16_t fit_width;
@@ -2312,6 +2370,11 @@ typedef struct lxw_worksheet_init_data {
     uint16_t index;
     uint8_t hidden;
     uint8_t optimize;
+    uint16_t optimize_rows;
+    uint8_t local_sst;
+    int8_t deflate_level;
+    uint8_t deflate_strategy;
+    lxw_row_store *row_store;
     uint16_t *active_sheet;
     uint16_t *first_sheet;
     lxw_sst *sst;
@@ -2321,6 +2384,7 @@ typedef struct lxw_worksheet_init_data {
     lxw_format *default_url_format;
     uint16_t max_url_length;
     uint8_t use_1904_epoch;
+    const lxw_col_name *col_names;
 
 } lxw_worksheet_init_data;
 
@@ -2336,19 +2400,31 @@ typedef struct lxw_row {
     uint8_t data_changed;
     uint8_t height_changed;
 
-    struct lxw_table_cells *cells;
+    /* The row cells in column order. */
+    lxw_col_t num_cells;
+    lxw_col_t cells_size;
+    struct lxw_cell **cells;
 
     /* tree management pointers for tree.h. */
     RB_ENTRY (lxw_row) tree_pointers;
 } lxw_row;
 
-/* Struct to represent a worksheet cell. */
+/* Struct to hold the additional data used by formula, hyperlink and comment
+ * cells. It is kept separate from lxw_cell so that the number, string and
+ * blank cells, which are the majority of cells, are smaller. */
+typedef struct lxw_cell_extra {
+    double formula_result;
+    char *user_data1;
+    char *user_data2;
+    lxw_vml_obj *comment;
+} lxw_cell_extra;
+
+/* Struct to represent a worksheet cell. The type is one of cell_types. */
 typedef struct lxw_cell {
     lxw_row_t row_num;
     lxw_col_t col_num;
-    enum cell_types type;
+    uint8_t type;
     lxw_format *format;
-    lxw_vml_obj *comment;
 
     union {
         double number;
@@ -2356,23 +2432,9 @@ typedef struct lxw_cell {
         const char *string;
     } u;
 
-    double formula_result;
-    char *user_data1;
-    char *user_data2;
-    char *sst_string;
-
-    /* List pointers for tree.h. */
-    RB_ENTRY (lxw_cell) tree_pointers;
+    lxw_cell_extra *extra;
 } lxw_cell;
 
-/* Struct to represent a drawing Target/ID pair. */
-typedef struct lxw_drawing_rel_id {
-    uint32_t id;
-    char *target;
-
-    RB_ENTRY (lxw_drawing_rel_id) tree_pointers;
-} lxw_drawing_rel_id;
-
 
 
 /* *INDENT-OFF* */
@@ -2476,6 +2538,150 @@ lxw_error worksheet_write_string(lxw_worksheet *worksheet,
                                  lxw_row_t row,
                                  lxw_col_t col, const char *string,
                                  lxw_format *format);
+
+/**
+ * @brief Write a string from the shared string table to a worksheet cell.
+ *
+ * @param worksheet    Pointer to a lxw_worksheet instance to be updated.
+ * @param row          The zero indexed row number.
+ * @param col          The zero indexed column number.
+ * @param string_index The index of a string returned by
+ *                     `workbook_add_shared_strings()`.
+ * @param format       A pointer to a Format instance or NULL.
+ *
+ * @return A #lxw_error code.
+ *
+ * The `%worksheet_write_shared_string()` function writes a string that has
+ * already been added to the workbook with `workbook_add_shared_strings()` to
+ * the cell specified by `row` and `column`. It is the same as
+ * `worksheet_write_string()` except that the string doesn't need to be
+ * looked up in the shared string table:
+ *
+ * @code
+ *     const char *labels[] = {"Yes", "No"};
+ *     uint32_t indices[2];
+ *
+ *     workbook_add_shared_strings(workbook, labels, 2, indices);
+ *
+ *     worksheet_write_shared_string(worksheet, 0, 0, indices[0], NULL);
+ *     worksheet_write_shared_string(worksheet, 1, 0, indices[1], NULL);
+ * @endcode
+ *
+ * An invalid index returns #LXW_ERROR_SHARED_STRING_INDEX_NOT_FOUND.
+ */
+lxw_error worksheet_write_shared_string(lxw_worksheet *worksheet,
+                                        lxw_row_t row,
+                                        lxw_col_t col, uint32_t string_index,
+                                        lxw_format *format);
+
+/**
+ * @brief Write a row of numbers to consecutive worksheet cells.
+ *
+ * @param worksheet Pointer to a lxw_worksheet instance to be updated.
+ * @param row       The zero indexed row number.
+ * @param first_col The zero indexed column number of the first cell.
+ * @param numbers   An array of numbers to write.
+ * @param num_cols  The number of elements in the array.
+ * @param format    A pointer to a Format instance or NULL.
+ *
+ * @return A #lxw_error code.
+ *
+ * The `%worksheet_write_number_row()` function writes `num_cols` numbers to
+ * the cells in `row` starting at `first_col`. It is equivalent to calling
+ * `worksheet_write_number()` for each cell but the row is looked up and its
+ * cell storage is allocated once:
+ *
+ * @code
+ *     double data[] = {1, 2, 3, 4, 5};
+ *
+ *     worksheet_write_number_row(worksheet, 0, 0, data, 5, NULL);
+ * @endcode
+ *
+ * The range is checked before anything is written so an out of range row or
+ * column leaves the worksheet unchanged.
+ */
+lxw_error worksheet_write_number_row(lxw_worksheet *worksheet,
+                                     lxw_row_t row,
+                                     lxw_col_t first_col,
+                                     const double *numbers,
+                                     lxw_col_t num_cols, lxw_format *format);
+
+/**
+ * @brief Write a row of strings to consecutive worksheet cells.
+ *
+ * @param worksheet Pointer to a lxw_worksheet instance to be updated.
+ * @param row       The zero indexed row number.
+ * @param first_col The zero indexed column number of the first cell.
+ * @param strings   An array of UTF-8 strings to write.
+ * @param num_cols  The number of elements in the array.
+ * @param format    A pointer to a Format instance or NULL.
+ *
+ * @return A #lxw_error code.
+ *
+ * The `%worksheet_write_string_row()` function writes `num_cols` strings to
+ * the cells in `row` starting at `first_col`, in the same way as
+ * `worksheet_write_string()`:
+ *
+ * @code
+ *     const char *headers[] = {"Name", "Age", "City"};
+ *
+ *     worksheet_write_string_row(worksheet, 0, 0, headers, 3, bold);
+ * @endcode
+ *
+ * NULL or empty strings are written as blank cells if a format is
+ * specified and are otherwise ignored. The string lengths and range are
+ * checked before anything is written.
+ */
+lxw_error worksheet_write_string_row(lxw_worksheet *worksheet,
+                                     lxw_row_t row,
+                                     lxw_col_t first_col,
+                                     const char **strings,
+                                     lxw_col_t num_cols, lxw_format *format);
+
+/**
+ * @brief Write a 2D array of numbers to a block of worksheet cells.
+ *
+ * @param worksheet  Pointer to a lxw_worksheet instance to be updated.
+ * @param first_row  The zero indexed row number of the first cell.
+ * @param first_col  The zero indexed column number of the first cell.
+ * @param num_rows   The number of rows to write.
+ * @param num_cols   The number of columns to write.
+ * @param numbers    A pointer to the first number in the array.
+ * @param row_stride The distance, in elements, between rows in the array.
+ * @param col_stride The distance, in elements, between columns in the array.
+ * @param formats    An array of `num_cols` formats, one per column, or NULL.
+ *
+ * @return A #lxw_error code.
+ *
+ * The `%worksheet_write_number_array()` function writes a `num_rows` by
+ * `num_cols` block of numbers. The number for the cell at `(i, j)` in the
+ * block is read from `numbers[i * row_stride + j * col_stride]` so that both
+ * row-major and column-major arrays can be written without copying:
+ *
+ * @code
+ *     double row_major[2][3] = {{1, 2, 3}, {4, 5, 6}};
+ *     double col_major[3][2] = {{1, 4}, {2, 5}, {3, 6}};
+ *
+ *     // Both of these write the same 2 x 3 block.
+ *     worksheet_write_number_array(worksheet, 0, 0, 2, 3,
+ *                                  &row_major[0][0], 3, 1, NULL);
+ *     worksheet_write_number_array(worksheet, 0, 0, 2, 3,
+ *                                  &col_major[0][0], 1, 2, NULL);
+ * @endcode
+ *
+ * In `constant_memory` mode the rows must be written in order, as with the
+ * other write functions.
+ */
+lxw_error worksheet_write_number_array(lxw_worksheet *worksheet,
+                                       lxw_row_t first_row,
+                                       lxw_col_t first_col,
+                                       lxw_row_t num_rows,
+                                       lxw_col_t num_cols,
+                                       const double *numbers,
+                                       size_t row_stride,
+                                       size_t col_stride,
+                                       lxw_format **formats);
+
 /**
  * @brief Write a formula to a worksheet cell.
  *
@@ -5904,10 +6110,56 @@ void worksheet_set_comments_author(lxw_worksheet *worksheet,
 lxw_error worksheet_ignore_errors(lxw_worksheet *worksheet, uint8_t type,
                                   const char *range);
 
+/**
+ * @brief Finish writing the rows of a `constant_memory` worksheet.
+ *
+ * @param worksheet Pointer to a lxw_worksheet instance.
+ *
+ * @return A #lxw_error code.
+ *
+ * In `constant_memory` mode each worksheet keeps a temporary file, and a row
+ * buffer, open until the workbook is closed. When a large number of
+ * worksheets are written one after the other the `%worksheet_finish()`
+ * function can be used to release them as soon as the last row of a
+ * worksheet has been written:
+ *
+ * @code
+ *     for (i = 0; i < 100; i++) {
+ *         worksheet = workbook_add_worksheet(workbook, NULL);
+ *
+ *         for (row = 0; row < 10000; row++)
+ *             worksheet_write_number(worksheet, row, 0, row, NULL);
+ *
+ *         worksheet_finish(worksheet);
+ *     }
+ * @endcode
+ *
+ * The compressed rows are moved to a single temporary file that is shared by
+ * all the worksheets in the workbook so the number of open files, and the
+ * memory used, doesn't grow with the number of worksheets.
+ *
+ * Only the cell data is finished. Other worksheet settings such as column
+ * widths, page setup or charts can still be added. Any later attempt to
+ * write a cell or set a row in the worksheet returns
+ * #LXW_ERROR_WORKSHEET_INDEX_OUT_OF_RANGE.
+ *
+ * This function does nothing if `constant_memory` mode isn't on.
+ */
+lxw_error worksheet_finish(lxw_worksheet *worksheet);
+
 lxw_worksheet *lxw_worksheet_new(lxw_worksheet_init_data *init_data);
 void lxw_worksheet_free(lxw_worksheet *worksheet);
 void lxw_worksheet_assemble_xml_file(lxw_worksheet *worksheet);
-void lxw_worksheet_write_single_row(lxw_worksheet *worksheet);
+void lxw_worksheet_flush_rows(lxw_worksheet *worksheet);
+void lxw_worksheet_finish_optimized_rows(lxw_worksheet *worksheet);
+size_t lxw_worksheet_read_deflated_rows(lxw_worksheet *worksheet,
+                                        uint64_t offset, char *data,
+                                        size_t size);
+lxw_row_store *lxw_row_store_new(const char *tmpdir);
+void lxw_row_store_free(lxw_row_store *store);
+lxw_col_name *lxw_col_names_new(void);
+void lxw_worksheet_prepare_xf_indices(lxw_worksheet *worksheet);
+lxw_error lxw_worksheet_merge_sst(lxw_worksheet *worksheet);
 
 void lxw_worksheet_prepare_image(lxw_worksheet *worksheet,
                                  uint32_t image_ref_id, uint32_t drawing_id,
@@ -5967,12 +6219,17 @@ STATIC void _worksheet_write_sheet_view(lxw_worksheet *worksheet);
 STATIC void _worksheet_write_sheet_views(lxw_worksheet *worksheet);
 STATIC void _worksheet_write_sheet_format_pr(lxw_worksheet *worksheet);
 STATIC void _worksheet_write_sheet_data(lxw_worksheet *worksheet);
+STATIC void _worksheet_write_optimized_sheet_data(lxw_worksheet *worksheet);
 STATIC void _worksheet_write_page_margins(lxw_worksheet *worksheet);
 STATIC void _worksheet_write_page_setup(lxw_worksheet *worksheet);
 STATIC void _worksheet_write_col_info(lxw_worksheet *worksheet,
                                       lxw_col_options *options);
-STATIC void _write_row(lxw_worksheet *worksheet, lxw_row *row, char *spans);
-STATIC lxw_row *_get_row_list(struct lxw_table_rows *table,
+STATIC void _write_row(lxw_worksheet *worksheet, lxw_xml_buffer *buffer,
+                       lxw_row *row, char *spans);
+STATIC void *_pool_alloc(lxw_mem_pool *pool);
+STATIC void _pool_release(lxw_mem_pool *pool, void *item);
+STATIC lxw_row *_get_row_list(lxw_worksheet *worksheet,
+                              struct lxw_table_rows *table,
                               lxw_row_t row_num);
 
 STATIC void _worksheet_write_merge_cell(lxw_worksheet *worksheet,
@@ -5994,6 +6251,36 @@ STATIC double _pixels_to_height(double pixels);
 STATIC double _pixels_to_width(double pixels);
 
 STATIC void _worksheet_write_auto_filter(lxw_worksheet *worksheet);
+
+STATIC void _set_row_name(lxw_worksheet *worksheet, lxw_row_t row_num);
+STATIC void _get_cell_reference(lxw_worksheet *worksheet, char *range,
+                                lxw_row_t row_num, lxw_col_t col_num);
+
+STATIC int32_t _worksheet_size_col(lxw_worksheet *worksheet,
+                                   lxw_col_t col_num, uint8_t anchor);
+STATIC int32_t _worksheet_size_row(lxw_worksheet *worksheet,
+                                   lxw_row_t row_num, uint8_t anchor);
+STATIC uint32_t _worksheet_col_position(lxw_worksheet *worksheet,
+                                        lxw_col_t col_num);
+STATIC uint32_t _worksheet_row_position(lxw_worksheet *worksheet,
+                                        lxw_row_t row_num);
+
+STATIC const unsigned char *_image_data_read(const unsigned char *data,
+                                             size_t size, size_t *position,
+                                             size_t count);
+STATIC void _image_data_skip(size_t size, size_t *position, size_t count);
+STATIC uint32_t _image_uint32_be(const unsigned char *bytes);
+STATIC uint16_t _image_uint16_be(const unsigned char *bytes);
+STATIC uint32_t _image_uint32_le(const unsigned char *bytes);
+STATIC uint16_t _image_uint16_le(const unsigned char *bytes);
+STATIC lxw_error _process_png(lxw_object_properties *object_props,
+                              const unsigned char *data, size_t size);
+STATIC lxw_error _process_jpeg(lxw_object_properties *image_props,
+                               const unsigned char *data, size_t size);
+STATIC lxw_error _process_bmp(lxw_object_properties *image_props,
+                              const unsigned char *data, size_t size);
+STATIC lxw_error _process_gif(lxw_object_properties *image_props,
+                              const unsigned char *data, size_t size);
 #endif /* TESTING */
 
 /* *INDENT-OFF* */
@@ -27,11 +27,19 @@
 
 #define LXW_MAX_ATTRIBUTE_LENGTH 2080   /* Max URL length. */
 #define LXW_ATTR_32              32
+#define LXW_XML_BUFFER_SIZE      2048
 
+#define LXW_MAX_ATTRIBUTES       16
+
+/* Copy a string into an attribute array without the zero padding of
+ * strncpy(), which would fill the whole array for every attribute. */
 #define LXW_ATTRIBUTE_COPY(dst, src)                    \
     do{                                                 \
-        strncpy(dst, src, LXW_MAX_ATTRIBUTE_LENGTH -1); \
-        dst[LXW_MAX_ATTRIBUTE_LENGTH - 1] = '\0';       \
+        size_t len = strlen(src);                       \
+        if (len > LXW_MAX_ATTRIBUTE_LENGTH - 1)         \
+            len = LXW_MAX_ATTRIBUTE_LENGTH - 1;         \
+        memcpy(dst, src, len);                          \
+        dst[len] = '\0';                                \
     } while (0)
 
 
@@ -53,6 +61,83 @@ struct xml_attribute {
 /* Use queue.h macros to define the xml_attribute_list type. */
 STAILQ_HEAD(xml_attribute_list, xml_attribute);
 
+/* Attribute types for lxw_attributes. */
+enum lxw_attribute_types {
+    LXW_ATTRIBUTE_STR,
+    LXW_ATTRIBUTE_INT,
+    LXW_ATTRIBUTE_DBL
+};
+
+/* Attribute stored in a lxw_attributes array. String keys and values aren't
+ * copied so they must remain valid until the tag is written. */
+typedef struct lxw_attribute {
+    const char *key;
+    uint8_t type;
+
+    union {
+        const char *string;
+        int32_t integer;
+        double number;
+    } u;
+} lxw_attribute;
+
+/* Fixed size array of attributes that can be declared on the stack. This is
+ * used instead of xml_attribute_list in the cell writing loops to avoid the
+ * memory allocation and string copying for each attribute. */
+typedef struct lxw_attributes {
+    uint8_t count;
+    lxw_attribute list[LXW_MAX_ATTRIBUTES];
+} lxw_attributes;
+
+/* Buffer used to assemble XML elements in memory so that they are written to
+ * the file in blocks rather than with several fprintf() calls per element.
+ * Buffers on the stack use the local data and buffers created with
+ * lxw_xml_buffer_new() use a larger allocated block. */
+typedef struct lxw_xml_buffer {
+    FILE *file;
+    char *data;
+    size_t length;
+    size_t size;
+    char local_data[LXW_XML_BUFFER_SIZE];
+} lxw_xml_buffer;
+
+/* Macro to append a string literal to a lxw_xml_buffer. */
+#define LXW_XML_BUFFER_APPEND_LITERAL(buffer, literal)          \
+    lxw_xml_buffer_append((buffer), (literal), sizeof(literal) - 1)
+
+void lxw_xml_buffer_init(lxw_xml_buffer *buffer, FILE *file);
+lxw_xml_buffer *lxw_xml_buffer_new(FILE *file, size_t size);
+void lxw_xml_buffer_free(lxw_xml_buffer *buffer);
+void lxw_xml_buffer_flush(lxw_xml_buffer *buffer);
+void lxw_xml_buffer_append(lxw_xml_buffer *buffer, const char *data,
+                           size_t length);
+void lxw_xml_buffer_append_str(lxw_xml_buffer *buffer, const char *string);
+void lxw_xml_buffer_append_int(lxw_xml_buffer *buffer, int32_t value);
+void lxw_xml_buffer_append_dbl(lxw_xml_buffer *buffer, double value);
+void lxw_xml_buffer_append_escaped(lxw_xml_buffer *buffer,
+                                   const char *string,
+                                   uint8_t escape_attribute);
+
+/* Add attributes to a lxw_attributes array. Attributes beyond
+ * LXW_MAX_ATTRIBUTES are ignored. */
+void lxw_attributes_init(lxw_attributes *attributes);
+void lxw_attributes_push_str(lxw_attributes *attributes, const char *key,
+                             const char *value);
+void lxw_attributes_push_int(lxw_attributes *attributes, const char *key,
+                             int32_t value);
+void lxw_attributes_push_dbl(lxw_attributes *attributes, const char *key,
+                             double value);
+
+/* Append XML elements, with optional lxw_attributes, to a buffer. */
+void lxw_xml_buffer_start_tag(lxw_xml_buffer *buffer, const char *tag,
+                              lxw_attributes *attributes);
+void lxw_xml_buffer_empty_tag(lxw_xml_buffer *buffer, const char *tag,
+                              lxw_attributes *attributes);
+void lxw_xml_buffer_end_tag(lxw_xml_buffer *buffer, const char *tag);
+void lxw_xml_buffer_data_element(lxw_xml_buffer *buffer, const char *tag,
+                                 const char *data,
+                                 lxw_attributes *attributes);
+
 /* Create a new attribute struct to add to a xml_attribute_list. */
 struct xml_attribute *lxw_new_attribute_str(const char *key,
                                             const char *value);
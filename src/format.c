@@ -12,6 +12,18 @@
 #include "xlsxwriter/format.h"
 #include "xlsxwriter/utility.h"
 
+/* Hash constants built from 32 bit halves for C89. */
+#define LXW_FORMAT_HASH_MULTIPLIER1 \
+    (((uint64_t) 0x9E3779B9UL << 32) | 0x7F4A7C15UL)
+#define LXW_FORMAT_HASH_MULTIPLIER2 \
+    (((uint64_t) 0xBF58476DUL << 32) | 0x1CE4E5B9UL)
+#define LXW_FORMAT_HASH_MULTIPLIER3 \
+    (((uint64_t) 0x94D049BBUL << 32) | 0x133111EBUL)
+#define LXW_FORMAT_FNV_OFFSET \
+    (((uint64_t) 0xCBF29CE4UL << 32) | 0x84222325UL)
+#define LXW_FORMAT_FNV_PRIME \
+    (((uint64_t) 0x00000100UL << 32) | 0x000001B3UL)
+
 /*****************************************************************************
  *
  * Private functions.
@@ -121,6 +133,175 @@ lxw_format_free(lxw_format *format)
     format = NULL;
 }
 
+/*
+ * Calculate the fingerprint contribution of a format property from its
+ * offset in the lxw_format struct and its value. The final mix is from
+ * the SplitMix64 generator.
+ */
+STATIC uint64_t
+_fingerprint_term(size_t offset, uint64_t value)
+{
+    uint64_t hash = value + offset * LXW_FORMAT_HASH_MULTIPLIER1;
+
+    hash ^= hash >> 30;
+    hash *= LXW_FORMAT_HASH_MULTIPLIER2;
+    hash ^= hash >> 27;
+    hash *= LXW_FORMAT_HASH_MULTIPLIER3;
+    hash ^= hash >> 31;
+
+    return hash;
+}
+
+/*
+ * Calculate a 64 bit FNV-1a hash of a string format property so that it
+ * can be added to the fingerprint like the numeric properties.
+ */
+STATIC uint64_t
+_fingerprint_string(const char *string)
+{
+    const unsigned char *p = (const unsigned char *) string;
+    uint64_t hash = LXW_FORMAT_FNV_OFFSET;
+
+    while (*p) {
+        hash ^= *p++;
+        hash *= LXW_FORMAT_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/*
+ * Set a string format property and update the format fingerprint.
+ */
+STATIC void
+_set_string_property(lxw_format *self, char *property, size_t offset,
+                     const char *value)
+{
+    uint64_t old_value = _fingerprint_string(property);
+
+    LXW_FORMAT_FIELD_COPY(property, value);
+
+    lxw_format_update_fingerprint(self, offset, old_value,
+                                  _fingerprint_string(property));
+}
+
+/*
+ * Fill a compact key with the format properties that are compared to check
+ * if two formats are the same. The string properties are compared
+ * separately.
+ */
+STATIC void
+_get_format_key(lxw_format *self, lxw_format_key *key)
+{
+    /* Clear any struct padding since the keys are compared with memcmp(). */
+    memset(key, 0, sizeof(lxw_format_key));
+
+    key->font_size = self->font_size;
+    key->xf_id = self->xf_id;
+    key->font_color = self->font_color;
+    key->fg_color = self->fg_color;
+    key->bg_color = self->bg_color;
+    key->bottom_color = self->bottom_color;
+    key->diag_color = self->diag_color;
+    key->left_color = self->left_color;
+    key->right_color = self->right_color;
+    key->top_color = self->top_color;
+    key->num_format_index = self->num_format_index;
+    key->rotation = self->rotation;
+    key->bold = self->bold;
+    key->italic = self->italic;
+    key->underline = self->underline;
+    key->font_strikeout = self->font_strikeout;
+    key->font_outline = self->font_outline;
+    key->font_shadow = self->font_shadow;
+    key->font_script = self->font_script;
+    key->font_family = self->font_family;
+    key->font_charset = self->font_charset;
+    key->font_condense = self->font_condense;
+    key->font_extend = self->font_extend;
+    key->theme = self->theme;
+    key->hyperlink = self->hyperlink;
+    key->hidden = self->hidden;
+    key->locked = self->locked;
+    key->text_h_align = self->text_h_align;
+    key->text_wrap = self->text_wrap;
+    key->text_v_align = self->text_v_align;
+    key->text_justlast = self->text_justlast;
+    key->pattern = self->pattern;
+    key->bottom = self->bottom;
+    key->diag_border = self->diag_border;
+    key->diag_type = self->diag_type;
+    key->left = self->left;
+    key->right = self->right;
+    key->top = self->top;
+    key->indent = self->indent;
+    key->shrink = self->shrink;
+    key->merge_range = self->merge_range;
+    key->reading_order = self->reading_order;
+    key->just_distrib = self->just_distrib;
+    key->color_indexed = self->color_indexed;
+    key->font_only = self->font_only;
+    key->quote_prefix = self->quote_prefix;
+}
+
+/*
+ * Check if two formats have the same properties.
+ */
+STATIC uint8_t
+_format_is_equal(lxw_format *format1, lxw_format *format2)
+{
+    lxw_format_key key1;
+    lxw_format_key key2;
+
+    _get_format_key(format1, &key1);
+    _get_format_key(format2, &key2);
+
+    if (memcmp(&key1, &key2, sizeof(lxw_format_key)) != 0)
+        return LXW_FALSE;
+
+    return strcmp(format1->num_format, format2->num_format) == 0
+        && strcmp(format1->font_name, format2->font_name) == 0
+        && strcmp(format1->font_scheme, format2->font_scheme) == 0;
+}
+
+/*
+ * Find a format with the same properties in a hash table of used formats,
+ * or add the format to the table if there isn't one. The table is keyed
+ * on the format fingerprint. If two different formats have the same
+ * fingerprint the next fingerprint value is tried, in the same way as
+ * linear probing. Returns NULL on memory error.
+ */
+STATIC lxw_format *
+_find_or_insert_format(lxw_hash_table *formats_hash_table, lxw_format *self)
+{
+    uint64_t fingerprint = self->fingerprint;
+    uint64_t *format_key;
+    lxw_hash_element *hash_element;
+
+    while ((hash_element = lxw_hash_key_exists(formats_hash_table,
+                                               &fingerprint,
+                                               sizeof(uint64_t)))) {
+
+        if (_format_is_equal(hash_element->value, self))
+            return hash_element->value;
+
+        fingerprint++;
+    }
+
+    format_key = calloc(1, sizeof(uint64_t));
+    RETURN_ON_MEM_ERROR(format_key, NULL);
+
+    *format_key = fingerprint;
+
+    if (!lxw_insert_hash_element(formats_hash_table, format_key, self,
+                                 sizeof(uint64_t))) {
+        free(format_key);
+        return NULL;
+    }
+
+    return self;
+}
+
 /*
  * Check a user input border.
  */
@@ -140,28 +321,21 @@ _check_border(uint8_t border)
  ****************************************************************************/
 
 /*
- * Returns a format struct suitable for hashing as a lookup key. This is
- * mainly a memcpy with any pointer members set to NULL.
+ * Update the format fingerprint when a property changes. The fingerprint is
+ * the xor of a hash of each property value so a property can be replaced by
+ * removing the hash of its old value and adding the hash of its new value.
+ * Formats with the same properties have the same fingerprint, independent of
+ * the order the properties were set in.
  */
-STATIC lxw_format *
-_get_format_key(lxw_format *self)
+void
+lxw_format_update_fingerprint(lxw_format *self, size_t offset,
+                              uint64_t old_value, uint64_t new_value)
 {
-    lxw_format *key = calloc(1, sizeof(lxw_format));
-    GOTO_LABEL_ON_MEM_ERROR(key, mem_error);
-
-    memcpy(key, self, sizeof(lxw_format));
-
-    /* Set pointer members to NULL since they aren't part of the comparison. */
-    key->xf_format_indices = NULL;
-    key->dxf_format_indices = NULL;
-    key->num_xf_formats = NULL;
-    key->num_dxf_formats = NULL;
-    key->list_pointers.stqe_next = NULL;
-
-    return key;
+    if (old_value == new_value)
+        return;
 
-mem_error:
-    return NULL;
+    self->fingerprint ^= _fingerprint_term(offset, old_value);
+    self->fingerprint ^= _fingerprint_term(offset, new_value);
 }
 
 /*
@@ -242,16 +416,13 @@ mem_error:
 }
 
 /*
- * Returns the XF index number used by Excel to identify a format.
+ * Get the XF index of a format, or assign one if it doesn't have one.
  */
-int32_t
-lxw_format_get_xf_index(lxw_format *self)
+STATIC int32_t
+_get_xf_index(lxw_format *self)
 {
-    lxw_format *format_key;
     lxw_format *existing_format;
-    lxw_hash_element *hash_element;
     lxw_hash_table *formats_hash_table = self->xf_format_indices;
-    int32_t index;
 
     /* Note: The formats_hash_table/xf_format_indices contains the unique and
      * more importantly the *used* formats in the workbook.
@@ -262,47 +433,48 @@ lxw_format_get_xf_index(lxw_format *self)
         return self->xf_index;
     }
 
-    /* Otherwise, the format doesn't have an index number so we assign one.
-     * First generate a unique key to identify the format in the hash table.
-     */
-    format_key = _get_format_key(self);
+    /* Otherwise, the format doesn't have an index number so we look for a
+     * format with the same properties or assign a new index. */
+    existing_format = _find_or_insert_format(formats_hash_table, self);
 
-    /* Return the default format index if the key generation failed. */
-    if (!format_key)
+    /* Return the default format index if the lookup failed. */
+    if (!existing_format)
         return 0;
 
-    /* Look up the format in the hash table. */
-    hash_element =
-        lxw_hash_key_exists(formats_hash_table, format_key,
-                            sizeof(lxw_format));
-
-    if (hash_element) {
-        /* Format matches existing format with an index. */
-        free(format_key);
-        existing_format = hash_element->value;
-        return existing_format->xf_index;
-    }
-    else {
+    if (existing_format == self) {
         /* New format requiring an index. */
-        index = formats_hash_table->unique_count;
-        self->xf_index = index;
-        lxw_insert_hash_element(formats_hash_table, format_key, self,
-                                sizeof(lxw_format));
-        return index;
+        self->xf_index = formats_hash_table->unique_count - 1;
     }
+
+    /* Format matches existing format with an index. */
+    return existing_format->xf_index;
 }
 
 /*
- * Returns the DXF index number used by Excel to identify a format.
+ * Returns the XF index number used by Excel to identify a format. The used
+ * formats table is shared by the worksheets so the lookup is locked when the
+ * worksheets are written to concurrently.
  */
 int32_t
-lxw_format_get_dxf_index(lxw_format *self)
+lxw_format_get_xf_index(lxw_format *self)
+{
+    int32_t index;
+
+    lxw_mutex_lock(self->index_mutex);
+    index = _get_xf_index(self);
+    lxw_mutex_unlock(self->index_mutex);
+
+    return index;
+}
+
+/*
+ * Get the DXF index of a format, or assign one if it doesn't have one.
+ */
+STATIC int32_t
+_get_dxf_index(lxw_format *self)
 {
-    lxw_format *format_key;
     lxw_format *existing_format;
-    lxw_hash_element *hash_element;
     lxw_hash_table *formats_hash_table = self->dxf_format_indices;
-    int32_t index;
 
     /* Note: The formats_hash_table/dxf_format_indices contains the unique and
      * more importantly the *used* formats in the workbook.
@@ -313,34 +485,38 @@ lxw_format_get_dxf_index(lxw_format *self)
         return self->dxf_index;
     }
 
-    /* Otherwise, the format doesn't have an index number so we assign one.
-     * First generate a unique key to identify the format in the hash table.
-     */
-    format_key = _get_format_key(self);
+    /* Otherwise, the format doesn't have an index number so we look for a
+     * format with the same properties or assign a new index. */
+    existing_format = _find_or_insert_format(formats_hash_table, self);
 
-    /* Return the default format index if the key generation failed. */
-    if (!format_key)
+    /* Return the default format index if the lookup failed. */
+    if (!existing_format)
         return 0;
 
-    /* Look up the format in the hash table. */
-    hash_element =
-        lxw_hash_key_exists(formats_hash_table, format_key,
-                            sizeof(lxw_format));
-
-    if (hash_element) {
-        /* Format matches existing format with an index. */
-        free(format_key);
-        existing_format = hash_element->value;
-        return existing_format->dxf_index;
-    }
-    else {
+    if (existing_format == self) {
         /* New format requiring an index. */
-        index = formats_hash_table->unique_count;
-        self->dxf_index = index;
-        lxw_insert_hash_element(formats_hash_table, format_key, self,
-                                sizeof(lxw_format));
-        return index;
+        self->dxf_index = formats_hash_table->unique_count - 1;
     }
+
+    /* Format matches existing format with an index. */
+    return existing_format->dxf_index;
+}
+
+/*
+ * Returns the DXF index number used by Excel to identify a format. The used
+ * formats table is shared by the worksheets so the lookup is locked when the
+ * worksheets are written to concurrently.
+ */
+int32_t
+lxw_format_get_dxf_index(lxw_format *self)
+{
+    int32_t index;
+
+    lxw_mutex_lock(self->index_mutex);
+    index = _get_dxf_index(self);
+    lxw_mutex_unlock(self->index_mutex);
+
+    return index;
 }
 
 /*
@@ -349,7 +525,8 @@ lxw_format_get_dxf_index(lxw_format *self)
 void
 format_set_font_name(lxw_format *self, const char *font_name)
 {
-    LXW_FORMAT_FIELD_COPY(self->font_name, font_name);
+    _set_string_property(self, self->font_name,
+                         offsetof(lxw_format, font_name), font_name);
 }
 
 /*
@@ -358,9 +535,18 @@ format_set_font_name(lxw_format *self, const char *font_name)
 void
 format_set_font_size(lxw_format *self, double size)
 {
+    uint64_t old_value;
+    uint64_t new_value;
 
-    if (size >= LXW_MIN_FONT_SIZE && size <= LXW_MAX_FONT_SIZE)
+    if (size >= LXW_MIN_FONT_SIZE && size <= LXW_MAX_FONT_SIZE) {
+        /* Use the bit pattern of the double for the fingerprint. */
+        memcpy(&old_value, &self->font_size, sizeof(uint64_t));
+        memcpy(&new_value, &size, sizeof(uint64_t));
+
+        lxw_format_update_fingerprint(self, offsetof(lxw_format, font_size),
+                                      old_value, new_value);
         self->font_size = size;
+    }
 }
 
 /*
@@ -369,7 +555,7 @@ format_set_font_size(lxw_format *self, double size)
 void
 format_set_font_color(lxw_format *self, lxw_color_t color)
 {
-    self->font_color = color;
+    LXW_FORMAT_SET_PROPERTY(self, font_color, color);
 }
 
 /*
@@ -378,7 +564,7 @@ format_set_font_color(lxw_format *self, lxw_color_t color)
 void
 format_set_bold(lxw_format *self)
 {
-    self->bold = LXW_TRUE;
+    LXW_FORMAT_SET_PROPERTY(self, bold, LXW_TRUE);
 }
 
 /*
@@ -388,7 +574,7 @@ format_set_bold(lxw_format *self)
 void
 format_set_italic(lxw_format *self)
 {
-    self->italic = LXW_TRUE;
+    LXW_FORMAT_SET_PROPERTY(self, italic, LXW_TRUE);
 }
 
 /*
@@ -399,7 +585,7 @@ format_set_underline(lxw_format *self, uint8_t style)
 {
     if (style >= LXW_UNDERLINE_SINGLE
         && style <= LXW_UNDERLINE_DOUBLE_ACCOUNTING)
-        self->underline = style;
+        LXW_FORMAT_SET_PROPERTY(self, underline, style);
 }
 
 /*
@@ -408,7 +594,7 @@ format_set_underline(lxw_format *self, uint8_t style)
 void
 format_set_font_strikeout(lxw_format *self)
 {
-    self->font_strikeout = LXW_TRUE;
+    LXW_FORMAT_SET_PROPERTY(self, font_strikeout, LXW_TRUE);
 }
 
 /*
@@ -418,7 +604,7 @@ void
 format_set_font_script(lxw_format *self, uint8_t style)
 {
     if (style >= LXW_FONT_SUPERSCRIPT && style <= LXW_FONT_SUBSCRIPT)
-        self->font_script = style;
+        LXW_FORMAT_SET_PROPERTY(self, font_script, style);
 }
 
 /*
@@ -427,7 +613,7 @@ format_set_font_script(lxw_format *self, uint8_t style)
 void
 format_set_font_outline(lxw_format *self)
 {
-    self->font_outline = LXW_TRUE;
+    LXW_FORMAT_SET_PROPERTY(self, font_outline, LXW_TRUE);
 }
 
 /*
@@ -436,7 +622,7 @@ format_set_font_outline(lxw_format *self)
 void
 format_set_font_shadow(lxw_format *self)
 {
-    self->font_shadow = LXW_TRUE;
+    LXW_FORMAT_SET_PROPERTY(self, font_shadow, LXW_TRUE);
 }
 
 /*
@@ -445,7 +631,8 @@ format_set_font_shadow(lxw_format *self)
 void
 format_set_num_format(lxw_format *self, const char *num_format)
 {
-    LXW_FORMAT_FIELD_COPY(self->num_format, num_format);
+    _set_string_property(self, self->num_format,
+                         offsetof(lxw_format, num_format), num_format);
 }
 
 /*
@@ -454,7 +641,7 @@ format_set_num_format(lxw_format *self, const char *num_format)
 void
 format_set_unlocked(lxw_format *self)
 {
-    self->locked = LXW_FALSE;
+    LXW_FORMAT_SET_PROPERTY(self, locked, LXW_FALSE);
 }
 
 /*
@@ -463,7 +650,7 @@ format_set_unlocked(lxw_format *self)
 void
 format_set_hidden(lxw_format *self)
 {
-    self->hidden = LXW_TRUE;
+    LXW_FORMAT_SET_PROPERTY(self, hidden, LXW_TRUE);
 }
 
 /*
@@ -473,12 +660,12 @@ void
 format_set_align(lxw_format *self, uint8_t value)
 {
     if (value >= LXW_ALIGN_LEFT && value <= LXW_ALIGN_DISTRIBUTED) {
-        self->text_h_align = value;
+        LXW_FORMAT_SET_PROPERTY(self, text_h_align, value);
     }
 
     if (value >= LXW_ALIGN_VERTICAL_TOP
         && value <= LXW_ALIGN_VERTICAL_DISTRIBUTED) {
-        self->text_v_align = value;
+        LXW_FORMAT_SET_PROPERTY(self, text_v_align, value);
     }
 }
 
@@ -488,7 +675,7 @@ format_set_align(lxw_format *self, uint8_t value)
 void
 format_set_text_wrap(lxw_format *self)
 {
-    self->text_wrap = LXW_TRUE;
+    LXW_FORMAT_SET_PROPERTY(self, text_wrap, LXW_TRUE);
 }
 
 /*
@@ -499,17 +686,17 @@ format_set_rotation(lxw_format *self, int16_t angle)
 {
     /* Convert user angle to Excel angle. */
     if (angle == 270) {
-        self->rotation = 255;
+        LXW_FORMAT_SET_PROPERTY(self, rotation, 255);
     }
     else if (angle >= -90 && angle <= 90) {
         if (angle < 0)
             angle = -angle + 90;
 
-        self->rotation = angle;
+        LXW_FORMAT_SET_PROPERTY(self, rotation, angle);
     }
     else {
         LXW_WARN("Rotation rotation outside range: -90 <= angle <= 90.");
-        self->rotation = 0;
+        LXW_FORMAT_SET_PROPERTY(self, rotation, 0);
     }
 }
 
@@ -519,7 +706,7 @@ format_set_rotation(lxw_format *self, int16_t angle)
 void
 format_set_indent(lxw_format *self, uint8_t value)
 {
-    self->indent = value;
+    LXW_FORMAT_SET_PROPERTY(self, indent, value);
 }
 
 /*
@@ -528,7 +715,7 @@ format_set_indent(lxw_format *self, uint8_t value)
 void
 format_set_shrink(lxw_format *self)
 {
-    self->shrink = LXW_TRUE;
+    LXW_FORMAT_SET_PROPERTY(self, shrink, LXW_TRUE);
 }
 
 /*
@@ -537,7 +724,7 @@ format_set_shrink(lxw_format *self)
 void
 format_set_text_justlast(lxw_format *self)
 {
-    self->text_justlast = LXW_TRUE;
+    LXW_FORMAT_SET_PROPERTY(self, text_justlast, LXW_TRUE);
 }
 
 /*
@@ -552,7 +739,7 @@ format_set_pattern(lxw_format *self, uint8_t value)
         return;
     }
 
-    self->pattern = value;
+    LXW_FORMAT_SET_PROPERTY(self, pattern, value);
 }
 
 /*
@@ -561,7 +748,7 @@ format_set_pattern(lxw_format *self, uint8_t value)
 void
 format_set_bg_color(lxw_format *self, lxw_color_t color)
 {
-    self->bg_color = color;
+    LXW_FORMAT_SET_PROPERTY(self, bg_color, color);
 }
 
 /*
@@ -570,7 +757,7 @@ format_set_bg_color(lxw_format *self, lxw_color_t color)
 void
 format_set_fg_color(lxw_format *self, lxw_color_t color)
 {
-    self->fg_color = color;
+    LXW_FORMAT_SET_PROPERTY(self, fg_color, color);
 }
 
 /*
@@ -580,10 +767,10 @@ void
 format_set_border(lxw_format *self, uint8_t style)
 {
     style = _check_border(style);
-    self->bottom = style;
-    self->top = style;
-    self->left = style;
-    self->right = style;
+    LXW_FORMAT_SET_PROPERTY(self, bottom, style);
+    LXW_FORMAT_SET_PROPERTY(self, top, style);
+    LXW_FORMAT_SET_PROPERTY(self, left, style);
+    LXW_FORMAT_SET_PROPERTY(self, right, style);
 }
 
 /*
@@ -592,10 +779,10 @@ format_set_border(lxw_format *self, uint8_t style)
 void
 format_set_border_color(lxw_format *self, lxw_color_t color)
 {
-    self->bottom_color = color;
-    self->top_color = color;
-    self->left_color = color;
-    self->right_color = color;
+    LXW_FORMAT_SET_PROPERTY(self, bottom_color, color);
+    LXW_FORMAT_SET_PROPERTY(self, top_color, color);
+    LXW_FORMAT_SET_PROPERTY(self, left_color, color);
+    LXW_FORMAT_SET_PROPERTY(self, right_color, color);
 }
 
 /*
@@ -604,7 +791,7 @@ format_set_border_color(lxw_format *self, lxw_color_t color)
 void
 format_set_bottom(lxw_format *self, uint8_t style)
 {
-    self->bottom = _check_border(style);
+    LXW_FORMAT_SET_PROPERTY(self, bottom, _check_border(style));
 }
 
 /*
@@ -613,7 +800,7 @@ format_set_bottom(lxw_format *self, uint8_t style)
 void
 format_set_bottom_color(lxw_format *self, lxw_color_t color)
 {
-    self->bottom_color = color;
+    LXW_FORMAT_SET_PROPERTY(self, bottom_color, color);
 }
 
 /*
@@ -622,7 +809,7 @@ format_set_bottom_color(lxw_format *self, lxw_color_t color)
 void
 format_set_left(lxw_format *self, uint8_t style)
 {
-    self->left = _check_border(style);
+    LXW_FORMAT_SET_PROPERTY(self, left, _check_border(style));
 }
 
 /*
@@ -631,7 +818,7 @@ format_set_left(lxw_format *self, uint8_t style)
 void
 format_set_left_color(lxw_format *self, lxw_color_t color)
 {
-    self->left_color = color;
+    LXW_FORMAT_SET_PROPERTY(self, left_color, color);
 }
 
 /*
@@ -640,7 +827,7 @@ format_set_left_color(lxw_format *self, lxw_color_t color)
 void
 format_set_right(lxw_format *self, uint8_t style)
 {
-    self->right = _check_border(style);
+    LXW_FORMAT_SET_PROPERTY(self, right, _check_border(style));
 }
 
 /*
@@ -649,7 +836,7 @@ format_set_right(lxw_format *self, uint8_t style)
 void
 format_set_right_color(lxw_format *self, lxw_color_t color)
 {
-    self->right_color = color;
+    LXW_FORMAT_SET_PROPERTY(self, right_color, color);
 }
 
 /*
@@ -658,7 +845,7 @@ format_set_right_color(lxw_format *self, lxw_color_t color)
 void
 format_set_top(lxw_format *self, uint8_t style)
 {
-    self->top = _check_border(style);
+    LXW_FORMAT_SET_PROPERTY(self, top, _check_border(style));
 }
 
 /*
@@ -667,7 +854,7 @@ format_set_top(lxw_format *self, uint8_t style)
 void
 format_set_top_color(lxw_format *self, lxw_color_t color)
 {
-    self->top_color = color;
+    LXW_FORMAT_SET_PROPERTY(self, top_color, color);
 }
 
 /*
@@ -677,7 +864,7 @@ void
 format_set_diag_type(lxw_format *self, uint8_t type)
 {
     if (type >= LXW_DIAGONAL_BORDER_UP && type <= LXW_DIAGONAL_BORDER_UP_DOWN)
-        self->diag_type = type;
+        LXW_FORMAT_SET_PROPERTY(self, diag_type, type);
 }
 
 /*
@@ -686,7 +873,7 @@ format_set_diag_type(lxw_format *self, uint8_t type)
 void
 format_set_diag_color(lxw_format *self, lxw_color_t color)
 {
-    self->diag_color = color;
+    LXW_FORMAT_SET_PROPERTY(self, diag_color, color);
 }
 
 /*
@@ -701,7 +888,7 @@ format_set_diag_border(lxw_format *self, uint8_t style)
         return;
     }
 
-    self->diag_border = style;
+    LXW_FORMAT_SET_PROPERTY(self, diag_border, style);
 }
 
 /*
@@ -710,7 +897,7 @@ format_set_diag_border(lxw_format *self, uint8_t style)
 void
 format_set_num_format_index(lxw_format *self, uint8_t value)
 {
-    self->num_format_index = value;
+    LXW_FORMAT_SET_PROPERTY(self, num_format_index, value);
 }
 
 /*
@@ -726,7 +913,7 @@ format_set_valign(lxw_format *self, uint8_t value)
         return;
     }
 
-    self->text_v_align = value;
+    LXW_FORMAT_SET_PROPERTY(self, text_v_align, value);
 }
 
 /*
@@ -735,7 +922,7 @@ format_set_valign(lxw_format *self, uint8_t value)
 void
 format_set_reading_order(lxw_format *self, uint8_t value)
 {
-    self->reading_order = value;
+    LXW_FORMAT_SET_PROPERTY(self, reading_order, value);
 }
 
 /*
@@ -744,7 +931,7 @@ format_set_reading_order(lxw_format *self, uint8_t value)
 void
 format_set_font_family(lxw_format *self, uint8_t value)
 {
-    self->font_family = value;
+    LXW_FORMAT_SET_PROPERTY(self, font_family, value);
 }
 
 /*
@@ -753,7 +940,7 @@ format_set_font_family(lxw_format *self, uint8_t value)
 void
 format_set_font_charset(lxw_format *self, uint8_t value)
 {
-    self->font_charset = value;
+    LXW_FORMAT_SET_PROPERTY(self, font_charset, value);
 }
 
 /*
@@ -762,7 +949,8 @@ format_set_font_charset(lxw_format *self, uint8_t value)
 void
 format_set_font_scheme(lxw_format *self, const char *font_scheme)
 {
-    LXW_FORMAT_FIELD_COPY(self->font_scheme, font_scheme);
+    _set_string_property(self, self->font_scheme,
+                         offsetof(lxw_format, font_scheme), font_scheme);
 }
 
 /*
@@ -771,7 +959,7 @@ format_set_font_scheme(lxw_format *self, const char *font_scheme)
 void
 format_set_font_condense(lxw_format *self)
 {
-    self->font_condense = LXW_TRUE;
+    LXW_FORMAT_SET_PROPERTY(self, font_condense, LXW_TRUE);
 }
 
 /*
@@ -780,7 +968,7 @@ format_set_font_condense(lxw_format *self)
 void
 format_set_font_extend(lxw_format *self)
 {
-    self->font_extend = LXW_TRUE;
+    LXW_FORMAT_SET_PROPERTY(self, font_extend, LXW_TRUE);
 }
 
 /*
@@ -789,7 +977,7 @@ format_set_font_extend(lxw_format *self)
 void
 format_set_theme(lxw_format *self, uint8_t value)
 {
-    self->theme = value;
+    LXW_FORMAT_SET_PROPERTY(self, theme, value);
 }
 
 /*
@@ -798,7 +986,7 @@ format_set_theme(lxw_format *self, uint8_t value)
 void
 format_set_color_indexed(lxw_format *self, uint8_t value)
 {
-    self->color_indexed = value;
+    LXW_FORMAT_SET_PROPERTY(self, color_indexed, value);
 }
 
 /*
@@ -807,7 +995,7 @@ format_set_color_indexed(lxw_format *self, uint8_t value)
 void
 format_set_font_only(lxw_format *self)
 {
-    self->font_only = LXW_TRUE;
+    LXW_FORMAT_SET_PROPERTY(self, font_only, LXW_TRUE);
 }
 
 /*
@@ -816,10 +1004,10 @@ format_set_font_only(lxw_format *self)
 void
 format_set_hyperlink(lxw_format *self)
 {
-    self->hyperlink = LXW_TRUE;
-    self->xf_id = 1;
-    self->underline = LXW_UNDERLINE_SINGLE;
-    self->theme = 10;
+    LXW_FORMAT_SET_PROPERTY(self, hyperlink, LXW_TRUE);
+    LXW_FORMAT_SET_PROPERTY(self, xf_id, 1);
+    LXW_FORMAT_SET_PROPERTY(self, underline, LXW_UNDERLINE_SINGLE);
+    LXW_FORMAT_SET_PROPERTY(self, theme, 10);
 }
 
 /*
@@ -828,5 +1016,5 @@ format_set_hyperlink(lxw_format *self)
 void
 format_set_quote_prefix(lxw_format *self)
 {
-    self->quote_prefix = LXW_TRUE;
+    LXW_FORMAT_SET_PROPERTY(self, quote_prefix, LXW_TRUE);
 }
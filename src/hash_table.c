@@ -14,151 +14,178 @@
 #include <stdint.h>
 #include "xlsxwriter/hash_table.h"
 
+/* The 64 bit golden ratio multiplier, built from 32 bit halves for C89. */
+#define LXW_HASH_MULTIPLIER (((uint64_t) 0x9E3779B9UL << 32) | 0x7F4A7C15UL)
+
 /*
- * Calculate the hash key using the FNV function. See:
- * http://en.wikipedia.org/wiki/Fowler-Noll-Vo_hash_function
+ * Calculate the hash key. The key is read 8 bytes at a time and each word is
+ * mixed into the hash with a multiply and xor-shift. The keys are mainly
+ * format structs that are hundreds of bytes long so this is significantly
+ * faster than a byte at a time hash.
  */
-STATIC size_t
-_generate_hash_key(void *data, size_t data_len, size_t num_buckets)
+STATIC uint32_t
+_generate_hash_key(void *data, size_t data_len)
 {
     unsigned char *p = data;
-    size_t hash = 2166136261U;
-    size_t i;
+    uint64_t hash = data_len * LXW_HASH_MULTIPLIER;
+    uint64_t word;
+
+    while (data_len >= sizeof(uint64_t)) {
+        memcpy(&word, p, sizeof(uint64_t));
+        hash = (hash ^ word) * LXW_HASH_MULTIPLIER;
+        hash ^= hash >> 32;
 
-    for (i = 0; i < data_len; i++)
-        hash = (hash * 16777619) ^ p[i];
+        p += sizeof(uint64_t);
+        data_len -= sizeof(uint64_t);
+    }
 
-    return hash % num_buckets;
+    /* Mix in any remaining bytes as a zero padded word. */
+    if (data_len) {
+        word = 0;
+        memcpy(&word, p, data_len);
+        hash = (hash ^ word) * LXW_HASH_MULTIPLIER;
+        hash ^= hash >> 32;
+    }
+
+    /* Final avalanche so that the low bits used for the bucket index
+     * depend on all of the key. */
+    hash ^= hash >> 29;
+    hash *= LXW_HASH_MULTIPLIER;
+    hash ^= hash >> 32;
+
+    return (uint32_t) hash;
 }
 
 /*
- * Check if an element exists in the hash table and return a pointer
- * to it if it does.
+ * Find the bucket that holds a key, or the empty bucket where it should be
+ * inserted, using linear probing.
  */
-lxw_hash_element *
-lxw_hash_key_exists(lxw_hash_table *lxw_hash, void *key, size_t key_len)
+STATIC lxw_hash_element **
+_find_bucket(lxw_hash_table *lxw_hash, void *key, size_t key_len,
+             uint32_t hash)
 {
-    size_t hash_key = _generate_hash_key(key, key_len, lxw_hash->num_buckets);
-    struct lxw_hash_bucket_list *list;
+    uint32_t mask = lxw_hash->num_buckets - 1;
+    uint32_t i = hash & mask;
     lxw_hash_element *element;
 
-    if (!lxw_hash->buckets[hash_key]) {
-        /* The key isn't in the LXW_HASH hash table. */
-        return NULL;
-    }
-    else {
-        /* The key is already in the table or there is a hash collision. */
-        list = lxw_hash->buckets[hash_key];
-
-        /* Iterate over the keys in the bucket's linked list. */
-        SLIST_FOREACH(element, list, lxw_hash_list_pointers) {
-            if (memcmp(element->key, key, key_len) == 0) {
-                /* The key already exists in the table. */
-                return element;
-            }
-        }
+    while ((element = lxw_hash->buckets[i])) {
+        if (element->hash == hash
+            && memcmp(element->key, key, key_len) == 0)
+            return &lxw_hash->buckets[i];
 
-        /* Key doesn't exist in the list so this is a hash collision. */
-        return NULL;
+        i = (i + 1) & mask;
     }
+
+    return &lxw_hash->buckets[i];
 }
 
 /*
- * Insert or update a value in the LXW_HASH table based on a key
- * and return a pointer to the new or updated element.
+ * Double the number of hash table buckets and reinsert the elements using
+ * their stored hash values.
  */
-lxw_hash_element *
-lxw_insert_hash_element(lxw_hash_table *lxw_hash, void *key, void *value,
-                        size_t key_len)
+STATIC lxw_error
+_resize_hash_table(lxw_hash_table *lxw_hash)
 {
-    size_t hash_key = _generate_hash_key(key, key_len, lxw_hash->num_buckets);
-    struct lxw_hash_bucket_list *list = NULL;
-    lxw_hash_element *element = NULL;
+    uint32_t num_buckets = lxw_hash->num_buckets * 2;
+    uint32_t mask = num_buckets - 1;
+    lxw_hash_element **buckets;
+    lxw_hash_element *element;
+    uint32_t i;
 
-    if (!lxw_hash->buckets[hash_key]) {
-        /* The key isn't in the LXW_HASH hash table. */
+    if (num_buckets == 0)
+        return LXW_ERROR_MEMORY_MALLOC_FAILED;
 
-        /* Create a linked list in the bucket to hold the lxw_hash keys. */
-        list = calloc(1, sizeof(struct lxw_hash_bucket_list));
-        GOTO_LABEL_ON_MEM_ERROR(list, mem_error1);
+    buckets = calloc(num_buckets, sizeof(lxw_hash_element *));
+    RETURN_ON_MEM_ERROR(buckets, LXW_ERROR_MEMORY_MALLOC_FAILED);
 
-        /* Initialize the bucket linked list. */
-        SLIST_INIT(list);
+    STAILQ_FOREACH(element, lxw_hash->order_list, lxw_hash_order_pointers) {
+        i = element->hash & mask;
 
-        /* Create an lxw_hash element to add to the linked list. */
-        element = calloc(1, sizeof(lxw_hash_element));
-        GOTO_LABEL_ON_MEM_ERROR(element, mem_error1);
+        while (buckets[i])
+            i = (i + 1) & mask;
 
-        /* Store the key and value. */
-        element->key = key;
-        element->value = value;
+        buckets[i] = element;
+    }
 
-        /* Add the lxw_hash element to the bucket's linked list. */
-        SLIST_INSERT_HEAD(list, element, lxw_hash_list_pointers);
+    free(lxw_hash->buckets);
+    lxw_hash->buckets = buckets;
+    lxw_hash->num_buckets = num_buckets;
 
-        /* Also add it to the insertion order linked list. */
-        STAILQ_INSERT_TAIL(lxw_hash->order_list, element,
-                           lxw_hash_order_pointers);
+    return LXW_NO_ERROR;
+}
 
-        /* Store the bucket list at the hash index. */
-        lxw_hash->buckets[hash_key] = list;
+/*
+ * Check if an element exists in the hash table and return a pointer
+ * to it if it does.
+ */
+lxw_hash_element *
+lxw_hash_key_exists(lxw_hash_table *lxw_hash, void *key, size_t key_len)
+{
+    uint32_t hash = _generate_hash_key(key, key_len);
 
-        lxw_hash->used_buckets++;
-        lxw_hash->unique_count++;
+    return *_find_bucket(lxw_hash, key, key_len, hash);
+}
 
-        return element;
+/*
+ * Insert or update a value in the LXW_HASH table based on a key
+ * and return a pointer to the new or updated element.
+ */
+lxw_hash_element *
+lxw_insert_hash_element(lxw_hash_table *lxw_hash, void *key, void *value,
+                        size_t key_len)
+{
+    uint32_t hash = _generate_hash_key(key, key_len);
+    lxw_hash_element **bucket;
+    lxw_hash_element *element;
+
+    /* Keep the table at most half full so that probe sequences are short. */
+    if ((lxw_hash->unique_count + 1) * 2 > lxw_hash->num_buckets) {
+        if (_resize_hash_table(lxw_hash) != LXW_NO_ERROR)
+            return NULL;
     }
-    else {
-        /* The key is already in the table or there is a hash collision. */
-        list = lxw_hash->buckets[hash_key];
-
-        /* Iterate over the keys in the bucket's linked list. */
-        SLIST_FOREACH(element, list, lxw_hash_list_pointers) {
-            if (memcmp(element->key, key, key_len) == 0) {
-                /* The key already exists in the table. Update the value. */
-                if (lxw_hash->free_value)
-                    free(element->value);
-
-                element->value = value;
-                return element;
-            }
-        }
 
-        /* Key doesn't exist in the list so this is a hash collision.
-         * Create an lxw_hash element to add to the linked list. */
-        element = calloc(1, sizeof(lxw_hash_element));
-        GOTO_LABEL_ON_MEM_ERROR(element, mem_error2);
+    bucket = _find_bucket(lxw_hash, key, key_len, hash);
+    element = *bucket;
+
+    if (element) {
+        /* The key already exists in the table. Update the value. */
+        if (lxw_hash->free_value)
+            free(element->value);
 
-        /* Store the key and value. */
-        element->key = key;
         element->value = value;
+        return element;
+    }
 
-        /* Add the lxw_hash element to the bucket linked list. */
-        SLIST_INSERT_HEAD(list, element, lxw_hash_list_pointers);
+    /* Create an lxw_hash element to add to the empty bucket. */
+    element = calloc(1, sizeof(lxw_hash_element));
+    RETURN_ON_MEM_ERROR(element, NULL);
 
-        /* Also add it to the insertion order linked list. */
-        STAILQ_INSERT_TAIL(lxw_hash->order_list, element,
-                           lxw_hash_order_pointers);
+    /* Store the key, value and hash. */
+    element->key = key;
+    element->value = value;
+    element->hash = hash;
 
-        lxw_hash->unique_count++;
+    *bucket = element;
 
-        return element;
-    }
+    /* Also add it to the insertion order linked list. */
+    STAILQ_INSERT_TAIL(lxw_hash->order_list, element,
+                       lxw_hash_order_pointers);
 
-mem_error1:
-    free(list);
+    lxw_hash->unique_count++;
 
-mem_error2:
-    free(element);
-    return NULL;
+    return element;
 }
 
 /*
- * Create a new LXW_HASH hash table object.
+ * Create a new LXW_HASH hash table object. The number of buckets is the
+ * initial size and is rounded up to a power of 2. The table grows as
+ * required.
  */
 lxw_hash_table *
 lxw_hash_new(uint32_t num_buckets, uint8_t free_key, uint8_t free_value)
 {
+    uint32_t size = LXW_HASH_MIN_BUCKETS;
+
     /* Create the new hash table. */
     lxw_hash_table *lxw_hash = calloc(1, sizeof(lxw_hash_table));
     RETURN_ON_MEM_ERROR(lxw_hash, NULL);
@@ -166,9 +193,11 @@ lxw_hash_new(uint32_t num_buckets, uint8_t free_key, uint8_t free_value)
     lxw_hash->free_key = free_key;
     lxw_hash->free_value = free_value;
 
+    while (size < num_buckets && size < 0x80000000U)
+        size *= 2;
+
     /* Add the lxw_hash element buckets. */
-    lxw_hash->buckets =
-        calloc(num_buckets, sizeof(struct lxw_hash_bucket_list *));
+    lxw_hash->buckets = calloc(size, sizeof(lxw_hash_element *));
     GOTO_LABEL_ON_MEM_ERROR(lxw_hash->buckets, mem_error);
 
     /* Add a list for tracking the insertion order. */
@@ -178,8 +207,7 @@ lxw_hash_new(uint32_t num_buckets, uint8_t free_key, uint8_t free_value)
     /* Initialize the order list. */
     STAILQ_INIT(lxw_hash->order_list);
 
-    /* Store the number of buckets to calculate the load factor. */
-    lxw_hash->num_buckets = num_buckets;
+    lxw_hash->num_buckets = size;
 
     return lxw_hash;
 
@@ -194,7 +222,6 @@ mem_error:
 void
 lxw_hash_free(lxw_hash_table *lxw_hash)
 {
-    size_t i;
     lxw_hash_element *element;
     lxw_hash_element *element_temp;
 
@@ -213,11 +240,6 @@ lxw_hash_free(lxw_hash_table *lxw_hash)
         }
     }
 
-    /* Free the buckets from the hash table. */
-    for (i = 0; i < lxw_hash->num_buckets; i++) {
-        free(lxw_hash->buckets[i]);
-    }
-
     free(lxw_hash->order_list);
     free(lxw_hash->buckets);
     free(lxw_hash);
@@ -49,6 +49,7 @@
 #include "xlsxwriter/packager.h"
 #include "xlsxwriter/hash_table.h"
 #include "xlsxwriter/utility.h"
+#include "xlsxwriter/thread.h"
 
 STATIC lxw_error _add_file_to_zip(lxw_packager *self, FILE *file,
                                   const char *filename);
@@ -60,6 +61,32 @@ STATIC lxw_error _add_to_zip(lxw_packager *self, FILE *file,
                              char **buffer, size_t *buffer_size,
                              const char *filename);
 
+STATIC lxw_error _add_deflated_to_zip(lxw_packager *self, FILE *file,
+                                      const char *buffer, size_t buffer_size,
+                                      const char *filename, uLong crc,
+                                      ZPOS64_T uncompressed_size);
+
+STATIC lxw_error _add_streamed_worksheet_to_zip(lxw_packager *self,
+                                                lxw_worksheet *worksheet,
+                                                char **buffer,
+                                                size_t *buffer_size,
+                                                const char *filename);
+
+STATIC uint8_t _use_deflated_rows(lxw_packager *self,
+                                  lxw_worksheet *worksheet,
+                                  const char *filename);
+
+STATIC lxw_error _deflate_member(FILE *file, const char *buffer,
+                                 size_t buffer_size, FILE *deflated_file,
+                                 int level, int strategy, uLong *crc,
+                                 ZPOS64_T *uncompressed_size);
+
+STATIC lxw_error _deflate_member_chunked(lxw_packager *self, FILE *file,
+                                         const char *buffer,
+                                         size_t buffer_size,
+                                         FILE *deflated_file, int level,
+                                         int strategy, uLong *crc);
+
 STATIC lxw_error _write_vml_drawing_rels_file(lxw_packager *self,
                                               lxw_worksheet *worksheet,
                                               uint32_t index);
@@ -276,6 +303,166 @@ _write_workbook_file(lxw_packager *self)
     return LXW_NO_ERROR;
 }
 
+/*
+ * Assemble and deflate a worksheet xml file. This runs in a worker thread so
+ * it mustn't modify any data that isn't owned by the worksheet job.
+ */
+STATIC void
+_assemble_worksheet_job(void *arg)
+{
+    lxw_worksheet_job *job = (lxw_worksheet_job *) arg;
+    lxw_worksheet *worksheet = job->worksheet;
+
+    lxw_worksheet_assemble_xml_file(worksheet);
+
+    /* Flush to ensure buffer is updated when using a memory-backed file. */
+    fflush(worksheet->file);
+
+    /* Stored files, and worksheets with compressed constant_memory rows,
+     * are added directly from the main thread. */
+    if (job->level == 0 || worksheet->optimize_splice)
+        return;
+
+    job->error = _deflate_member(worksheet->file, job->buffer,
+                                 job->buffer_size, job->deflated_file,
+                                 job->level, job->strategy,
+                                 &job->crc, &job->uncompressed_size);
+
+    fflush(job->deflated_file);
+}
+
+/*
+ * Write the worksheet files using worker threads. The worksheets are
+ * assembled and deflated in parallel, in batches of worker_threads, and then
+ * added to the zip file in the same order as the single threaded version.
+ */
+STATIC lxw_error
+_write_worksheet_files_threaded(lxw_packager *self, uint16_t num_worksheets)
+{
+    lxw_workbook *workbook = self->workbook;
+    uint16_t num_threads = workbook->options.worker_threads;
+    lxw_sheet *sheet;
+    lxw_worksheet *worksheet;
+    lxw_worksheet_job *jobs;
+    lxw_worksheet_job *job;
+    lxw_thread **threads;
+    uint16_t first;
+    uint16_t last;
+    uint16_t i;
+    uint16_t index = 0;
+    lxw_error err = LXW_NO_ERROR;
+
+    jobs = calloc(num_worksheets, sizeof(lxw_worksheet_job));
+    threads = calloc(num_threads, sizeof(lxw_thread *));
+
+    if (!jobs || !threads) {
+        free(jobs);
+        free(threads);
+        return LXW_ERROR_MEMORY_MALLOC_FAILED;
+    }
+
+    /* Assign the format indices in the same order as the serial version
+     * since the workbook format table is shared by all the worksheets. */
+    STAILQ_FOREACH(sheet, workbook->sheets, list_pointers) {
+        if (sheet->is_chartsheet)
+            continue;
+        else
+            worksheet = sheet->u.worksheet;
+
+        job = &jobs[index++];
+        job->worksheet = worksheet;
+
+        lxw_snprintf(job->filename, LXW_FILENAME_LENGTH,
+                     "xl/worksheets/sheet%d.xml", index);
+
+        lxw_packager_get_compression(workbook, job->filename, &job->level,
+                                     &job->strategy);
+
+        if (worksheet->optimize) {
+            lxw_worksheet_flush_rows(worksheet);
+            lxw_worksheet_finish_optimized_rows(worksheet);
+        }
+
+        worksheet->optimize_splice =
+            _use_deflated_rows(self, worksheet, job->filename);
+
+        lxw_worksheet_prepare_xf_indices(worksheet);
+    }
+
+    for (first = 0; first < num_worksheets; first += num_threads) {
+        last = first + num_threads;
+        if (last > num_worksheets)
+            last = num_worksheets;
+
+        /* Create the temp files in the main thread since the tmpfile
+         * functions aren't guaranteed to be thread safe. */
+        for (i = first; i < last && !err; i++) {
+            job = &jobs[i];
+
+            job->file = lxw_get_filehandle(&job->buffer, &job->buffer_size,
+                                           self->tmpdir);
+
+            job->deflated_file =
+                lxw_get_filehandle(&job->deflated_buffer,
+                                   &job->deflated_buffer_size, self->tmpdir);
+
+            if (!job->file || !job->deflated_file)
+                err = LXW_ERROR_CREATING_TMPFILE;
+
+            job->worksheet->file = job->file;
+        }
+
+        if (!err) {
+            for (i = first; i < last; i++)
+                threads[i - first] =
+                    lxw_thread_new(_assemble_worksheet_job, &jobs[i]);
+
+            for (i = first; i < last; i++)
+                lxw_thread_join(threads[i - first]);
+        }
+
+        /* Add the deflated files to the zip file in worksheet order. */
+        for (i = first; i < last; i++) {
+            job = &jobs[i];
+
+            if (!err)
+                err = job->error;
+
+            if (!err && job->worksheet->optimize_splice)
+                err = _add_streamed_worksheet_to_zip(self, job->worksheet,
+                                                     &job->buffer,
+                                                     &job->buffer_size,
+                                                     job->filename);
+            else if (!err && job->level == 0)
+                err = _add_to_zip(self, job->file, &job->buffer,
+                                  &job->buffer_size, job->filename);
+            else if (!err)
+                err = _add_deflated_to_zip(self, job->deflated_file,
+                                           job->deflated_buffer,
+                                           job->deflated_buffer_size,
+                                           job->filename, job->crc,
+                                           job->uncompressed_size);
+
+            if (job->file)
+                fclose(job->file);
+
+            if (job->deflated_file)
+                fclose(job->deflated_file);
+
+            free(job->buffer);
+            free(job->deflated_buffer);
+        }
+
+        if (err)
+            break;
+    }
+
+    free(threads);
+    free(jobs);
+
+    return err;
+}
+
 /*
  * Write the worksheet files.
  */
@@ -291,6 +478,11 @@ _write_worksheet_files(lxw_packager *self)
     uint32_t index = 1;
     lxw_error err;
 
+    if (workbook->options.worker_threads > 1
+        && workbook->num_worksheets > 1)
+        return _write_worksheet_files_threaded(self,
+                                               workbook->num_worksheets);
+
     STAILQ_FOREACH(sheet, workbook->sheets, list_pointers) {
         if (sheet->is_chartsheet)
             continue;
@@ -300,8 +492,13 @@ _write_worksheet_files(lxw_packager *self)
         lxw_snprintf(sheetname, LXW_FILENAME_LENGTH,
                      "xl/worksheets/sheet%d.xml", index++);
 
-        if (worksheet->optimize_row)
-            lxw_worksheet_write_single_row(worksheet);
+        if (worksheet->optimize) {
+            lxw_worksheet_flush_rows(worksheet);
+            lxw_worksheet_finish_optimized_rows(worksheet);
+        }
+
+        worksheet->optimize_splice =
+            _use_deflated_rows(self, worksheet, sheetname);
 
         worksheet->file = lxw_get_filehandle(&buffer, &buffer_size,
                                              self->tmpdir);
@@ -310,8 +507,12 @@ _write_worksheet_files(lxw_packager *self)
 
         lxw_worksheet_assemble_xml_file(worksheet);
 
-        err = _add_to_zip(self, worksheet->file, &buffer, &buffer_size,
-                          sheetname);
+        if (worksheet->optimize_splice)
+            err = _add_streamed_worksheet_to_zip(self, worksheet, &buffer,
+                                                 &buffer_size, sheetname);
+        else
+            err = _add_to_zip(self, worksheet->file, &buffer, &buffer_size,
+                              sheetname);
         fclose(worksheet->file);
         free(buffer);
         RETURN_ON_ERROR(err);
@@ -2054,19 +2255,91 @@ mem_error:
  *
  ****************************************************************************/
 
+/*
+ * Get the zlib compression level and strategy for a zip member based on the
+ * class of the part and the workbook settings. A level of 0 indicates that
+ * the member should be stored without compression.
+ */
+void
+lxw_packager_get_compression(lxw_workbook *workbook, const char *filename,
+                             int *level, int *strategy)
+{
+    const char *extension;
+    uint8_t part = LXW_PART_OTHER;
+    uint8_t part_level;
+    uint8_t part_strategy;
+
+    *level = Z_DEFAULT_COMPRESSION;
+    *strategy = Z_DEFAULT_STRATEGY;
+
+    if (!workbook)
+        return;
+
+    if (strncmp(filename, "xl/worksheets/sheet", 19) == 0)
+        part = LXW_PART_WORKSHEETS;
+    else if (strcmp(filename, "xl/sharedStrings.xml") == 0)
+        part = LXW_PART_SHARED_STRINGS;
+    else if (strncmp(filename, "xl/media/", 9) == 0)
+        part = LXW_PART_MEDIA;
+
+    part_level = workbook->compression_levels[part];
+    part_strategy = workbook->compression_strategies[part];
+
+    if (part_level == LXW_COMPRESSION_DEFAULT) {
+        part_level = workbook->options.compression_level;
+
+        /* Don't recompress image formats that are already compressed. */
+        if (part == LXW_PART_MEDIA) {
+            extension = strrchr(filename, '.');
+
+            if (extension && (strcmp(extension, ".png") == 0
+                              || strcmp(extension, ".jpeg") == 0
+                              || strcmp(extension, ".gif") == 0))
+                part_level = LXW_COMPRESSION_STORE;
+        }
+    }
+
+    if (part_strategy == LXW_COMPRESSION_STRATEGY_DEFAULT)
+        part_strategy = workbook->options.compression_strategy;
+
+    if (part_level == LXW_COMPRESSION_STORE)
+        *level = 0;
+    else if (part_level != LXW_COMPRESSION_DEFAULT)
+        *level = part_level;
+
+    switch (part_strategy) {
+        case LXW_COMPRESSION_STRATEGY_FILTERED:
+            *strategy = Z_FILTERED;
+            break;
+        case LXW_COMPRESSION_STRATEGY_HUFFMAN_ONLY:
+            *strategy = Z_HUFFMAN_ONLY;
+            break;
+        case LXW_COMPRESSION_STRATEGY_RLE:
+            *strategy = Z_RLE;
+            break;
+        case LXW_COMPRESSION_STRATEGY_FIXED:
+            *strategy = Z_FIXED;
+            break;
+    }
+}
+
 STATIC lxw_error
 _add_file_to_zip(lxw_packager *self, FILE *file, const char *filename)
 {
     int16_t error = ZIP_OK;
     size_t size_read;
+    int level;
+    int strategy;
+
+    lxw_packager_get_compression(self->workbook, filename, &level, &strategy);
 
     error = zipOpenNewFileInZip4_64(self->zipfile,
                                     filename,
                                     &self->zipfile_info,
                                     NULL, 0, NULL, 0, NULL,
-                                    Z_DEFLATED, Z_DEFAULT_COMPRESSION, 0,
+                                    level ? Z_DEFLATED : 0, level, 0,
                                     -MAX_WBITS, DEF_MEM_LEVEL,
-                                    Z_DEFAULT_STRATEGY, NULL, 0, 0, 0,
+                                    strategy, NULL, 0, 0, 0,
                                     self->use_zip64);
 
     if (error != ZIP_OK) {
@@ -2114,14 +2387,18 @@ _add_buffer_to_zip(lxw_packager *self, const char *buffer, size_t buffer_size,
                    const char *filename)
 {
     int16_t error = ZIP_OK;
+    int level;
+    int strategy;
+
+    lxw_packager_get_compression(self->workbook, filename, &level, &strategy);
 
     error = zipOpenNewFileInZip4_64(self->zipfile,
                                     filename,
                                     &self->zipfile_info,
                                     NULL, 0, NULL, 0, NULL,
-                                    Z_DEFLATED, Z_DEFAULT_COMPRESSION, 0,
+                                    level ? Z_DEFLATED : 0, level, 0,
                                     -MAX_WBITS, DEF_MEM_LEVEL,
-                                    Z_DEFAULT_STRATEGY, NULL, 0, 0, 0,
+                                    strategy, NULL, 0, 0, 0,
                                     self->use_zip64);
 
     if (error != ZIP_OK) {
@@ -2146,12 +2423,678 @@ _add_buffer_to_zip(lxw_packager *self, const char *buffer, size_t buffer_size,
     return LXW_NO_ERROR;
 }
 
+/*
+ * Write data that has already been compressed with raw deflate to the
+ * current zip member, which must have been opened in raw mode. The data is
+ * either in the memory buffer, for memory-backed files, or in the file.
+ */
+STATIC lxw_error
+_write_raw_to_zip(lxw_packager *self, FILE *file, const char *buffer,
+                  size_t buffer_size)
+{
+    int16_t error = ZIP_OK;
+    size_t size_read;
+
+    if (buffer) {
+        error = zipWriteInFileInZip(self->zipfile,
+                                    buffer, (unsigned int) buffer_size);
+    }
+    else {
+        rewind(file);
+
+        size_read = fread((void *) self->buffer, 1, self->buffer_size, file);
+
+        while (size_read && error >= 0) {
+            error = zipWriteInFileInZip(self->zipfile,
+                                        self->buffer,
+                                        (unsigned int) size_read);
+
+            size_read =
+                fread((void *) self->buffer, 1, self->buffer_size, file);
+        }
+
+        if (ferror(file)) {
+            LXW_ERROR("Error reading member file data");
+            return LXW_ERROR_ZIP_FILE_ADD;
+        }
+    }
+
+    if (error < 0) {
+        LXW_ERROR("Error in writing member in the zipfile");
+        RETURN_ON_ZIP_ERROR(error, LXW_ERROR_ZIP_FILE_ADD);
+    }
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Add a member to the zip file that has already been compressed with raw
+ * deflate by _deflate_member(). The data is either in the memory buffer, for
+ * memory-backed files, or in the file.
+ */
+STATIC lxw_error
+_add_deflated_to_zip(lxw_packager *self, FILE *file, const char *buffer,
+                     size_t buffer_size, const char *filename, uLong crc,
+                     ZPOS64_T uncompressed_size)
+{
+    int16_t error = ZIP_OK;
+    int level;
+    int strategy;
+    lxw_error err;
+
+    lxw_packager_get_compression(self->workbook, filename, &level, &strategy);
+
+    error = zipOpenNewFileInZip4_64(self->zipfile,
+                                    filename,
+                                    &self->zipfile_info,
+                                    NULL, 0, NULL, 0, NULL,
+                                    Z_DEFLATED, level, 1,
+                                    -MAX_WBITS, DEF_MEM_LEVEL,
+                                    strategy, NULL, 0, 0, 0,
+                                    self->use_zip64);
+
+    if (error != ZIP_OK) {
+        LXW_ERROR("Error adding member to zipfile");
+        RETURN_ON_ZIP_ERROR(error, LXW_ERROR_ZIP_FILE_ADD);
+    }
+
+    err = _write_raw_to_zip(self, file, buffer, buffer_size);
+    RETURN_ON_ERROR(err);
+
+    error = zipCloseFileInZipRaw64(self->zipfile, uncompressed_size, crc);
+    if (error != ZIP_OK) {
+        LXW_ERROR("Error in closing member in the zipfile");
+        RETURN_ON_ZIP_ERROR(error, LXW_ERROR_ZIP_FILE_ADD);
+    }
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Combine two CRC32 values like crc32_combine() for a second block that may
+ * be larger than a z_off_t, which is only 32 bits on some platforms. The
+ * crc32_combine64() function isn't declared by all zlib builds so the first
+ * CRC is shifted over the excess length, in steps that fit a z_off_t, by
+ * combining it with the CRC of an empty block.
+ */
+STATIC uLong
+_crc32_combine64(uLong crc1, uLong crc2, uint64_t size2)
+{
+    while (size2 > LXW_CRC_COMBINE_STEP) {
+        crc1 = crc32_combine(crc1, 0, (z_off_t) LXW_CRC_COMBINE_STEP);
+        size2 -= LXW_CRC_COMBINE_STEP;
+    }
+
+    return crc32_combine(crc1, crc2, (z_off_t) size2);
+}
+
+/*
+ * Compress a range of a member file, or its memory buffer, with raw deflate
+ * directly into the current zip member, which must have been opened in raw
+ * mode. The range ends with the given zlib flush mode.
+ */
+STATIC lxw_error
+_deflate_range_to_zip(lxw_packager *self, FILE *file, const char *buffer,
+                      uint64_t start, uint64_t size, int level, int strategy,
+                      int flush, uLong *crc)
+{
+    z_stream stream;
+    unsigned char *out_buffer;
+    size_t size_read;
+    size_t size_out;
+    uint8_t is_last;
+    int error = ZIP_OK;
+    lxw_error err = LXW_NO_ERROR;
+
+    *crc = crc32(0L, Z_NULL, 0);
+
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS,
+                     DEF_MEM_LEVEL, strategy) != Z_OK)
+        return LXW_ERROR_MEMORY_MALLOC_FAILED;
+
+    out_buffer = malloc(LXW_ZIP_BUFFER_SIZE);
+    if (!out_buffer) {
+        LXW_MEM_ERROR();
+        deflateEnd(&stream);
+        return LXW_ERROR_MEMORY_MALLOC_FAILED;
+    }
+
+    if (!buffer && lxw_fseeko(file, start, SEEK_SET) != 0) {
+        err = LXW_ERROR_ZIP_FILE_ADD;
+        goto error;
+    }
+
+    do {
+        /* Get the next block of input data. */
+        size_read = size < self->buffer_size ?
+            (size_t) size : self->buffer_size;
+
+        if (buffer) {
+            stream.next_in = (Bytef *) buffer + (size_t) start;
+            start += size_read;
+        }
+        else {
+            if (fread((void *) self->buffer, 1, size_read, file)
+                != size_read) {
+                err = LXW_ERROR_ZIP_FILE_ADD;
+                goto error;
+            }
+            stream.next_in = (Bytef *) self->buffer;
+        }
+
+        size -= size_read;
+        is_last = (size == 0);
+
+        stream.avail_in = (uInt) size_read;
+        *crc = crc32(*crc, stream.next_in, (uInt) size_read);
+
+        /* Compress it and write it to the zip member. */
+        do {
+            stream.next_out = out_buffer;
+            stream.avail_out = LXW_ZIP_BUFFER_SIZE;
+
+            if (deflate(&stream, is_last ? flush : Z_NO_FLUSH)
+                == Z_STREAM_ERROR) {
+                err = LXW_ERROR_ZIP_FILE_ADD;
+                goto error;
+            }
+
+            size_out = LXW_ZIP_BUFFER_SIZE - stream.avail_out;
+            if (size_out)
+                error = zipWriteInFileInZip(self->zipfile, out_buffer,
+                                            (unsigned int) size_out);
+
+            if (error < 0) {
+                err = LXW_ERROR_ZIP_FILE_ADD;
+                goto error;
+            }
+        } while (stream.avail_out == 0);
+
+    } while (!is_last);
+
+error:
+    deflateEnd(&stream);
+    free(out_buffer);
+    return err;
+}
+
+/*
+ * Check if the constant_memory rows of a worksheet, that were compressed as
+ * they were written, can be added to the zip file directly. This requires
+ * that they were compressed with the current worksheet settings.
+ */
+STATIC uint8_t
+_use_deflated_rows(lxw_packager *self, lxw_worksheet *worksheet,
+                   const char *filename)
+{
+    int level;
+    int strategy;
+
+    if (!worksheet->optimize_deflated)
+        return LXW_FALSE;
+
+    lxw_packager_get_compression(self->workbook, filename, &level, &strategy);
+
+    /* Rows compressed by worksheet_finish() for a stored worksheet are
+     * decompressed into the sheet file instead. */
+    return level != 0 && level == worksheet->optimize_level
+        && strategy == worksheet->optimize_strategy;
+}
+
+/*
+ * Copy the compressed rows of a constant_memory worksheet to the open zip
+ * member. The rows are read from the worksheet, rather than from a file,
+ * since they may have been moved to the workbook row store.
+ */
+STATIC lxw_error
+_write_deflated_rows_to_zip(lxw_packager *self, lxw_worksheet *worksheet)
+{
+    int16_t error = ZIP_OK;
+    uint64_t offset = 0;
+    size_t size_read;
+
+    size_read = lxw_worksheet_read_deflated_rows(worksheet, offset,
+                                                 (char *) self->buffer,
+                                                 self->buffer_size);
+
+    while (size_read && error >= 0) {
+        error = zipWriteInFileInZip(self->zipfile, self->buffer,
+                                    (unsigned int) size_read);
+        offset += size_read;
+
+        size_read = lxw_worksheet_read_deflated_rows(worksheet, offset,
+                                                     (char *) self->buffer,
+                                                     self->buffer_size);
+    }
+
+    if (error < 0) {
+        LXW_ERROR("Error in writing member in the zipfile");
+        RETURN_ON_ZIP_ERROR(error, LXW_ERROR_ZIP_FILE_ADD);
+    }
+
+    if (offset != worksheet->optimize_deflated_size) {
+        LXW_ERROR("Error reading member file data");
+        return LXW_ERROR_ZIP_FILE_ADD;
+    }
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Add a constant_memory worksheet to the zip file without copying the row
+ * data. The sheet file contains the XML before and after the rows, which is
+ * compressed here, and the rows have already been compressed as they were
+ * written. The three raw deflate streams end on byte boundaries so they can
+ * be concatenated into a single zip member.
+ */
+STATIC lxw_error
+_add_streamed_worksheet_to_zip(lxw_packager *self, lxw_worksheet *worksheet,
+                               char **buffer, size_t *buffer_size,
+                               const char *filename)
+{
+    FILE *file = worksheet->file;
+    uint64_t head_size = worksheet->optimize_data_offset;
+    uint64_t file_size;
+    uint64_t tail_size;
+    uLong crc;
+    uLong tail_crc;
+    int16_t error;
+    int level;
+    int strategy;
+    lxw_error err;
+
+    /* Flush to ensure buffer is updated when using a memory-backed file. */
+    fflush(file);
+
+    if (*buffer) {
+        file_size = *buffer_size;
+    }
+    else {
+        if (lxw_fseeko(file, 0, SEEK_END) != 0
+            || lxw_ftello(file, &file_size) != 0)
+            return LXW_ERROR_ZIP_FILE_ADD;
+    }
+
+    tail_size = file_size - head_size;
+
+    lxw_packager_get_compression(self->workbook, filename, &level, &strategy);
+
+    error = zipOpenNewFileInZip4_64(self->zipfile,
+                                    filename,
+                                    &self->zipfile_info,
+                                    NULL, 0, NULL, 0, NULL,
+                                    Z_DEFLATED, level, 1,
+                                    -MAX_WBITS, DEF_MEM_LEVEL,
+                                    strategy, NULL, 0, 0, 0,
+                                    self->use_zip64);
+
+    if (error != ZIP_OK) {
+        LXW_ERROR("Error adding member to zipfile");
+        RETURN_ON_ZIP_ERROR(error, LXW_ERROR_ZIP_FILE_ADD);
+    }
+
+    err = _deflate_range_to_zip(self, file, *buffer, 0, head_size,
+                                level, strategy, Z_SYNC_FLUSH, &crc);
+    RETURN_ON_ERROR(err);
+
+    err = _write_deflated_rows_to_zip(self, worksheet);
+    RETURN_ON_ERROR(err);
+
+    err = _deflate_range_to_zip(self, file, *buffer, head_size, tail_size,
+                                level, strategy, Z_FINISH, &tail_crc);
+    RETURN_ON_ERROR(err);
+
+    crc = _crc32_combine64(crc, worksheet->optimize_crc,
+                           worksheet->optimize_data_size);
+    crc = _crc32_combine64(crc, tail_crc, tail_size);
+
+    error = zipCloseFileInZipRaw64(self->zipfile,
+                                   head_size +
+                                   worksheet->optimize_data_size +
+                                   tail_size, crc);
+    if (error != ZIP_OK) {
+        LXW_ERROR("Error in closing member in the zipfile");
+        RETURN_ON_ZIP_ERROR(error, LXW_ERROR_ZIP_FILE_ADD);
+    }
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Compress a member file, or its memory buffer, with raw deflate into
+ * deflated_file so that it can be added to the zip file in raw mode. This
+ * doesn't use any packager data so it can be called from a worker thread.
+ */
+STATIC lxw_error
+_deflate_member(FILE *file, const char *buffer, size_t buffer_size,
+                FILE *deflated_file, int level, int strategy, uLong *crc,
+                ZPOS64_T *uncompressed_size)
+{
+    z_stream stream;
+    unsigned char *in_buffer = NULL;
+    unsigned char *out_buffer = NULL;
+    size_t size_read;
+    size_t size_out;
+    int flush;
+    int zerr = Z_OK;
+    lxw_error err = LXW_NO_ERROR;
+
+    *crc = crc32(0L, Z_NULL, 0);
+    *uncompressed_size = 0;
+
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS,
+                     DEF_MEM_LEVEL, strategy) != Z_OK)
+        return LXW_ERROR_MEMORY_MALLOC_FAILED;
+
+    out_buffer = malloc(LXW_ZIP_BUFFER_SIZE);
+    GOTO_LABEL_ON_MEM_ERROR(out_buffer, mem_error);
+
+    if (!buffer) {
+        in_buffer = malloc(LXW_ZIP_BUFFER_SIZE);
+        GOTO_LABEL_ON_MEM_ERROR(in_buffer, mem_error);
+        rewind(file);
+    }
+
+    do {
+        /* Get the next block of input data. */
+        if (buffer) {
+            size_read = buffer_size;
+            stream.next_in = (Bytef *) buffer;
+            flush = Z_FINISH;
+        }
+        else {
+            size_read = fread(in_buffer, 1, LXW_ZIP_BUFFER_SIZE, file);
+            if (ferror(file)) {
+                err = LXW_ERROR_ZIP_FILE_ADD;
+                goto error;
+            }
+            stream.next_in = in_buffer;
+            flush = feof(file) ? Z_FINISH : Z_NO_FLUSH;
+        }
+
+        stream.avail_in = (uInt) size_read;
+        *crc = crc32(*crc, stream.next_in, (uInt) size_read);
+        *uncompressed_size += size_read;
+
+        /* Compress it and write it to the output file. */
+        do {
+            stream.next_out = out_buffer;
+            stream.avail_out = LXW_ZIP_BUFFER_SIZE;
+
+            zerr = deflate(&stream, flush);
+            if (zerr == Z_STREAM_ERROR) {
+                err = LXW_ERROR_ZIP_FILE_ADD;
+                goto error;
+            }
+
+            size_out = LXW_ZIP_BUFFER_SIZE - stream.avail_out;
+            if (fwrite(out_buffer, 1, size_out, deflated_file) != size_out) {
+                err = LXW_ERROR_ZIP_FILE_ADD;
+                goto error;
+            }
+        } while (stream.avail_out == 0);
+
+    } while (flush != Z_FINISH);
+
+error:
+    deflateEnd(&stream);
+    free(in_buffer);
+    free(out_buffer);
+    return err;
+
+mem_error:
+    deflateEnd(&stream);
+    free(in_buffer);
+    free(out_buffer);
+    return LXW_ERROR_MEMORY_MALLOC_FAILED;
+}
+
+/*
+ * Deflate a single chunk of a member. The chunk is primed with the preceding
+ * input data, if any, and ends with a sync flush so that the deflated chunks
+ * can be concatenated into a single raw deflate stream. This runs in a worker
+ * thread and only uses data owned by the chunk.
+ */
+STATIC void
+_deflate_chunk(void *arg)
+{
+    lxw_deflate_chunk *chunk = (lxw_deflate_chunk *) arg;
+    z_stream stream;
+    size_t size;
+    int zerr;
+
+    chunk->crc = crc32(crc32(0L, Z_NULL, 0), chunk->data, (uInt) chunk->size);
+
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, chunk->level, Z_DEFLATED, -MAX_WBITS,
+                     DEF_MEM_LEVEL, chunk->strategy) != Z_OK) {
+        chunk->error = LXW_ERROR_MEMORY_MALLOC_FAILED;
+        return;
+    }
+
+    if (chunk->dict_size)
+        deflateSetDictionary(&stream, chunk->dict, (uInt) chunk->dict_size);
+
+    /* The bound doesn't include the sync flush marker so add some room. */
+    size = deflateBound(&stream, (uLong) chunk->size) + 16;
+    chunk->deflated = malloc(size);
+    if (!chunk->deflated) {
+        chunk->error = LXW_ERROR_MEMORY_MALLOC_FAILED;
+        deflateEnd(&stream);
+        return;
+    }
+
+    stream.next_in = (Bytef *) chunk->data;
+    stream.avail_in = (uInt) chunk->size;
+    stream.next_out = chunk->deflated;
+    stream.avail_out = (uInt) size;
+
+    zerr = deflate(&stream, chunk->is_last ? Z_FINISH : Z_SYNC_FLUSH);
+
+    if (stream.avail_in != 0
+        || (chunk->is_last && zerr != Z_STREAM_END)
+        || (!chunk->is_last && zerr != Z_OK))
+        chunk->error = LXW_ERROR_ZIP_FILE_ADD;
+
+    chunk->deflated_size = size - stream.avail_out;
+
+    deflateEnd(&stream);
+}
+
+/*
+ * Compress a member with raw deflate in independent chunks, in the style of
+ * pigz, using the worker threads. The chunks are deflated in batches of
+ * worker_threads and written in order to deflated_file, so the output is
+ * the same regardless of the number of threads.
+ */
+STATIC lxw_error
+_deflate_member_chunked(lxw_packager *self, FILE *file, const char *buffer,
+                        size_t buffer_size, FILE *deflated_file, int level,
+                        int strategy, uLong *crc)
+{
+    uint16_t num_threads = self->workbook->options.worker_threads;
+    lxw_deflate_chunk *chunks;
+    lxw_deflate_chunk *chunk;
+    lxw_thread **threads;
+    unsigned char *input = NULL;
+    const unsigned char *data;
+    size_t remaining = buffer_size;
+    size_t dict_size = 0;
+    size_t batch_size;
+    size_t offset;
+    uint16_t num_chunks;
+    uint16_t i;
+    lxw_error err = LXW_NO_ERROR;
+
+    chunks = calloc(num_threads, sizeof(lxw_deflate_chunk));
+    threads = calloc(num_threads, sizeof(lxw_thread *));
+    GOTO_LABEL_ON_MEM_ERROR(chunks, mem_error);
+    GOTO_LABEL_ON_MEM_ERROR(threads, mem_error);
+
+    /* For file-backed members read each batch into an input buffer that
+     * also holds the dictionary data from the end of the previous batch. */
+    if (!buffer) {
+        input = malloc(LXW_DEFLATE_DICT_SIZE +
+                       (size_t) num_threads * LXW_DEFLATE_CHUNK_SIZE);
+        GOTO_LABEL_ON_MEM_ERROR(input, mem_error);
+        rewind(file);
+    }
+
+    data = (const unsigned char *) buffer;
+    *crc = crc32(0L, Z_NULL, 0);
+
+    while (remaining && !err) {
+        batch_size = (size_t) num_threads * LXW_DEFLATE_CHUNK_SIZE;
+        if (batch_size > remaining)
+            batch_size = remaining;
+
+        if (input) {
+            if (fread(input + dict_size, 1, batch_size, file) != batch_size) {
+                err = LXW_ERROR_ZIP_FILE_ADD;
+                break;
+            }
+            data = input + dict_size;
+        }
+
+        /* Split the batch into chunks. */
+        num_chunks = 0;
+        for (offset = 0; offset < batch_size;
+             offset += LXW_DEFLATE_CHUNK_SIZE) {
+            chunk = &chunks[num_chunks++];
+            memset(chunk, 0, sizeof(lxw_deflate_chunk));
+
+            chunk->data = data + offset;
+            chunk->size = batch_size - offset;
+            if (chunk->size > LXW_DEFLATE_CHUNK_SIZE)
+                chunk->size = LXW_DEFLATE_CHUNK_SIZE;
+
+            chunk->dict_size = offset ? LXW_DEFLATE_DICT_SIZE : dict_size;
+            chunk->dict = chunk->data - chunk->dict_size;
+            chunk->is_last = (offset + chunk->size == remaining);
+            chunk->level = level;
+            chunk->strategy = strategy;
+        }
+
+        for (i = 0; i < num_chunks; i++)
+            threads[i] = lxw_thread_new(_deflate_chunk, &chunks[i]);
+
+        for (i = 0; i < num_chunks; i++)
+            lxw_thread_join(threads[i]);
+
+        /* Write the deflated chunks in order and combine the CRCs. */
+        for (i = 0; i < num_chunks; i++) {
+            chunk = &chunks[i];
+
+            if (!err)
+                err = chunk->error;
+
+            if (!err && fwrite(chunk->deflated, 1, chunk->deflated_size,
+                               deflated_file) != chunk->deflated_size)
+                err = LXW_ERROR_ZIP_FILE_ADD;
+
+            if (!err)
+                *crc = crc32_combine(*crc, chunk->crc,
+                                     (z_off_t) chunk->size);
+
+            free(chunk->deflated);
+        }
+
+        remaining -= batch_size;
+
+        /* Keep the end of the batch as the dictionary for the next one. The
+         * batch is always full, and larger than the dictionary, if there is
+         * data remaining. */
+        if (input && remaining)
+            memmove(input, data + batch_size - LXW_DEFLATE_DICT_SIZE,
+                    LXW_DEFLATE_DICT_SIZE);
+        else
+            data += batch_size;
+
+        dict_size = LXW_DEFLATE_DICT_SIZE;
+    }
+
+    fflush(deflated_file);
+
+    free(input);
+    free(threads);
+    free(chunks);
+    return err;
+
+mem_error:
+    free(input);
+    free(threads);
+    free(chunks);
+    return LXW_ERROR_MEMORY_MALLOC_FAILED;
+}
+
+/*
+ * Deflate a large member in parallel chunks and add it to the zip file in
+ * raw mode.
+ */
+STATIC lxw_error
+_add_to_zip_chunked(lxw_packager *self, FILE *file, const char *buffer,
+                    size_t buffer_size, const char *filename)
+{
+    FILE *deflated_file;
+    char *deflated_buffer = NULL;
+    size_t deflated_buffer_size = 0;
+    int level;
+    int strategy;
+    uLong crc;
+    lxw_error err;
+
+    lxw_packager_get_compression(self->workbook, filename, &level, &strategy);
+
+    deflated_file = lxw_get_filehandle(&deflated_buffer,
+                                       &deflated_buffer_size, self->tmpdir);
+    if (!deflated_file)
+        return LXW_ERROR_CREATING_TMPFILE;
+
+    err = _deflate_member_chunked(self, file, buffer, buffer_size,
+                                  deflated_file, level, strategy, &crc);
+
+    if (!err)
+        err = _add_deflated_to_zip(self, deflated_file, deflated_buffer,
+                                   deflated_buffer_size, filename, crc,
+                                   buffer_size);
+
+    fclose(deflated_file);
+    free(deflated_buffer);
+
+    return err;
+}
+
 STATIC lxw_error
 _add_to_zip(lxw_packager *self, FILE *file, char **buffer,
             size_t *buffer_size, const char *filename)
 {
+    long file_size;
+    int level;
+    int strategy;
+
     /* Flush to ensure buffer is updated when using a memory-backed file. */
     fflush(file);
+
+    lxw_packager_get_compression(self->workbook, filename, &level, &strategy);
+
+    /* Use parallel chunked compression for large compressed members. */
+    if (level && self->workbook
+        && self->workbook->options.worker_threads > 1) {
+        if (*buffer) {
+            if (*buffer_size >= 2 * LXW_DEFLATE_CHUNK_SIZE)
+                return _add_to_zip_chunked(self, file, *buffer,
+                                           *buffer_size, filename);
+        }
+        else if (fseek(file, 0L, SEEK_END) == 0) {
+            file_size = ftell(file);
+            if (file_size >= 2 * LXW_DEFLATE_CHUNK_SIZE)
+                return _add_to_zip_chunked(self, file, NULL,
+                                           (size_t) file_size, filename);
+        }
+    }
+
     return *buffer ?
         _add_buffer_to_zip(self, *buffer, *buffer_size, filename) :
         _add_file_to_zip(self, file, filename);
@@ -13,18 +13,6 @@
 #include "xlsxwriter/utility.h"
 #include <ctype.h>
 
-/*
- * Forward declarations.
- */
-
-STATIC int _element_cmp(struct sst_element *element1,
-                        struct sst_element *element2);
-
-#ifndef __clang_analyzer__
-LXW_RB_GENERATE_ELEMENT(sst_rb_tree, sst_element, sst_tree_pointers,
-                        _element_cmp);
-#endif
-
 /*****************************************************************************
  *
  * Private functions.
@@ -41,19 +29,17 @@ lxw_sst_new(void)
     lxw_sst *sst = calloc(1, sizeof(lxw_sst));
     RETURN_ON_MEM_ERROR(sst, NULL);
 
-    /* Add the sst RB tree. */
-    sst->rb_tree = calloc(1, sizeof(struct sst_rb_tree));
-    GOTO_LABEL_ON_MEM_ERROR(sst->rb_tree, mem_error);
+    /* Add the sst hash table buckets. */
+    sst->buckets = calloc(LXW_SST_HASH_INITIAL_SIZE,
+                          sizeof(struct sst_element *));
+    GOTO_LABEL_ON_MEM_ERROR(sst->buckets, mem_error);
+    sst->num_buckets = LXW_SST_HASH_INITIAL_SIZE;
 
-    /* Add a list for tracking the insertion order. */
-    sst->order_list = calloc(1, sizeof(struct sst_order_list));
-    GOTO_LABEL_ON_MEM_ERROR(sst->order_list, mem_error);
-
-    /* Initialize the order list. */
-    STAILQ_INIT(sst->order_list);
-
-    /* Initialize the RB tree. */
-    RB_INIT(sst->rb_tree);
+    /* Add an array for tracking the insertion order. */
+    sst->elements = calloc(LXW_SST_HASH_INITIAL_SIZE / 2,
+                           sizeof(struct sst_element *));
+    GOTO_LABEL_ON_MEM_ERROR(sst->elements, mem_error);
+    sst->elements_size = LXW_SST_HASH_INITIAL_SIZE / 2;
 
     return sst;
 
@@ -68,36 +54,628 @@ mem_error:
 void
 lxw_sst_free(lxw_sst *sst)
 {
-    struct sst_element *sst_element;
-    struct sst_element *sst_element_temp;
+    lxw_sst_block *block;
+    lxw_sst_block *next_block;
 
     if (!sst)
         return;
 
-    /* Free the sst_elements and their data using the ordered linked list. */
-    if (sst->order_list) {
-        STAILQ_FOREACH_SAFE(sst_element, sst->order_list, sst_order_pointers,
-                            sst_element_temp) {
+    /* The sst_elements and their strings are stored in the memory blocks. */
+    for (block = sst->blocks; block; block = next_block) {
+        next_block = block->next;
+        free(block);
+    }
+
+    if (sst->strings_file)
+        fclose(sst->strings_file);
+
+    if (sst->offsets_file)
+        fclose(sst->offsets_file);
+
+    if (sst->index_file)
+        fclose(sst->index_file);
+
+    lxw_mutex_free(sst->mutex);
+    free(sst->read_buffer);
+    free(sst->lookup_buffer);
+    free(sst->elements);
+    free(sst->buckets);
+    free(sst);
+}
+
+/*
+ * Hash a string using FNV-1a, with a final avalanche step so that the low
+ * bits used to index the hash table are well mixed. The string length is
+ * also returned since it is calculated as part of the same loop.
+ */
+STATIC uint32_t
+_sst_hash(const char *string, size_t *length)
+{
+    const unsigned char *p = (const unsigned char *) string;
+    uint32_t hash = 2166136261U;
+
+    while (*p) {
+        hash ^= *p++;
+        hash *= 16777619U;
+    }
+
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6BU;
+    hash ^= hash >> 13;
+
+    *length = (size_t) ((const char *) p - string);
+
+    return hash;
+}
+
+/*
+ * Allocate space for an element and its string from the current SST memory
+ * block, adding a new block if there isn't enough space left.
+ */
+STATIC void *
+_sst_alloc(lxw_sst *sst, size_t size)
+{
+    lxw_sst_block *block = sst->blocks;
+    size_t block_size = LXW_SST_BLOCK_SIZE;
+    void *data;
+
+    /* Keep the allocations aligned for the sst_element structs. */
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    if (!block || block->size - block->used < size) {
+        if (size > block_size)
+            block_size = size;
+
+        block = malloc(sizeof(lxw_sst_block) + block_size);
+        if (!block)
+            return NULL;
+
+        block->size = block_size;
+        block->used = 0;
+        block->next = sst->blocks;
+        sst->blocks = block;
+    }
+
+    data = (char *) (block + 1) + block->used;
+    block->used += size;
+
+    return data;
+}
+
+/*
+ * Double the number of buckets in the hash table, and the size of the
+ * elements array, and re-insert the existing elements using their stored
+ * hash values.
+ */
+STATIC lxw_error
+_sst_resize(lxw_sst *sst)
+{
+    uint32_t num_buckets = sst->num_buckets * 2;
+    uint32_t mask = num_buckets - 1;
+    struct sst_element **buckets;
+    struct sst_element **elements;
+    struct sst_element *element;
+    uint32_t i;
+    uint32_t j;
+
+    elements = realloc(sst->elements,
+                       num_buckets / 2 * sizeof(struct sst_element *));
+    RETURN_ON_MEM_ERROR(elements, LXW_ERROR_MEMORY_MALLOC_FAILED);
+
+    sst->elements = elements;
+    sst->elements_size = num_buckets / 2;
+
+    buckets = calloc(num_buckets, sizeof(struct sst_element *));
+    RETURN_ON_MEM_ERROR(buckets, LXW_ERROR_MEMORY_MALLOC_FAILED);
+
+    for (i = 0; i < sst->num_elements; i++) {
+        element = sst->elements[i];
+
+        j = element->hash & mask;
+        while (buckets[j])
+            j = (j + 1) & mask;
+
+        buckets[j] = element;
+    }
+
+    free(sst->buckets);
+    sst->buckets = buckets;
+    sst->num_buckets = num_buckets;
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Add a new element, and a copy of its string, to the in-memory hash table
+ * and to the array of elements in insertion order.
+ */
+STATIC struct sst_element *
+_sst_insert_element(lxw_sst *sst, const char *string, size_t length,
+                    uint32_t hash, uint32_t index, uint8_t is_rich_string)
+{
+    struct sst_element *element;
+    uint32_t mask;
+    uint32_t i;
+
+    /* Keep the hash table at most half full so that the probes are short.
+     * This also makes room for the element in the elements array. */
+    if (sst->num_elements >= sst->elements_size) {
+        if (_sst_resize(sst) != LXW_NO_ERROR)
+            return NULL;
+    }
+
+    mask = sst->num_buckets - 1;
+    i = hash & mask;
+    while (sst->buckets[i])
+        i = (i + 1) & mask;
+
+    /* Store the new element and a copy of its string together. */
+    element = _sst_alloc(sst, sizeof(struct sst_element) + length + 1);
+    if (!element)
+        return NULL;
+
+    element->index = index;
+    element->hash = hash;
+    element->length = length;
+    element->string = (char *) (element + 1);
+    element->is_rich_string = is_rich_string;
+    element->is_spilled = LXW_FALSE;
+    element->is_referenced = LXW_FALSE;
+    memcpy(element->string, string, length + 1);
+
+    sst->buckets[i] = element;
+
+    /* Also add it to the insertion order array. */
+    sst->elements[sst->num_elements] = element;
+    sst->num_elements++;
+
+    return element;
+}
+
+/*
+ * In constant_memory mode the number of strings kept in memory can be
+ * bounded by max_strings. All of the strings are then also written, in index
+ * order, to a strings temp file with their offsets in a second temp file.
+ * When the in-memory table is full its strings are added to an on-disk
+ * index, an open addressing hash table of lxw_sst_slot structs in a third
+ * temp file, and the in-memory table is cleared except for the strings that
+ * have been found again since they were added or last kept, up to half of
+ * the table. This is a CLOCK, or second chance, policy: frequently repeated
+ * strings stay in memory while strings that are only used once are evicted.
+ * Strings that aren't found in memory are looked up in the on-disk index and
+ * kept in memory again.
+ */
+
+/*
+ * Read a string record, at the current position of the strings temp file,
+ * into a buffer that is grown as required. The string is NUL terminated.
+ */
+STATIC lxw_error
+_sst_read_record(FILE *file, char **buffer, size_t *buffer_size,
+                 size_t *length, uint8_t *is_rich_string)
+{
+    uint32_t string_length;
+    char *new_buffer;
+
+    if (fread(&string_length, sizeof(uint32_t), 1, file) != 1
+        || fread(is_rich_string, 1, 1, file) != 1)
+        return LXW_ERROR_READING_TMPFILE;
 
-            if (sst_element && sst_element->string)
-                free(sst_element->string);
-            if (sst_element)
-                free(sst_element);
+    if ((size_t) string_length + 1 > *buffer_size) {
+        new_buffer = realloc(*buffer, (size_t) string_length + 1);
+        RETURN_ON_MEM_ERROR(new_buffer, LXW_ERROR_MEMORY_MALLOC_FAILED);
+
+        *buffer = new_buffer;
+        *buffer_size = (size_t) string_length + 1;
+    }
+
+    if (string_length
+        && fread(*buffer, 1, string_length, file) != string_length)
+        return LXW_ERROR_READING_TMPFILE;
+
+    (*buffer)[string_length] = '\0';
+    *length = string_length;
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Read a string from the strings temp file by its index.
+ */
+STATIC lxw_error
+_sst_read_string(lxw_sst *sst, uint32_t index, char **buffer,
+                 size_t *buffer_size, size_t *length,
+                 uint8_t *is_rich_string)
+{
+    uint64_t offset;
+
+    /* The next write has to seek back to the end of the files. */
+    sst->files_read = LXW_TRUE;
+
+    if (lxw_fseeko(sst->offsets_file, (uint64_t) index * sizeof(uint64_t),
+                   SEEK_SET)
+        || fread(&offset, sizeof(uint64_t), 1, sst->offsets_file) != 1)
+        return LXW_ERROR_READING_TMPFILE;
+
+    if (lxw_fseeko(sst->strings_file, offset, SEEK_SET))
+        return LXW_ERROR_READING_TMPFILE;
+
+    return _sst_read_record(sst->strings_file, buffer, buffer_size, length,
+                            is_rich_string);
+}
+
+/*
+ * Add a new string to the end of the strings temp file, and its offset to
+ * the offsets temp file.
+ */
+STATIC lxw_error
+_sst_write_string(lxw_sst *sst, const char *string, size_t length,
+                  uint8_t is_rich_string)
+{
+    uint32_t string_length = (uint32_t) length;
+
+    if (!sst->strings_file)
+        sst->strings_file = lxw_tmpfile(sst->tmpdir);
+
+    if (!sst->offsets_file)
+        sst->offsets_file = lxw_tmpfile(sst->tmpdir);
+
+    if (!sst->strings_file || !sst->offsets_file)
+        return LXW_ERROR_CREATING_TMPFILE;
+
+    /* Seek to the end of the data, which also overwrites any partly written
+     * string, if the files have been read from since the last write. */
+    if (sst->files_read) {
+        if (lxw_fseeko(sst->strings_file, sst->strings_size, SEEK_SET)
+            || lxw_fseeko(sst->offsets_file,
+                          (uint64_t) sst->unique_count * sizeof(uint64_t),
+                          SEEK_SET))
+            return LXW_ERROR_CREATING_TMPFILE;
+
+        sst->files_read = LXW_FALSE;
+    }
+
+    if (fwrite(&string_length, sizeof(uint32_t), 1, sst->strings_file) != 1
+        || fwrite(&is_rich_string, 1, 1, sst->strings_file) != 1
+        || fwrite(string, 1, length, sst->strings_file) != length
+        || fwrite(&sst->strings_size, sizeof(uint64_t), 1,
+                  sst->offsets_file) != 1) {
+        sst->files_read = LXW_TRUE;
+        return LXW_ERROR_CREATING_TMPFILE;
+    }
+
+    sst->strings_size += sizeof(uint32_t) + 1 + length;
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Read or write a slot of the on-disk index.
+ */
+STATIC lxw_error
+_sst_read_slot(FILE *file, uint32_t position, lxw_sst_slot *slot)
+{
+    if (lxw_fseeko(file, (uint64_t) position * sizeof(lxw_sst_slot),
+                   SEEK_SET)
+        || fread(slot, sizeof(lxw_sst_slot), 1, file) != 1)
+        return LXW_ERROR_READING_TMPFILE;
+
+    return LXW_NO_ERROR;
+}
+
+STATIC lxw_error
+_sst_write_slot(FILE *file, uint32_t position, lxw_sst_slot *slot)
+{
+    if (lxw_fseeko(file, (uint64_t) position * sizeof(lxw_sst_slot),
+                   SEEK_SET)
+        || fwrite(slot, sizeof(lxw_sst_slot), 1, file) != 1)
+        return LXW_ERROR_CREATING_TMPFILE;
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Create an on-disk index file with index_size empty slots.
+ */
+STATIC FILE *
+_sst_new_index_file(lxw_sst *sst, uint32_t index_size)
+{
+    lxw_sst_slot slots[256];
+    uint32_t num_slots;
+    FILE *file = lxw_tmpfile(sst->tmpdir);
+
+    if (!file)
+        return NULL;
+
+    memset(slots, 0, sizeof(slots));
+
+    while (index_size) {
+        num_slots = index_size < 256 ? index_size : 256;
+
+        if (fwrite(slots, sizeof(lxw_sst_slot), num_slots, file) != num_slots) {
+            fclose(file);
+            return NULL;
         }
+
+        index_size -= num_slots;
     }
 
-    free(sst->order_list);
-    free(sst->rb_tree);
-    free(sst);
+    return file;
+}
+
+/*
+ * Store a string hash and index in the first free slot, using linear
+ * probing from its hash, of an on-disk index file.
+ */
+STATIC lxw_error
+_sst_put_slot(FILE *file, uint32_t index_size, uint32_t hash,
+              uint32_t index)
+{
+    lxw_sst_slot slot;
+    uint32_t mask = index_size - 1;
+    uint32_t i = hash & mask;
+    lxw_error err;
+
+    while (1) {
+        err = _sst_read_slot(file, i, &slot);
+        RETURN_ON_ERROR(err);
+
+        if (!slot.index)
+            break;
+
+        i = (i + 1) & mask;
+    }
+
+    slot.hash = hash;
+    slot.index = index + 1;
+
+    return _sst_write_slot(file, i, &slot);
+}
+
+/*
+ * Double the size of the on-disk index by re-inserting its slots into a new
+ * index file.
+ */
+STATIC lxw_error
+_sst_resize_index(lxw_sst *sst)
+{
+    lxw_sst_slot slots[256];
+    uint32_t index_size = sst->index_size * 2;
+    uint32_t remaining = sst->index_size;
+    uint32_t num_slots;
+    uint32_t i;
+    lxw_error err = LXW_NO_ERROR;
+    FILE *file = _sst_new_index_file(sst, index_size);
+
+    if (!file)
+        return LXW_ERROR_CREATING_TMPFILE;
+
+    rewind(sst->index_file);
+
+    while (remaining && !err) {
+        num_slots = remaining < 256 ? remaining : 256;
+
+        if (fread(slots, sizeof(lxw_sst_slot), num_slots, sst->index_file)
+            != num_slots) {
+            err = LXW_ERROR_READING_TMPFILE;
+            break;
+        }
+
+        for (i = 0; i < num_slots && !err; i++) {
+            if (slots[i].index)
+                err = _sst_put_slot(file, index_size, slots[i].hash,
+                                    slots[i].index - 1);
+        }
+
+        remaining -= num_slots;
+    }
+
+    if (err) {
+        fclose(file);
+        return err;
+    }
+
+    fclose(sst->index_file);
+    sst->index_file = file;
+    sst->index_size = index_size;
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Add a string hash and index to the on-disk index, creating it or growing
+ * it as required so that it is at most half full.
+ */
+STATIC lxw_error
+_sst_index_insert(lxw_sst *sst, uint32_t hash, uint32_t index)
+{
+    lxw_error err;
+
+    if (!sst->index_file) {
+        sst->index_file = _sst_new_index_file(sst, LXW_SST_INDEX_INITIAL_SIZE);
+        if (!sst->index_file)
+            return LXW_ERROR_CREATING_TMPFILE;
+
+        sst->index_size = LXW_SST_INDEX_INITIAL_SIZE;
+    }
+    else if (sst->index_count >= sst->index_size / 2) {
+        err = _sst_resize_index(sst);
+        RETURN_ON_ERROR(err);
+    }
+
+    err = _sst_put_slot(sst->index_file, sst->index_size, hash, index);
+    RETURN_ON_ERROR(err);
+
+    sst->index_count++;
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Look for a string in the on-disk index. The strings with a matching hash
+ * are read back from the strings temp file to compare them.
+ */
+STATIC lxw_error
+_sst_index_find(lxw_sst *sst, const char *string, size_t length,
+                uint32_t hash, uint32_t *index, uint8_t *is_rich_string,
+                uint8_t *found)
+{
+    lxw_sst_slot slot;
+    uint32_t mask = sst->index_size - 1;
+    uint32_t i = hash & mask;
+    size_t string_length;
+    uint8_t string_is_rich;
+    lxw_error err;
+
+    *found = LXW_FALSE;
+
+    while (1) {
+        err = _sst_read_slot(sst->index_file, i, &slot);
+        RETURN_ON_ERROR(err);
+
+        if (!slot.index)
+            return LXW_NO_ERROR;
+
+        if (slot.hash == hash) {
+            err = _sst_read_string(sst, slot.index - 1, &sst->read_buffer,
+                                   &sst->read_buffer_size, &string_length,
+                                   &string_is_rich);
+            RETURN_ON_ERROR(err);
+
+            if (string_length == length
+                && memcmp(sst->read_buffer, string, length) == 0) {
+                *index = slot.index - 1;
+                *is_rich_string = string_is_rich;
+                *found = LXW_TRUE;
+                return LXW_NO_ERROR;
+            }
+        }
+
+        i = (i + 1) & mask;
+    }
+}
+
+/*
+ * Add the in-memory strings that aren't already in the on-disk index to it
+ * and then evict the strings that haven't been found again since they were
+ * added or last kept. At most half of the table is kept, preferring the most
+ * recently added strings, so that each spill frees at least half of it. The
+ * kept strings are copied to new memory blocks before the old blocks are
+ * freed.
+ */
+STATIC lxw_error
+_sst_spill(lxw_sst *sst)
+{
+    struct sst_element *element;
+    struct sst_element *kept;
+    lxw_sst_block *blocks = sst->blocks;
+    lxw_sst_block *block;
+    lxw_sst_block *next_block;
+    uint32_t num_elements = sst->num_elements;
+    uint32_t max_kept = sst->max_strings / 2;
+    uint32_t num_referenced = 0;
+    uint32_t num_skipped = 0;
+    uint32_t i;
+    lxw_error err = LXW_NO_ERROR;
+
+    for (i = 0; i < num_elements; i++) {
+        element = sst->elements[i];
+
+        if (!element->is_spilled) {
+            err = _sst_index_insert(sst, element->hash, element->index);
+            RETURN_ON_ERROR(err);
+
+            element->is_spilled = LXW_TRUE;
+        }
+
+        if (element->is_referenced)
+            num_referenced++;
+    }
+
+    /* Skip the oldest referenced strings if there are too many to keep. */
+    if (num_referenced > max_kept)
+        num_skipped = num_referenced - max_kept;
+
+    sst->blocks = NULL;
+    sst->num_elements = 0;
+    memset(sst->buckets, 0, sst->num_buckets * sizeof(struct sst_element *));
+
+    /* The kept elements are added back in order, so the elements array is
+     * only overwritten at or before the element being read. */
+    for (i = 0; i < num_elements; i++) {
+        element = sst->elements[i];
+
+        if (!element->is_referenced)
+            continue;
+
+        if (num_skipped) {
+            num_skipped--;
+            continue;
+        }
+
+        kept = _sst_insert_element(sst, element->string, element->length,
+                                   element->hash, element->index,
+                                   element->is_rich_string);
+        if (!kept) {
+            err = LXW_ERROR_MEMORY_MALLOC_FAILED;
+            break;
+        }
+
+        /* The string has to be found again to be kept by the next spill. */
+        kept->is_spilled = LXW_TRUE;
+    }
+
+    for (block = blocks; block; block = next_block) {
+        next_block = block->next;
+        free(block);
+    }
+
+    return err;
 }
 
 /*
- * Comparator for the element structure
+ * Add to or find a string in a bounded SST. A string that isn't in memory is
+ * looked up in the on-disk index or, if it is new, added to the temp files.
+ * It is then kept in memory, after making room for it if required.
  */
-STATIC int
-_element_cmp(struct sst_element *element1, struct sst_element *element2)
+STATIC struct sst_element *
+_add_bounded_sst_string(lxw_sst *sst, const char *string, size_t length,
+                        uint32_t hash, uint8_t is_rich_string)
 {
-    return strcmp(element1->string, element2->string);
+    struct sst_element *element;
+    uint32_t index = 0;
+    uint8_t found = LXW_FALSE;
+
+    sst->file_error = LXW_NO_ERROR;
+
+    if (sst->index_file)
+        sst->file_error = _sst_index_find(sst, string, length, hash, &index,
+                                          &is_rich_string, &found);
+    if (sst->file_error)
+        return NULL;
+
+    if (!found) {
+        sst->file_error = _sst_write_string(sst, string, length,
+                                            is_rich_string);
+        if (sst->file_error)
+            return NULL;
+
+        index = sst->unique_count;
+        sst->unique_count++;
+    }
+
+    if (sst->num_elements >= sst->max_strings) {
+        sst->file_error = _sst_spill(sst);
+        if (sst->file_error)
+            return NULL;
+    }
+
+    element = _sst_insert_element(sst, string, length, hash, index,
+                                  is_rich_string);
+    if (element)
+        element->is_spilled = found;
+
+    return element;
 }
 
 /*****************************************************************************
@@ -196,6 +774,35 @@ _write_sst(lxw_sst *self)
  *
  ****************************************************************************/
 
+/*
+ * Write the strings of a bounded SST from the strings temp file.
+ */
+STATIC void
+_write_bounded_sst_strings(lxw_sst *self)
+{
+    size_t length;
+    uint8_t is_rich_string;
+    uint32_t i;
+
+    if (!self->strings_file || lxw_fseeko(self->strings_file, 0, SEEK_SET))
+        return;
+
+    self->files_read = LXW_TRUE;
+
+    for (i = 0; i < self->unique_count; i++) {
+        if (_sst_read_record(self->strings_file, &self->read_buffer,
+                             &self->read_buffer_size, &length,
+                             &is_rich_string) != LXW_NO_ERROR)
+            return;
+
+        /* Write the si element. */
+        if (is_rich_string)
+            _write_rich_si(self, self->read_buffer);
+        else
+            _write_si(self, self->read_buffer);
+    }
+}
+
 /*
  * Assemble and write the XML file.
  */
@@ -203,8 +810,16 @@ STATIC void
 _write_sst_strings(lxw_sst *self)
 {
     struct sst_element *sst_element;
+    uint32_t i;
+
+    if (self->max_strings) {
+        _write_bounded_sst_strings(self);
+        return;
+    }
+
+    for (i = 0; i < self->unique_count; i++) {
+        sst_element = self->elements[i];
 
-    STAILQ_FOREACH(sst_element, self->order_list, sst_order_pointers) {
         /* Write the si element. */
         if (sst_element->is_rich_string)
             _write_rich_si(self, sst_element->string);
@@ -233,11 +848,65 @@ lxw_sst_assemble_xml_file(lxw_sst *self)
     lxw_xml_end_tag(self->file, "sst");
 }
 
+/*
+ * Add to or find a string in the SST SharedString table, without counting it
+ * as a use of the string, and return it's element. The string is only copied
+ * if it isn't already in the table.
+ */
+STATIC struct sst_element *
+_add_sst_string(lxw_sst *sst, const char *string, uint8_t is_rich_string)
+{
+    struct sst_element *element;
+    size_t length;
+    uint32_t hash = _sst_hash(string, &length);
+    uint32_t mask = sst->num_buckets - 1;
+    uint32_t i = hash & mask;
+
+    /* Look for the string using linear probing from its hash bucket. */
+    while ((element = sst->buckets[i])) {
+        if (element->hash == hash && element->length == length
+            && memcmp(element->string, string, length) == 0) {
+            element->is_referenced = LXW_TRUE;
+            return element;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    if (sst->max_strings)
+        return _add_bounded_sst_string(sst, string, length, hash,
+                                       is_rich_string);
+
+    element = _sst_insert_element(sst, string, length, hash,
+                                  sst->unique_count, is_rich_string);
+    if (!element)
+        return NULL;
+
+    sst->unique_count++;
+    return element;
+}
+
 /*****************************************************************************
  *
  * Public functions.
  *
  ****************************************************************************/
+/*
+ * Add to or find a string in the SST SharedString table, without counting it
+ * as a use of the string, and return it's element.
+ */
+struct sst_element *
+lxw_add_sst_string(lxw_sst *sst, const char *string, uint8_t is_rich_string)
+{
+    struct sst_element *element;
+
+    lxw_mutex_lock(sst->mutex);
+    element = _add_sst_string(sst, string, is_rich_string);
+    lxw_mutex_unlock(sst->mutex);
+
+    return element;
+}
+
 /*
  * Add to or find a string in the SST SharedString table and return it's index.
  */
@@ -245,35 +914,111 @@ struct sst_element *
 lxw_get_sst_index(lxw_sst *sst, const char *string, uint8_t is_rich_string)
 {
     struct sst_element *element;
-    struct sst_element *existing_element;
 
-    /* Create an sst element to potentially add to the table. */
-    element = calloc(1, sizeof(struct sst_element));
-    if (!element)
-        return NULL;
+    lxw_mutex_lock(sst->mutex);
 
-    /* Create potential new element with the string and its index. */
-    element->index = sst->unique_count;
-    element->string = lxw_strdup(string);
-    element->is_rich_string = is_rich_string;
+    element = _add_sst_string(sst, string, is_rich_string);
 
-    /* Try to insert it and see whether we already have that string. */
-    existing_element = RB_INSERT(sst_rb_tree, sst->rb_tree, element);
+    if (element)
+        sst->string_count++;
+
+    lxw_mutex_unlock(sst->mutex);
 
-    /* If existing_element is not NULL, then it already existed. */
-    /* Free new created element. */
-    if (existing_element) {
-        free(element->string);
-        free(element);
+    return element;
+}
+
+/*
+ * Add to or find a string in the SST SharedString table and return its
+ * index. The element isn't returned since, in a bounded table, it can be
+ * freed by another thread as soon as the lock is released.
+ */
+lxw_error
+lxw_get_sst_string_index(lxw_sst *sst, const char *string, uint32_t *index)
+{
+    struct sst_element *element;
+
+    lxw_mutex_lock(sst->mutex);
+
+    element = _add_sst_string(sst, string, LXW_FALSE);
+
+    if (element) {
         sst->string_count++;
-        return existing_element;
+        *index = element->index;
+    }
+
+    lxw_mutex_unlock(sst->mutex);
+
+    if (!element)
+        return LXW_ERROR_SHARED_STRING_INDEX_NOT_FOUND;
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Check that a string index is in the SST SharedString table and whether the
+ * string is empty. Unlike lxw_get_sst_string() this is safe to use from
+ * several threads with a bounded table.
+ */
+lxw_error
+lxw_check_sst_string(lxw_sst *sst, uint32_t index, uint8_t *is_empty)
+{
+    lxw_error err = LXW_NO_ERROR;
+    size_t length = 0;
+    uint8_t is_rich_string;
+
+    lxw_mutex_lock(sst->mutex);
+
+    if (index >= sst->unique_count)
+        err = LXW_ERROR_SHARED_STRING_INDEX_NOT_FOUND;
+    else if (!sst->max_strings)
+        length = sst->elements[index]->length;
+    else
+        err = _sst_read_string(sst, index, &sst->lookup_buffer,
+                               &sst->lookup_buffer_size, &length,
+                               &is_rich_string);
+
+    lxw_mutex_unlock(sst->mutex);
+
+    *is_empty = length == 0;
+
+    return err;
+}
+
+/*
+ * Get a string from the SST SharedString table by its index. In a bounded
+ * table the string is read into a buffer that is only valid until the next
+ * call.
+ */
+const char *
+lxw_get_sst_string(lxw_sst *sst, uint32_t index)
+{
+    const char *string = NULL;
+    size_t length;
+    uint8_t is_rich_string;
+
+    lxw_mutex_lock(sst->mutex);
+
+    if (index < sst->unique_count) {
+        if (!sst->max_strings)
+            string = sst->elements[index]->string;
+        else if (_sst_read_string(sst, index, &sst->lookup_buffer,
+                                  &sst->lookup_buffer_size, &length,
+                                  &is_rich_string) == LXW_NO_ERROR)
+            string = sst->lookup_buffer;
     }
 
-    /* If it didn't exist, also add it to the insertion order linked list. */
-    STAILQ_INSERT_TAIL(sst->order_list, element, sst_order_pointers);
+    lxw_mutex_unlock(sst->mutex);
+
+    return string;
+}
 
-    /* Update SST string counts. */
+/*
+ * Count a use of a string that is already in the SST SharedString table.
+ */
+void
+lxw_count_sst_string(lxw_sst *sst)
+{
+    lxw_mutex_lock(sst->mutex);
     sst->string_count++;
-    sst->unique_count++;
-    return element;
+    lxw_mutex_unlock(sst->mutex);
 }
@@ -337,7 +337,7 @@ lxw_theme_assemble_xml_file(lxw_theme *self)
     int i = 0;
 
     while (strlen(theme_strs[i])) {
-        fprintf(self->file, "%s", theme_strs[i]);
+        fputs(theme_strs[i], self->file);
         i++;
     }
 }
@@ -0,0 +1,210 @@
+/*****************************************************************************
+ * thread - Minimal portable thread functions for libxlsxwriter.
+ *
+ * Used in conjunction with the libxlsxwriter library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include "xlsxwriter/thread.h"
+
+/* Avoid non MSVC definition of _WIN32 in MinGW. */
+#ifdef __MINGW32__
+#undef _WIN32
+#endif
+
+#if !defined(USE_NO_THREADS) && defined(_WIN32)
+/* Silence Windows warning with duplicate symbol for SLIST_ENTRY in local
+ * queue.h and windows.h. */
+#undef SLIST_ENTRY
+#include <windows.h>
+#elif !defined(USE_NO_THREADS)
+#include <pthread.h>
+#endif
+
+struct lxw_thread {
+    lxw_thread_func func;
+    void *arg;
+    uint8_t started;
+
+#if !defined(USE_NO_THREADS) && defined(_WIN32)
+    HANDLE handle;
+#elif !defined(USE_NO_THREADS)
+    pthread_t handle;
+#endif
+};
+
+struct lxw_mutex {
+#if !defined(USE_NO_THREADS) && defined(_WIN32)
+    CRITICAL_SECTION lock;
+#elif !defined(USE_NO_THREADS)
+    pthread_mutex_t lock;
+#else
+    uint8_t unused;
+#endif
+};
+
+/*****************************************************************************
+ *
+ * Private functions.
+ *
+ ****************************************************************************/
+
+#if !defined(USE_NO_THREADS) && defined(_WIN32)
+STATIC DWORD WINAPI
+_thread_start(LPVOID data)
+{
+    lxw_thread *thread = (lxw_thread *) data;
+
+    thread->func(thread->arg);
+
+    return 0;
+}
+#elif !defined(USE_NO_THREADS)
+STATIC void *
+_thread_start(void *data)
+{
+    lxw_thread *thread = (lxw_thread *) data;
+
+    thread->func(thread->arg);
+
+    return NULL;
+}
+#endif
+
+/*****************************************************************************
+ *
+ * Public functions.
+ *
+ ****************************************************************************/
+
+/*
+ * Start a new thread to run func(arg). If threads aren't supported, or the
+ * thread can't be created, the function is run synchronously instead so that
+ * callers don't need a separate serial code path.
+ */
+lxw_thread *
+lxw_thread_new(lxw_thread_func func, void *arg)
+{
+    lxw_thread *thread = calloc(1, sizeof(lxw_thread));
+
+    if (!thread) {
+        LXW_MEM_ERROR();
+        func(arg);
+        return NULL;
+    }
+
+    thread->func = func;
+    thread->arg = arg;
+
+#if !defined(USE_NO_THREADS) && defined(_WIN32)
+    thread->handle = CreateThread(NULL, 0, _thread_start, thread, 0, NULL);
+    thread->started = thread->handle != NULL;
+#elif !defined(USE_NO_THREADS)
+    thread->started = pthread_create(&thread->handle, NULL,
+                                     _thread_start, thread) == 0;
+#endif
+
+    if (!thread->started)
+        func(arg);
+
+    return thread;
+}
+
+/*
+ * Wait for a thread to finish and free it.
+ */
+void
+lxw_thread_join(lxw_thread *thread)
+{
+    if (!thread)
+        return;
+
+#if !defined(USE_NO_THREADS) && defined(_WIN32)
+    if (thread->started) {
+        WaitForSingleObject(thread->handle, INFINITE);
+        CloseHandle(thread->handle);
+    }
+#elif !defined(USE_NO_THREADS)
+    if (thread->started)
+        pthread_join(thread->handle, NULL);
+#endif
+
+    free(thread);
+}
+
+/*
+ * Create a new mutex. Returns NULL on error.
+ */
+lxw_mutex *
+lxw_mutex_new(void)
+{
+    lxw_mutex *mutex = calloc(1, sizeof(lxw_mutex));
+    RETURN_ON_MEM_ERROR(mutex, NULL);
+
+#if !defined(USE_NO_THREADS) && defined(_WIN32)
+    InitializeCriticalSection(&mutex->lock);
+#elif !defined(USE_NO_THREADS)
+    if (pthread_mutex_init(&mutex->lock, NULL) != 0) {
+        free(mutex);
+        return NULL;
+    }
+#endif
+
+    return mutex;
+}
+
+/*
+ * Lock a mutex. A NULL mutex is ignored.
+ */
+void
+lxw_mutex_lock(lxw_mutex *mutex)
+{
+    if (!mutex)
+        return;
+
+#if !defined(USE_NO_THREADS) && defined(_WIN32)
+    EnterCriticalSection(&mutex->lock);
+#elif !defined(USE_NO_THREADS)
+    pthread_mutex_lock(&mutex->lock);
+#endif
+}
+
+/*
+ * Unlock a mutex. A NULL mutex is ignored.
+ */
+void
+lxw_mutex_unlock(lxw_mutex *mutex)
+{
+    if (!mutex)
+        return;
+
+#if !defined(USE_NO_THREADS) && defined(_WIN32)
+    LeaveCriticalSection(&mutex->lock);
+#elif !defined(USE_NO_THREADS)
+    pthread_mutex_unlock(&mutex->lock);
+#endif
+}
+
+/*
+ * Free a mutex.
+ */
+void
+lxw_mutex_free(lxw_mutex *mutex)
+{
+    if (!mutex)
+        return;
+
+#if !defined(USE_NO_THREADS) && defined(_WIN32)
+    DeleteCriticalSection(&mutex->lock);
+#elif !defined(USE_NO_THREADS)
+    pthread_mutex_destroy(&mutex->lock);
+#endif
+
+    free(mutex);
+}
@@ -10,6 +10,13 @@
 
 #ifdef USE_FMEMOPEN
 #define _POSIX_C_SOURCE 200809L
+#elif !defined(_WIN32)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+/* Use a 64 bit off_t for fseeko()/ftello() on 32 bit POSIX systems. */
+#if !defined(_WIN32) && !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS 64
 #endif
 
 #include <ctype.h>
@@ -21,10 +28,18 @@
 #include "xlsxwriter/common.h"
 #include "xlsxwriter/third_party/tmpfileplus.h"
 
-#ifdef USE_DTOA_LIBRARY
+#ifndef USE_STANDARD_DOUBLE
 #include "xlsxwriter/third_party/emyg_dtoa.h"
 #endif
 
+/* The MurmurHash3 x64 128 bit block and finalizer constants. */
+#define LXW_DIGEST_C1       (((uint64_t) 0x87C37B91UL << 32) | 0x114253D5UL)
+#define LXW_DIGEST_C2       (((uint64_t) 0x4CF5AD43UL << 32) | 0x2745937FUL)
+#define LXW_DIGEST_F1       (((uint64_t) 0xFF51AFD7UL << 32) | 0xED558CCDUL)
+#define LXW_DIGEST_F2       (((uint64_t) 0xC4CEB9FEUL << 32) | 0x1A85EC53UL)
+
+#define LXW_ROTL64(x, r)    (((x) << (r)) | ((x) >> (64 - (r))))
+
 char *error_strings[LXW_MAX_ERRNO + 1] = {
     "No error.",
     "Memory error, failed to malloc() required memory.",
@@ -693,12 +708,62 @@ lxw_get_filehandle(char **buf, size_t *size, const char *tmpdir)
 
 /*
  * Use third party function to handle sprintf of doubles for locale portable
- * code.
+ * code. Integers, which are the most common numbers in worksheets, are
+ * converted directly.
  */
-#ifdef USE_DTOA_LIBRARY
+#ifndef USE_STANDARD_DOUBLE
 int
 lxw_sprintf_dbl(char *data, double number)
 {
+    static const char digit_pairs[] =
+        "000102030405060708091011121314151617181920212223242526272829"
+        "303132333435363738394041424344454647484950515253545556575859"
+        "606162636465666768697071727374757677787980818283848586878889"
+        "90919293949596979899";
+    static const double zero = 0.0;
+    char digits[LXW_ATTR_32];
+    char *p_digits = digits + sizeof(digits);
+    uint64_t integer;
+    size_t length;
+
+    /* Fast path for integers. The limit is below the point where the dtoa
+     * function switches to exponent notation so the output is the same.
+     * Negative zero is excluded so that it keeps its sign, as "-0". */
+    if (number > -1e15 && number < 1e15
+        && number == (double) (int64_t) number
+        && (number != 0.0 || memcmp(&number, &zero, sizeof(double)) == 0)) {
+
+        integer = (uint64_t) (number < 0 ? -number : number);
+
+        while (integer >= 100) {
+            p_digits -= 2;
+            memcpy(p_digits, &digit_pairs[(integer % 100) * 2], 2);
+            integer /= 100;
+        }
+
+        if (integer >= 10) {
+            p_digits -= 2;
+            memcpy(p_digits, &digit_pairs[integer * 2], 2);
+        }
+        else {
+            *--p_digits = (char) ('0' + integer);
+        }
+
+        if (number < 0)
+            *--p_digits = '-';
+
+        length = (size_t) (digits + sizeof(digits) - p_digits);
+        memcpy(data, p_digits, length);
+        data[length] = '\0';
+
+        return 0;
+    }
+
+    /* The dtoa function doesn't handle NaN and infinity, or the sign of
+     * negative zero, which is the only zero that reaches here. */
+    if (number != number || number - number != 0.0 || number == 0.0)
+        return lxw_snprintf(data, LXW_ATTR_32, "%.16G", number);
+
     emyg_dtoa(number, data);
     return 0;
 }
@@ -749,6 +814,104 @@ lxw_hash_password(const char *password)
     return hash;
 }
 
+/*
+ * Mix the lanes of the 128 bit digest.
+ */
+STATIC uint64_t
+_digest_mix_k1(uint64_t k1)
+{
+    k1 *= LXW_DIGEST_C1;
+    k1 = LXW_ROTL64(k1, 31);
+    return k1 * LXW_DIGEST_C2;
+}
+
+STATIC uint64_t
+_digest_mix_k2(uint64_t k2)
+{
+    k2 *= LXW_DIGEST_C2;
+    k2 = LXW_ROTL64(k2, 33);
+    return k2 * LXW_DIGEST_C1;
+}
+
+STATIC uint64_t
+_digest_finalize(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= LXW_DIGEST_F1;
+    k ^= k >> 33;
+    k *= LXW_DIGEST_F2;
+    k ^= k >> 33;
+
+    return k;
+}
+
+/*
+ * Calculate a 128 bit digest of a block of data, such as an image file, so
+ * that duplicates can be found without comparing the data. This uses the
+ * MurmurHash3 x64 128 bit algorithm which is several times faster than MD5.
+ * It isn't a cryptographic hash and the digest is only stable for the
+ * current platform, which is all that is needed to remove duplicates.
+ */
+void
+lxw_hash_digest(const void *data, size_t data_len, uint8_t *digest)
+{
+    const unsigned char *p = data;
+    size_t remaining = data_len;
+    uint64_t h1 = 0;
+    uint64_t h2 = 0;
+    uint64_t k1;
+    uint64_t k2;
+
+    /* Mix in the data 16 bytes at a time. */
+    while (remaining >= 2 * sizeof(uint64_t)) {
+        memcpy(&k1, p, sizeof(uint64_t));
+        memcpy(&k2, p + sizeof(uint64_t), sizeof(uint64_t));
+
+        h1 ^= _digest_mix_k1(k1);
+        h1 = LXW_ROTL64(h1, 27);
+        h1 += h2;
+        h1 = h1 * 5 + 0x52DCE729UL;
+
+        h2 ^= _digest_mix_k2(k2);
+        h2 = LXW_ROTL64(h2, 31);
+        h2 += h1;
+        h2 = h2 * 5 + 0x38495AB5UL;
+
+        p += 2 * sizeof(uint64_t);
+        remaining -= 2 * sizeof(uint64_t);
+    }
+
+    /* Mix in any remaining bytes as zero padded words. */
+    if (remaining > sizeof(uint64_t)) {
+        k2 = 0;
+        memcpy(&k2, p + sizeof(uint64_t), remaining - sizeof(uint64_t));
+        h2 ^= _digest_mix_k2(k2);
+        remaining = sizeof(uint64_t);
+    }
+
+    if (remaining) {
+        k1 = 0;
+        memcpy(&k1, p, remaining);
+        h1 ^= _digest_mix_k1(k1);
+    }
+
+    /* Final avalanche of both lanes. */
+    h1 ^= (uint64_t) data_len;
+    h2 ^= (uint64_t) data_len;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = _digest_finalize(h1);
+    h2 = _digest_finalize(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    memcpy(digest, &h1, sizeof(uint64_t));
+    memcpy(digest + sizeof(uint64_t), &h2, sizeof(uint64_t));
+}
+
 /* Make a simple portable version of fopen() for Windows. */
 #ifdef __MINGW32__
 #undef _WIN32
@@ -790,3 +953,47 @@ lxw_fopen(const char *filename, const char *mode)
     return fopen(filename, mode);
 }
 #endif
+
+/*
+ * Portable 64 bit versions of fseek() and ftell() for temp files that can
+ * grow beyond 2GB. A long is only 32 bits on Windows so the fseek()/ftell()
+ * offsets would overflow there.
+ */
+int
+lxw_fseeko(FILE *file, uint64_t offset, int origin)
+{
+    /* Offsets are always positive and must fit in a signed 64 bit value. */
+    if (offset > (((uint64_t) 0x7FFFFFFF << 32) | 0xFFFFFFFF))
+        return -1;
+
+#if defined(_MSC_VER)
+    return _fseeki64(file, (__int64) offset, origin);
+#elif defined(__MINGW32__)
+    return fseeko64(file, (off64_t) offset, origin);
+#else
+    /* Guard against a 32 bit off_t, if _FILE_OFFSET_BITS isn't supported. */
+    if (sizeof(off_t) < sizeof(uint64_t) && offset > 0x7FFFFFFF)
+        return -1;
+
+    return fseeko(file, (off_t) offset, origin);
+#endif
+}
+
+int
+lxw_ftello(FILE *file, uint64_t *offset)
+{
+#if defined(_MSC_VER)
+    __int64 position = _ftelli64(file);
+#elif defined(__MINGW32__)
+    off64_t position = ftello64(file);
+#else
+    off_t position = ftello(file);
+#endif
+
+    if (position < 0)
+        return -1;
+
+    *offset = (uint64_t) position;
+
+    return 0;
+}
@@ -934,10 +934,15 @@ _vml_write_comment_shapetype(lxw_vml *self)
 STATIC void
 _vml_write_idmap(lxw_vml *self)
 {
+    lxw_xml_buffer buffer;
+
     /* Since the vml_data_id_str may exceed the LXW_MAX_ATTRIBUTE_LENGTH we
      * write it directly without the xml helper functions. */
-    fprintf(self->file, "<o:idmap v:ext=\"edit\" data=\"%s\"/>",
-            self->vml_data_id_str);
+    lxw_xml_buffer_init(&buffer, self->file);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "<o:idmap v:ext=\"edit\" data=\"");
+    lxw_xml_buffer_append_str(&buffer, self->vml_data_id_str);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "\"/>");
+    lxw_xml_buffer_flush(&buffer);
 }
 
 /*
@@ -19,15 +19,12 @@ STATIC int _worksheet_name_cmp(lxw_worksheet_name *name1,
                                lxw_worksheet_name *name2);
 STATIC int _chartsheet_name_cmp(lxw_chartsheet_name *name1,
                                 lxw_chartsheet_name *name2);
-STATIC int _image_md5_cmp(lxw_image_md5 *tuple1, lxw_image_md5 *tuple2);
 
 #ifndef __clang_analyzer__
 LXW_RB_GENERATE_WORKSHEET_NAMES(lxw_worksheet_names, lxw_worksheet_name,
                                 tree_pointers, _worksheet_name_cmp);
 LXW_RB_GENERATE_CHARTSHEET_NAMES(lxw_chartsheet_names, lxw_chartsheet_name,
                                  tree_pointers, _chartsheet_name_cmp);
-LXW_RB_GENERATE_IMAGE_MD5S(lxw_image_md5s, lxw_image_md5,
-                           tree_pointers, _image_md5_cmp);
 #endif
 
 /*
@@ -55,10 +52,56 @@ _chartsheet_name_cmp(lxw_chartsheet_name *name1, lxw_chartsheet_name *name2)
     return lxw_strcasecmp(name1->name, name2->name);
 }
 
-STATIC int
-_image_md5_cmp(lxw_image_md5 *tuple1, lxw_image_md5 *tuple2)
+/*
+ * Find the ref id of the first instance of an image in one of the image
+ * digest tables, or 0 if the image hasn't been stored yet.
+ */
+STATIC uint32_t
+_find_image_digest(lxw_hash_table *digests,
+                   lxw_object_properties *object_props)
 {
-    return strcmp(tuple1->md5, tuple2->md5);
+    lxw_hash_element *element;
+
+    if (!object_props->has_digest)
+        return 0;
+
+    element = lxw_hash_key_exists(digests, object_props->digest,
+                                  LXW_IMAGE_DIGEST_SIZE);
+
+    if (element)
+        return *(uint32_t *) element->value;
+    else
+        return 0;
+}
+
+/*
+ * Store the ref id of the first instance of an image. If this fails the
+ * image is stored again instead of being deduplicated.
+ */
+STATIC void
+_store_image_digest(lxw_hash_table *digests,
+                    lxw_object_properties *object_props, uint32_t ref_id)
+{
+    uint8_t *digest;
+    uint32_t *id;
+
+    if (!object_props->has_digest)
+        return;
+
+    digest = malloc(LXW_IMAGE_DIGEST_SIZE);
+    id = malloc(sizeof(uint32_t));
+
+    if (digest && id) {
+        memcpy(digest, object_props->digest, LXW_IMAGE_DIGEST_SIZE);
+        *id = ref_id;
+
+        if (lxw_insert_hash_element(digests, digest, id,
+                                    LXW_IMAGE_DIGEST_SIZE))
+            return;
+    }
+
+    free(digest);
+    free(id);
 }
 
 /*
@@ -109,8 +152,6 @@ lxw_workbook_free(lxw_workbook *workbook)
     struct lxw_worksheet_name *next_worksheet_name;
     struct lxw_chartsheet_name *chartsheet_name;
     struct lxw_chartsheet_name *next_chartsheet_name;
-    struct lxw_image_md5 *image_md5;
-    struct lxw_image_md5 *next_image_md5;
     lxw_chart *chart;
     lxw_format *format;
     lxw_defined_name *defined_name;
@@ -218,68 +259,16 @@ lxw_workbook_free(lxw_workbook *workbook)
         free(workbook->chartsheet_names);
     }
 
-    if (workbook->image_md5s) {
-        for (image_md5 = RB_MIN(lxw_image_md5s, workbook->image_md5s);
-             image_md5; image_md5 = next_image_md5) {
-
-            next_image_md5 =
-                RB_NEXT(lxw_image_md5s, workbook->image_md5, image_md5);
-            RB_REMOVE(lxw_image_md5s, workbook->image_md5s, image_md5);
-            free(image_md5->md5);
-            free(image_md5);
-        }
-
-        free(workbook->image_md5s);
-    }
-
-    if (workbook->embedded_image_md5s) {
-        for (image_md5 =
-             RB_MIN(lxw_image_md5s, workbook->embedded_image_md5s); image_md5;
-             image_md5 = next_image_md5) {
-
-            next_image_md5 =
-                RB_NEXT(lxw_image_md5s, workbook->embedded_image_md5s,
-                        image_md5);
-            RB_REMOVE(lxw_image_md5s, workbook->embedded_image_md5s,
-                      image_md5);
-            free(image_md5->md5);
-            free(image_md5);
-        }
-
-        free(workbook->embedded_image_md5s);
-    }
-
-    if (workbook->header_image_md5s) {
-        for (image_md5 = RB_MIN(lxw_image_md5s, workbook->header_image_md5s);
-             image_md5; image_md5 = next_image_md5) {
-
-            next_image_md5 =
-                RB_NEXT(lxw_image_md5s, workbook->header_image_md5s,
-                        image_md5);
-            RB_REMOVE(lxw_image_md5s, workbook->header_image_md5s, image_md5);
-            free(image_md5->md5);
-            free(image_md5);
-        }
-
-        free(workbook->header_image_md5s);
-    }
-
-    if (workbook->background_md5s) {
-        for (image_md5 = RB_MIN(lxw_image_md5s, workbook->background_md5s);
-             image_md5; image_md5 = next_image_md5) {
-
-            next_image_md5 =
-                RB_NEXT(lxw_image_md5s, workbook->background_md5s, image_md5);
-            RB_REMOVE(lxw_image_md5s, workbook->background_md5s, image_md5);
-            free(image_md5->md5);
-            free(image_md5);
-        }
-
-        free(workbook->background_md5s);
-    }
+    lxw_hash_free(workbook->image_digests);
+    lxw_hash_free(workbook->embedded_image_digests);
+    lxw_hash_free(workbook->header_image_digests);
+    lxw_hash_free(workbook->background_digests);
 
     lxw_hash_free(workbook->used_xf_formats);
     lxw_hash_free(workbook->used_dxf_formats);
+    lxw_mutex_free(workbook->format_mutex);
+    lxw_row_store_free(workbook->row_store);
+    free(workbook->col_names);
     lxw_sst_free(workbook->sst);
     free((void *) workbook->options.tmpdir);
     free(workbook->ordered_charts);
@@ -899,7 +888,9 @@ _populate_range_data_cache(lxw_workbook *self, lxw_series_range *range)
                 }
 
                 if (cell_obj->type == STRING_CELL) {
-                    data_point->string = lxw_strdup(cell_obj->sst_string);
+                    data_point->string =
+                        lxw_strdup(lxw_get_sst_string(worksheet->sst,
+                                                      cell_obj->u.string_id));
                     data_point->is_string = LXW_TRUE;
                     range->has_string_cache = LXW_TRUE;
                 }
@@ -1088,9 +1079,6 @@ _prepare_drawings(lxw_workbook *self)
     uint32_t ref_id = 0;
     uint32_t drawing_id = 0;
     uint8_t is_chartsheet;
-    lxw_image_md5 tmp_image_md5;
-    lxw_image_md5 *new_image_md5 = NULL;
-    lxw_image_md5 *found_duplicate_image = NULL;
     uint8_t i;
 
     STAILQ_FOREACH(sheet, self->sheets, list_pointers) {
@@ -1123,15 +1111,10 @@ _prepare_drawings(lxw_workbook *self)
                 self->has_embedded_image_descriptions = LXW_TRUE;
 
             /* Check for duplicate images and only store the first instance. */
-            if (object_props->md5) {
-                tmp_image_md5.md5 = object_props->md5;
-                found_duplicate_image = RB_FIND(lxw_image_md5s,
-                                                self->embedded_image_md5s,
-                                                &tmp_image_md5);
-            }
+            ref_id = _find_image_digest(self->embedded_image_digests,
+                                        object_props);
 
-            if (found_duplicate_image) {
-                ref_id = found_duplicate_image->id;
+            if (ref_id) {
                 object_props->is_duplicate = LXW_TRUE;
             }
             else {
@@ -1139,16 +1122,8 @@ _prepare_drawings(lxw_workbook *self)
                 ref_id = image_ref_id;
                 self->num_embedded_images++;
 
-#ifndef USE_NO_MD5
-                new_image_md5 = calloc(1, sizeof(lxw_image_md5));
-#endif
-                if (new_image_md5 && object_props->md5) {
-                    new_image_md5->id = ref_id;
-                    new_image_md5->md5 = lxw_strdup(object_props->md5);
-
-                    RB_INSERT(lxw_image_md5s, self->embedded_image_md5s,
-                              new_image_md5);
-                }
+                _store_image_digest(self->embedded_image_digests, object_props,
+                                    ref_id);
             }
 
             worksheet_set_error_cell(worksheet, object_props, ref_id);
@@ -1162,31 +1137,18 @@ _prepare_drawings(lxw_workbook *self)
             _store_image_type(self, object_props->image_type);
 
             /* Check for duplicate images and only store the first instance. */
-            if (object_props->md5) {
-                tmp_image_md5.md5 = object_props->md5;
-                found_duplicate_image = RB_FIND(lxw_image_md5s,
-                                                self->background_md5s,
-                                                &tmp_image_md5);
-            }
+            ref_id = _find_image_digest(self->background_digests,
+                                        object_props);
 
-            if (found_duplicate_image) {
-                ref_id = found_duplicate_image->id;
+            if (ref_id) {
                 object_props->is_duplicate = LXW_TRUE;
             }
             else {
                 image_ref_id++;
                 ref_id = image_ref_id;
 
-#ifndef USE_NO_MD5
-                new_image_md5 = calloc(1, sizeof(lxw_image_md5));
-#endif
-                if (new_image_md5 && object_props->md5) {
-                    new_image_md5->id = ref_id;
-                    new_image_md5->md5 = lxw_strdup(object_props->md5);
-
-                    RB_INSERT(lxw_image_md5s, self->background_md5s,
-                              new_image_md5);
-                }
+                _store_image_digest(self->background_digests, object_props,
+                                    ref_id);
             }
 
             lxw_worksheet_prepare_background(worksheet, ref_id, object_props);
@@ -1202,31 +1164,16 @@ _prepare_drawings(lxw_workbook *self)
             _store_image_type(self, object_props->image_type);
 
             /* Check for duplicate images and only store the first instance. */
-            if (object_props->md5) {
-                tmp_image_md5.md5 = object_props->md5;
-                found_duplicate_image = RB_FIND(lxw_image_md5s,
-                                                self->image_md5s,
-                                                &tmp_image_md5);
-            }
+            ref_id = _find_image_digest(self->image_digests, object_props);
 
-            if (found_duplicate_image) {
-                ref_id = found_duplicate_image->id;
+            if (ref_id) {
                 object_props->is_duplicate = LXW_TRUE;
             }
             else {
                 image_ref_id++;
                 ref_id = image_ref_id;
 
-#ifndef USE_NO_MD5
-                new_image_md5 = calloc(1, sizeof(lxw_image_md5));
-#endif
-                if (new_image_md5 && object_props->md5) {
-                    new_image_md5->id = ref_id;
-                    new_image_md5->md5 = lxw_strdup(object_props->md5);
-
-                    RB_INSERT(lxw_image_md5s, self->image_md5s,
-                              new_image_md5);
-                }
+                _store_image_digest(self->image_digests, object_props, ref_id);
             }
 
             lxw_worksheet_prepare_image(worksheet, ref_id, drawing_id,
@@ -1253,31 +1200,18 @@ _prepare_drawings(lxw_workbook *self)
             _store_image_type(self, object_props->image_type);
 
             /* Check for duplicate images and only store the first instance. */
-            if (object_props->md5) {
-                tmp_image_md5.md5 = object_props->md5;
-                found_duplicate_image = RB_FIND(lxw_image_md5s,
-                                                self->header_image_md5s,
-                                                &tmp_image_md5);
-            }
+            ref_id = _find_image_digest(self->header_image_digests,
+                                        object_props);
 
-            if (found_duplicate_image) {
-                ref_id = found_duplicate_image->id;
+            if (ref_id) {
                 object_props->is_duplicate = LXW_TRUE;
             }
             else {
                 image_ref_id++;
                 ref_id = image_ref_id;
 
-#ifndef USE_NO_MD5
-                new_image_md5 = calloc(1, sizeof(lxw_image_md5));
-#endif
-                if (new_image_md5 && object_props->md5) {
-                    new_image_md5->id = ref_id;
-                    new_image_md5->md5 = lxw_strdup(object_props->md5);
-
-                    RB_INSERT(lxw_image_md5s, self->header_image_md5s,
-                              new_image_md5);
-                }
+                _store_image_digest(self->header_image_digests, object_props,
+                                    ref_id);
             }
 
             lxw_worksheet_prepare_header_image(worksheet, ref_id,
@@ -1893,25 +1827,18 @@ workbook_new_opt(const char *filename, lxw_workbook_options *options)
     GOTO_LABEL_ON_MEM_ERROR(workbook->chartsheet_names, mem_error);
     RB_INIT(workbook->chartsheet_names);
 
-    /* Add the image MD5 tree. */
-    workbook->image_md5s = calloc(1, sizeof(struct lxw_image_md5s));
-    GOTO_LABEL_ON_MEM_ERROR(workbook->image_md5s, mem_error);
-    RB_INIT(workbook->image_md5s);
+    /* Add the image digest tables used to remove duplicate images. */
+    workbook->image_digests = lxw_hash_new(16, 1, 1);
+    GOTO_LABEL_ON_MEM_ERROR(workbook->image_digests, mem_error);
 
-    /* Add the embedded image MD5 tree. */
-    workbook->embedded_image_md5s = calloc(1, sizeof(struct lxw_image_md5s));
-    GOTO_LABEL_ON_MEM_ERROR(workbook->embedded_image_md5s, mem_error);
-    RB_INIT(workbook->embedded_image_md5s);
+    workbook->embedded_image_digests = lxw_hash_new(16, 1, 1);
+    GOTO_LABEL_ON_MEM_ERROR(workbook->embedded_image_digests, mem_error);
 
-    /* Add the header image MD5 tree. */
-    workbook->header_image_md5s = calloc(1, sizeof(struct lxw_image_md5s));
-    GOTO_LABEL_ON_MEM_ERROR(workbook->header_image_md5s, mem_error);
-    RB_INIT(workbook->header_image_md5s);
+    workbook->header_image_digests = lxw_hash_new(16, 1, 1);
+    GOTO_LABEL_ON_MEM_ERROR(workbook->header_image_digests, mem_error);
 
-    /* Add the background image MD5 tree. */
-    workbook->background_md5s = calloc(1, sizeof(struct lxw_image_md5s));
-    GOTO_LABEL_ON_MEM_ERROR(workbook->background_md5s, mem_error);
-    RB_INIT(workbook->background_md5s);
+    workbook->background_digests = lxw_hash_new(16, 1, 1);
+    GOTO_LABEL_ON_MEM_ERROR(workbook->background_digests, mem_error);
 
     /* Add the charts list. */
     workbook->charts = calloc(1, sizeof(struct lxw_charts));
@@ -1974,6 +1901,56 @@ workbook_new_opt(const char *filename, lxw_workbook_options *options)
         workbook->options.use_zip64 = options->use_zip64;
         workbook->options.output_buffer = options->output_buffer;
         workbook->options.output_buffer_size = options->output_buffer_size;
+        workbook->options.worker_threads = options->worker_threads;
+        workbook->options.compression_level = options->compression_level;
+        workbook->options.compression_strategy =
+            options->compression_strategy;
+        workbook->options.concurrent_worksheets =
+            options->concurrent_worksheets;
+        workbook->options.constant_memory_rows =
+            options->constant_memory_rows;
+        workbook->options.constant_memory_strings =
+            options->constant_memory_strings;
+
+        if (options->compression_level > LXW_COMPRESSION_STORE) {
+            LXW_WARN_FORMAT1("workbook_new_opt(): invalid compression_level: "
+                             "%d", options->compression_level);
+            workbook->options.compression_level = LXW_COMPRESSION_DEFAULT;
+        }
+
+        if (options->compression_strategy > LXW_COMPRESSION_STRATEGY_FIXED) {
+            LXW_WARN_FORMAT1("workbook_new_opt(): invalid "
+                             "compression_strategy: %d",
+                             options->compression_strategy);
+            workbook->options.compression_strategy =
+                LXW_COMPRESSION_STRATEGY_DEFAULT;
+        }
+
+        /* Add the locks for the data shared by the worksheets. */
+        if (options->concurrent_worksheets) {
+            workbook->format_mutex = lxw_mutex_new();
+            GOTO_LABEL_ON_MEM_ERROR(workbook->format_mutex, mem_error);
+
+            workbook->sst->mutex = lxw_mutex_new();
+            GOTO_LABEL_ON_MEM_ERROR(workbook->sst->mutex, mem_error);
+
+            /* Also lock the default formats added above. */
+            STAILQ_FOREACH(format, workbook->formats, list_pointers) {
+                format->index_mutex = workbook->format_mutex;
+            }
+        }
+
+        /* Add the store for the rows of finished constant_memory sheets. */
+        if (options->constant_memory) {
+            workbook->row_store = lxw_row_store_new(workbook->options.tmpdir);
+            GOTO_LABEL_ON_MEM_ERROR(workbook->row_store, mem_error);
+        }
+
+        /* Use a bounded shared string table instead of inline strings. */
+        if (options->constant_memory && options->constant_memory_strings) {
+            workbook->sst->max_strings = options->constant_memory_strings;
+            workbook->sst->tmpdir = workbook->options.tmpdir;
+        }
     }
 
     workbook->max_url_length = 2079;
@@ -1999,8 +1976,10 @@ workbook_add_worksheet(lxw_workbook *self, const char *sheetname)
     lxw_worksheet_name *worksheet_name = NULL;
     lxw_error error;
     lxw_worksheet_init_data init_data =
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
     char *new_name = NULL;
+    int level;
+    int strategy;
 
     if (sheetname) {
         /* Use the user supplied name. */
@@ -2035,6 +2014,8 @@ workbook_add_worksheet(lxw_workbook *self, const char *sheetname)
     init_data.index = self->num_sheets;
     init_data.sst = self->sst;
     init_data.optimize = self->options.constant_memory;
+    init_data.optimize_rows = self->options.constant_memory_rows;
+    init_data.local_sst = self->options.concurrent_worksheets;
     init_data.active_sheet = &self->active_sheet;
     init_data.first_sheet = &self->first_sheet;
     init_data.tmpdir = self->options.tmpdir;
@@ -2042,6 +2023,24 @@ workbook_add_worksheet(lxw_workbook *self, const char *sheetname)
     init_data.max_url_length = self->max_url_length;
     init_data.use_1904_epoch = self->use_1904_epoch;
 
+    /* The column names are shared by the worksheets and are read only once
+     * built, so build them here before any of the sheets are written. */
+    if (!self->col_names) {
+        self->col_names = lxw_col_names_new();
+        GOTO_LABEL_ON_MEM_ERROR(self->col_names, mem_error);
+    }
+    init_data.col_names = self->col_names;
+
+    /* In constant_memory mode the rows are compressed as they are written
+     * so the worksheet needs the compression settings up front. */
+    if (self->options.constant_memory) {
+        lxw_packager_get_compression(self, "xl/worksheets/sheet.xml",
+                                     &level, &strategy);
+        init_data.deflate_level = (int8_t) level;
+        init_data.deflate_strategy = (uint8_t) strategy;
+        init_data.row_store = self->row_store;
+    }
+
     /* Create a new worksheet object. */
     worksheet = lxw_worksheet_new(&init_data);
     GOTO_LABEL_ON_MEM_ERROR(worksheet, mem_error);
@@ -2085,7 +2084,7 @@ workbook_add_chartsheet(lxw_workbook *self, const char *sheetname)
     lxw_chartsheet_name *chartsheet_name = NULL;
     lxw_error error;
     lxw_worksheet_init_data init_data =
-        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+        { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
     char *new_name = NULL;
 
     if (sheetname) {
@@ -2194,6 +2193,7 @@ workbook_add_format(lxw_workbook *self)
 
     format->xf_format_indices = self->used_xf_formats;
     format->dxf_format_indices = self->used_dxf_formats;
+    format->index_mutex = self->format_mutex;
     format->num_xf_formats = &self->num_xf_formats;
 
     STAILQ_INSERT_TAIL(self->formats, format, list_pointers);
@@ -2269,6 +2269,16 @@ workbook_close(lxw_workbook *self)
         }
     }
 
+    /* Merge the worksheet string tables into the shared string table. */
+    STAILQ_FOREACH(sheet, self->sheets, list_pointers) {
+        if (sheet->is_chartsheet)
+            continue;
+
+        error = lxw_worksheet_merge_sst(sheet->u.worksheet);
+        if (error)
+            goto mem_error;
+    }
+
     /* Prepare the worksheet VML elements such as comments. */
     _prepare_vml(self);
 
@@ -2738,10 +2748,12 @@ workbook_get_default_url_format(lxw_workbook *self)
 void
 workbook_unset_default_url_format(lxw_workbook *self)
 {
-    self->default_url_format->hyperlink = LXW_FALSE;
-    self->default_url_format->xf_id = 0;
-    self->default_url_format->underline = LXW_UNDERLINE_NONE;
-    self->default_url_format->theme = 0;
+    lxw_format *format = self->default_url_format;
+
+    LXW_FORMAT_SET_PROPERTY(format, hyperlink, LXW_FALSE);
+    LXW_FORMAT_SET_PROPERTY(format, xf_id, 0);
+    LXW_FORMAT_SET_PROPERTY(format, underline, LXW_UNDERLINE_NONE);
+    LXW_FORMAT_SET_PROPERTY(format, theme, 0);
 }
 
 /*
@@ -2898,3 +2910,70 @@ workbook_set_size(lxw_workbook *workbook, uint16_t width, uint16_t height)
         workbook->window_height = height * 1440 / 96;
 
 }
+
+/*
+ * Add an array of strings to the shared string table and return their
+ * indices.
+ */
+lxw_error
+workbook_add_shared_strings(lxw_workbook *self, const char **strings,
+                            uint32_t num_strings, uint32_t *indices)
+{
+    struct sst_element *sst_element;
+    uint32_t i;
+
+    if (!strings || !indices)
+        return LXW_ERROR_NULL_PARAMETER_IGNORED;
+
+    for (i = 0; i < num_strings; i++) {
+        if (!strings[i])
+            return LXW_ERROR_NULL_PARAMETER_IGNORED;
+
+        if (strlen(strings[i]) > LXW_STR_MAX
+            && lxw_utf8_strlen(strings[i]) > LXW_STR_MAX)
+            return LXW_ERROR_MAX_STRING_LENGTH_EXCEEDED;
+
+        sst_element = lxw_add_sst_string(self->sst, strings[i], LXW_FALSE);
+
+        /* A bounded table can also fail to use its temp files. */
+        if (!sst_element && self->sst->file_error)
+            return self->sst->file_error;
+
+        RETURN_ON_MEM_ERROR(sst_element, LXW_ERROR_MEMORY_MALLOC_FAILED);
+
+        indices[i] = sst_element->index;
+    }
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Set the compression level and strategy for a class of parts.
+ */
+lxw_error
+workbook_set_compression(lxw_workbook *self, uint8_t part, uint8_t level,
+                         uint8_t strategy)
+{
+    if (part > LXW_PART_OTHER) {
+        LXW_WARN_FORMAT1("workbook_set_compression(): invalid part: %d",
+                         part);
+        return LXW_ERROR_PARAMETER_VALIDATION;
+    }
+
+    if (level > LXW_COMPRESSION_STORE) {
+        LXW_WARN_FORMAT1("workbook_set_compression(): invalid level: %d",
+                         level);
+        return LXW_ERROR_PARAMETER_VALIDATION;
+    }
+
+    if (strategy > LXW_COMPRESSION_STRATEGY_FIXED) {
+        LXW_WARN_FORMAT1("workbook_set_compression(): invalid strategy: %d",
+                         strategy);
+        return LXW_ERROR_PARAMETER_VALIDATION;
+    }
+
+    self->compression_levels[part] = level;
+    self->compression_strategies[part] = strategy;
+
+    return LXW_NO_ERROR;
+}
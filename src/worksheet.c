@@ -16,40 +16,41 @@
 #include "xlsxwriter/worksheet.h"
 #include "xlsxwriter/format.h"
 #include "xlsxwriter/utility.h"
+#include "zlib.h"
 
+#if !defined(USE_NO_MD5) && !defined(USE_FAST_IMAGE_HASH)
 #ifdef USE_OPENSSL_MD5
 #include <openssl/md5.h>
 #else
-#ifndef USE_NO_MD5
 #include "xlsxwriter/third_party/md5.h"
 #endif
 #endif
 
-#define LXW_STR_MAX                      32767
 #define LXW_BUFFER_SIZE                  4096
+#define LXW_OPTIMIZE_DEFLATE_SIZE        65536
+#define LXW_ROW_BUFFER_SIZE              65536
 #define LXW_PRINT_ACROSS                 1
 #define LXW_VALIDATION_MAX_TITLE_LENGTH  32
 #define LXW_VALIDATION_MAX_STRING_LENGTH 255
 #define LXW_THIS_ROW "[#This Row],"
+
+#ifndef DEF_MEM_LEVEL
+#define DEF_MEM_LEVEL 8
+#endif
+
 /*
  * Forward declarations.
  */
 STATIC void _worksheet_write_rows(lxw_worksheet *self);
+STATIC void _worksheet_flush_optimized_rows(lxw_worksheet *self,
+                                            lxw_row_t first_row);
 STATIC int _row_cmp(lxw_row *row1, lxw_row *row2);
-STATIC int _cell_cmp(lxw_cell *cell1, lxw_cell *cell2);
-STATIC int _drawing_rel_id_cmp(lxw_drawing_rel_id *tuple1,
-                               lxw_drawing_rel_id *tuple2);
+STATIC uint8_t _row_in_geometry(lxw_worksheet *self, lxw_row *row);
 STATIC int _cond_format_hash_cmp(lxw_cond_format_hash_element *elem_1,
                                  lxw_cond_format_hash_element *elem_2);
 
 #ifndef __clang_analyzer__
 LXW_RB_GENERATE_ROW(lxw_table_rows, lxw_row, tree_pointers, _row_cmp);
-LXW_RB_GENERATE_CELL(lxw_table_cells, lxw_cell, tree_pointers, _cell_cmp);
-LXW_RB_GENERATE_DRAWING_REL_IDS(lxw_drawing_rel_ids, lxw_drawing_rel_id,
-                                tree_pointers, _drawing_rel_id_cmp);
-LXW_RB_GENERATE_VML_DRAWING_REL_IDS(lxw_vml_drawing_rel_ids,
-                                    lxw_drawing_rel_id, tree_pointers,
-                                    _drawing_rel_id_cmp);
 LXW_RB_GENERATE_COND_FORMAT_HASH(lxw_cond_format_hash,
                                  lxw_cond_format_hash_element, tree_pointers,
                                  _cond_format_hash_cmp);
@@ -74,20 +75,47 @@ lxw_worksheet_find_row(lxw_worksheet *self, lxw_row_t row_num)
     return RB_FIND(lxw_table_rows, self->table, &tmp_row);
 }
 
+/*
+ * Find the position of a column in the sorted cell vector of a row. This is
+ * either the position of the cell for that column or the position where it
+ * would be inserted.
+ */
+STATIC lxw_col_t
+_find_cell_index(lxw_row *row, lxw_col_t col_num)
+{
+    lxw_col_t low = 0;
+    lxw_col_t high = row->num_cells;
+    lxw_col_t mid;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+
+        if (row->cells[mid]->col_num < col_num)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
 /*
  * Find but don't create a cell object for a given row object and col number.
  */
 lxw_cell *
 lxw_worksheet_find_cell_in_row(lxw_row *row, lxw_col_t col_num)
 {
-    lxw_cell tmp_cell;
+    lxw_col_t index;
 
     if (!row)
         return NULL;
 
-    tmp_cell.col_num = col_num;
+    index = _find_cell_index(row, col_num);
 
-    return RB_FIND(lxw_table_cells, row->cells, &tmp_cell);
+    if (index < row->num_cells && row->cells[index]->col_num == col_num)
+        return row->cells[index];
+    else
+        return NULL;
 }
 
 /*
@@ -96,6 +124,7 @@ lxw_worksheet_find_cell_in_row(lxw_row *row, lxw_col_t col_num)
 lxw_worksheet *
 lxw_worksheet_new(lxw_worksheet_init_data *init_data)
 {
+    uint16_t i;
     lxw_worksheet *worksheet = calloc(1, sizeof(lxw_worksheet));
     GOTO_LABEL_ON_MEM_ERROR(worksheet, mem_error);
 
@@ -116,10 +145,10 @@ lxw_worksheet_new(lxw_worksheet_init_data *init_data)
     worksheet->hyperlinks->cached_row_num = LXW_ROW_MAX + 1;
     worksheet->comments->cached_row_num = LXW_ROW_MAX + 1;
 
-    if (init_data && init_data->optimize) {
-        worksheet->array = calloc(LXW_COL_MAX, sizeof(struct lxw_cell *));
-        GOTO_LABEL_ON_MEM_ERROR(worksheet->array, mem_error);
-    }
+    /* Initialize the memory pools for the cells and rows. */
+    worksheet->cell_pool.item_size = sizeof(lxw_cell);
+    worksheet->cell_extra_pool.item_size = sizeof(lxw_cell_extra);
+    worksheet->row_pool.item_size = sizeof(lxw_row);
 
     worksheet->col_options =
         calloc(LXW_COL_META_MAX, sizeof(lxw_col_options *));
@@ -130,10 +159,6 @@ lxw_worksheet_new(lxw_worksheet_init_data *init_data)
     worksheet->col_formats_max = LXW_COL_META_MAX;
     GOTO_LABEL_ON_MEM_ERROR(worksheet->col_formats, mem_error);
 
-    worksheet->optimize_row = calloc(1, sizeof(struct lxw_row));
-    GOTO_LABEL_ON_MEM_ERROR(worksheet->optimize_row, mem_error);
-    worksheet->optimize_row->height = LXW_DEF_ROW_HEIGHT;
-
     worksheet->merged_ranges = calloc(1, sizeof(struct lxw_merged_ranges));
     GOTO_LABEL_ON_MEM_ERROR(worksheet->merged_ranges, mem_error);
     STAILQ_INIT(worksheet->merged_ranges);
@@ -217,15 +242,11 @@ lxw_worksheet_new(lxw_worksheet_init_data *init_data)
         worksheet->file = worksheet->optimize_tmpfile;
     }
 
-    worksheet->drawing_rel_ids =
-        calloc(1, sizeof(struct lxw_drawing_rel_ids));
+    worksheet->drawing_rel_ids = lxw_hash_new(16, 1, 1);
     GOTO_LABEL_ON_MEM_ERROR(worksheet->drawing_rel_ids, mem_error);
-    RB_INIT(worksheet->drawing_rel_ids);
 
-    worksheet->vml_drawing_rel_ids =
-        calloc(1, sizeof(struct lxw_vml_drawing_rel_ids));
+    worksheet->vml_drawing_rel_ids = lxw_hash_new(16, 1, 1);
     GOTO_LABEL_ON_MEM_ERROR(worksheet->vml_drawing_rel_ids, mem_error);
-    RB_INIT(worksheet->vml_drawing_rel_ids);
 
     worksheet->conditional_formats =
         calloc(1, sizeof(struct lxw_cond_format_hash));
@@ -289,12 +310,43 @@ lxw_worksheet_new(lxw_worksheet_init_data *init_data)
         worksheet->index = init_data->index;
         worksheet->hidden = init_data->hidden;
         worksheet->sst = init_data->sst;
+        worksheet->workbook_sst = init_data->sst;
         worksheet->optimize = init_data->optimize;
         worksheet->active_sheet = init_data->active_sheet;
         worksheet->first_sheet = init_data->first_sheet;
         worksheet->default_url_format = init_data->default_url_format;
         worksheet->max_url_length = init_data->max_url_length;
         worksheet->use_1904_epoch = init_data->use_1904_epoch;
+        worksheet->optimize_level = init_data->deflate_level;
+        worksheet->optimize_strategy = init_data->deflate_strategy;
+        worksheet->optimize_deflate = init_data->optimize
+            && init_data->deflate_level != 0;
+        worksheet->row_store = init_data->row_store;
+        worksheet->col_names = init_data->col_names;
+
+        /* Use a private string table, that is merged into the workbook
+         * table on close, so that worksheets don't contend for the SST when
+         * they are written to concurrently. */
+        if (init_data->local_sst && !init_data->optimize) {
+            worksheet->sst = lxw_sst_new();
+            GOTO_LABEL_ON_MEM_ERROR(worksheet->sst, mem_error);
+            worksheet->local_sst = LXW_TRUE;
+        }
+
+        /* In constant_memory mode the rows that haven't been written yet
+         * are kept in a ring, indexed by row number, of at least one row. */
+        if (init_data->optimize) {
+            worksheet->optimize_num_rows = 1;
+            if (init_data->optimize_rows > 1)
+                worksheet->optimize_num_rows = init_data->optimize_rows;
+
+            worksheet->optimize_rows = calloc(worksheet->optimize_num_rows,
+                                              sizeof(struct lxw_row));
+            GOTO_LABEL_ON_MEM_ERROR(worksheet->optimize_rows, mem_error);
+
+            for (i = 0; i < worksheet->optimize_num_rows; i++)
+                worksheet->optimize_rows[i].height = LXW_DEF_ROW_HEIGHT;
+        }
     }
 
     return worksheet;
@@ -365,14 +417,111 @@ _free_filter_rules(lxw_worksheet *worksheet)
 }
 
 /*
- * Free a worksheet cell.
+ * Get the number of items in a memory pool block. The blocks start small so
+ * that worksheets with little data don't use much memory.
+ */
+STATIC size_t
+_pool_block_items(size_t block_num)
+{
+    size_t items = LXW_MEM_POOL_MIN_ITEMS;
+
+    while (block_num-- && items < LXW_MEM_POOL_MAX_ITEMS)
+        items *= 2;
+
+    return items;
+}
+
+/*
+ * Allocate a zeroed item from a worksheet memory pool.
+ */
+STATIC void *
+_pool_alloc(lxw_mem_pool *pool)
+{
+    char **blocks;
+    size_t blocks_size;
+    size_t items;
+
+    /* Reuse a released item if there is one. They are already zeroed. */
+    if (pool->num_free)
+        return pool->free_items[--pool->num_free];
+
+    if (pool->num_blocks)
+        items = _pool_block_items(pool->num_blocks - 1);
+    else
+        items = 0;
+
+    /* Add a new block if the current one is full. */
+    if (pool->used == items) {
+        if (pool->num_blocks == pool->blocks_size) {
+            blocks_size = pool->blocks_size ? pool->blocks_size * 2 : 16;
+            blocks = realloc(pool->blocks, blocks_size * sizeof(char *));
+            if (!blocks)
+                return NULL;
+
+            pool->blocks = blocks;
+            pool->blocks_size = blocks_size;
+        }
+
+        items = _pool_block_items(pool->num_blocks);
+        pool->blocks[pool->num_blocks] = calloc(items, pool->item_size);
+        if (!pool->blocks[pool->num_blocks])
+            return NULL;
+
+        pool->num_blocks++;
+        pool->used = 0;
+    }
+
+    return pool->blocks[pool->num_blocks - 1]
+        + pool->item_size * pool->used++;
+}
+
+/*
+ * Return an item to a worksheet memory pool so that it can be reused.
  */
 STATIC void
-_free_cell(lxw_cell *cell)
+_pool_release(lxw_mem_pool *pool, void *item)
 {
-    if (!cell)
-        return;
+    void **free_items;
+    size_t free_size;
+
+    memset(item, 0, pool->item_size);
+
+    if (pool->num_free == pool->free_size) {
+        free_size = pool->free_size ? pool->free_size * 2 : 64;
+        free_items = realloc(pool->free_items, free_size * sizeof(void *));
+
+        /* If the stack can't grow the item is just not reused. */
+        if (!free_items)
+            return;
+
+        pool->free_items = free_items;
+        pool->free_size = free_size;
+    }
+
+    pool->free_items[pool->num_free++] = item;
+}
+
+/*
+ * Free all the blocks in a worksheet memory pool.
+ */
+STATIC void
+_pool_free(lxw_mem_pool *pool)
+{
+    size_t i;
 
+    for (i = 0; i < pool->num_blocks; i++)
+        free(pool->blocks[i]);
+
+    free(pool->blocks);
+    free(pool->free_items);
+}
+
+/*
+ * Free the data owned by a worksheet cell.
+ */
+STATIC void
+_free_cell_data(lxw_cell *cell)
+{
     if (cell->type != NUMBER_CELL && cell->type != STRING_CELL
         && cell->type != BLANK_CELL && cell->type != BOOLEAN_CELL
         && cell->type != ERROR_CELL) {
@@ -380,34 +529,85 @@ _free_cell(lxw_cell *cell)
         free((void *) cell->u.string);
     }
 
-    free(cell->user_data1);
-    free(cell->user_data2);
+    if (cell->extra) {
+        free(cell->extra->user_data1);
+        free(cell->extra->user_data2);
+
+        _free_vml_object(cell->extra->comment);
+    }
+}
+
+/*
+ * Free a worksheet cell and return it to the cell pool.
+ */
+STATIC void
+_free_cell(lxw_worksheet *self, lxw_cell *cell)
+{
+    if (!cell)
+        return;
+
+    _free_cell_data(cell);
 
-    _free_vml_object(cell->comment);
+    if (cell->extra)
+        _pool_release(&self->cell_extra_pool, cell->extra);
 
-    free(cell);
+    _pool_release(&self->cell_pool, cell);
 }
 
 /*
- * Free a worksheet row.
+ * Free the cell vectors of all of the worksheet rows, and the rows, by
+ * walking the row pool.
  */
 STATIC void
-_free_row(lxw_row *row)
+_free_rows(lxw_worksheet *self)
 {
-    lxw_cell *cell;
-    lxw_cell *next_cell;
+    lxw_mem_pool *pool = &self->row_pool;
+    lxw_row *rows;
+    size_t items;
+    size_t i;
+    size_t j;
 
-    if (!row)
-        return;
+    for (i = 0; i < pool->num_blocks; i++) {
+        rows = (lxw_row *) pool->blocks[i];
+
+        if (i == pool->num_blocks - 1)
+            items = pool->used;
+        else
+            items = _pool_block_items(i);
+
+        for (j = 0; j < items; j++)
+            free(rows[j].cells);
+    }
+
+    _pool_free(pool);
+}
+
+/*
+ * Free the data owned by all of the worksheet cells, and the cells, by
+ * walking the cell pool instead of the cell trees.
+ */
+STATIC void
+_free_cells(lxw_worksheet *self)
+{
+    lxw_mem_pool *pool = &self->cell_pool;
+    lxw_cell *cells;
+    size_t items;
+    size_t i;
+    size_t j;
+
+    for (i = 0; i < pool->num_blocks; i++) {
+        cells = (lxw_cell *) pool->blocks[i];
+
+        if (i == pool->num_blocks - 1)
+            items = pool->used;
+        else
+            items = _pool_block_items(i);
 
-    for (cell = RB_MIN(lxw_table_cells, row->cells); cell; cell = next_cell) {
-        next_cell = RB_NEXT(lxw_table_cells, row->cells, cell);
-        RB_REMOVE(lxw_table_cells, row->cells, cell);
-        _free_cell(cell);
+        for (j = 0; j < items; j++)
+            _free_cell_data(&cells[j]);
     }
 
-    free(row->cells);
-    free(row);
+    _pool_free(pool);
 }
 
 /*
@@ -425,7 +625,6 @@ _free_object_properties(lxw_object_properties *object_property)
     free(object_property->url);
     free(object_property->tip);
     free(object_property->image_buffer);
-    free(object_property->md5);
     free(object_property->image_position);
     free(object_property);
     object_property = NULL;
@@ -522,15 +721,76 @@ _free_worksheet_table(lxw_table_obj *table)
     free(table);
 }
 
+/*
+ * Create a new row store. The temp file is created when the first worksheet
+ * is finished.
+ */
+lxw_row_store *
+lxw_row_store_new(const char *tmpdir)
+{
+    lxw_row_store *store = calloc(1, sizeof(lxw_row_store));
+    RETURN_ON_MEM_ERROR(store, NULL);
+
+    /* The store is always locked since the packager threads may read from
+     * it when the workbook is closed. */
+    store->mutex = lxw_mutex_new();
+    if (!store->mutex) {
+        free(store);
+        return NULL;
+    }
+
+    store->tmpdir = tmpdir;
+
+    return store;
+}
+
+/*
+ * Create the table of column names used in cell references. It is built in
+ * full, before any worksheet is written, so that it can be shared read only
+ * between the worksheets of a workbook.
+ */
+lxw_col_name *
+lxw_col_names_new(void)
+{
+    lxw_col_name *col_names = calloc(LXW_COL_MAX, sizeof(lxw_col_name));
+    lxw_col_t col_num;
+
+    RETURN_ON_MEM_ERROR(col_names, NULL);
+
+    for (col_num = 0; col_num < LXW_COL_MAX; col_num++) {
+        lxw_col_to_name(col_names[col_num].name, col_num, LXW_FALSE);
+        col_names[col_num].length =
+            (uint8_t) strlen(col_names[col_num].name);
+    }
+
+    return col_names;
+}
+
+/*
+ * Free a row store.
+ */
+void
+lxw_row_store_free(lxw_row_store *store)
+{
+    if (!store)
+        return;
+
+    if (store->file)
+        fclose(store->file);
+
+    free(store->buffer);
+    lxw_mutex_free(store->mutex);
+    free(store);
+}
+
 /*
  * Free a worksheet object.
  */
 void
 lxw_worksheet_free(lxw_worksheet *worksheet)
 {
-    lxw_row *row;
-    lxw_row *next_row;
     lxw_col_t col;
+    uint16_t i;
     lxw_merged_range *merged_range;
     lxw_object_properties *object_props;
     lxw_vml_obj *vml_obj;
@@ -539,8 +799,6 @@ lxw_worksheet_free(lxw_worksheet *worksheet)
     lxw_rel_tuple *relationship;
     lxw_cond_format_obj *cond_format;
     lxw_table_obj *table_obj;
-    struct lxw_drawing_rel_id *drawing_rel_id;
-    struct lxw_drawing_rel_id *next_drawing_rel_id;
     struct lxw_cond_format_hash_element *cond_format_elem;
     struct lxw_cond_format_hash_element *next_cond_format_elem;
 
@@ -557,42 +815,22 @@ lxw_worksheet_free(lxw_worksheet *worksheet)
     free(worksheet->col_options);
     free(worksheet->col_sizes);
     free(worksheet->col_formats);
+    free(worksheet->col_geometry);
+    free(worksheet->row_geometry);
+    lxw_xml_buffer_free(worksheet->row_buffer);
 
-    if (worksheet->table) {
-        for (row = RB_MIN(lxw_table_rows, worksheet->table); row;
-             row = next_row) {
-
-            next_row = RB_NEXT(lxw_table_rows, worksheet->table, row);
-            RB_REMOVE(lxw_table_rows, worksheet->table, row);
-            _free_row(row);
-        }
-
-        free(worksheet->table);
-    }
-
-    if (worksheet->hyperlinks) {
-        for (row = RB_MIN(lxw_table_rows, worksheet->hyperlinks); row;
-             row = next_row) {
+    /* The cells and rows are freed in bulk from the memory pools. */
+    _free_cells(worksheet);
+    _pool_free(&worksheet->cell_extra_pool);
+    _free_rows(worksheet);
 
-            next_row = RB_NEXT(lxw_table_rows, worksheet->hyperlinks, row);
-            RB_REMOVE(lxw_table_rows, worksheet->hyperlinks, row);
-            _free_row(row);
-        }
-
-        free(worksheet->hyperlinks);
-    }
-
-    if (worksheet->comments) {
-        for (row = RB_MIN(lxw_table_rows, worksheet->comments); row;
-             row = next_row) {
+    if (worksheet->local_sst)
+        lxw_sst_free(worksheet->sst);
 
-            next_row = RB_NEXT(lxw_table_rows, worksheet->comments, row);
-            RB_REMOVE(lxw_table_rows, worksheet->comments, row);
-            _free_row(row);
-        }
-
-        free(worksheet->comments);
-    }
+    free(worksheet->sst_remap);
+    free(worksheet->table);
+    free(worksheet->hyperlinks);
+    free(worksheet->comments);
 
     if (worksheet->merged_ranges) {
         while (!STAILQ_EMPTY(worksheet->merged_ranges)) {
@@ -723,39 +961,8 @@ lxw_worksheet_free(lxw_worksheet *worksheet)
     }
     free(worksheet->external_table_links);
 
-    if (worksheet->drawing_rel_ids) {
-        for (drawing_rel_id =
-             RB_MIN(lxw_drawing_rel_ids, worksheet->drawing_rel_ids);
-             drawing_rel_id; drawing_rel_id = next_drawing_rel_id) {
-
-            next_drawing_rel_id =
-                RB_NEXT(lxw_drawing_rel_ids, worksheet->drawing_rel_id,
-                        drawing_rel_id);
-            RB_REMOVE(lxw_drawing_rel_ids, worksheet->drawing_rel_ids,
-                      drawing_rel_id);
-            free(drawing_rel_id->target);
-            free(drawing_rel_id);
-        }
-
-        free(worksheet->drawing_rel_ids);
-    }
-
-    if (worksheet->vml_drawing_rel_ids) {
-        for (drawing_rel_id =
-             RB_MIN(lxw_vml_drawing_rel_ids, worksheet->vml_drawing_rel_ids);
-             drawing_rel_id; drawing_rel_id = next_drawing_rel_id) {
-
-            next_drawing_rel_id =
-                RB_NEXT(lxw_vml_drawing_rel_ids, worksheet->drawing_rel_id,
-                        drawing_rel_id);
-            RB_REMOVE(lxw_vml_drawing_rel_ids, worksheet->vml_drawing_rel_ids,
-                      drawing_rel_id);
-            free(drawing_rel_id->target);
-            free(drawing_rel_id);
-        }
-
-        free(worksheet->vml_drawing_rel_ids);
-    }
+    lxw_hash_free(worksheet->drawing_rel_ids);
+    lxw_hash_free(worksheet->vml_drawing_rel_ids);
 
     if (worksheet->conditional_formats) {
         for (cond_format_elem =
@@ -789,15 +996,27 @@ lxw_worksheet_free(lxw_worksheet *worksheet)
 
     _free_filter_rules(worksheet);
 
-    if (worksheet->array) {
-        for (col = 0; col < LXW_COL_MAX; col++) {
-            _free_cell(worksheet->array[col]);
-        }
-        free(worksheet->array);
+    if (worksheet->optimize_rows) {
+        for (i = 0; i < worksheet->optimize_num_rows; i++)
+            free(worksheet->optimize_rows[i].cells);
+
+        free(worksheet->optimize_rows);
+    }
+
+    if (worksheet->optimize_stream) {
+        deflateEnd(worksheet->optimize_stream);
+        free(worksheet->optimize_stream);
     }
 
-    if (worksheet->optimize_row)
-        free(worksheet->optimize_row);
+    if (worksheet->optimize_deflated_file)
+        fclose(worksheet->optimize_deflated_file);
+
+    free(worksheet->optimize_deflated_buffer);
+
+    if (worksheet->optimize_tmpfile)
+        fclose(worksheet->optimize_tmpfile);
+
+    free(worksheet->optimize_buffer);
 
     if (worksheet->drawing)
         lxw_drawing_free(worksheet->drawing);
@@ -830,35 +1049,50 @@ lxw_worksheet_free(lxw_worksheet *worksheet)
  * Create a new worksheet row object.
  */
 STATIC lxw_row *
-_new_row(lxw_row_t row_num)
+_new_row(lxw_worksheet *self, lxw_row_t row_num)
 {
-    lxw_row *row = calloc(1, sizeof(lxw_row));
+    lxw_row *row = _pool_alloc(&self->row_pool);
+    RETURN_ON_MEM_ERROR(row, NULL);
 
-    if (row) {
-        row->row_num = row_num;
-        row->cells = calloc(1, sizeof(struct lxw_table_cells));
-        row->height = LXW_DEF_ROW_HEIGHT;
+    row->row_num = row_num;
+    row->height = LXW_DEF_ROW_HEIGHT;
 
-        if (row->cells)
-            RB_INIT(row->cells);
-        else
-            LXW_MEM_ERROR();
-    }
-    else {
+    /* A new row only changes the row geometry used for objects if its height
+     * differs from the default row height. */
+    if (_row_in_geometry(self, row))
+        self->row_geometry_valid = LXW_FALSE;
+
+    return row;
+}
+
+/*
+ * Create a new cell object with the additional data used by formula,
+ * hyperlink and comment cells.
+ */
+STATIC lxw_cell *
+_new_extra_cell(lxw_worksheet *self)
+{
+    lxw_cell *cell = _pool_alloc(&self->cell_pool);
+    RETURN_ON_MEM_ERROR(cell, NULL);
+
+    cell->extra = _pool_alloc(&self->cell_extra_pool);
+    if (!cell->extra) {
+        _pool_release(&self->cell_pool, cell);
         LXW_MEM_ERROR();
+        return NULL;
     }
 
-    return row;
+    return cell;
 }
 
 /*
  * Create a new worksheet number cell object.
  */
 STATIC lxw_cell *
-_new_number_cell(lxw_row_t row_num,
+_new_number_cell(lxw_worksheet *self, lxw_row_t row_num,
                  lxw_col_t col_num, double value, lxw_format *format)
 {
-    lxw_cell *cell = calloc(1, sizeof(lxw_cell));
+    lxw_cell *cell = _pool_alloc(&self->cell_pool);
     RETURN_ON_MEM_ERROR(cell, cell);
 
     cell->row_num = row_num;
@@ -874,11 +1108,10 @@ _new_number_cell(lxw_row_t row_num,
  * Create a new worksheet string cell object.
  */
 STATIC lxw_cell *
-_new_string_cell(lxw_row_t row_num,
-                 lxw_col_t col_num, int32_t string_id, char *sst_string,
-                 lxw_format *format)
+_new_string_cell(lxw_worksheet *self, lxw_row_t row_num,
+                 lxw_col_t col_num, int32_t string_id, lxw_format *format)
 {
-    lxw_cell *cell = calloc(1, sizeof(lxw_cell));
+    lxw_cell *cell = _pool_alloc(&self->cell_pool);
     RETURN_ON_MEM_ERROR(cell, cell);
 
     cell->row_num = row_num;
@@ -886,7 +1119,6 @@ _new_string_cell(lxw_row_t row_num,
     cell->type = STRING_CELL;
     cell->format = format;
     cell->u.string_id = string_id;
-    cell->sst_string = sst_string;
 
     return cell;
 }
@@ -895,10 +1127,10 @@ _new_string_cell(lxw_row_t row_num,
  * Create a new worksheet inline_string cell object.
  */
 STATIC lxw_cell *
-_new_inline_string_cell(lxw_row_t row_num,
+_new_inline_string_cell(lxw_worksheet *self, lxw_row_t row_num,
                         lxw_col_t col_num, char *string, lxw_format *format)
 {
-    lxw_cell *cell = calloc(1, sizeof(lxw_cell));
+    lxw_cell *cell = _pool_alloc(&self->cell_pool);
     RETURN_ON_MEM_ERROR(cell, cell);
 
     cell->row_num = row_num;
@@ -914,11 +1146,11 @@ _new_inline_string_cell(lxw_row_t row_num,
  * Create a new worksheet inline_string cell object for rich strings.
  */
 STATIC lxw_cell *
-_new_inline_rich_string_cell(lxw_row_t row_num,
+_new_inline_rich_string_cell(lxw_worksheet *self, lxw_row_t row_num,
                              lxw_col_t col_num, const char *string,
                              lxw_format *format)
 {
-    lxw_cell *cell = calloc(1, sizeof(lxw_cell));
+    lxw_cell *cell = _pool_alloc(&self->cell_pool);
     RETURN_ON_MEM_ERROR(cell, cell);
 
     cell->row_num = row_num;
@@ -930,15 +1162,49 @@ _new_inline_rich_string_cell(lxw_row_t row_num,
     return cell;
 }
 
+/*
+ * Create a string cell that refers to the SST or, in constant_memory mode,
+ * an inline string cell with an escaped copy of the string.
+ */
+STATIC lxw_cell *
+_new_sst_or_inline_cell(lxw_worksheet *self, lxw_row_t row_num,
+                        lxw_col_t col_num, const char *string,
+                        lxw_format *format)
+{
+    uint32_t string_id;
+    char *string_copy;
+
+    /* Strings are only written inline in constant_memory mode when the
+     * number of shared strings in memory isn't bounded. */
+    if (!self->optimize || self->sst->max_strings) {
+        /* Get the SST string id. */
+        if (lxw_get_sst_string_index(self->sst, string, &string_id))
+            return NULL;
+
+        return _new_string_cell(self, row_num, col_num, string_id, format);
+    }
+
+    /* Look for and escape control chars in the string. */
+    if (lxw_has_control_characters(string))
+        string_copy = lxw_escape_control_characters(string);
+    else
+        string_copy = lxw_strdup(string);
+
+    return _new_inline_string_cell(self, row_num, col_num, string_copy,
+                                   format);
+}
+
 /*
  * Create a new worksheet formula cell object.
  */
 STATIC lxw_cell *
-_new_formula_cell(lxw_row_t row_num,
+_new_formula_cell(lxw_worksheet *self, lxw_row_t row_num,
                   lxw_col_t col_num, char *formula, lxw_format *format)
 {
-    lxw_cell *cell = calloc(1, sizeof(lxw_cell));
-    RETURN_ON_MEM_ERROR(cell, cell);
+    lxw_cell *cell = _new_extra_cell(self);
+
+    if (!cell)
+        return NULL;
 
     cell->row_num = row_num;
     cell->col_num = col_num;
@@ -953,17 +1219,20 @@ _new_formula_cell(lxw_row_t row_num,
  * Create a new worksheet array formula cell object.
  */
 STATIC lxw_cell *
-_new_array_formula_cell(lxw_row_t row_num, lxw_col_t col_num, char *formula,
-                        char *range, lxw_format *format, uint8_t is_dynamic)
+_new_array_formula_cell(lxw_worksheet *self, lxw_row_t row_num,
+                        lxw_col_t col_num, char *formula, char *range,
+                        lxw_format *format, uint8_t is_dynamic)
 {
-    lxw_cell *cell = calloc(1, sizeof(lxw_cell));
-    RETURN_ON_MEM_ERROR(cell, cell);
+    lxw_cell *cell = _new_extra_cell(self);
+
+    if (!cell)
+        return NULL;
 
     cell->row_num = row_num;
     cell->col_num = col_num;
     cell->format = format;
     cell->u.string = formula;
-    cell->user_data1 = range;
+    cell->extra->user_data1 = range;
 
     if (is_dynamic)
         cell->type = DYNAMIC_ARRAY_FORMULA_CELL;
@@ -977,9 +1246,10 @@ _new_array_formula_cell(lxw_row_t row_num, lxw_col_t col_num, char *formula,
  * Create a new worksheet blank cell object.
  */
 STATIC lxw_cell *
-_new_blank_cell(lxw_row_t row_num, lxw_col_t col_num, lxw_format *format)
+_new_blank_cell(lxw_worksheet *self, lxw_row_t row_num, lxw_col_t col_num,
+                lxw_format *format)
 {
-    lxw_cell *cell = calloc(1, sizeof(lxw_cell));
+    lxw_cell *cell = _pool_alloc(&self->cell_pool);
     RETURN_ON_MEM_ERROR(cell, cell);
 
     cell->row_num = row_num;
@@ -994,10 +1264,10 @@ _new_blank_cell(lxw_row_t row_num, lxw_col_t col_num, lxw_format *format)
  * Create a new worksheet boolean cell object.
  */
 STATIC lxw_cell *
-_new_boolean_cell(lxw_row_t row_num, lxw_col_t col_num, int value,
-                  lxw_format *format)
+_new_boolean_cell(lxw_worksheet *self, lxw_row_t row_num, lxw_col_t col_num,
+                  int value, lxw_format *format)
 {
-    lxw_cell *cell = calloc(1, sizeof(lxw_cell));
+    lxw_cell *cell = _pool_alloc(&self->cell_pool);
     RETURN_ON_MEM_ERROR(cell, cell);
 
     cell->row_num = row_num;
@@ -1013,10 +1283,10 @@ _new_boolean_cell(lxw_row_t row_num, lxw_col_t col_num, int value,
  * Create a new worksheet error cell object.
  */
 STATIC lxw_cell *
-_new_error_cell(lxw_row_t row_num, lxw_col_t col_num, uint32_t value,
-                lxw_format *format)
+_new_error_cell(lxw_worksheet *self, lxw_row_t row_num, lxw_col_t col_num,
+                uint32_t value, lxw_format *format)
 {
-    lxw_cell *cell = calloc(1, sizeof(lxw_cell));
+    lxw_cell *cell = _pool_alloc(&self->cell_pool);
     RETURN_ON_MEM_ERROR(cell, cell);
 
     cell->row_num = row_num;
@@ -1032,16 +1302,18 @@ _new_error_cell(lxw_row_t row_num, lxw_col_t col_num, uint32_t value,
  * Create a new comment cell object.
  */
 STATIC lxw_cell *
-_new_comment_cell(lxw_row_t row_num, lxw_col_t col_num,
+_new_comment_cell(lxw_worksheet *self, lxw_row_t row_num, lxw_col_t col_num,
                   lxw_vml_obj *comment_obj)
 {
-    lxw_cell *cell = calloc(1, sizeof(lxw_cell));
-    RETURN_ON_MEM_ERROR(cell, cell);
+    lxw_cell *cell = _new_extra_cell(self);
+
+    if (!cell)
+        return NULL;
 
     cell->row_num = row_num;
     cell->col_num = col_num;
     cell->type = COMMENT;
-    cell->comment = comment_obj;
+    cell->extra->comment = comment_obj;
 
     return cell;
 }
@@ -1050,19 +1322,21 @@ _new_comment_cell(lxw_row_t row_num, lxw_col_t col_num,
  * Create a new worksheet hyperlink cell object.
  */
 STATIC lxw_cell *
-_new_hyperlink_cell(lxw_row_t row_num, lxw_col_t col_num,
+_new_hyperlink_cell(lxw_worksheet *self, lxw_row_t row_num, lxw_col_t col_num,
                     enum cell_types link_type, char *url, char *string,
                     char *tooltip)
 {
-    lxw_cell *cell = calloc(1, sizeof(lxw_cell));
-    RETURN_ON_MEM_ERROR(cell, cell);
+    lxw_cell *cell = _new_extra_cell(self);
+
+    if (!cell)
+        return NULL;
 
     cell->row_num = row_num;
     cell->col_num = col_num;
     cell->type = link_type;
     cell->u.string = url;
-    cell->user_data1 = string;
-    cell->user_data2 = tooltip;
+    cell->extra->user_data1 = string;
+    cell->extra->user_data2 = tooltip;
 
     return cell;
 }
@@ -1071,7 +1345,8 @@ _new_hyperlink_cell(lxw_row_t row_num, lxw_col_t col_num,
  * Get or create the row object for a given row number.
  */
 STATIC lxw_row *
-_get_row_list(struct lxw_table_rows *table, lxw_row_t row_num)
+_get_row_list(lxw_worksheet *self, struct lxw_table_rows *table,
+              lxw_row_t row_num)
 {
     lxw_row *row;
     lxw_row *existing_row;
@@ -1080,13 +1355,16 @@ _get_row_list(struct lxw_table_rows *table, lxw_row_t row_num)
         return table->cached_row;
 
     /* Create a new row and try and insert it. */
-    row = _new_row(row_num);
+    row = _new_row(self, row_num);
+    if (!row)
+        return NULL;
+
     existing_row = RB_INSERT(lxw_table_rows, table, row);
 
-    /* If existing_row is not NULL, then it already existed. Free new row */
-    /* and return existing_row. */
+    /* If existing_row is not NULL, then it already existed. Return the new */
+    /* row to the pool and return existing_row. */
     if (existing_row) {
-        _free_row(row);
+        _pool_release(&self->row_pool, row);
         row = existing_row;
     }
 
@@ -1105,50 +1383,80 @@ _get_row(lxw_worksheet *self, lxw_row_t row_num)
     lxw_row *row;
 
     if (!self->optimize) {
-        row = _get_row_list(self->table, row_num);
+        row = _get_row_list(self, self->table, row_num);
         return row;
     }
     else {
-        if (row_num < self->optimize_row->row_num) {
+        if (row_num < self->optimize_first_row)
             return NULL;
-        }
-        else if (row_num == self->optimize_row->row_num) {
-            return self->optimize_row;
-        }
-        else {
-            /* Flush row. */
-            lxw_worksheet_write_single_row(self);
-            row = self->optimize_row;
-            row->row_num = row_num;
-            return row;
-        }
+
+        /* Flush the rows that fall out of the row window. */
+        if (row_num - self->optimize_first_row >= self->optimize_num_rows)
+            _worksheet_flush_optimized_rows(self, row_num -
+                                            self->optimize_num_rows + 1);
+
+        row = &self->optimize_rows[row_num % self->optimize_num_rows];
+        row->row_num = row_num;
+        return row;
     }
 }
 
 /*
- * Insert a cell object in the cell list of a row object.
+ * Insert a cell object in the cell vector of a row object. Cells are usually
+ * written left to right so they are normally appended to the vector.
  */
 STATIC void
-_insert_cell_list(struct lxw_table_cells *cell_list,
-                  lxw_cell *cell, lxw_col_t col_num)
+_insert_cell_list(lxw_worksheet *self, lxw_row *row, lxw_cell *cell,
+                  lxw_col_t col_num)
 {
-    lxw_cell *existing_cell;
+    lxw_cell **cells;
+    lxw_col_t cells_size;
+    lxw_col_t index;
 
     cell->col_num = col_num;
 
-    existing_cell = RB_INSERT(lxw_table_cells, cell_list, cell);
+    if (!row->num_cells || row->cells[row->num_cells - 1]->col_num < col_num) {
+        index = row->num_cells;
+    }
+    else {
+        index = _find_cell_index(row, col_num);
+
+        /* If the cell already exists then replace it. */
+        if (row->cells[index]->col_num == col_num) {
+            _free_cell(self, row->cells[index]);
+            row->cells[index] = cell;
+            return;
+        }
+    }
+
+    /* Grow the cell vector if required. */
+    if (row->num_cells == row->cells_size) {
+        if (row->cells_size)
+            cells_size = (lxw_col_t) (row->cells_size * 2);
+        else
+            cells_size = 8;
+
+        if (cells_size > LXW_COL_MAX)
+            cells_size = LXW_COL_MAX;
 
-    /* If existing_cell is not NULL, then that cell already existed. */
-    /* Remove existing_cell and add new one in again. */
-    if (existing_cell) {
-        RB_REMOVE(lxw_table_cells, cell_list, existing_cell);
+        cells = realloc(row->cells, cells_size * sizeof(lxw_cell *));
+        if (!cells) {
+            LXW_MEM_ERROR();
+            _free_cell(self, cell);
+            return;
+        }
 
-        /* Add it in again. */
-        RB_INSERT(lxw_table_cells, cell_list, cell);
-        _free_cell(existing_cell);
+        row->cells = cells;
+        row->cells_size = cells_size;
     }
 
-    return;
+    /* Make room for an out of order cell. */
+    if (index < row->num_cells)
+        memmove(&row->cells[index + 1], &row->cells[index],
+                (row->num_cells - index) * sizeof(lxw_cell *));
+
+    row->cells[index] = cell;
+    row->num_cells++;
 }
 
 /*
@@ -1160,21 +1468,44 @@ _insert_cell(lxw_worksheet *self, lxw_row_t row_num, lxw_col_t col_num,
 {
     lxw_row *row = _get_row(self, row_num);
 
-    if (!self->optimize) {
-        row->data_changed = LXW_TRUE;
-        _insert_cell_list(row->cells, cell, col_num);
+    if (!row) {
+        _free_cell(self, cell);
+        return;
     }
-    else {
-        if (row) {
-            row->data_changed = LXW_TRUE;
 
-            /* Overwrite an existing cell if necessary. */
-            if (self->array[col_num])
-                _free_cell(self->array[col_num]);
+    row->data_changed = LXW_TRUE;
+    _insert_cell_list(self, row, cell, col_num);
+}
+
+/*
+ * Get or create a row for a bulk write and reserve space in its cell vector
+ * for the new cells so that the vector is only grown once.
+ */
+STATIC lxw_row *
+_get_bulk_row(lxw_worksheet *self, lxw_row_t row_num, lxw_col_t num_cols)
+{
+    lxw_row *row = _get_row(self, row_num);
+    lxw_cell **cells;
+    size_t cells_size;
 
-            self->array[col_num] = cell;
-        }
+    if (!row)
+        return NULL;
+
+    row->data_changed = LXW_TRUE;
+
+    cells_size = (size_t) row->num_cells + num_cols;
+    if (cells_size > LXW_COL_MAX)
+        cells_size = LXW_COL_MAX;
+
+    if (cells_size > row->cells_size) {
+        cells = realloc(row->cells, cells_size * sizeof(lxw_cell *));
+        RETURN_ON_MEM_ERROR(cells, NULL);
+
+        row->cells = cells;
+        row->cells_size = (lxw_col_t) cells_size;
     }
+
+    return row;
 }
 
 /*
@@ -1194,17 +1525,17 @@ _insert_cell_placeholder(lxw_worksheet *self, lxw_row_t row_num,
     if (self->optimize)
         return;
 
-    cell = _new_blank_cell(row_num, col_num, NULL);
+    cell = _new_blank_cell(self, row_num, col_num, NULL);
     if (!cell)
         return;
 
     /* Only add a cell if one doesn't already exist. */
     row = _get_row(self, row_num);
-    if (!RB_FIND(lxw_table_cells, row->cells, cell)) {
-        _insert_cell_list(row->cells, cell, col_num);
+    if (!lxw_worksheet_find_cell_in_row(row, col_num)) {
+        _insert_cell_list(self, row, cell, col_num);
     }
     else {
-        _free_cell(cell);
+        _free_cell(self, cell);
     }
 }
 
@@ -1215,9 +1546,9 @@ STATIC void
 _insert_hyperlink(lxw_worksheet *self, lxw_row_t row_num, lxw_col_t col_num,
                   lxw_cell *link)
 {
-    lxw_row *row = _get_row_list(self->hyperlinks, row_num);
+    lxw_row *row = _get_row_list(self, self->hyperlinks, row_num);
 
-    _insert_cell_list(row->cells, link, col_num);
+    _insert_cell_list(self, row, link, col_num);
 }
 
 /*
@@ -1227,9 +1558,9 @@ STATIC void
 _insert_comment(lxw_worksheet *self, lxw_row_t row_num, lxw_col_t col_num,
                 lxw_cell *link)
 {
-    lxw_row *row = _get_row_list(self->comments, row_num);
+    lxw_row *row = _get_row_list(self, self->comments, row_num);
 
-    _insert_cell_list(row->cells, link, col_num);
+    _insert_cell_list(self, row, link, col_num);
 }
 
 /*
@@ -1270,11 +1601,15 @@ _check_dimensions(lxw_worksheet *self,
     /* In optimization mode we don't change dimensions for rows that are */
     /* already written. */
     if (!ignore_row && !ignore_col && self->optimize) {
-        if (row_num < self->optimize_row->row_num)
+        if (row_num < self->optimize_first_row)
             return LXW_ERROR_WORKSHEET_INDEX_OUT_OF_RANGE;
     }
 
-    if (!ignore_row) {
+    /* No rows can be added once a worksheet has been finished. */
+    if (!ignore_row && self->optimize_finished)
+        return LXW_ERROR_WORKSHEET_INDEX_OUT_OF_RANGE;
+
+    if (!ignore_row) {
         if (row_num < self->dim_rowmin)
             self->dim_rowmin = row_num;
         if (row_num > self->dim_rowmax)
@@ -1292,40 +1627,41 @@ _check_dimensions(lxw_worksheet *self,
 }
 
 /*
- * Comparator for the row structure red/black tree.
+ * Check the dimensions of a block of cells for a bulk write. Only the first
+ * and last cells need to be checked.
  */
-STATIC int
-_row_cmp(lxw_row *row1, lxw_row *row2)
+STATIC lxw_error
+_check_bulk_dimensions(lxw_worksheet *self, lxw_row_t first_row,
+                       lxw_col_t first_col, lxw_row_t num_rows,
+                       lxw_col_t num_cols)
 {
-    if (row1->row_num > row2->row_num)
-        return 1;
-    if (row1->row_num < row2->row_num)
-        return -1;
-    return 0;
+    lxw_error err;
+
+    if ((size_t) first_row + num_rows > LXW_ROW_MAX
+        || (size_t) first_col + num_cols > LXW_COL_MAX)
+        return LXW_ERROR_WORKSHEET_INDEX_OUT_OF_RANGE;
+
+    err = _check_dimensions(self, first_row, first_col, LXW_FALSE, LXW_FALSE);
+    if (err)
+        return err;
+
+    return _check_dimensions(self, first_row + num_rows - 1,
+                             first_col + num_cols - 1, LXW_FALSE, LXW_FALSE);
 }
 
 /*
- * Comparator for the cell structure red/black tree.
+ * Comparator for the row structure red/black tree.
  */
 STATIC int
-_cell_cmp(lxw_cell *cell1, lxw_cell *cell2)
+_row_cmp(lxw_row *row1, lxw_row *row2)
 {
-    if (cell1->col_num > cell2->col_num)
+    if (row1->row_num > row2->row_num)
         return 1;
-    if (cell1->col_num < cell2->col_num)
+    if (row1->row_num < row2->row_num)
         return -1;
     return 0;
 }
 
-/*
- * Comparator for the image/hyperlink relationship ids.
- */
-STATIC int
-_drawing_rel_id_cmp(lxw_drawing_rel_id *rel_id1, lxw_drawing_rel_id *rel_id2)
-{
-    return strcmp(rel_id1->target, rel_id2->target);
-}
-
 /*
  * Comparator for the conditional format RB hash elements.
  */
@@ -1337,127 +1673,118 @@ _cond_format_hash_cmp(lxw_cond_format_hash_element *elem_1,
 }
 
 /*
- * Get the index used to address a drawing rel link.
+ * Get the index used to address a drawing or VML drawing rel link. The
+ * targets are URL strings, including the terminating NUL, or image digests.
+ * Links without a target, such as charts, always get a new index.
  */
 STATIC uint32_t
-_get_drawing_rel_index(lxw_worksheet *self, char *target)
+_get_rel_index(lxw_hash_table *rel_ids, uint32_t *rel_id,
+               const void *target, size_t target_len)
 {
-    lxw_drawing_rel_id tmp_drawing_rel_id;
-    lxw_drawing_rel_id *found_duplicate_target = NULL;
-    lxw_drawing_rel_id *new_drawing_rel_id = NULL;
+    lxw_hash_element *element;
+    void *key;
+    uint32_t *id;
 
     if (target) {
-        tmp_drawing_rel_id.target = target;
-        found_duplicate_target = RB_FIND(lxw_drawing_rel_ids,
-                                         self->drawing_rel_ids,
-                                         &tmp_drawing_rel_id);
+        element = lxw_hash_key_exists(rel_ids, (void *) target, target_len);
+        if (element)
+            return *(uint32_t *) element->value;
     }
 
-    if (found_duplicate_target) {
-        return found_duplicate_target->id;
-    }
-    else {
-        self->drawing_rel_id++;
+    (*rel_id)++;
 
-        if (target) {
-            new_drawing_rel_id = calloc(1, sizeof(lxw_drawing_rel_id));
+    if (target) {
+        key = malloc(target_len);
+        id = malloc(sizeof(uint32_t));
 
-            if (new_drawing_rel_id) {
-                new_drawing_rel_id->id = self->drawing_rel_id;
-                new_drawing_rel_id->target = lxw_strdup(target);
+        if (key && id) {
+            memcpy(key, target, target_len);
+            *id = *rel_id;
 
-                RB_INSERT(lxw_drawing_rel_ids, self->drawing_rel_ids,
-                          new_drawing_rel_id);
-            }
+            if (lxw_insert_hash_element(rel_ids, key, id, target_len))
+                return *rel_id;
         }
 
-        return self->drawing_rel_id;
+        free(key);
+        free(id);
     }
+
+    return *rel_id;
 }
 
 /*
- * find the index used to address a drawing rel link.
+ * Find the index used to address a drawing or VML drawing rel link.
  */
 STATIC uint32_t
-_find_drawing_rel_index(lxw_worksheet *self, char *target)
+_find_rel_index(lxw_hash_table *rel_ids, const void *target,
+                size_t target_len)
 {
-    lxw_drawing_rel_id tmp_drawing_rel_id;
-    lxw_drawing_rel_id *found_duplicate_target = NULL;
+    lxw_hash_element *element;
 
     if (!target)
         return 0;
 
-    tmp_drawing_rel_id.target = target;
-    found_duplicate_target = RB_FIND(lxw_drawing_rel_ids,
-                                     self->drawing_rel_ids,
-                                     &tmp_drawing_rel_id);
+    element = lxw_hash_key_exists(rel_ids, (void *) target, target_len);
 
-    if (found_duplicate_target)
-        return found_duplicate_target->id;
+    if (element)
+        return *(uint32_t *) element->value;
     else
         return 0;
 }
 
 /*
- * Get the index used to address a VMLdrawing rel link.
+ * Get the index used to address a drawing rel link.
  */
 STATIC uint32_t
-_get_vml_drawing_rel_index(lxw_worksheet *self, char *target)
+_get_drawing_rel_index(lxw_worksheet *self, const void *target,
+                       size_t target_len)
 {
-    lxw_drawing_rel_id tmp_drawing_rel_id;
-    lxw_drawing_rel_id *found_duplicate_target = NULL;
-    lxw_drawing_rel_id *new_drawing_rel_id = NULL;
-
-    if (target) {
-        tmp_drawing_rel_id.target = target;
-        found_duplicate_target = RB_FIND(lxw_vml_drawing_rel_ids,
-                                         self->vml_drawing_rel_ids,
-                                         &tmp_drawing_rel_id);
-    }
-
-    if (found_duplicate_target) {
-        return found_duplicate_target->id;
-    }
-    else {
-        self->vml_drawing_rel_id++;
-
-        if (target) {
-            new_drawing_rel_id = calloc(1, sizeof(lxw_drawing_rel_id));
-
-            if (new_drawing_rel_id) {
-                new_drawing_rel_id->id = self->vml_drawing_rel_id;
-                new_drawing_rel_id->target = lxw_strdup(target);
-
-                RB_INSERT(lxw_vml_drawing_rel_ids, self->vml_drawing_rel_ids,
-                          new_drawing_rel_id);
-            }
-        }
-
-        return self->vml_drawing_rel_id;
-    }
+    return _get_rel_index(self->drawing_rel_ids, &self->drawing_rel_id,
+                          target, target_len);
 }
 
 /*
- * find the index used to address a VML drawing rel link.
+ * Find the index used to address a drawing rel link.
  */
 STATIC uint32_t
-_find_vml_drawing_rel_index(lxw_worksheet *self, char *target)
+_find_drawing_rel_index(lxw_worksheet *self, const void *target,
+                        size_t target_len)
 {
-    lxw_drawing_rel_id tmp_drawing_rel_id;
-    lxw_drawing_rel_id *found_duplicate_target = NULL;
+    return _find_rel_index(self->drawing_rel_ids, target, target_len);
+}
 
-    if (!target)
-        return 0;
+/*
+ * Get the index used to address a VML drawing rel link.
+ */
+STATIC uint32_t
+_get_vml_drawing_rel_index(lxw_worksheet *self, const void *target,
+                           size_t target_len)
+{
+    return _get_rel_index(self->vml_drawing_rel_ids,
+                          &self->vml_drawing_rel_id, target, target_len);
+}
 
-    tmp_drawing_rel_id.target = target;
-    found_duplicate_target = RB_FIND(lxw_vml_drawing_rel_ids,
-                                     self->vml_drawing_rel_ids,
-                                     &tmp_drawing_rel_id);
+/*
+ * Find the index used to address a VML drawing rel link.
+ */
+STATIC uint32_t
+_find_vml_drawing_rel_index(lxw_worksheet *self, const void *target,
+                            size_t target_len)
+{
+    return _find_rel_index(self->vml_drawing_rel_ids, target, target_len);
+}
 
-    if (found_duplicate_target)
-        return found_duplicate_target->id;
+/*
+ * Get the image digest used as a rel link target, or NULL if the image
+ * doesn't have one and therefore can't be deduplicated.
+ */
+STATIC const void *
+_image_rel_target(lxw_object_properties *object_props)
+{
+    if (object_props->has_digest)
+        return object_props->digest;
     else
-        return 0;
+        return NULL;
 }
 
 /*
@@ -2549,10 +2876,217 @@ _worksheet_write_sheet_data(lxw_worksheet *self)
     }
 }
 
+/*
+ * In constant_memory mode the rows are written to a staging temp file which
+ * is compressed into a raw deflate stream whenever it fills up, and at close.
+ * The packager can then add the compressed rows directly to the zip file
+ * instead of copying the uncompressed rows through the sheet file.
+ */
+STATIC lxw_error
+_worksheet_start_deflated_rows(lxw_worksheet *self)
+{
+    z_stream *stream = calloc(1, sizeof(z_stream));
+    RETURN_ON_MEM_ERROR(stream, LXW_ERROR_MEMORY_MALLOC_FAILED);
+
+    if (deflateInit2(stream, self->optimize_level, Z_DEFLATED, -MAX_WBITS,
+                     DEF_MEM_LEVEL, self->optimize_strategy) != Z_OK) {
+        free(stream);
+        return LXW_ERROR_MEMORY_MALLOC_FAILED;
+    }
+
+    self->optimize_deflated_file =
+        lxw_get_filehandle(&self->optimize_deflated_buffer,
+                           &self->optimize_deflated_buffer_size,
+                           self->tmpdir);
+
+    if (!self->optimize_deflated_file) {
+        deflateEnd(stream);
+        free(stream);
+        return LXW_ERROR_CREATING_TMPFILE;
+    }
+
+    self->optimize_stream = stream;
+    self->optimize_crc = crc32(0L, Z_NULL, 0);
+    self->optimize_data_size = 0;
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Add a block of row data to the compressed row stream.
+ */
+STATIC void
+_worksheet_deflate_row_data(lxw_worksheet *self, const char *data,
+                            size_t size, int flush)
+{
+    z_stream *stream = self->optimize_stream;
+    char buffer[LXW_BUFFER_SIZE];
+    size_t size_out;
+
+    self->optimize_crc = crc32(self->optimize_crc, (const Bytef *) data,
+                               (uInt) size);
+    self->optimize_data_size += size;
+
+    stream->next_in = (Bytef *) data;
+    stream->avail_in = (uInt) size;
+
+    do {
+        stream->next_out = (Bytef *) buffer;
+        stream->avail_out = LXW_BUFFER_SIZE;
+
+        /* Ignore return value. There is no easy way to raise error. */
+        (void) deflate(stream, flush);
+
+        size_out = LXW_BUFFER_SIZE - stream->avail_out;
+        (void) fwrite(buffer, 1, size_out, self->optimize_deflated_file);
+    } while (stream->avail_out == 0);
+}
+
+/*
+ * Compress the rows in the staging file and reset it. With Z_NO_FLUSH this
+ * only happens when the staging file is full. A Z_SYNC_FLUSH is used at close
+ * so that the compressed rows end on a byte boundary.
+ */
+STATIC void
+_worksheet_deflate_optimized_rows(lxw_worksheet *self, int flush)
+{
+    char buffer[LXW_BUFFER_SIZE];
+    uint64_t data_size;
+    size_t size_read;
+
+    /* Ignore if compression is off or the row stream has been ended. */
+    if (!self->optimize_deflate)
+        return;
+
+    if (lxw_ftello(self->optimize_tmpfile, &data_size) != 0)
+        return;
+
+    if (flush == Z_NO_FLUSH && data_size < LXW_OPTIMIZE_DEFLATE_SIZE)
+        return;
+
+    if (data_size == 0 && !self->optimize_stream)
+        return;
+
+    /* Start the compressed row stream on the first flush. If that fails the
+     * rows are stored uncompressed, as before. */
+    if (!self->optimize_stream) {
+        if (_worksheet_start_deflated_rows(self) != LXW_NO_ERROR) {
+            self->optimize_deflate = LXW_FALSE;
+            return;
+        }
+    }
+
+    fflush(self->optimize_tmpfile);
+
+    if (self->optimize_buffer) {
+        _worksheet_deflate_row_data(self, self->optimize_buffer,
+                                    (size_t) data_size, Z_NO_FLUSH);
+    }
+    else {
+        rewind(self->optimize_tmpfile);
+
+        while (data_size > 0) {
+            size_read = fread(buffer, 1, LXW_BUFFER_SIZE,
+                              self->optimize_tmpfile);
+            if (!size_read)
+                break;
+
+            if (size_read > data_size)
+                size_read = (size_t) data_size;
+
+            _worksheet_deflate_row_data(self, buffer, size_read, Z_NO_FLUSH);
+            data_size -= size_read;
+        }
+    }
+
+    if (flush != Z_NO_FLUSH)
+        _worksheet_deflate_row_data(self, "", 0, flush);
+
+    rewind(self->optimize_tmpfile);
+}
+
+/*
+ * Read a block of data, starting at offset, from a temp file or from its
+ * memory buffer.
+ */
+STATIC size_t
+_read_file_range(FILE *file, const char *buffer, uint64_t offset,
+                 char *data, size_t size)
+{
+    if (buffer) {
+        memcpy(data, buffer + offset, size);
+        return size;
+    }
+
+    if (lxw_fseeko(file, offset, SEEK_SET) != 0)
+        return 0;
+
+    return fread(data, 1, size, file);
+}
+
+/*
+ * Add a block of compressed row data to the uncompressed sheet file.
+ */
+STATIC void
+_worksheet_inflate_row_data(lxw_worksheet *self, z_stream *stream,
+                            const char *data, size_t size)
+{
+    char buffer[LXW_BUFFER_SIZE];
+    size_t size_out;
+    int zerr;
+
+    stream->next_in = (Bytef *) data;
+    stream->avail_in = (uInt) size;
+
+    do {
+        stream->next_out = (Bytef *) buffer;
+        stream->avail_out = LXW_BUFFER_SIZE;
+
+        zerr = inflate(stream, Z_NO_FLUSH);
+        if (zerr != Z_OK && zerr != Z_BUF_ERROR)
+            return;
+
+        size_out = LXW_BUFFER_SIZE - stream->avail_out;
+        (void) fwrite(buffer, 1, size_out, self->file);
+    } while (stream->avail_out == 0);
+}
+
+/*
+ * Decompress the compressed rows into the sheet file. This is only required
+ * if the packager can't use the compressed rows directly, for example if the
+ * worksheet compression settings were changed after the rows were written.
+ */
+STATIC void
+_worksheet_inflate_optimized_rows(lxw_worksheet *self)
+{
+    z_stream stream;
+    char buffer[LXW_BUFFER_SIZE];
+    uint64_t offset = 0;
+    size_t size_read;
+
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return;
+
+    size_read = lxw_worksheet_read_deflated_rows(self, offset, buffer,
+                                                 LXW_BUFFER_SIZE);
+    while (size_read) {
+        _worksheet_inflate_row_data(self, &stream, buffer, size_read);
+        offset += size_read;
+
+        size_read = lxw_worksheet_read_deflated_rows(self, offset, buffer,
+                                                     LXW_BUFFER_SIZE);
+    }
+
+    inflateEnd(&stream);
+}
+
 /*
  * Write the <sheetData> element when the memory optimization is on. In which
  * case we read the data stored in the temp file and rewrite it to the XML
- * sheet file.
+ * sheet file. If the rows have been compressed, and the packager is going to
+ * add them to the zip file directly, only the offset of the row data in the
+ * sheet file is stored.
  */
 STATIC void
 _worksheet_write_optimized_sheet_data(lxw_worksheet *self)
@@ -2560,38 +3094,61 @@ _worksheet_write_optimized_sheet_data(lxw_worksheet *self)
     size_t read_size = 1;
     char buffer[LXW_BUFFER_SIZE];
 
+    lxw_worksheet_finish_optimized_rows(self);
+
     if (self->dim_rowmin == LXW_ROW_MAX) {
         /* If the dimensions aren't defined then there is no data to write. */
         lxw_xml_empty_tag(self->file, "sheetData", NULL);
+        self->optimize_splice = LXW_FALSE;
     }
     else {
 
         lxw_xml_start_tag(self->file, "sheetData", NULL);
 
-        /* Flush the temp file. */
-        fflush(self->optimize_tmpfile);
-
-        if (self->optimize_buffer) {
-            /* Ignore return value. There is no easy way to raise error. */
-            (void) fwrite(self->optimize_buffer, self->optimize_buffer_size,
-                          1, self->file);
+        if (self->optimize_splice) {
+            /* Store the offset where the packager adds the rows, or add
+             * them here if it isn't available. */
+            fflush(self->file);
+            if (lxw_ftello(self->file, &self->optimize_data_offset) != 0) {
+                self->optimize_splice = LXW_FALSE;
+                _worksheet_inflate_optimized_rows(self);
+            }
         }
-        else {
-            /* Rewind the temp file. */
-            rewind(self->optimize_tmpfile);
-            while (read_size) {
-                read_size =
-                    fread(buffer, 1, LXW_BUFFER_SIZE, self->optimize_tmpfile);
+        else if (self->optimize_deflated) {
+            _worksheet_inflate_optimized_rows(self);
+        }
+        else if (self->optimize_tmpfile) {
+            /* Flush the temp file. */
+            fflush(self->optimize_tmpfile);
+
+            if (self->optimize_buffer) {
                 /* Ignore return value. There is no easy way to raise error. */
-                (void) fwrite(buffer, 1, read_size, self->file);
+                (void) fwrite(self->optimize_buffer,
+                              self->optimize_buffer_size, 1, self->file);
+            }
+            else {
+                /* Rewind the temp file. */
+                rewind(self->optimize_tmpfile);
+                while (read_size) {
+                    read_size = fread(buffer, 1, LXW_BUFFER_SIZE,
+                                      self->optimize_tmpfile);
+                    /* Ignore return value. There is no easy way to raise
+                     * error. */
+                    (void) fwrite(buffer, 1, read_size, self->file);
+                }
             }
         }
 
-        fclose(self->optimize_tmpfile);
-        free(self->optimize_buffer);
-
         lxw_xml_end_tag(self->file, "sheetData");
     }
+
+    if (self->optimize_tmpfile) {
+        fclose(self->optimize_tmpfile);
+        self->optimize_tmpfile = NULL;
+    }
+
+    free(self->optimize_buffer);
+    self->optimize_buffer = NULL;
 }
 
 /*
@@ -2740,10 +3297,10 @@ _worksheet_write_print_options(lxw_worksheet *self)
  * Write the <row> element.
  */
 STATIC void
-_write_row(lxw_worksheet *self, lxw_row *row, char *spans)
+_write_row(lxw_worksheet *self, lxw_xml_buffer *buffer, lxw_row *row,
+           char *spans)
 {
-    struct xml_attribute_list attributes;
-    struct xml_attribute *attribute;
+    lxw_attributes attributes;
     int32_t xf_index = 0;
     double height;
 
@@ -2756,42 +3313,40 @@ _write_row(lxw_worksheet *self, lxw_row *row, char *spans)
     else
         height = self->default_row_height;
 
-    LXW_INIT_ATTRIBUTES();
-    LXW_PUSH_ATTRIBUTES_INT("r", row->row_num + 1);
+    lxw_attributes_init(&attributes);
+    lxw_attributes_push_int(&attributes, "r", row->row_num + 1);
 
     if (spans)
-        LXW_PUSH_ATTRIBUTES_STR("spans", spans);
+        lxw_attributes_push_str(&attributes, "spans", spans);
 
     if (xf_index)
-        LXW_PUSH_ATTRIBUTES_INT("s", xf_index);
+        lxw_attributes_push_int(&attributes, "s", xf_index);
 
     if (row->format)
-        LXW_PUSH_ATTRIBUTES_STR("customFormat", "1");
+        lxw_attributes_push_str(&attributes, "customFormat", "1");
 
     if (height != LXW_DEF_ROW_HEIGHT)
-        LXW_PUSH_ATTRIBUTES_DBL("ht", height);
+        lxw_attributes_push_dbl(&attributes, "ht", height);
 
     if (row->hidden)
-        LXW_PUSH_ATTRIBUTES_STR("hidden", "1");
+        lxw_attributes_push_str(&attributes, "hidden", "1");
 
     if (height != LXW_DEF_ROW_HEIGHT)
-        LXW_PUSH_ATTRIBUTES_STR("customHeight", "1");
+        lxw_attributes_push_str(&attributes, "customHeight", "1");
 
     if (row->level)
-        LXW_PUSH_ATTRIBUTES_INT("outlineLevel", row->level);
+        lxw_attributes_push_int(&attributes, "outlineLevel", row->level);
 
     if (row->collapsed)
-        LXW_PUSH_ATTRIBUTES_STR("collapsed", "1");
+        lxw_attributes_push_str(&attributes, "collapsed", "1");
 
     if (self->excel_version == 2010)
-        LXW_PUSH_ATTRIBUTES_STR("x14ac:dyDescent", "0.25");
+        lxw_attributes_push_str(&attributes, "x14ac:dyDescent", "0.25");
 
     if (!row->data_changed)
-        lxw_xml_empty_tag(self->file, "row", &attributes);
+        lxw_xml_buffer_empty_tag(buffer, "row", &attributes);
     else
-        lxw_xml_start_tag(self->file, "row", &attributes);
-
-    LXW_FREE_ATTRIBUTES();
+        lxw_xml_buffer_start_tag(buffer, "row", &attributes);
 }
 
 /*
@@ -2799,49 +3354,20 @@ _write_row(lxw_worksheet *self, lxw_row *row, char *spans)
  * column width to the nearest pixel. If the width hasn't been set by the user
  * we use the default value. If the column is hidden it has a value of zero.
  */
-STATIC int32_t
-_worksheet_size_col(lxw_worksheet *self, lxw_col_t col_num, uint8_t anchor)
+STATIC uint32_t
+_col_options_pixels(lxw_col_options *col_opt, uint8_t anchor)
 {
-    lxw_col_options *col_opt = NULL;
-    uint32_t pixels;
-    double width;
+    double width = col_opt->width;
     double max_digit_width = 7.0;       /* For Calabri 11. */
     double padding = 5.0;
-    lxw_col_t col_index;
-
-    /* Search for the col number in the array of col_options. Each col_option
-     * entry contains the start and end column for a range.
-     */
-    for (col_index = 0; col_index < self->col_options_max; col_index++) {
-        col_opt = self->col_options[col_index];
-
-        if (col_opt) {
-            if (col_num >= col_opt->firstcol && col_num <= col_opt->lastcol)
-                break;
-            else
-                col_opt = NULL;
-        }
-    }
-
-    if (col_opt) {
-        width = col_opt->width;
 
-        /* Convert to pixels. */
-        if (col_opt->hidden && anchor != LXW_OBJECT_MOVE_AND_SIZE_AFTER) {
-            pixels = 0;
-        }
-        else if (width < 1.0) {
-            pixels = (uint32_t) (width * (max_digit_width + padding) + 0.5);
-        }
-        else {
-            pixels = (uint32_t) (width * max_digit_width + 0.5) + 5;
-        }
-    }
-    else {
-        pixels = self->default_col_pixels;
-    }
-
-    return pixels;
+    /* Convert to pixels. */
+    if (col_opt->hidden && anchor != LXW_OBJECT_MOVE_AND_SIZE_AFTER)
+        return 0;
+    else if (width < 1.0)
+        return (uint32_t) (width * (max_digit_width + padding) + 0.5);
+    else
+        return (uint32_t) (width * max_digit_width + 0.5) + 5;
 }
 
 /*
@@ -2849,55 +3375,349 @@ _worksheet_size_col(lxw_worksheet *self, lxw_col_t col_num, uint8_t anchor)
  * hasn't been set by the user we use the default value. If the row is hidden
  * it has a value of zero.
  */
-STATIC int32_t
-_worksheet_size_row(lxw_worksheet *self, lxw_row_t row_num, uint8_t anchor)
+STATIC uint32_t
+_row_pixels(lxw_worksheet *self, lxw_row *row, uint8_t anchor)
 {
-    lxw_row *row;
-    uint32_t pixels;
-
-    row = lxw_worksheet_find_row(self, row_num);
-
     /* Note, the 0.75 below is due to the difference between 72/96 DPI. */
     if (row) {
         if (row->hidden && anchor != LXW_OBJECT_MOVE_AND_SIZE_AFTER)
-            pixels = 0;
+            return 0;
         else
-            pixels = (uint32_t) (row->height / 0.75);
+            return (uint32_t) (row->height / 0.75);
     }
     else {
-        pixels = (uint32_t) (self->default_row_height / 0.75);
+        return (uint32_t) (self->default_row_height / 0.75);
     }
+}
 
-    return pixels;
+/*
+ * Check if a row is stored in the row geometry, i.e., if it is hidden or has
+ * a height that differs from the default.
+ */
+STATIC uint8_t
+_row_in_geometry(lxw_worksheet *self, lxw_row *row)
+{
+    return row->hidden
+        || _row_pixels(self, row, LXW_OBJECT_MOVE_AND_SIZE_AFTER)
+        != _row_pixels(self, NULL, 0);
 }
 
 /*
- * Calculate the vertices that define the position of a graphical object
- * within the worksheet in pixels.
- *         +------------+------------+
- *         |     A      |      B     |
- *   +-----+------------+------------+
- *   |     |(x1,y1)     |            |
- *   |  1  |(A1)._______|______      |
- *   |     |    |              |     |
- *   |     |    |              |     |
- *   +-----+----|    BITMAP    |-----+
- *   |     |    |              |     |
- *   |  2  |    |______________.     |
- *   |     |            |        (B2)|
- *   |     |            |     (x2,y2)|
- *   +---- +------------+------------+
- *
- * Example of an object that covers some of the area from cell A1 to cell B2.
- * Based on the width and height of the object we need to calculate 8 vars:
- *
- *     col_start, row_start, col_end, row_end, x1, y1, x2, y2.
- *
- * We also calculate the absolute x and y position of the top left vertex of
- * the object. This is required for images:
- *
- *    x_abs, y_abs
- *
+ * Build the geometry of the columns used to position objects. The width
+ * and position of each column up to the last one with column options are
+ * stored since the columns after it have the default width.
+ */
+STATIC lxw_error
+_worksheet_build_col_geometry(lxw_worksheet *self)
+{
+    lxw_col_options *col_opt;
+    lxw_col_geometry *geometry;
+    lxw_col_t num_cols = 0;
+    lxw_col_t col_index;
+    lxw_col_t col;
+
+    for (col_index = 0; col_index < self->col_options_max; col_index++) {
+        col_opt = self->col_options[col_index];
+
+        if (col_opt && col_opt->lastcol + 1 > num_cols)
+            num_cols = col_opt->lastcol + 1;
+    }
+
+    geometry = realloc(self->col_geometry,
+                       (num_cols + 1) * sizeof(lxw_col_geometry));
+    RETURN_ON_MEM_ERROR(geometry, LXW_ERROR_MEMORY_MALLOC_FAILED);
+
+    self->col_geometry = geometry;
+
+    /* Store the width of each column. As in _worksheet_size_col() the first
+     * matching column options are used. */
+    for (col = 0; col < num_cols; col++)
+        geometry[col].pixels = UINT32_MAX;
+
+    for (col_index = 0; col_index < self->col_options_max; col_index++) {
+        col_opt = self->col_options[col_index];
+
+        if (!col_opt)
+            continue;
+
+        for (col = col_opt->firstcol; col <= col_opt->lastcol; col++) {
+            if (geometry[col].pixels == UINT32_MAX) {
+                geometry[col].pixels =
+                    _col_options_pixels(col_opt,
+                                        LXW_OBJECT_MOVE_AND_SIZE_AFTER);
+                geometry[col].hidden = col_opt->hidden;
+            }
+        }
+    }
+
+    /* Add the position of the left side of each column, and the right side
+     * of the last one, ignoring any object anchor. */
+    geometry[0].position = 0;
+
+    for (col = 0; col < num_cols; col++) {
+        if (geometry[col].pixels == UINT32_MAX) {
+            geometry[col].pixels = self->default_col_pixels;
+            geometry[col].hidden = LXW_FALSE;
+        }
+
+        geometry[col + 1].position = geometry[col].position;
+
+        if (!geometry[col].hidden)
+            geometry[col + 1].position += geometry[col].pixels;
+    }
+
+    self->col_geometry_count = num_cols;
+    self->col_geometry_valid = LXW_TRUE;
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Build the geometry of the rows used to position objects. Only the rows
+ * that are hidden or have a height that differs from the default are
+ * stored, in row order, along with the running sum of the differences so
+ * that the position of any row can be found with a binary search.
+ */
+STATIC lxw_error
+_worksheet_build_row_geometry(lxw_worksheet *self)
+{
+    lxw_row *row;
+    lxw_row_geometry *geometry;
+    int64_t sum = 0;
+    uint32_t default_pixels = _row_pixels(self, NULL, 0);
+    uint32_t pixels;
+    uint32_t count = 0;
+
+    RB_FOREACH(row, lxw_table_rows, self->table) {
+        if (_row_in_geometry(self, row))
+            count++;
+    }
+
+    if (count) {
+        geometry = realloc(self->row_geometry,
+                           count * sizeof(lxw_row_geometry));
+        RETURN_ON_MEM_ERROR(geometry, LXW_ERROR_MEMORY_MALLOC_FAILED);
+
+        self->row_geometry = geometry;
+    }
+
+    count = 0;
+
+    RB_FOREACH(row, lxw_table_rows, self->table) {
+        pixels = _row_pixels(self, row, LXW_OBJECT_MOVE_AND_SIZE_AFTER);
+
+        if (row->hidden || pixels != default_pixels) {
+            geometry = &self->row_geometry[count++];
+            geometry->row_num = row->row_num;
+            geometry->pixels = pixels;
+            geometry->hidden = row->hidden;
+
+            sum += (int64_t) (row->hidden ? 0 : pixels) - default_pixels;
+            geometry->sum = sum;
+        }
+    }
+
+    self->row_geometry_count = count;
+    self->row_geometry_valid = LXW_TRUE;
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Check that the column geometry is up to date, building it if required.
+ */
+STATIC uint8_t
+_worksheet_has_col_geometry(lxw_worksheet *self)
+{
+    return self->col_geometry_valid
+        || _worksheet_build_col_geometry(self) == LXW_NO_ERROR;
+}
+
+/*
+ * Check that the row geometry is up to date, building it if required.
+ */
+STATIC uint8_t
+_worksheet_has_row_geometry(lxw_worksheet *self)
+{
+    return self->row_geometry_valid
+        || _worksheet_build_row_geometry(self) == LXW_NO_ERROR;
+}
+
+/*
+ * Find the number of stored rows in the row geometry above a row.
+ */
+STATIC uint32_t
+_worksheet_find_row_geometry(lxw_worksheet *self, lxw_row_t row_num)
+{
+    uint32_t low = 0;
+    uint32_t high = self->row_geometry_count;
+    uint32_t mid;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+
+        if (self->row_geometry[mid].row_num < row_num)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low;
+}
+
+/*
+ * Get the width of a column in pixels, as above, from the column geometry
+ * or, if it can't be built, from the column options.
+ */
+STATIC int32_t
+_worksheet_size_col(lxw_worksheet *self, lxw_col_t col_num, uint8_t anchor)
+{
+    lxw_col_options *col_opt = NULL;
+    lxw_col_geometry *geometry;
+    lxw_col_t col_index;
+
+    if (_worksheet_has_col_geometry(self)) {
+        if (col_num >= self->col_geometry_count)
+            return self->default_col_pixels;
+
+        geometry = &self->col_geometry[col_num];
+
+        if (geometry->hidden && anchor != LXW_OBJECT_MOVE_AND_SIZE_AFTER)
+            return 0;
+        else
+            return geometry->pixels;
+    }
+
+    /* Search for the col number in the array of col_options. Each col_option
+     * entry contains the start and end column for a range.
+     */
+    for (col_index = 0; col_index < self->col_options_max; col_index++) {
+        col_opt = self->col_options[col_index];
+
+        if (col_opt) {
+            if (col_num >= col_opt->firstcol && col_num <= col_opt->lastcol)
+                break;
+            else
+                col_opt = NULL;
+        }
+    }
+
+    if (col_opt)
+        return _col_options_pixels(col_opt, anchor);
+    else
+        return self->default_col_pixels;
+}
+
+/*
+ * Get the height of a row in pixels, as above, from the row geometry or, if
+ * it can't be built, from the row properties.
+ */
+STATIC int32_t
+_worksheet_size_row(lxw_worksheet *self, lxw_row_t row_num, uint8_t anchor)
+{
+    lxw_row_geometry *geometry;
+    uint32_t index;
+
+    if (!_worksheet_has_row_geometry(self))
+        return _row_pixels(self, lxw_worksheet_find_row(self, row_num),
+                           anchor);
+
+    index = _worksheet_find_row_geometry(self, row_num);
+
+    if (index == self->row_geometry_count
+        || self->row_geometry[index].row_num != row_num)
+        return _row_pixels(self, NULL, anchor);
+
+    geometry = &self->row_geometry[index];
+
+    if (geometry->hidden && anchor != LXW_OBJECT_MOVE_AND_SIZE_AFTER)
+        return 0;
+    else
+        return geometry->pixels;
+}
+
+/*
+ * Get the absolute x position, in pixels, of the left side of a column.
+ */
+STATIC uint32_t
+_worksheet_col_position(lxw_worksheet *self, lxw_col_t col_num)
+{
+    uint32_t x_abs = 0;
+    lxw_col_t count;
+    lxw_col_t i;
+
+    if (!_worksheet_has_col_geometry(self)) {
+        /* Fall back to summing the column widths. */
+        for (i = 0; i < col_num; i++)
+            x_abs += _worksheet_size_col(self, i, LXW_OBJECT_POSITION_DEFAULT);
+
+        return x_abs;
+    }
+
+    count = self->col_geometry_count;
+
+    if (col_num <= count)
+        return self->col_geometry[col_num].position;
+
+    return self->col_geometry[count].position
+        + self->default_col_pixels * (col_num - count);
+}
+
+/*
+ * Get the absolute y position, in pixels, of the top of a row.
+ */
+STATIC uint32_t
+_worksheet_row_position(lxw_worksheet *self, lxw_row_t row_num)
+{
+    uint32_t default_pixels = _row_pixels(self, NULL, 0);
+    uint32_t y_abs = 0;
+    uint32_t index;
+    lxw_row_t i;
+
+    if (!_worksheet_has_row_geometry(self)) {
+        /* Fall back to summing the row heights. */
+        for (i = 0; i < row_num; i++)
+            y_abs += _worksheet_size_row(self, i, LXW_OBJECT_POSITION_DEFAULT);
+
+        return y_abs;
+    }
+
+    index = _worksheet_find_row_geometry(self, row_num);
+
+    if (!index)
+        return default_pixels * row_num;
+
+    return (uint32_t) ((int64_t) default_pixels * row_num
+                       + self->row_geometry[index - 1].sum);
+}
+
+/*
+ * Calculate the vertices that define the position of a graphical object
+ * within the worksheet in pixels.
+ *         +------------+------------+
+ *         |     A      |      B     |
+ *   +-----+------------+------------+
+ *   |     |(x1,y1)     |            |
+ *   |  1  |(A1)._______|______      |
+ *   |     |    |              |     |
+ *   |     |    |              |     |
+ *   +-----+----|    BITMAP    |-----+
+ *   |     |    |              |     |
+ *   |  2  |    |______________.     |
+ *   |     |            |        (B2)|
+ *   |     |            |     (x2,y2)|
+ *   +---- +------------+------------+
+ *
+ * Example of an object that covers some of the area from cell A1 to cell B2.
+ * Based on the width and height of the object we need to calculate 8 vars:
+ *
+ *     col_start, row_start, col_end, row_end, x1, y1, x2, y2.
+ *
+ * We also calculate the absolute x and y position of the top left vertex of
+ * the object. This is required for images:
+ *
+ *    x_abs, y_abs
+ *
  * The width and height of the cells that the object occupies can be variable
  * and have to be taken into account.
  *
@@ -2929,7 +3749,6 @@ _worksheet_position_object_pixels(lxw_worksheet *self,
     uint32_t x_abs = 0;         /* Abs. distance to left side of object. */
     uint32_t y_abs = 0;         /* Abs. distance to top  side of object. */
 
-    uint32_t i;
     uint8_t anchor = drawing_object->anchor;
     uint8_t ignore_anchor = LXW_OBJECT_POSITION_DEFAULT;
 
@@ -2961,8 +3780,7 @@ _worksheet_position_object_pixels(lxw_worksheet *self,
 
     /* Calculate the absolute x offset of the top-left vertex. */
     if (self->col_size_changed) {
-        for (i = 0; i < col_start; i++)
-            x_abs += _worksheet_size_col(self, i, ignore_anchor);
+        x_abs += _worksheet_col_position(self, col_start);
     }
     else {
         /* Optimization for when the column widths haven't changed. */
@@ -2974,8 +3792,7 @@ _worksheet_position_object_pixels(lxw_worksheet *self,
     /* Calculate the absolute y offset of the top-left vertex. */
     /* Store the column change to allow optimizations. */
     if (self->row_size_changed) {
-        for (i = 0; i < row_start; i++)
-            y_abs += _worksheet_size_row(self, i, ignore_anchor);
+        y_abs += _worksheet_row_position(self, row_start);
     }
     else {
         /* Optimization for when the row heights haven"t changed. */
@@ -3457,7 +4274,7 @@ lxw_worksheet_prepare_image(lxw_worksheet *self,
             goto mem_error;
         }
 
-        if (!_find_drawing_rel_index(self, url)) {
+        if (!_find_drawing_rel_index(self, url, strlen(url) + 1)) {
             STAILQ_INSERT_TAIL(self->drawing_links, relationship,
                                list_pointers);
         }
@@ -3468,11 +4285,13 @@ lxw_worksheet_prepare_image(lxw_worksheet *self,
             free(relationship);
         }
 
-        drawing_object->url_rel_index = _get_drawing_rel_index(self, url);
+        drawing_object->url_rel_index =
+            _get_drawing_rel_index(self, url, strlen(url) + 1);
 
     }
 
-    if (!_find_drawing_rel_index(self, object_props->md5)) {
+    if (!_find_drawing_rel_index(self, _image_rel_target(object_props),
+                                 LXW_IMAGE_DIGEST_SIZE)) {
         relationship = calloc(1, sizeof(lxw_rel_tuple));
         GOTO_LABEL_ON_MEM_ERROR(relationship, mem_error);
 
@@ -3489,7 +4308,8 @@ lxw_worksheet_prepare_image(lxw_worksheet *self,
     }
 
     drawing_object->rel_index =
-        _get_drawing_rel_index(self, object_props->md5);
+        _get_drawing_rel_index(self, _image_rel_target(object_props),
+                               LXW_IMAGE_DIGEST_SIZE);
 
     return;
 
@@ -3517,7 +4337,8 @@ lxw_worksheet_prepare_header_image(lxw_worksheet *self,
 
     STAILQ_INSERT_TAIL(self->image_props, object_props, list_pointers);
 
-    if (!_find_vml_drawing_rel_index(self, object_props->md5)) {
+    if (!_find_vml_drawing_rel_index(self, _image_rel_target(object_props),
+                                     LXW_IMAGE_DIGEST_SIZE)) {
         relationship = calloc(1, sizeof(lxw_rel_tuple));
         RETURN_VOID_ON_MEM_ERROR(relationship);
 
@@ -3553,7 +4374,8 @@ lxw_worksheet_prepare_header_image(lxw_worksheet *self,
         *extension = '\0';
 
     header_image_vml->rel_index =
-        _get_vml_drawing_rel_index(self, object_props->md5);
+        _get_vml_drawing_rel_index(self, _image_rel_target(object_props),
+                                   LXW_IMAGE_DIGEST_SIZE);
 
     STAILQ_INSERT_TAIL(self->header_image_objs, header_image_vml,
                        list_pointers);
@@ -3661,7 +4483,7 @@ lxw_worksheet_prepare_chart(lxw_worksheet *self,
     drawing_object->type = LXW_DRAWING_CHART;
     drawing_object->description = lxw_strdup(object_props->description);
     drawing_object->tip = NULL;
-    drawing_object->rel_index = _get_drawing_rel_index(self, NULL);
+    drawing_object->rel_index = _get_drawing_rel_index(self, NULL, 0);
     drawing_object->url_rel_index = 0;
     drawing_object->decorative = object_props->decorative;
 
@@ -3717,6 +4539,7 @@ lxw_worksheet_prepare_vml_objects(lxw_worksheet *self,
 {
     lxw_row *row;
     lxw_cell *cell;
+    lxw_col_t col;
     lxw_rel_tuple *relationship;
     char filename[LXW_FILENAME_LENGTH];
     uint32_t comment_count = 0;
@@ -3728,12 +4551,14 @@ lxw_worksheet_prepare_vml_objects(lxw_worksheet *self,
 
     RB_FOREACH(row, lxw_table_rows, self->comments) {
 
-        RB_FOREACH(cell, lxw_table_cells, row->cells) {
+        for (col = 0; col < row->num_cells; col++) {
+            cell = row->cells[col];
+
             /* Calculate the worksheet position of the comment. */
-            _worksheet_position_vml_object(self, cell->comment);
+            _worksheet_position_vml_object(self, cell->extra->comment);
 
             /* Store comment in a simple list for use by packager. */
-            STAILQ_INSERT_TAIL(self->comment_objs, cell->comment,
+            STAILQ_INSERT_TAIL(self->comment_objs, cell->extra->comment,
                                list_pointers);
             comment_count++;
         }
@@ -3920,91 +4745,147 @@ mem_error:
     return;
 }
 
+/*
+ * Return a pointer to the next "count" bytes of an image held in memory and
+ * advance the read position past them. Returns NULL, like a short fread(),
+ * if there aren't enough bytes left.
+ */
+STATIC const unsigned char *
+_image_data_read(const unsigned char *data, size_t size, size_t *position,
+                 size_t count)
+{
+    const unsigned char *bytes;
+
+    if (count > size - *position)
+        return NULL;
+
+    bytes = data + *position;
+    *position += count;
+
+    return bytes;
+}
+
+/*
+ * Advance the read position of an image held in memory. The position is
+ * clamped to the end of the data so that, like a read past the end of a
+ * file, the next read fails.
+ */
+STATIC void
+_image_data_skip(size_t size, size_t *position, size_t count)
+{
+    if (count > size - *position)
+        *position = size;
+    else
+        *position += count;
+}
+
+/*
+ * Read big and little endian integers from image data.
+ */
+STATIC uint32_t
+_image_uint32_be(const unsigned char *bytes)
+{
+    return ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) |
+        ((uint32_t) bytes[2] << 8) | (uint32_t) bytes[3];
+}
+
+STATIC uint16_t
+_image_uint16_be(const unsigned char *bytes)
+{
+    return (uint16_t) ((bytes[0] << 8) | bytes[1]);
+}
+
+STATIC uint32_t
+_image_uint32_le(const unsigned char *bytes)
+{
+    return ((uint32_t) bytes[3] << 24) | ((uint32_t) bytes[2] << 16) |
+        ((uint32_t) bytes[1] << 8) | (uint32_t) bytes[0];
+}
+
+STATIC uint16_t
+_image_uint16_le(const unsigned char *bytes)
+{
+    return (uint16_t) ((bytes[1] << 8) | bytes[0]);
+}
+
 /*
  * Extract width and height information from a PNG file.
  */
 STATIC lxw_error
-_process_png(lxw_object_properties *object_props)
+_process_png(lxw_object_properties *object_props,
+             const unsigned char *data, size_t size)
 {
+    const unsigned char *bytes;
+    const unsigned char *type;
     uint32_t length;
     uint32_t offset;
-    char type[4];
     uint32_t width = 0;
     uint32_t height = 0;
     double x_dpi = 96;
     double y_dpi = 96;
-    int fseek_err;
 
-    FILE *stream = object_props->stream;
+    /* Start at the end of the 8 byte PNG header. */
+    size_t position = 8;
 
-    /* Skip another 4 bytes to the end of the PNG header. */
-    fseek_err = fseek(stream, 4, SEEK_CUR);
-    if (fseek_err)
-        goto file_error;
-
-    while (!feof(stream)) {
+    while (position < size) {
 
         /* Read the PNG length and type fields for the sub-section. */
-        if (fread(&length, sizeof(length), 1, stream) < 1)
+        bytes = _image_data_read(data, size, &position, 4);
+        if (!bytes)
             break;
 
-        if (fread(&type, 1, 4, stream) < 4)
+        type = _image_data_read(data, size, &position, 4);
+        if (!type)
             break;
 
-        /* Convert the length to network order. */
-        length = LXW_UINT32_NETWORK(length);
+        length = _image_uint32_be(bytes);
 
-        /* The offset for next fseek() is the field length + type length. */
+        /* The offset to the next section is the field length + CRC length. */
         offset = length + 4;
 
         if (memcmp(type, "IHDR", 4) == 0) {
-            if (fread(&width, sizeof(width), 1, stream) < 1)
+            bytes = _image_data_read(data, size, &position, 4);
+            if (!bytes)
                 break;
 
-            if (fread(&height, sizeof(height), 1, stream) < 1)
+            width = _image_uint32_be(bytes);
+
+            bytes = _image_data_read(data, size, &position, 4);
+            if (!bytes)
                 break;
 
-            width = LXW_UINT32_NETWORK(width);
-            height = LXW_UINT32_NETWORK(height);
+            height = _image_uint32_be(bytes);
 
-            /* Reduce the offset by the length of previous freads(). */
+            /* Reduce the offset by the length of the previous reads. */
             offset -= 8;
         }
 
         if (memcmp(type, "pHYs", 4) == 0) {
-            uint32_t x_ppu = 0;
-            uint32_t y_ppu = 0;
-            uint8_t units = 1;
+            uint32_t x_ppu;
+            uint32_t y_ppu;
+            uint8_t units;
 
-            if (fread(&x_ppu, sizeof(x_ppu), 1, stream) < 1)
+            bytes = _image_data_read(data, size, &position, 9);
+            if (!bytes)
                 break;
 
-            if (fread(&y_ppu, sizeof(y_ppu), 1, stream) < 1)
-                break;
-
-            if (fread(&units, sizeof(units), 1, stream) < 1)
-                break;
+            x_ppu = _image_uint32_be(bytes);
+            y_ppu = _image_uint32_be(bytes + 4);
+            units = bytes[8];
 
             if (units == 1) {
-                x_ppu = LXW_UINT32_NETWORK(x_ppu);
-                y_ppu = LXW_UINT32_NETWORK(y_ppu);
-
                 x_dpi = (double) x_ppu *0.0254;
                 y_dpi = (double) y_ppu *0.0254;
             }
 
-            /* Reduce the offset by the length of previous freads(). */
+            /* Reduce the offset by the length of the previous reads. */
             offset -= 9;
         }
 
         if (memcmp(type, "IEND", 4) == 0)
             break;
 
-        if (!feof(stream)) {
-            fseek_err = fseek(stream, offset, SEEK_CUR);
-            if (fseek_err)
-                goto file_error;
-        }
+        _image_data_skip(size, &position, offset);
     }
 
     /* Ensure that we read some valid data from the file. */
@@ -4032,8 +4913,10 @@ file_error:
  * Extract width and height information from a JPEG file.
  */
 STATIC lxw_error
-_process_jpeg(lxw_object_properties *image_props)
+_process_jpeg(lxw_object_properties *image_props,
+              const unsigned char *data, size_t size)
 {
+    const unsigned char *bytes;
     uint16_t length;
     uint16_t marker;
     uint32_t offset;
@@ -4041,74 +4924,62 @@ _process_jpeg(lxw_object_properties *image_props)
     uint16_t height = 0;
     double x_dpi = 96;
     double y_dpi = 96;
-    int fseek_err;
 
-    FILE *stream = image_props->stream;
-
-    /* Read back 2 bytes to the end of the initial 0xFFD8 marker. */
-    fseek_err = fseek(stream, -2, SEEK_CUR);
-    if (fseek_err)
-        goto file_error;
+    /* Start at the end of the initial 0xFFD8 marker. */
+    size_t position = 2;
 
     /* Search through the image data and read the JPEG markers. */
-    while (!feof(stream)) {
+    while (position < size) {
 
         /* Read the JPEG marker and length fields for the sub-section. */
-        if (fread(&marker, sizeof(marker), 1, stream) < 1)
-            break;
-
-        if (fread(&length, sizeof(length), 1, stream) < 1)
+        bytes = _image_data_read(data, size, &position, 4);
+        if (!bytes)
             break;
 
-        /* Convert the marker and length to network order. */
-        marker = LXW_UINT16_NETWORK(marker);
-        length = LXW_UINT16_NETWORK(length);
+        marker = _image_uint16_be(bytes);
+        length = _image_uint16_be(bytes + 2);
 
-        /* The offset for next fseek() is the field length + type length. */
+        /* The offset to the next section is the field length - length size. */
         offset = length - 2;
 
         /* Read the height and width in the 0xFFCn elements (except C4, C8 */
         /* and CC which aren't SOF markers). */
         if ((marker & 0xFFF0) == 0xFFC0 && marker != 0xFFC4
             && marker != 0xFFC8 && marker != 0xFFCC) {
+
             /* Skip 1 byte to height and width. */
-            fseek_err = fseek(stream, 1, SEEK_CUR);
-            if (fseek_err)
-                goto file_error;
+            _image_data_skip(size, &position, 1);
 
-            if (fread(&height, sizeof(height), 1, stream) < 1)
+            bytes = _image_data_read(data, size, &position, 2);
+            if (!bytes)
                 break;
 
-            if (fread(&width, sizeof(width), 1, stream) < 1)
+            height = _image_uint16_be(bytes);
+
+            bytes = _image_data_read(data, size, &position, 2);
+            if (!bytes)
                 break;
 
-            height = LXW_UINT16_NETWORK(height);
-            width = LXW_UINT16_NETWORK(width);
+            width = _image_uint16_be(bytes);
 
             offset -= 9;
         }
 
         /* Read the DPI in the 0xFFE0 element. */
         if (marker == 0xFFE0) {
-            uint16_t x_density = 0;
-            uint16_t y_density = 0;
-            uint8_t units = 1;
-
-            fseek_err = fseek(stream, 7, SEEK_CUR);
-            if (fseek_err)
-                goto file_error;
+            uint16_t x_density;
+            uint16_t y_density;
+            uint8_t units;
 
-            if (fread(&units, sizeof(units), 1, stream) < 1)
-                break;
-
-            if (fread(&x_density, sizeof(x_density), 1, stream) < 1)
-                break;
+            _image_data_skip(size, &position, 7);
 
-            if (fread(&y_density, sizeof(y_density), 1, stream) < 1)
+            bytes = _image_data_read(data, size, &position, 5);
+            if (!bytes)
                 break;
 
-            x_density = LXW_UINT16_NETWORK(x_density);
-            y_density = LXW_UINT16_NETWORK(y_density);
+            units = bytes[0];
+            x_density = _image_uint16_be(bytes + 1);
+            y_density = _image_uint16_be(bytes + 3);
 
             if (units == 1) {
                 x_dpi = x_density;
@@ -4126,11 +4997,7 @@ _process_jpeg(lxw_object_properties *image_props)
         if (marker == 0xFFDA)
             break;
 
-        if (!feof(stream)) {
-            fseek_err = fseek(stream, offset, SEEK_CUR);
-            if (fseek_err)
-                break;
-        }
+        _image_data_skip(size, &position, offset);
     }
 
     /* Ensure that we read some valid data from the file. */
@@ -4158,34 +5025,25 @@ file_error:
  * Extract width and height information from a BMP file.
  */
 STATIC lxw_error
-_process_bmp(lxw_object_properties *image_props)
+_process_bmp(lxw_object_properties *image_props,
+             const unsigned char *data, size_t size)
 {
     uint32_t width = 0;
     uint32_t height = 0;
     double x_dpi = 96;
     double y_dpi = 96;
-    int fseek_err;
-
-    FILE *stream = image_props->stream;
-
-    /* Skip another 14 bytes to the start of the BMP height/width. */
-    fseek_err = fseek(stream, 14, SEEK_CUR);
-    if (fseek_err)
-        goto file_error;
 
-    if (fread(&width, sizeof(width), 1, stream) < 1)
-        width = 0;
+    /* The BMP width and height are at offset 18 and 22. */
+    if (size >= 22)
+        width = _image_uint32_le(data + 18);
 
-    if (fread(&height, sizeof(height), 1, stream) < 1)
-        height = 0;
+    if (size >= 26)
+        height = _image_uint32_le(data + 22);
 
     /* Ensure that we read some valid data from the file. */
     if (width == 0)
         goto file_error;
 
-    height = LXW_UINT32_HOST(height);
-    width = LXW_UINT32_HOST(width);
-
     /* Set the image metadata. */
     image_props->image_type = LXW_IMAGE_BMP;
     image_props->width = width;
@@ -4207,34 +5065,25 @@ file_error:
  * Extract width and height information from a GIF file.
  */
 STATIC lxw_error
-_process_gif(lxw_object_properties *image_props)
+_process_gif(lxw_object_properties *image_props,
+             const unsigned char *data, size_t size)
 {
     uint16_t width = 0;
     uint16_t height = 0;
     double x_dpi = 96;
     double y_dpi = 96;
-    int fseek_err;
-
-    FILE *stream = image_props->stream;
-
-    /* Skip another 2 bytes to the start of the GIF height/width. */
-    fseek_err = fseek(stream, 2, SEEK_CUR);
-    if (fseek_err)
-        goto file_error;
 
-    if (fread(&width, sizeof(width), 1, stream) < 1)
-        width = 0;
+    /* The GIF width and height are at offset 6 and 8. */
+    if (size >= 8)
+        width = _image_uint16_le(data + 6);
 
-    if (fread(&height, sizeof(height), 1, stream) < 1)
-        height = 0;
+    if (size >= 10)
+        height = _image_uint16_le(data + 8);
 
     /* Ensure that we read some valid data from the file. */
     if (width == 0)
         goto file_error;
 
-    height = LXW_UINT16_HOST(height);
-    width = LXW_UINT16_HOST(width);
-
     /* Set the image metadata. */
     image_props->image_type = LXW_IMAGE_GIF;
     image_props->width = width;
@@ -4252,82 +5101,130 @@ file_error:
     return LXW_ERROR_IMAGE_DIMENSIONS;
 }
 
+/*
+ * Read the whole of an image file into memory so that the header parsing and
+ * the image digest can share a single pass over the data.
+ */
+STATIC unsigned char *
+_read_image_stream(FILE *stream, size_t *size)
+{
+    unsigned char *data = NULL;
+    unsigned char *new_data;
+    size_t capacity = LXW_IMAGE_BUFFER_SIZE;
+    size_t size_read;
+    long file_size;
+
+    *size = 0;
+
+    /* Size the buffer from the file length if it is available. */
+    if (fseek(stream, 0, SEEK_END) == 0) {
+        file_size = ftell(stream);
+        if (file_size > 0)
+            capacity = (size_t) file_size + 1;
+    }
+    rewind(stream);
+
+    data = malloc(capacity);
+    RETURN_ON_MEM_ERROR(data, NULL);
+
+    /* Read until EOF in case the file has changed size since ftell(). */
+    while (1) {
+        size_read = fread(data + *size, 1, capacity - *size, stream);
+        *size += size_read;
+
+        if (*size < capacity)
+            break;
+
+        new_data = realloc(data, capacity * 2);
+        if (!new_data) {
+            free(data);
+            LXW_MEM_ERROR();
+            return NULL;
+        }
+
+        data = new_data;
+        capacity *= 2;
+    }
+
+    return data;
+}
+
 /*
  * Extract information from the image file such as dimension, type, filename,
- * and extension.
+ * and extension. The image is parsed from memory: either the copy held for
+ * buffer images or the file contents read once from the stream.
  */
 STATIC lxw_error
 _get_image_properties(lxw_object_properties *image_props)
 {
-    unsigned char signature[4];
-#ifndef USE_NO_MD5
-    uint8_t i;
+    const unsigned char *data;
+    unsigned char *file_data = NULL;
+    size_t size;
+    lxw_error err;
+#if !defined(USE_NO_MD5) && !defined(USE_FAST_IMAGE_HASH)
     MD5_CTX md5_context;
-    size_t size_read;
-    char buffer[LXW_IMAGE_BUFFER_SIZE];
-    unsigned char md5_checksum[LXW_MD5_SIZE];
 #endif
 
-    /* Read 4 bytes to look for the file header/signature. */
-    if (fread(signature, 1, 4, image_props->stream) < 4) {
+    if (image_props->is_image_buffer) {
+        data = (const unsigned char *) image_props->image_buffer;
+        size = image_props->image_buffer_size;
+    }
+    else {
+        file_data = _read_image_stream(image_props->stream, &size);
+        if (!file_data)
+            return LXW_ERROR_MEMORY_MALLOC_FAILED;
+
+        data = file_data;
+    }
+
+    /* Look for the file header/signature in the first 4 bytes. */
+    if (size < 4) {
         LXW_WARN_FORMAT1("worksheet image insertion: "
                          "couldn't read image type for: %s.",
                          image_props->filename);
-        return LXW_ERROR_IMAGE_DIMENSIONS;
+        err = LXW_ERROR_IMAGE_DIMENSIONS;
+        goto done;
     }
 
-    if (memcmp(&signature[1], "PNG", 3) == 0) {
-        if (_process_png(image_props) != LXW_NO_ERROR)
-            return LXW_ERROR_IMAGE_DIMENSIONS;
+    if (memcmp(&data[1], "PNG", 3) == 0) {
+        err = _process_png(image_props, data, size);
     }
-    else if (signature[0] == 0xFF && signature[1] == 0xD8) {
-        if (_process_jpeg(image_props) != LXW_NO_ERROR)
-            return LXW_ERROR_IMAGE_DIMENSIONS;
+    else if (data[0] == 0xFF && data[1] == 0xD8) {
+        err = _process_jpeg(image_props, data, size);
     }
-    else if (memcmp(signature, "BM", 2) == 0) {
-        if (_process_bmp(image_props) != LXW_NO_ERROR)
-            return LXW_ERROR_IMAGE_DIMENSIONS;
+    else if (memcmp(data, "BM", 2) == 0) {
+        err = _process_bmp(image_props, data, size);
     }
-    else if (memcmp(signature, "GIF8", 4) == 0) {
-        if (_process_gif(image_props) != LXW_NO_ERROR)
-            return LXW_ERROR_IMAGE_DIMENSIONS;
+    else if (memcmp(data, "GIF8", 4) == 0) {
+        err = _process_gif(image_props, data, size);
     }
     else {
         LXW_WARN_FORMAT1("worksheet image insertion: "
                          "unsupported image format for: %s.",
                          image_props->filename);
-        return LXW_ERROR_IMAGE_DIMENSIONS;
+        err = LXW_ERROR_IMAGE_DIMENSIONS;
     }
 
-#ifndef USE_NO_MD5
-    /* Calculate an MD5 checksum for the image so that we can remove duplicate
-     * images to reduce the xlsx file size.*/
-    rewind(image_props->stream);
-
-    MD5_Init(&md5_context);
-
-    size_read = fread(buffer, 1, LXW_IMAGE_BUFFER_SIZE, image_props->stream);
-    while (size_read) {
-        MD5_Update(&md5_context, buffer, (unsigned long) size_read);
-        size_read =
-            fread(buffer, 1, LXW_IMAGE_BUFFER_SIZE, image_props->stream);
+    if (err != LXW_NO_ERROR) {
+        err = LXW_ERROR_IMAGE_DIMENSIONS;
+        goto done;
     }
 
-    MD5_Final(md5_checksum, &md5_context);
-
-    /* Create a 32 char hex string buffer for the MD5 checksum. */
-    image_props->md5 = calloc(1, LXW_MD5_SIZE * 2 + 1);
-
-    /* If this calloc fails we just return and don't remove duplicates. */
-    RETURN_ON_MEM_ERROR(image_props->md5, LXW_NO_ERROR);
-
-    /* Convert the 16 byte MD5 buffer to a 32 char hex string. */
-    for (i = 0; i < LXW_MD5_SIZE; i++) {
-        lxw_snprintf(&image_props->md5[2 * i], 3, "%02x", md5_checksum[i]);
-    }
+    /* Calculate a digest of the image so that we can remove duplicate
+     * images to reduce the xlsx file size. */
+#if defined(USE_FAST_IMAGE_HASH)
+    lxw_hash_digest(data, size, image_props->digest);
+    image_props->has_digest = LXW_TRUE;
+#elif !defined(USE_NO_MD5)
+    MD5_Init(&md5_context);
+    MD5_Update(&md5_context, data, (unsigned long) size);
+    MD5_Final(image_props->digest, &md5_context);
+    image_props->has_digest = LXW_TRUE;
 #endif
 
-    return LXW_NO_ERROR;
+done:
+    free(file_data);
+    return err;
 }
 
 /* Conditional formats that refer to the same cell sqref range, like A or
@@ -4392,34 +5289,34 @@ mem_error:
  ****************************************************************************/
 
 /*
- * Write out a number worksheet cell. Doesn't use the xml functions as an
- * optimization in the inner cell writing loop.
+ * Write the common start of a cell: <c r="A1" s="1"
  */
 STATIC void
-_write_number_cell(lxw_worksheet *self, char *range,
-                   int32_t style_index, lxw_cell *cell)
+_append_cell_start(lxw_xml_buffer *buffer, char *range, int32_t style_index)
 {
-#ifdef USE_DTOA_LIBRARY
-    char data[LXW_ATTR_32];
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "<c r=\"");
+    lxw_xml_buffer_append_str(buffer, range);
 
-    lxw_sprintf_dbl(data, cell->u.number);
+    if (style_index) {
+        LXW_XML_BUFFER_APPEND_LITERAL(buffer, "\" s=\"");
+        lxw_xml_buffer_append_int(buffer, style_index);
+    }
 
-    if (style_index)
-        fprintf(self->file,
-                "<c r=\"%s\" s=\"%d\"><v>%s</v></c>",
-                range, style_index, data);
-    else
-        fprintf(self->file, "<c r=\"%s\"><v>%s</v></c>", range, data);
-#else
-    if (style_index)
-        fprintf(self->file,
-                "<c r=\"%s\" s=\"%d\"><v>%.16G</v></c>",
-                range, style_index, cell->u.number);
-    else
-        fprintf(self->file,
-                "<c r=\"%s\"><v>%.16G</v></c>", range, cell->u.number);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "\"");
+}
 
-#endif
+/*
+ * Write out a number worksheet cell. Doesn't use the xml functions as an
+ * optimization in the inner cell writing loop.
+ */
+STATIC void
+_write_number_cell(lxw_xml_buffer *buffer, char *range, int32_t style_index,
+                   lxw_cell *cell)
+{
+    _append_cell_start(buffer, range, style_index);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "><v>");
+    lxw_xml_buffer_append_dbl(buffer, cell->u.number);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "</v></c>");
 }
 
 /*
@@ -4427,18 +5324,19 @@ _write_number_cell(lxw_worksheet *self, char *range,
  * optimization in the inner cell writing loop.
  */
 STATIC void
-_write_string_cell(lxw_worksheet *self, char *range,
+_write_string_cell(lxw_worksheet *self, lxw_xml_buffer *buffer, char *range,
                    int32_t style_index, lxw_cell *cell)
 {
+    uint32_t string_id = cell->u.string_id;
 
-    if (style_index)
-        fprintf(self->file,
-                "<c r=\"%s\" s=\"%d\" t=\"s\"><v>%d</v></c>",
-                range, style_index, cell->u.string_id);
-    else
-        fprintf(self->file,
-                "<c r=\"%s\" t=\"s\"><v>%d</v></c>",
-                range, cell->u.string_id);
+    /* Map a worksheet string index to the workbook SST index. */
+    if (self->sst_remap)
+        string_id = self->sst_remap[string_id];
+
+    _append_cell_start(buffer, range, style_index);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, " t=\"s\"><v>");
+    lxw_xml_buffer_append_int(buffer, string_id);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "</v></c>");
 }
 
 /*
@@ -4446,38 +5344,24 @@ _write_string_cell(lxw_worksheet *self, char *range,
  * optimization in the inner cell writing loop.
  */
 STATIC void
-_write_inline_string_cell(lxw_worksheet *self, char *range,
+_write_inline_string_cell(lxw_xml_buffer *buffer, char *range,
                           int32_t style_index, lxw_cell *cell)
 {
-    char *string = lxw_escape_data(cell->u.string);
+    const char *string = cell->u.string;
+    size_t length = strlen(string);
+
+    _append_cell_start(buffer, range, style_index);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, " t=\"inlineStr\"><is>");
 
     /* Add attribute to preserve leading or trailing whitespace. */
-    if (isspace((unsigned char) string[0])
-        || isspace((unsigned char) string[strlen(string) - 1])) {
-
-        if (style_index)
-            fprintf(self->file,
-                    "<c r=\"%s\" s=\"%d\" t=\"inlineStr\"><is>"
-                    "<t xml:space=\"preserve\">%s</t></is></c>",
-                    range, style_index, string);
-        else
-            fprintf(self->file,
-                    "<c r=\"%s\" t=\"inlineStr\"><is>"
-                    "<t xml:space=\"preserve\">%s</t></is></c>",
-                    range, string);
-    }
-    else {
-        if (style_index)
-            fprintf(self->file,
-                    "<c r=\"%s\" s=\"%d\" t=\"inlineStr\">"
-                    "<is><t>%s</t></is></c>", range, style_index, string);
-        else
-            fprintf(self->file,
-                    "<c r=\"%s\" t=\"inlineStr\">"
-                    "<is><t>%s</t></is></c>", range, string);
-    }
+    if (length && (isspace((unsigned char) string[0])
+                   || isspace((unsigned char) string[length - 1])))
+        LXW_XML_BUFFER_APPEND_LITERAL(buffer, "<t xml:space=\"preserve\">");
+    else
+        LXW_XML_BUFFER_APPEND_LITERAL(buffer, "<t>");
 
-    free(string);
+    lxw_xml_buffer_append_escaped(buffer, string, LXW_FALSE);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "</t></is></c>");
 }
 
 /*
@@ -4485,91 +5369,74 @@ _write_inline_string_cell(lxw_worksheet *self, char *range,
  * optimization in the inner cell writing loop.
  */
 STATIC void
-_write_inline_rich_string_cell(lxw_worksheet *self, char *range,
+_write_inline_rich_string_cell(lxw_xml_buffer *buffer, char *range,
                                int32_t style_index, lxw_cell *cell)
 {
-    const char *string = cell->u.string;
-
-    if (style_index)
-        fprintf(self->file,
-                "<c r=\"%s\" s=\"%d\" t=\"inlineStr\">"
-                "<is>%s</is></c>", range, style_index, string);
-    else
-        fprintf(self->file,
-                "<c r=\"%s\" t=\"inlineStr\">"
-                "<is>%s</is></c>", range, string);
+    _append_cell_start(buffer, range, style_index);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, " t=\"inlineStr\"><is>");
+    lxw_xml_buffer_append_str(buffer, cell->u.string);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "</is></c>");
 }
 
 /*
  * Write out a formula worksheet cell with a numeric result.
  */
 STATIC void
-_write_formula_num_cell(lxw_worksheet *self, lxw_cell *cell)
+_write_formula_num_cell(lxw_xml_buffer *buffer, lxw_cell *cell)
 {
-    char data[LXW_ATTR_32];
-
-    lxw_sprintf_dbl(data, cell->formula_result);
-    lxw_xml_data_element(self->file, "f", cell->u.string, NULL);
-    lxw_xml_data_element(self->file, "v", data, NULL);
+    lxw_xml_buffer_data_element(buffer, "f", cell->u.string, NULL);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "<v>");
+    lxw_xml_buffer_append_dbl(buffer, cell->extra->formula_result);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "</v>");
 }
 
 /*
  * Write out a formula worksheet cell with a numeric result.
  */
 STATIC void
-_write_formula_str_cell(lxw_worksheet *self, lxw_cell *cell)
+_write_formula_str_cell(lxw_xml_buffer *buffer, lxw_cell *cell)
 {
-    lxw_xml_data_element(self->file, "f", cell->u.string, NULL);
-    lxw_xml_data_element(self->file, "v", cell->user_data2, NULL);
+    lxw_xml_buffer_data_element(buffer, "f", cell->u.string, NULL);
+    lxw_xml_buffer_data_element(buffer, "v", cell->extra->user_data2, NULL);
 }
 
 /*
  * Write out an array formula worksheet cell with a numeric result.
  */
 STATIC void
-_write_array_formula_num_cell(lxw_worksheet *self, lxw_cell *cell)
+_write_array_formula_num_cell(lxw_xml_buffer *buffer, lxw_cell *cell)
 {
-    struct xml_attribute_list attributes;
-    struct xml_attribute *attribute;
-    char data[LXW_ATTR_32];
+    lxw_attributes attributes;
 
-    LXW_INIT_ATTRIBUTES();
-    LXW_PUSH_ATTRIBUTES_STR("t", "array");
-    LXW_PUSH_ATTRIBUTES_STR("ref", cell->user_data1);
-
-    lxw_sprintf_dbl(data, cell->formula_result);
+    lxw_attributes_init(&attributes);
+    lxw_attributes_push_str(&attributes, "t", "array");
+    lxw_attributes_push_str(&attributes, "ref", cell->extra->user_data1);
 
-    lxw_xml_data_element(self->file, "f", cell->u.string, &attributes);
-    lxw_xml_data_element(self->file, "v", data, NULL);
-
-    LXW_FREE_ATTRIBUTES();
+    lxw_xml_buffer_data_element(buffer, "f", cell->u.string, &attributes);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "<v>");
+    lxw_xml_buffer_append_dbl(buffer, cell->extra->formula_result);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "</v>");
 }
 
 /*
  * Write out a boolean worksheet cell.
  */
 STATIC void
-_write_boolean_cell(lxw_worksheet *self, lxw_cell *cell)
+_write_boolean_cell(lxw_xml_buffer *buffer, lxw_cell *cell)
 {
-    char data[LXW_ATTR_32];
-
     if (cell->u.number == 0.0)
-        data[0] = '0';
+        LXW_XML_BUFFER_APPEND_LITERAL(buffer, "<v>0</v>");
     else
-        data[0] = '1';
-
-    data[1] = '\0';
-
-    lxw_xml_data_element(self->file, "v", data, NULL);
+        LXW_XML_BUFFER_APPEND_LITERAL(buffer, "<v>1</v>");
 }
 
 /*
  * Write out a error worksheet cell.
  */
 STATIC void
-_write_error_cell(lxw_worksheet *self)
+_write_error_cell(lxw_xml_buffer *buffer)
 {
-    lxw_xml_data_element(self->file, "v", "#VALUE!", NULL);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "<v>#VALUE!</v>");
 }
 
 /*
@@ -4582,10 +5449,8 @@ _write_error_cell(lxw_worksheet *self)
 STATIC void
 _calculate_spans(struct lxw_row *row, char *span, int32_t *block_num)
 {
-    lxw_cell *cell_min = RB_MIN(lxw_table_cells, row->cells);
-    lxw_cell *cell_max = RB_MAX(lxw_table_cells, row->cells);
-    lxw_col_t span_col_min = cell_min->col_num;
-    lxw_col_t span_col_max = cell_max->col_num;
+    lxw_col_t span_col_min = row->cells[0]->col_num;
+    lxw_col_t span_col_max = row->cells[row->num_cells - 1]->col_num;
     lxw_col_t col_min;
     lxw_col_t col_max;
     *block_num = row->row_num / 16;
@@ -4594,11 +5459,9 @@ _calculate_spans(struct lxw_row *row, char *span, int32_t *block_num)
 
     while (row && (int32_t) (row->row_num / 16) == *block_num) {
 
-        if (!RB_EMPTY(row->cells)) {
-            cell_min = RB_MIN(lxw_table_cells, row->cells);
-            cell_max = RB_MAX(lxw_table_cells, row->cells);
-            col_min = cell_min->col_num;
-            col_max = cell_max->col_num;
+        if (row->num_cells) {
+            col_min = row->cells[0]->col_num;
+            col_max = row->cells[row->num_cells - 1]->col_num;
 
             if (col_min < span_col_min)
                 span_col_min = col_min;
@@ -4614,103 +5477,219 @@ _calculate_spans(struct lxw_row *row, char *span, int32_t *block_num)
                  "%d:%d", span_col_min + 1, span_col_max + 1);
 }
 
+/*
+ * Get the XF index for a cell. The cell format takes precedence over the row
+ * format which takes precedence over the column format.
+ */
+STATIC int32_t
+_get_cell_style_index(lxw_worksheet *self, lxw_cell *cell,
+                      lxw_format *row_format)
+{
+    lxw_col_t col_num = cell->col_num;
+
+    if (cell->format)
+        return lxw_format_get_xf_index(cell->format);
+
+    if (row_format)
+        return lxw_format_get_xf_index(row_format);
+
+    if (col_num < self->col_formats_max && self->col_formats[col_num])
+        return lxw_format_get_xf_index(self->col_formats[col_num]);
+
+    return 0;
+}
+
+/*
+ * Set the cached row number string used in cell references. Rows are
+ * written in order so the common case is to increment the previous string.
+ */
+STATIC void
+_set_row_name(lxw_worksheet *self, lxw_row_t row_num)
+{
+    char *row_name = self->row_name;
+    uint8_t length = self->row_name_length;
+    uint32_t number;
+    int pos;
+
+    if (length && row_num == self->row_name_num + 1) {
+        /* Increment the decimal string in place. */
+        for (pos = length - 1; pos >= 0 && row_name[pos] == '9'; pos--)
+            row_name[pos] = '0';
+
+        if (pos >= 0) {
+            row_name[pos]++;
+        }
+        else {
+            /* Carry into a new leading digit, e.g. 999 to 1000. */
+            memmove(row_name + 1, row_name, length + 1);
+            row_name[0] = '1';
+            self->row_name_length++;
+        }
+    }
+    else {
+        /* Convert the 1-indexed row number from scratch. */
+        number = row_num + 1;
+        length = 0;
+
+        do {
+            row_name[length++] = (char) ('0' + number % 10);
+            number /= 10;
+        } while (number);
+
+        row_name[length] = '\0';
+        self->row_name_length = length;
+
+        /* Reverse the digits. */
+        for (pos = 0; pos < length / 2; pos++) {
+            char tmp = row_name[pos];
+            row_name[pos] = row_name[length - pos - 1];
+            row_name[length - pos - 1] = tmp;
+        }
+    }
+
+    self->row_name_num = row_num;
+}
+
+/*
+ * Get the A1 style reference for a cell in the cell writing loop. This is
+ * equivalent to lxw_rowcol_to_cell() but it uses the workbook table of
+ * column names and a cache of the current row number string.
+ */
+STATIC void
+_get_cell_reference(lxw_worksheet *self, char *range, lxw_row_t row_num,
+                    lxw_col_t col_num)
+{
+    const char *col_name;
+    uint8_t col_name_length;
+    char name[LXW_MAX_COL_NAME_LENGTH];
+
+    if (self->col_names) {
+        col_name = self->col_names[col_num].name;
+        col_name_length = self->col_names[col_num].length;
+    }
+    else {
+        /* Worksheets created outside a workbook don't have the table. */
+        lxw_col_to_name(name, col_num, LXW_FALSE);
+        col_name = name;
+        col_name_length = (uint8_t) strlen(name);
+    }
+
+    if (!self->row_name_length || row_num != self->row_name_num)
+        _set_row_name(self, row_num);
+
+    memcpy(range, col_name, col_name_length);
+    memcpy(range + col_name_length, self->row_name,
+           self->row_name_length + 1);
+}
+
 /*
  * Write out a generic worksheet cell.
  */
 STATIC void
-_write_cell(lxw_worksheet *self, lxw_cell *cell, lxw_format *row_format)
+_write_cell(lxw_worksheet *self, lxw_xml_buffer *buffer, lxw_cell *cell,
+            lxw_format *row_format)
 {
-    struct xml_attribute_list attributes;
-    struct xml_attribute *attribute;
+    lxw_attributes attributes;
     char range[LXW_MAX_CELL_NAME_LENGTH] = { 0 };
     lxw_row_t row_num = cell->row_num;
     lxw_col_t col_num = cell->col_num;
-    int32_t style_index = 0;
+    int32_t style_index;
 
-    lxw_rowcol_to_cell(range, row_num, col_num);
+    _get_cell_reference(self, range, row_num, col_num);
 
-    if (cell->format) {
-        style_index = lxw_format_get_xf_index(cell->format);
-    }
-    else if (row_format) {
-        style_index = lxw_format_get_xf_index(row_format);
-    }
-    else if (col_num < self->col_formats_max && self->col_formats[col_num]) {
-        style_index = lxw_format_get_xf_index(self->col_formats[col_num]);
-    }
+    style_index = _get_cell_style_index(self, cell, row_format);
 
     /* Unrolled optimization for most commonly written cell types. */
     if (cell->type == NUMBER_CELL) {
-        _write_number_cell(self, range, style_index, cell);
+        _write_number_cell(buffer, range, style_index, cell);
         return;
     }
 
     if (cell->type == STRING_CELL) {
-        _write_string_cell(self, range, style_index, cell);
+        _write_string_cell(self, buffer, range, style_index, cell);
         return;
     }
 
     if (cell->type == INLINE_STRING_CELL) {
-        _write_inline_string_cell(self, range, style_index, cell);
+        _write_inline_string_cell(buffer, range, style_index, cell);
         return;
     }
 
     if (cell->type == INLINE_RICH_STRING_CELL) {
-        _write_inline_rich_string_cell(self, range, style_index, cell);
+        _write_inline_rich_string_cell(buffer, range, style_index, cell);
         return;
     }
 
     /* For other cell types use the general functions. */
-    LXW_INIT_ATTRIBUTES();
-    LXW_PUSH_ATTRIBUTES_STR("r", range);
+    lxw_attributes_init(&attributes);
+    lxw_attributes_push_str(&attributes, "r", range);
 
     if (style_index)
-        LXW_PUSH_ATTRIBUTES_INT("s", style_index);
+        lxw_attributes_push_int(&attributes, "s", style_index);
 
     if (cell->type == FORMULA_CELL) {
         /* If user_data2 is set then the formula has a string result. */
-        if (cell->user_data2)
-            LXW_PUSH_ATTRIBUTES_STR("t", "str");
+        if (cell->extra->user_data2)
+            lxw_attributes_push_str(&attributes, "t", "str");
 
-        lxw_xml_start_tag(self->file, "c", &attributes);
+        lxw_xml_buffer_start_tag(buffer, "c", &attributes);
 
-        if (cell->user_data2)
-            _write_formula_str_cell(self, cell);
+        if (cell->extra->user_data2)
+            _write_formula_str_cell(buffer, cell);
         else
-            _write_formula_num_cell(self, cell);
+            _write_formula_num_cell(buffer, cell);
 
-        lxw_xml_end_tag(self->file, "c");
+        lxw_xml_buffer_end_tag(buffer, "c");
     }
     else if (cell->type == BLANK_CELL) {
         if (cell->format)
-            lxw_xml_empty_tag(self->file, "c", &attributes);
+            lxw_xml_buffer_empty_tag(buffer, "c", &attributes);
     }
     else if (cell->type == BOOLEAN_CELL) {
-        LXW_PUSH_ATTRIBUTES_STR("t", "b");
-        lxw_xml_start_tag(self->file, "c", &attributes);
-        _write_boolean_cell(self, cell);
-        lxw_xml_end_tag(self->file, "c");
+        lxw_attributes_push_str(&attributes, "t", "b");
+        lxw_xml_buffer_start_tag(buffer, "c", &attributes);
+        _write_boolean_cell(buffer, cell);
+        lxw_xml_buffer_end_tag(buffer, "c");
     }
     else if (cell->type == ARRAY_FORMULA_CELL) {
-        lxw_xml_start_tag(self->file, "c", &attributes);
-        _write_array_formula_num_cell(self, cell);
-        lxw_xml_end_tag(self->file, "c");
+        lxw_xml_buffer_start_tag(buffer, "c", &attributes);
+        _write_array_formula_num_cell(buffer, cell);
+        lxw_xml_buffer_end_tag(buffer, "c");
     }
     else if (cell->type == DYNAMIC_ARRAY_FORMULA_CELL) {
-        LXW_PUSH_ATTRIBUTES_STR("cm", "1");
-        lxw_xml_start_tag(self->file, "c", &attributes);
-        _write_array_formula_num_cell(self, cell);
-        lxw_xml_end_tag(self->file, "c");
+        lxw_attributes_push_str(&attributes, "cm", "1");
+        lxw_xml_buffer_start_tag(buffer, "c", &attributes);
+        _write_array_formula_num_cell(buffer, cell);
+        lxw_xml_buffer_end_tag(buffer, "c");
     }
     else if (cell->type == ERROR_CELL) {
-        LXW_PUSH_ATTRIBUTES_STR("t", "e");
-        LXW_PUSH_ATTRIBUTES_DBL("vm", cell->u.number);
-        lxw_xml_start_tag(self->file, "c", &attributes);
-        _write_error_cell(self);
-        lxw_xml_end_tag(self->file, "c");
+        lxw_attributes_push_str(&attributes, "t", "e");
+        lxw_attributes_push_dbl(&attributes, "vm", cell->u.number);
+        lxw_xml_buffer_start_tag(buffer, "c", &attributes);
+        _write_error_cell(buffer);
+        lxw_xml_buffer_end_tag(buffer, "c");
     }
+}
 
-    LXW_FREE_ATTRIBUTES();
+/*
+ * Get the buffer used to write the rows and cells to the worksheet file in
+ * large blocks. It is created on first use and kept between the passes over
+ * the constant_memory rows. If it can't be allocated the smaller local
+ * buffer is used instead.
+ */
+STATIC lxw_xml_buffer *
+_get_row_buffer(lxw_worksheet *self, lxw_xml_buffer *local_buffer)
+{
+    if (!self->row_buffer)
+        self->row_buffer = lxw_xml_buffer_new(self->file, LXW_ROW_BUFFER_SIZE);
+
+    if (self->row_buffer) {
+        self->row_buffer->file = self->file;
+        return self->row_buffer;
+    }
+
+    lxw_xml_buffer_init(local_buffer, self->file);
+    return local_buffer;
 }
 
 /*
@@ -4720,83 +5699,293 @@ STATIC void
 _worksheet_write_rows(lxw_worksheet *self)
 {
     lxw_row *row;
-    lxw_cell *cell;
+    lxw_col_t col;
     int32_t block_num = -1;
     char spans[LXW_MAX_CELL_RANGE_LENGTH] = { 0 };
+    lxw_xml_buffer local_buffer;
+    lxw_xml_buffer *buffer = _get_row_buffer(self, &local_buffer);
+
+    RB_FOREACH(row, lxw_table_rows, self->table) {
+
+        if (!row->num_cells) {
+            /* Row contains no cells but has height, format or other data. */
+
+            /* Write a default span for default rows. */
+            if (self->default_row_set)
+                _write_row(self, buffer, row, "1:1");
+            else
+                _write_row(self, buffer, row, NULL);
+        }
+        else {
+            /* Row and cell data. */
+            if ((int32_t) row->row_num / 16 > block_num)
+                _calculate_spans(row, spans, &block_num);
+
+            _write_row(self, buffer, row, spans);
+
+            if (row->data_changed) {
+                for (col = 0; col < row->num_cells; col++)
+                    _write_cell(self, buffer, row->cells[col], row->format);
+
+                lxw_xml_buffer_end_tag(buffer, "row");
+            }
+        }
+    }
+
+    /* The rows are only written once so release the buffer. */
+    lxw_xml_buffer_flush(buffer);
+    lxw_xml_buffer_free(self->row_buffer);
+    self->row_buffer = NULL;
+}
+
+/*
+ * Write out a constant_memory row, and its cells, and reset it for reuse by
+ * a later row. We don't write span data in the optimized case since it is
+ * optional.
+ */
+STATIC void
+_worksheet_write_optimized_row(lxw_worksheet *self, lxw_xml_buffer *buffer,
+                               lxw_row *row)
+{
+    lxw_col_t i;
+
+    /* skip row if it doesn't contain row formatting, cell data or a comment. */
+    if (!(row->row_changed || row->data_changed))
+        return;
+
+    /* Write the cells if the row contains data. */
+    if (!row->data_changed) {
+        /* Row data only. No cells. */
+        _write_row(self, buffer, row, NULL);
+    }
+    else {
+        /* Row and cell data. */
+        _write_row(self, buffer, row, NULL);
+
+        for (i = 0; i < row->num_cells; i++) {
+            _write_cell(self, buffer, row->cells[i], row->format);
+            _free_cell(self, row->cells[i]);
+        }
+
+        row->num_cells = 0;
+
+        lxw_xml_buffer_end_tag(buffer, "row");
+    }
+
+    /* Reset the row. */
+    row->height = LXW_DEF_ROW_HEIGHT;
+    row->format = NULL;
+    row->hidden = LXW_FALSE;
+    row->level = 0;
+    row->collapsed = LXW_FALSE;
+    row->data_changed = LXW_FALSE;
+    row->row_changed = LXW_FALSE;
+}
+
+/*
+ * Write the constant_memory rows before first_row, in row order, and move
+ * the start of the row window to first_row. The window is a ring indexed by
+ * row number so at most one pass over it is needed.
+ */
+STATIC void
+_worksheet_flush_optimized_rows(lxw_worksheet *self, lxw_row_t first_row)
+{
+    lxw_row_t row_num = self->optimize_first_row;
+    lxw_row_t num_rows = first_row - row_num;
+    lxw_row *row;
+    lxw_xml_buffer local_buffer;
+    lxw_xml_buffer *buffer = _get_row_buffer(self, &local_buffer);
+
+    if (num_rows > self->optimize_num_rows)
+        num_rows = self->optimize_num_rows;
+
+    while (num_rows--) {
+        row = &self->optimize_rows[row_num % self->optimize_num_rows];
+        _worksheet_write_optimized_row(self, buffer, row);
+        row_num++;
+    }
+
+    lxw_xml_buffer_flush(buffer);
+    self->optimize_first_row = first_row;
+
+    /* Compress the staged rows if the staging file is full. */
+    _worksheet_deflate_optimized_rows(self, Z_NO_FLUSH);
+}
+
+/*
+ * Write out all of the rows that are still in the constant_memory row ring
+ * when the worksheet is finished or closed.
+ */
+void
+lxw_worksheet_flush_rows(lxw_worksheet *self)
+{
+    _worksheet_flush_optimized_rows(self, self->optimize_first_row +
+                                    self->optimize_num_rows);
+}
+
+/*
+ * Compress any remaining constant_memory rows and end the compressed row
+ * stream. This is called by the packager before the worksheet is assembled.
+ */
+void
+lxw_worksheet_finish_optimized_rows(lxw_worksheet *self)
+{
+    _worksheet_deflate_optimized_rows(self, Z_SYNC_FLUSH);
+
+    if (self->optimize_stream) {
+        deflateEnd(self->optimize_stream);
+        free(self->optimize_stream);
+        self->optimize_stream = NULL;
+        fflush(self->optimize_deflated_file);
+
+        if (self->optimize_deflated_buffer) {
+            self->optimize_deflated_size = self->optimize_deflated_buffer_size;
+            self->optimize_deflated = LXW_TRUE;
+        }
+        else if (lxw_ftello(self->optimize_deflated_file,
+                            &self->optimize_deflated_size) == 0) {
+            self->optimize_deflated = LXW_TRUE;
+        }
+    }
+
+    self->optimize_deflate = LXW_FALSE;
+}
+
+/*
+ * Read a block of the compressed rows, starting at offset, from the worksheet
+ * temp file or, if the worksheet has been finished, from the workbook row
+ * store. Returns the number of bytes read.
+ */
+size_t
+lxw_worksheet_read_deflated_rows(lxw_worksheet *self, uint64_t offset,
+                                 char *data, size_t size)
+{
+    lxw_row_store *store = self->row_store;
+    size_t size_read;
+
+    if (offset >= self->optimize_deflated_size)
+        return 0;
+
+    if (size > self->optimize_deflated_size - offset)
+        size = (size_t) (self->optimize_deflated_size - offset);
+
+    if (self->optimize_deflated_file)
+        return _read_file_range(self->optimize_deflated_file,
+                                self->optimize_deflated_buffer, offset,
+                                data, size);
+
+    lxw_mutex_lock(store->mutex);
+    fflush(store->file);
+    size_read = _read_file_range(store->file, store->buffer,
+                                 self->optimize_store_offset + offset,
+                                 data, size);
+    lxw_mutex_unlock(store->mutex);
+
+    return size_read;
+}
+
+/*
+ * Finish writing the rows of a constant_memory worksheet. The remaining rows
+ * are compressed and moved to the workbook row store so that the worksheet
+ * temp files and row buffers can be released before the workbook is closed.
+ */
+lxw_error
+worksheet_finish(lxw_worksheet *self)
+{
+    lxw_row_store *store = self->row_store;
+    char buffer[LXW_BUFFER_SIZE];
+    uint64_t offset = 0;
+    uint64_t store_offset = 0;
+    uint64_t staged_size = 0;
+    uint16_t i;
+    size_t size_read;
+    lxw_error err = LXW_NO_ERROR;
+
+    if (!self->optimize || self->optimize_finished)
+        return LXW_NO_ERROR;
+
+    self->optimize_finished = LXW_TRUE;
+
+    /* Write the last row and compress any remaining rows. The rows are
+     * compressed even if the worksheet is stored uncompressed, since they
+     * are decompressed into the sheet file on close in that case. */
+    lxw_worksheet_flush_rows(self);
+
+    if (!self->optimize_stream)
+        self->optimize_deflate = LXW_TRUE;
+
+    lxw_worksheet_finish_optimized_rows(self);
+
+    /* The rows stay in the staging file if they couldn't be compressed. */
+    if (!self->optimize_deflated
+        && (lxw_ftello(self->optimize_tmpfile, &staged_size) != 0
+            || staged_size > 0))
+        return LXW_ERROR_CREATING_TMPFILE;
+
+    /* Release the staging file, the row buffers and the row cell vectors. */
+    fclose(self->optimize_tmpfile);
+    self->optimize_tmpfile = NULL;
+    self->file = NULL;
 
-    RB_FOREACH(row, lxw_table_rows, self->table) {
+    free(self->optimize_buffer);
+    self->optimize_buffer = NULL;
+    lxw_xml_buffer_free(self->row_buffer);
+    self->row_buffer = NULL;
 
-        if (RB_EMPTY(row->cells)) {
-            /* Row contains no cells but has height, format or other data. */
+    for (i = 0; i < self->optimize_num_rows; i++) {
+        free(self->optimize_rows[i].cells);
+        self->optimize_rows[i].cells = NULL;
+        self->optimize_rows[i].cells_size = 0;
+    }
 
-            /* Write a default span for default rows. */
-            if (self->default_row_set)
-                _write_row(self, row, "1:1");
-            else
-                _write_row(self, row, NULL);
-        }
-        else {
-            /* Row and cell data. */
-            if ((int32_t) row->row_num / 16 > block_num)
-                _calculate_spans(row, spans, &block_num);
+    if (!self->optimize_deflated || !store)
+        return LXW_NO_ERROR;
 
-            _write_row(self, row, spans);
+    /* Append the compressed rows to the row store. */
+    lxw_mutex_lock(store->mutex);
 
-            if (row->data_changed) {
-                RB_FOREACH(cell, lxw_table_cells, row->cells) {
-                    _write_cell(self, cell, row->format);
-                }
+    if (!store->file)
+        store->file = lxw_get_filehandle(&store->buffer, &store->buffer_size,
+                                         store->tmpdir);
 
-                lxw_xml_end_tag(self->file, "row");
+    if (store->file && lxw_fseeko(store->file, 0, SEEK_END) == 0
+        && lxw_ftello(store->file, &store_offset) == 0) {
+
+        size_read = lxw_worksheet_read_deflated_rows(self, offset, buffer,
+                                                     LXW_BUFFER_SIZE);
+        while (size_read) {
+            if (fwrite(buffer, 1, size_read, store->file) != size_read) {
+                err = LXW_ERROR_CREATING_TMPFILE;
+                break;
             }
+
+            offset += size_read;
+            size_read = lxw_worksheet_read_deflated_rows(self, offset, buffer,
+                                                         LXW_BUFFER_SIZE);
         }
+
+        fflush(store->file);
+    }
+    else {
+        err = LXW_ERROR_CREATING_TMPFILE;
     }
-}
 
-/*
- * Write out the worksheet data as a single row with cells. This method is
- * used when memory optimization is on. A single row is written and the data
- * array is reset. That way only one row of data is kept in memory at any one
- * time. We don't write span data in the optimized case since it is optional.
- */
-void
-lxw_worksheet_write_single_row(lxw_worksheet *self)
-{
-    lxw_row *row = self->optimize_row;
-    lxw_col_t col;
+    lxw_mutex_unlock(store->mutex);
 
-    /* skip row if it doesn't contain row formatting, cell data or a comment. */
-    if (!(row->row_changed || row->data_changed))
-        return;
+    /* The rows stay in the worksheet temp file if they couldn't be moved. */
+    if (err)
+        return err;
 
-    /* Write the cells if the row contains data. */
-    if (!row->data_changed) {
-        /* Row data only. No cells. */
-        _write_row(self, row, NULL);
-    }
-    else {
-        /* Row and cell data. */
-        _write_row(self, row, NULL);
+    self->optimize_store_offset = store_offset;
 
-        for (col = self->dim_colmin; col <= self->dim_colmax; col++) {
-            if (self->array[col]) {
-                _write_cell(self, self->array[col], row->format);
-                _free_cell(self->array[col]);
-                self->array[col] = NULL;
-            }
-        }
+    fclose(self->optimize_deflated_file);
+    self->optimize_deflated_file = NULL;
 
-        lxw_xml_end_tag(self->file, "row");
-    }
+    free(self->optimize_deflated_buffer);
+    self->optimize_deflated_buffer = NULL;
+    self->optimize_deflated_buffer_size = 0;
 
-    /* Reset the row. */
-    row->height = LXW_DEF_ROW_HEIGHT;
-    row->format = NULL;
-    row->hidden = LXW_FALSE;
-    row->level = 0;
-    row->collapsed = LXW_FALSE;
-    row->data_changed = LXW_FALSE;
-    row->row_changed = LXW_FALSE;
+    return LXW_NO_ERROR;
 }
 
 /* Process a header/footer image and store it in the correct slot. */
@@ -5534,6 +6723,7 @@ _worksheet_write_hyperlinks(lxw_worksheet *self)
 
     lxw_row *row;
     lxw_cell *link;
+    lxw_col_t col;
     lxw_rel_tuple *relationship;
 
     if (RB_EMPTY(self->hyperlinks))
@@ -5544,7 +6734,8 @@ _worksheet_write_hyperlinks(lxw_worksheet *self)
 
     RB_FOREACH(row, lxw_table_rows, self->hyperlinks) {
 
-        RB_FOREACH(link, lxw_table_cells, row->cells) {
+        for (col = 0; col < row->num_cells; col++) {
+            link = row->cells[col];
 
             if (link->type == HYPERLINK_URL
                 || link->type == HYPERLINK_EXTERNAL) {
@@ -5568,8 +6759,8 @@ _worksheet_write_hyperlinks(lxw_worksheet *self)
 
                 _worksheet_write_hyperlink_external(self, link->row_num,
                                                     link->col_num,
-                                                    link->user_data1,
-                                                    link->user_data2,
+                                                    link->extra->user_data1,
+                                                    link->extra->user_data2,
                                                     self->rel_count);
             }
 
@@ -5578,8 +6769,8 @@ _worksheet_write_hyperlinks(lxw_worksheet *self)
                 _worksheet_write_hyperlink_internal(self, link->row_num,
                                                     link->col_num,
                                                     link->u.string,
-                                                    link->user_data1,
-                                                    link->user_data2);
+                                                    link->extra->user_data1,
+                                                    link->extra->user_data2);
             }
 
         }
@@ -7898,6 +9089,76 @@ lxw_worksheet_assemble_xml_file(lxw_worksheet *self)
     lxw_xml_end_tag(self->file, "worksheet");
 }
 
+/*
+ * Assign XF indices to the formats used in the worksheet, in the same order
+ * that lxw_worksheet_assemble_xml_file() would assign them. This allows the
+ * worksheet XML to be assembled later, for example in a worker thread,
+ * without adding new formats to the shared workbook format table.
+ */
+void
+lxw_worksheet_prepare_xf_indices(lxw_worksheet *self)
+{
+    lxw_row *row;
+    lxw_col_t col;
+
+    /* Formats used in the <cols> element. */
+    if (self->col_size_changed) {
+        for (col = 0; col < self->col_options_max; col++) {
+            if (self->col_options[col] && self->col_options[col]->format)
+                lxw_format_get_xf_index(self->col_options[col]->format);
+        }
+    }
+
+    /* In constant_memory mode the rows have already been written. */
+    if (self->optimize)
+        return;
+
+    /* Formats used in the <row> and <c> elements. */
+    RB_FOREACH(row, lxw_table_rows, self->table) {
+        if (row->format)
+            lxw_format_get_xf_index(row->format);
+
+        if (!row->num_cells || !row->data_changed)
+            continue;
+
+        for (col = 0; col < row->num_cells; col++)
+            _get_cell_style_index(self, row->cells[col], row->format);
+    }
+}
+
+/*
+ * Merge the worksheet string table, if it has one, into the workbook SST
+ * and store the map from the worksheet string indices to the SST indices
+ * for use when the string cells are written.
+ */
+lxw_error
+lxw_worksheet_merge_sst(lxw_worksheet *self)
+{
+    lxw_sst *sst = self->sst;
+    struct sst_element *element;
+    uint32_t i;
+
+    if (!self->local_sst || self->sst_remap || !sst->unique_count)
+        return LXW_NO_ERROR;
+
+    self->sst_remap = calloc(sst->unique_count, sizeof(uint32_t));
+    RETURN_ON_MEM_ERROR(self->sst_remap, LXW_ERROR_MEMORY_MALLOC_FAILED);
+
+    /* Add the strings in the order they were first used in the worksheet. */
+    for (i = 0; i < sst->unique_count; i++) {
+        element = lxw_add_sst_string(self->workbook_sst,
+                                     sst->elements[i]->string,
+                                     sst->elements[i]->is_rich_string);
+        RETURN_ON_MEM_ERROR(element, LXW_ERROR_MEMORY_MALLOC_FAILED);
+
+        self->sst_remap[i] = element->index;
+    }
+
+    self->workbook_sst->string_count += sst->string_count;
+
+    return LXW_NO_ERROR;
+}
+
 /*****************************************************************************
  *
  * Public functions.
@@ -7919,7 +9180,7 @@ worksheet_write_number(lxw_worksheet *self,
     if (err)
         return err;
 
-    cell = _new_number_cell(row_num, col_num, value, format);
+    cell = _new_number_cell(self, row_num, col_num, value, format);
 
     _insert_cell(self, row_num, col_num, cell);
 
@@ -7936,9 +9197,6 @@ worksheet_write_string(lxw_worksheet *self,
                        lxw_format *format)
 {
     lxw_cell *cell;
-    int32_t string_id;
-    char *string_copy;
-    struct sst_element *sst_element;
     lxw_error err;
 
     if (!string || !*string) {
@@ -7954,32 +9212,223 @@ worksheet_write_string(lxw_worksheet *self,
     if (err)
         return err;
 
-    if (lxw_utf8_strlen(string) > LXW_STR_MAX)
+    /* A UTF-8 string can't have more chars than bytes so only count the
+     * chars in long strings. */
+    if (strlen(string) > LXW_STR_MAX
+        && lxw_utf8_strlen(string) > LXW_STR_MAX)
         return LXW_ERROR_MAX_STRING_LENGTH_EXCEEDED;
 
-    if (!self->optimize) {
-        /* Get the SST element and string id. */
-        sst_element = lxw_get_sst_index(self->sst, string, LXW_FALSE);
+    cell = _new_sst_or_inline_cell(self, row_num, col_num, string, format);
+    if (!cell)
+        return LXW_ERROR_SHARED_STRING_INDEX_NOT_FOUND;
 
-        if (!sst_element)
-            return LXW_ERROR_SHARED_STRING_INDEX_NOT_FOUND;
+    _insert_cell(self, row_num, col_num, cell);
 
-        string_id = sst_element->index;
-        cell = _new_string_cell(row_num, col_num, string_id,
-                                sst_element->string, format);
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Write a string from the shared string table, using its index, to a cell.
+ */
+lxw_error
+worksheet_write_shared_string(lxw_worksheet *self,
+                              lxw_row_t row_num,
+                              lxw_col_t col_num, uint32_t string_index,
+                              lxw_format *format)
+{
+    lxw_cell *cell;
+    const char *string;
+    uint8_t is_empty;
+    lxw_error err;
+
+    if (self->optimize && self->sst->max_strings) {
+        /* A bounded table reads the string into a buffer that another
+         * thread could overwrite, so only check that it isn't empty. */
+        err = lxw_check_sst_string(self->sst, string_index, &is_empty);
+        if (err)
+            return err;
+
+        if (is_empty)
+            return worksheet_write_string(self, row_num, col_num, "",
+                                          format);
     }
     else {
-        /* Look for and escape control chars in the string. */
-        if (lxw_has_control_characters(string)) {
-            string_copy = lxw_escape_control_characters(string);
+        string = lxw_get_sst_string(self->workbook_sst, string_index);
+        if (!string)
+            return LXW_ERROR_SHARED_STRING_INDEX_NOT_FOUND;
+
+        /* Handle empty strings, inline strings in constant_memory mode, and
+         * worksheet string tables in the same way as
+         * worksheet_write_string(). */
+        if (self->optimize || self->local_sst || !*string)
+            return worksheet_write_string(self, row_num, col_num, string,
+                                          format);
+    }
+
+    err = _check_dimensions(self, row_num, col_num, LXW_FALSE, LXW_FALSE);
+    if (err)
+        return err;
+
+    /* Count the use of the string in the SST. */
+    lxw_count_sst_string(self->sst);
+
+    cell = _new_string_cell(self, row_num, col_num, string_index, format);
+
+    _insert_cell(self, row_num, col_num, cell);
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Write a block of numbers, read from an array with the given strides, to a
+ * worksheet. The cells use either a single format or a format per column.
+ */
+STATIC lxw_error
+_write_number_block(lxw_worksheet *self, lxw_row_t first_row,
+                    lxw_col_t first_col, lxw_row_t num_rows,
+                    lxw_col_t num_cols, const double *numbers,
+                    size_t row_stride, size_t col_stride,
+                    lxw_format *format, lxw_format **formats)
+{
+    lxw_row *row;
+    lxw_cell *cell;
+    lxw_row_t row_num;
+    lxw_col_t col;
+    lxw_error err;
+
+    if (!numbers)
+        return LXW_ERROR_NULL_PARAMETER_IGNORED;
+
+    if (!num_rows || !num_cols)
+        return LXW_NO_ERROR;
+
+    err = _check_bulk_dimensions(self, first_row, first_col, num_rows,
+                                 num_cols);
+    if (err)
+        return err;
+
+    for (row_num = 0; row_num < num_rows; row_num++) {
+        row = _get_bulk_row(self, first_row + row_num, num_cols);
+        RETURN_ON_MEM_ERROR(row, LXW_ERROR_MEMORY_MALLOC_FAILED);
+
+        for (col = 0; col < num_cols; col++) {
+            if (formats)
+                format = formats[col];
+
+            cell = _new_number_cell(self, first_row + row_num,
+                                    first_col + col,
+                                    numbers[row_num * row_stride +
+                                            col * col_stride], format);
+            RETURN_ON_MEM_ERROR(cell, LXW_ERROR_MEMORY_MALLOC_FAILED);
+
+            _insert_cell_list(self, row, cell, first_col + col);
         }
-        else {
-            string_copy = lxw_strdup(string);
+    }
+
+    return LXW_NO_ERROR;
+}
+
+/*
+ * Write a row of numbers to consecutive cells.
+ */
+lxw_error
+worksheet_write_number_row(lxw_worksheet *self,
+                           lxw_row_t row_num,
+                           lxw_col_t first_col, const double *numbers,
+                           lxw_col_t num_cols, lxw_format *format)
+{
+    return _write_number_block(self, row_num, first_col, 1, num_cols,
+                               numbers, 0, 1, format, NULL);
+}
+
+/*
+ * Write a 2D array of numbers to a block of cells.
+ */
+lxw_error
+worksheet_write_number_array(lxw_worksheet *self,
+                             lxw_row_t first_row, lxw_col_t first_col,
+                             lxw_row_t num_rows, lxw_col_t num_cols,
+                             const double *numbers, size_t row_stride,
+                             size_t col_stride, lxw_format **formats)
+{
+    return _write_number_block(self, first_row, first_col, num_rows,
+                               num_cols, numbers, row_stride, col_stride,
+                               NULL, formats);
+}
+
+/*
+ * Write a row of strings to consecutive cells.
+ */
+lxw_error
+worksheet_write_string_row(lxw_worksheet *self,
+                           lxw_row_t row_num,
+                           lxw_col_t first_col, const char **strings,
+                           lxw_col_t num_cols, lxw_format *format)
+{
+    lxw_row *row;
+    lxw_cell *cell;
+    const char *string;
+    lxw_col_t col;
+    lxw_col_t min_col = 0;
+    lxw_col_t max_col = 0;
+    uint8_t has_cells = LXW_FALSE;
+    lxw_error err;
+
+    if (!strings)
+        return LXW_ERROR_NULL_PARAMETER_IGNORED;
+
+    if ((size_t) first_col + num_cols > LXW_COL_MAX)
+        return LXW_ERROR_WORKSHEET_INDEX_OUT_OF_RANGE;
+
+    /* Check the strings before writing any of them. NULL or empty strings
+     * are written as blank cells if there is a format, or are ignored, in
+     * the same way as worksheet_write_string(). */
+    for (col = 0; col < num_cols; col++) {
+        string = strings[col];
+
+        if (!string || !*string) {
+            if (!format)
+                continue;
+        }
+        else if (strlen(string) > LXW_STR_MAX
+                 && lxw_utf8_strlen(string) > LXW_STR_MAX) {
+            return LXW_ERROR_MAX_STRING_LENGTH_EXCEEDED;
         }
-        cell = _new_inline_string_cell(row_num, col_num, string_copy, format);
+
+        if (!has_cells)
+            min_col = col;
+
+        max_col = col;
+        has_cells = LXW_TRUE;
     }
 
-    _insert_cell(self, row_num, col_num, cell);
+    if (!has_cells)
+        return LXW_NO_ERROR;
+
+    err = _check_bulk_dimensions(self, row_num, first_col + min_col, 1,
+                                 max_col - min_col + 1);
+    if (err)
+        return err;
+
+    row = _get_bulk_row(self, row_num, max_col - min_col + 1);
+    RETURN_ON_MEM_ERROR(row, LXW_ERROR_MEMORY_MALLOC_FAILED);
+
+    for (col = min_col; col <= max_col; col++) {
+        string = strings[col];
+
+        if (string && *string)
+            cell = _new_sst_or_inline_cell(self, row_num, first_col + col,
+                                           string, format);
+        else if (format)
+            cell = _new_blank_cell(self, row_num, first_col + col, format);
+        else
+            continue;
+
+        if (!cell)
+            return LXW_ERROR_SHARED_STRING_INDEX_NOT_FOUND;
+
+        _insert_cell_list(self, row, cell, first_col + col);
+    }
 
     return LXW_NO_ERROR;
 }
@@ -8014,8 +9463,8 @@ worksheet_write_formula_num(lxw_worksheet *self,
     else
         formula_copy = lxw_strdup(formula);
 
-    cell = _new_formula_cell(row_num, col_num, formula_copy, format);
-    cell->formula_result = result;
+    cell = _new_formula_cell(self, row_num, col_num, formula_copy, format);
+    cell->extra->formula_result = result;
 
     _insert_cell(self, row_num, col_num, cell);
 
@@ -8052,8 +9501,8 @@ worksheet_write_formula_str(lxw_worksheet *self,
     else
         formula_copy = lxw_strdup(formula);
 
-    cell = _new_formula_cell(row_num, col_num, formula_copy, format);
-    cell->user_data2 = lxw_strdup(result);
+    cell = _new_formula_cell(self, row_num, col_num, formula_copy, format);
+    cell->extra->user_data2 = lxw_strdup(result);
 
     _insert_cell(self, row_num, col_num, cell);
 
@@ -8151,10 +9600,10 @@ _store_array_formula(lxw_worksheet *self,
     }
 
     /* Create a new array formula cell object. */
-    cell = _new_array_formula_cell(first_row, first_col,
+    cell = _new_array_formula_cell(self, first_row, first_col,
                                    formula_copy, range, format, is_dynamic);
 
-    cell->formula_result = result;
+    cell->extra->formula_result = result;
 
     _insert_cell(self, first_row, first_col, cell);
 
@@ -8288,7 +9737,7 @@ worksheet_write_blank(lxw_worksheet *self,
     if (err)
         return err;
 
-    cell = _new_blank_cell(row_num, col_num, format);
+    cell = _new_blank_cell(self, row_num, col_num, format);
 
     _insert_cell(self, row_num, col_num, cell);
 
@@ -8310,7 +9759,7 @@ worksheet_write_boolean(lxw_worksheet *self,
     if (err)
         return err;
 
-    cell = _new_boolean_cell(row_num, col_num, value, format);
+    cell = _new_boolean_cell(self, row_num, col_num, value, format);
 
     _insert_cell(self, row_num, col_num, cell);
 
@@ -8341,7 +9790,7 @@ worksheet_write_datetime(lxw_worksheet *self,
     excel_date =
         lxw_datetime_to_excel_date_with_epoch(datetime, self->use_1904_epoch);
 
-    cell = _new_number_cell(row_num, col_num, excel_date, format);
+    cell = _new_number_cell(self, row_num, col_num, excel_date, format);
 
     _insert_cell(self, row_num, col_num, cell);
 
@@ -8368,7 +9817,7 @@ worksheet_write_unixtime(lxw_worksheet *self,
     excel_date =
         lxw_unixtime_to_excel_date_with_epoch(unixtime, self->use_1904_epoch);
 
-    cell = _new_number_cell(row_num, col_num, excel_date, format);
+    cell = _new_number_cell(self, row_num, col_num, excel_date, format);
 
     _insert_cell(self, row_num, col_num, cell);
 
@@ -8554,7 +10003,7 @@ worksheet_write_url_opt(lxw_worksheet *self,
     /* Reset default error condition. */
     err = LXW_ERROR_MEMORY_MALLOC_FAILED;
 
-    link = _new_hyperlink_cell(row_num, col_num, link_type, url_copy,
+    link = _new_hyperlink_cell(self, row_num, col_num, link_type, url_copy,
                                url_string, tooltip_copy);
     GOTO_LABEL_ON_MEM_ERROR(link, mem_error);
 
@@ -8708,8 +10157,7 @@ worksheet_write_rich_string(lxw_worksheet *self,
             return LXW_ERROR_SHARED_STRING_INDEX_NOT_FOUND;
 
         string_id = sst_element->index;
-        cell = _new_string_cell(row_num, col_num, string_id,
-                                sst_element->string, format);
+        cell = _new_string_cell(self, row_num, col_num, string_id, format);
     }
     else {
         /* Look for and escape control chars in the string. */
@@ -8720,7 +10168,7 @@ worksheet_write_rich_string(lxw_worksheet *self,
         else {
             string_copy = rich_string;
         }
-        cell = _new_inline_rich_string_cell(row_num, col_num, string_copy,
+        cell = _new_inline_rich_string_cell(self, row_num, col_num, string_copy,
                                             format);
     }
 
@@ -8770,7 +10218,7 @@ worksheet_write_comment_opt(lxw_worksheet *self,
     comment->row = row_num;
     comment->col = col_num;
 
-    cell = _new_comment_cell(row_num, col_num, comment);
+    cell = _new_comment_cell(self, row_num, col_num, comment);
     GOTO_LABEL_ON_MEM_ERROR(cell, mem_error);
 
     _insert_comment(self, row_num, col_num, cell);
@@ -8923,6 +10371,7 @@ worksheet_set_column_opt(lxw_worksheet *self,
 
     /* Store the column change to allow optimizations. */
     self->col_size_changed = LXW_TRUE;
+    self->col_geometry_valid = LXW_FALSE;
 
     return LXW_NO_ERROR;
 }
@@ -9022,6 +10471,11 @@ worksheet_set_row_opt(lxw_worksheet *self,
     /* Store the row properties. */
     row = _get_row(self, row_num);
 
+    /* The row geometry used for objects changes if the row was, or will be,
+     * stored in it. */
+    if (_row_in_geometry(self, row))
+        self->row_geometry_valid = LXW_FALSE;
+
     row->height = height;
     row->format = format;
     row->hidden = hidden;
@@ -9032,6 +10486,9 @@ worksheet_set_row_opt(lxw_worksheet *self,
     if (height != self->default_row_height)
         row->height_changed = LXW_TRUE;
 
+    if (_row_in_geometry(self, row))
+        self->row_geometry_valid = LXW_FALSE;
+
     return LXW_NO_ERROR;
 }
 
@@ -10464,6 +11921,7 @@ worksheet_set_default_row(lxw_worksheet *self, double height,
     if (height != self->default_row_height) {
         self->default_row_height = height;
         self->row_size_changed = LXW_TRUE;
+        self->row_geometry_valid = LXW_FALSE;
     }
 
     if (hide_unused_rows)
@@ -10577,7 +12035,6 @@ worksheet_insert_image_buffer_opt(lxw_worksheet *self,
                                   size_t image_size,
                                   lxw_image_options *user_options)
 {
-    FILE *image_stream;
     lxw_object_properties *object_props;
 
     if (!image_size) {
@@ -10586,31 +12043,9 @@ worksheet_insert_image_buffer_opt(lxw_worksheet *self,
         return LXW_ERROR_NULL_PARAMETER_IGNORED;
     }
 
-    /* Write the image buffer to a file (preferably in memory) so we can read
-     * the dimensions like an ordinary file. */
-#ifdef USE_FMEMOPEN
-    image_stream = fmemopen((void *) image_buffer, image_size, "rb");
-
-    if (!image_stream)
-        return LXW_ERROR_CREATING_TMPFILE;
-#else
-    image_stream = lxw_tmpfile(self->tmpdir);
-
-    if (!image_stream)
-        return LXW_ERROR_CREATING_TMPFILE;
-
-    if (fwrite(image_buffer, 1, image_size, image_stream) != image_size) {
-        fclose(image_stream);
-        return LXW_ERROR_CREATING_TMPFILE;
-    }
-
-    rewind(image_stream);
-#endif
-
     /* Create a new object to hold the image properties. */
     object_props = calloc(1, sizeof(lxw_object_properties));
     if (!object_props) {
-        fclose(image_stream);
         return LXW_ERROR_MEMORY_MALLOC_FAILED;
     }
 
@@ -10618,7 +12053,6 @@ worksheet_insert_image_buffer_opt(lxw_worksheet *self,
     object_props->image_buffer = calloc(1, image_size);
     if (!object_props->image_buffer) {
         _free_object_properties(object_props);
-        fclose(image_stream);
         return LXW_ERROR_MEMORY_MALLOC_FAILED;
     }
     else {
@@ -10641,7 +12075,6 @@ worksheet_insert_image_buffer_opt(lxw_worksheet *self,
 
     /* Copy other options or set defaults. */
     object_props->filename = lxw_strdup("image_buffer");
-    object_props->stream = image_stream;
     object_props->row = row_num;
     object_props->col = col_num;
 
@@ -10653,12 +12086,10 @@ worksheet_insert_image_buffer_opt(lxw_worksheet *self,
 
     if (_get_image_properties(object_props) == LXW_NO_ERROR) {
         STAILQ_INSERT_TAIL(self->image_props, object_props, list_pointers);
-        fclose(image_stream);
         return LXW_NO_ERROR;
     }
     else {
         _free_object_properties(object_props);
-        fclose(image_stream);
         return LXW_ERROR_IMAGE_DIMENSIONS;
     }
 }
@@ -10797,7 +12228,6 @@ worksheet_embed_image_buffer_opt(lxw_worksheet *self,
                                  size_t image_size,
                                  lxw_image_options *user_options)
 {
-    FILE *image_stream;
     lxw_object_properties *object_props;
     lxw_error err;
 
@@ -10807,28 +12237,6 @@ worksheet_embed_image_buffer_opt(lxw_worksheet *self,
         return LXW_ERROR_NULL_PARAMETER_IGNORED;
     }
 
-    /* Write the image buffer to a file (preferably in memory) so we can read
-     * the dimensions like an ordinary file. For embedded images we really only
-     * need the image type. */
-#ifdef USE_FMEMOPEN
-    image_stream = fmemopen((void *) image_buffer, image_size, "rb");
-
-    if (!image_stream)
-        return LXW_ERROR_CREATING_TMPFILE;
-#else
-    image_stream = lxw_tmpfile(self->tmpdir);
-
-    if (!image_stream)
-        return LXW_ERROR_CREATING_TMPFILE;
-
-    if (fwrite(image_buffer, 1, image_size, image_stream) != image_size) {
-        fclose(image_stream);
-        return LXW_ERROR_CREATING_TMPFILE;
-    }
-
-    rewind(image_stream);
-#endif
-
     /* Check and store the cell dimensions. */
     err = _check_dimensions(self, row_num, col_num, LXW_FALSE, LXW_FALSE);
     if (err)
@@ -10837,7 +12245,6 @@ worksheet_embed_image_buffer_opt(lxw_worksheet *self,
     /* Create a new object to hold the image properties. */
     object_props = calloc(1, sizeof(lxw_object_properties));
     if (!object_props) {
-        fclose(image_stream);
         return LXW_ERROR_MEMORY_MALLOC_FAILED;
     }
 
@@ -10845,7 +12252,6 @@ worksheet_embed_image_buffer_opt(lxw_worksheet *self,
     object_props->image_buffer = calloc(1, image_size);
     if (!object_props->image_buffer) {
         _free_object_properties(object_props);
-        fclose(image_stream);
         return LXW_ERROR_MEMORY_MALLOC_FAILED;
     }
     else {
@@ -10872,7 +12278,6 @@ worksheet_embed_image_buffer_opt(lxw_worksheet *self,
                                       object_props->format);
             if (err) {
                 _free_object_properties(object_props);
-                fclose(image_stream);
                 return err;
             }
 
@@ -10886,7 +12291,6 @@ worksheet_embed_image_buffer_opt(lxw_worksheet *self,
 
     /* Copy other options or set defaults. */
     object_props->filename = lxw_strdup("image_buffer");
-    object_props->stream = image_stream;
     object_props->row = row_num;
     object_props->col = col_num;
 
@@ -10899,13 +12303,11 @@ worksheet_embed_image_buffer_opt(lxw_worksheet *self,
     if (_get_image_properties(object_props) == LXW_NO_ERROR) {
         STAILQ_INSERT_TAIL(self->embedded_image_props, object_props,
                            list_pointers);
-        fclose(image_stream);
 
         return LXW_NO_ERROR;
     }
     else {
         _free_object_properties(object_props);
-        fclose(image_stream);
         return LXW_ERROR_IMAGE_DIMENSIONS;
     }
 }
@@ -10982,7 +12384,6 @@ worksheet_set_background_buffer(lxw_worksheet *self,
                                 const unsigned char *image_buffer,
                                 size_t image_size)
 {
-    FILE *image_stream;
     lxw_object_properties *object_props;
 
     if (!image_size) {
@@ -10990,31 +12391,9 @@ worksheet_set_background_buffer(lxw_worksheet *self,
         return LXW_ERROR_NULL_PARAMETER_IGNORED;
     }
 
-    /* Write the image buffer to a file (preferably in memory) so we can read
-     * the dimensions like an ordinary file. */
-#ifdef USE_FMEMOPEN
-    image_stream = fmemopen((void *) image_buffer, image_size, "rb");
-
-    if (!image_stream)
-        return LXW_ERROR_CREATING_TMPFILE;
-#else
-    image_stream = lxw_tmpfile(self->tmpdir);
-
-    if (!image_stream)
-        return LXW_ERROR_CREATING_TMPFILE;
-
-    if (fwrite(image_buffer, 1, image_size, image_stream) != image_size) {
-        fclose(image_stream);
-        return LXW_ERROR_CREATING_TMPFILE;
-    }
-
-    rewind(image_stream);
-#endif
-
     /* Create a new object to hold the image properties. */
     object_props = calloc(1, sizeof(lxw_object_properties));
     if (!object_props) {
-        fclose(image_stream);
         return LXW_ERROR_MEMORY_MALLOC_FAILED;
     }
 
@@ -11022,7 +12401,6 @@ worksheet_set_background_buffer(lxw_worksheet *self,
     object_props->image_buffer = calloc(1, image_size);
     if (!object_props->image_buffer) {
         _free_object_properties(object_props);
-        fclose(image_stream);
         return LXW_ERROR_MEMORY_MALLOC_FAILED;
     }
     else {
@@ -11033,19 +12411,16 @@ worksheet_set_background_buffer(lxw_worksheet *self,
 
     /* Copy other options or set defaults. */
     object_props->filename = lxw_strdup("image_buffer");
-    object_props->stream = image_stream;
     object_props->is_background = LXW_TRUE;
 
     if (_get_image_properties(object_props) == LXW_NO_ERROR) {
         _free_object_properties(self->background_image);
         self->background_image = object_props;
         self->has_background_image = LXW_TRUE;
-        fclose(image_stream);
         return LXW_NO_ERROR;
     }
     else {
         _free_object_properties(object_props);
-        fclose(image_stream);
         return LXW_ERROR_IMAGE_DIMENSIONS;
     }
 }
@@ -11766,7 +13141,7 @@ worksheet_set_error_cell(lxw_worksheet *self,
     lxw_col_t col_num = object_props->col;
 
     lxw_cell *cell =
-        _new_error_cell(row_num, col_num, ref_id, object_props->format);
+        _new_error_cell(self, row_num, col_num, ref_id, object_props->format);
     _insert_cell(self, row_num, col_num, cell);
 
 }
@@ -20,184 +20,481 @@
 #define LXW_QUOT "&quot;"
 #define LXW_NL   "&#xA;"
 
-/* Defines. */
-#define LXW_MAX_ENCODED_ATTRIBUTE_LENGTH (LXW_MAX_ATTRIBUTE_LENGTH*6)
-
 /* Forward declarations. */
-STATIC char *_escape_attributes(struct xml_attribute *attribute);
-
 char *lxw_escape_data(const char *data);
 
-STATIC void _fprint_escaped_attributes(FILE *xmlfile,
-                                       struct xml_attribute_list *attributes);
+STATIC void _append_attributes(lxw_xml_buffer *buffer,
+                               struct xml_attribute_list *attributes,
+                               uint8_t escape);
 
-STATIC void _fprint_escaped_data(FILE *xmlfile, const char *data);
+/*****************************************************************************
+ *
+ * XML buffer functions.
+ *
+ ****************************************************************************/
 
 /*
- * Write the XML declaration.
+ * Initialize an XML buffer that writes to the given file.
  */
 void
-lxw_xml_declaration(FILE *xmlfile)
+lxw_xml_buffer_init(lxw_xml_buffer *buffer, FILE *file)
 {
-    fprintf(xmlfile, "<?xml version=\"1.0\" "
-            "encoding=\"UTF-8\" standalone=\"yes\"?>\n");
+    buffer->file = file;
+    buffer->data = buffer->local_data;
+    buffer->length = 0;
+    buffer->size = LXW_XML_BUFFER_SIZE;
 }
 
 /*
- * Write an XML start tag with optional attributes.
+ * Create an XML buffer with an allocated block of the given size, for writing
+ * a large number of elements such as the worksheet rows and cells.
  */
-void
-lxw_xml_start_tag(FILE *xmlfile,
-                  const char *tag, struct xml_attribute_list *attributes)
+lxw_xml_buffer *
+lxw_xml_buffer_new(FILE *file, size_t size)
 {
-    fprintf(xmlfile, "<%s", tag);
+    lxw_xml_buffer *buffer = calloc(1, sizeof(lxw_xml_buffer));
+    RETURN_ON_MEM_ERROR(buffer, NULL);
+
+    buffer->data = malloc(size);
+    if (!buffer->data) {
+        LXW_MEM_ERROR();
+        free(buffer);
+        return NULL;
+    }
 
-    _fprint_escaped_attributes(xmlfile, attributes);
+    buffer->file = file;
+    buffer->size = size;
 
-    fprintf(xmlfile, ">");
+    return buffer;
 }
 
 /*
- * Write an XML start tag with optional, unencoded, attributes.
- * This is a minor speed optimization for elements that don't need encoding.
+ * Free an XML buffer created with lxw_xml_buffer_new(). Any buffered data
+ * should be flushed first.
  */
 void
-lxw_xml_start_tag_unencoded(FILE *xmlfile,
-                            const char *tag,
-                            struct xml_attribute_list *attributes)
+lxw_xml_buffer_free(lxw_xml_buffer *buffer)
 {
-    struct xml_attribute *attribute;
+    if (!buffer)
+        return;
 
-    fprintf(xmlfile, "<%s", tag);
-
-    if (attributes) {
-        STAILQ_FOREACH(attribute, attributes, list_entries) {
-            fprintf(xmlfile, " %s=\"%s\"", attribute->key, attribute->value);
-        }
-    }
+    if (buffer->data != buffer->local_data)
+        free(buffer->data);
 
-    fprintf(xmlfile, ">");
+    free(buffer);
 }
 
 /*
- * Write an XML end tag.
+ * Write any buffered data to the file.
  */
 void
-lxw_xml_end_tag(FILE *xmlfile, const char *tag)
+lxw_xml_buffer_flush(lxw_xml_buffer *buffer)
 {
-    fprintf(xmlfile, "</%s>", tag);
+    if (buffer->length) {
+        (void) fwrite(buffer->data, 1, buffer->length, buffer->file);
+        buffer->length = 0;
+    }
 }
 
 /*
- * Write an empty XML tag with optional attributes.
+ * Append data to the buffer, flushing it to the file if it is full. Data
+ * that is larger than the buffer is written directly.
  */
 void
-lxw_xml_empty_tag(FILE *xmlfile,
-                  const char *tag, struct xml_attribute_list *attributes)
+lxw_xml_buffer_append(lxw_xml_buffer *buffer, const char *data,
+                      size_t length)
 {
-    fprintf(xmlfile, "<%s", tag);
+    if (buffer->length + length > buffer->size) {
+        lxw_xml_buffer_flush(buffer);
 
-    _fprint_escaped_attributes(xmlfile, attributes);
+        if (length > buffer->size) {
+            (void) fwrite(data, 1, length, buffer->file);
+            return;
+        }
+    }
 
-    fprintf(xmlfile, "/>");
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
 }
 
 /*
- * Write an XML start tag with optional, unencoded, attributes.
- * This is a minor speed optimization for elements that don't need encoding.
+ * Append a string to the buffer.
  */
 void
-lxw_xml_empty_tag_unencoded(FILE *xmlfile,
-                            const char *tag,
-                            struct xml_attribute_list *attributes)
+lxw_xml_buffer_append_str(lxw_xml_buffer *buffer, const char *string)
 {
-    struct xml_attribute *attribute;
-
-    fprintf(xmlfile, "<%s", tag);
-
-    if (attributes) {
-        STAILQ_FOREACH(attribute, attributes, list_entries) {
-            fprintf(xmlfile, " %s=\"%s\"", attribute->key, attribute->value);
-        }
-    }
-
-    fprintf(xmlfile, "/>");
+    lxw_xml_buffer_append(buffer, string, strlen(string));
 }
 
 /*
- * Write an XML element containing data with optional attributes.
+ * Append a signed integer to the buffer. This avoids the overhead of the
+ * printf() functions in the inner cell writing loops.
  */
 void
-lxw_xml_data_element(FILE *xmlfile,
-                     const char *tag,
-                     const char *data, struct xml_attribute_list *attributes)
+lxw_xml_buffer_append_int(lxw_xml_buffer *buffer, int32_t value)
 {
-    fprintf(xmlfile, "<%s", tag);
+    char digits[LXW_UINT32_T_LENGTH + 1];
+    char *p_digits = digits + sizeof(digits);
+    uint32_t number = (uint32_t) value;
 
-    _fprint_escaped_attributes(xmlfile, attributes);
+    if (value < 0)
+        number = 0U - number;
 
-    fprintf(xmlfile, ">");
+    do {
+        *--p_digits = (char) ('0' + number % 10);
+        number /= 10;
+    } while (number);
 
-    _fprint_escaped_data(xmlfile, data);
+    if (value < 0)
+        *--p_digits = '-';
 
-    fprintf(xmlfile, "</%s>", tag);
+    lxw_xml_buffer_append(buffer, p_digits,
+                          (size_t) (digits + sizeof(digits) - p_digits));
 }
 
 /*
- * Write an XML <si> element for rich strings, without encoding.
+ * Append a double to the buffer in the same format as lxw_sprintf_dbl().
  */
 void
-lxw_xml_rich_si_element(FILE *xmlfile, const char *string)
+lxw_xml_buffer_append_dbl(lxw_xml_buffer *buffer, double value)
 {
-    fprintf(xmlfile, "<si>%s</si>", string);
+    char data[LXW_ATTR_32];
+
+    lxw_sprintf_dbl(data, value);
+    lxw_xml_buffer_append_str(buffer, data);
 }
 
 /*
- * Escape XML characters in attributes.
+ * Append a string with the XML data characters &, < and > escaped. If
+ * escape_attribute is set the double quote and newline characters, which
+ * Excel only escapes in attributes, are also escaped.
  */
-STATIC char *
-_escape_attributes(struct xml_attribute *attribute)
+void
+lxw_xml_buffer_append_escaped(lxw_xml_buffer *buffer, const char *string,
+                              uint8_t escape_attribute)
 {
-    char *encoded = (char *) calloc(LXW_MAX_ENCODED_ATTRIBUTE_LENGTH, 1);
-    char *p_encoded = encoded;
-    char *p_attr = attribute->value;
+    const char *special = escape_attribute ? "&<>\"\n" : "&<>";
+    size_t length;
+
+    while (*string) {
+        /* Append the run of characters that don't need escaping. */
+        length = strcspn(string, special);
+        lxw_xml_buffer_append(buffer, string, length);
+        string += length;
 
-    while (*p_attr) {
-        switch (*p_attr) {
+        switch (*string) {
             case '&':
-                memcpy(p_encoded, LXW_AMP, sizeof(LXW_AMP) - 1);
-                p_encoded += sizeof(LXW_AMP) - 1;
+                LXW_XML_BUFFER_APPEND_LITERAL(buffer, LXW_AMP);
                 break;
             case '<':
-                memcpy(p_encoded, LXW_LT, sizeof(LXW_LT) - 1);
-                p_encoded += sizeof(LXW_LT) - 1;
+                LXW_XML_BUFFER_APPEND_LITERAL(buffer, LXW_LT);
                 break;
             case '>':
-                memcpy(p_encoded, LXW_GT, sizeof(LXW_GT) - 1);
-                p_encoded += sizeof(LXW_GT) - 1;
+                LXW_XML_BUFFER_APPEND_LITERAL(buffer, LXW_GT);
                 break;
             case '"':
-                memcpy(p_encoded, LXW_QUOT, sizeof(LXW_QUOT) - 1);
-                p_encoded += sizeof(LXW_QUOT) - 1;
+                LXW_XML_BUFFER_APPEND_LITERAL(buffer, LXW_QUOT);
                 break;
             case '\n':
-                memcpy(p_encoded, LXW_NL, sizeof(LXW_NL) - 1);
-                p_encoded += sizeof(LXW_NL) - 1;
+                LXW_XML_BUFFER_APPEND_LITERAL(buffer, LXW_NL);
                 break;
             default:
-                *p_encoded = *p_attr;
-                p_encoded++;
-                break;
+                /* End of string. */
+                return;
         }
-        p_attr++;
+        string++;
     }
+}
 
-    return encoded;
+/*
+ * Initialize an empty lxw_attributes array.
+ */
+void
+lxw_attributes_init(lxw_attributes *attributes)
+{
+    attributes->count = 0;
+}
+
+/*
+ * Add a string attribute. The value is escaped when it is written.
+ */
+void
+lxw_attributes_push_str(lxw_attributes *attributes, const char *key,
+                        const char *value)
+{
+    lxw_attribute *attribute;
+
+    if (attributes->count >= LXW_MAX_ATTRIBUTES)
+        return;
+
+    attribute = &attributes->list[attributes->count++];
+    attribute->key = key;
+    attribute->type = LXW_ATTRIBUTE_STR;
+    attribute->u.string = value;
+}
+
+/*
+ * Add an integer attribute.
+ */
+void
+lxw_attributes_push_int(lxw_attributes *attributes, const char *key,
+                        int32_t value)
+{
+    lxw_attribute *attribute;
+
+    if (attributes->count >= LXW_MAX_ATTRIBUTES)
+        return;
+
+    attribute = &attributes->list[attributes->count++];
+    attribute->key = key;
+    attribute->type = LXW_ATTRIBUTE_INT;
+    attribute->u.integer = value;
+}
+
+/*
+ * Add a double attribute.
+ */
+void
+lxw_attributes_push_dbl(lxw_attributes *attributes, const char *key,
+                        double value)
+{
+    lxw_attribute *attribute;
+
+    if (attributes->count >= LXW_MAX_ATTRIBUTES)
+        return;
+
+    attribute = &attributes->list[attributes->count++];
+    attribute->key = key;
+    attribute->type = LXW_ATTRIBUTE_DBL;
+    attribute->u.number = value;
+}
+
+/* Append a lxw_attributes array to the buffer. Numeric values don't need to
+ * be escaped and string values are only copied piecewise if the scan in
+ * lxw_xml_buffer_append_escaped() finds characters that need escaping. */
+STATIC void
+_append_attribute_array(lxw_xml_buffer *buffer, lxw_attributes *attributes)
+{
+    lxw_attribute *attribute;
+    uint8_t i;
+
+    if (!attributes)
+        return;
+
+    for (i = 0; i < attributes->count; i++) {
+        attribute = &attributes->list[i];
+
+        LXW_XML_BUFFER_APPEND_LITERAL(buffer, " ");
+        lxw_xml_buffer_append_str(buffer, attribute->key);
+        LXW_XML_BUFFER_APPEND_LITERAL(buffer, "=\"");
+
+        if (attribute->type == LXW_ATTRIBUTE_INT)
+            lxw_xml_buffer_append_int(buffer, attribute->u.integer);
+        else if (attribute->type == LXW_ATTRIBUTE_DBL)
+            lxw_xml_buffer_append_dbl(buffer, attribute->u.number);
+        else
+            lxw_xml_buffer_append_escaped(buffer, attribute->u.string,
+                                          LXW_TRUE);
+
+        LXW_XML_BUFFER_APPEND_LITERAL(buffer, "\"");
+    }
+}
+
+/*
+ * Append an XML start tag with optional attributes to the buffer.
+ */
+void
+lxw_xml_buffer_start_tag(lxw_xml_buffer *buffer, const char *tag,
+                         lxw_attributes *attributes)
+{
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "<");
+    lxw_xml_buffer_append_str(buffer, tag);
+    _append_attribute_array(buffer, attributes);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, ">");
+}
+
+/*
+ * Append an empty XML tag with optional attributes to the buffer.
+ */
+void
+lxw_xml_buffer_empty_tag(lxw_xml_buffer *buffer, const char *tag,
+                         lxw_attributes *attributes)
+{
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "<");
+    lxw_xml_buffer_append_str(buffer, tag);
+    _append_attribute_array(buffer, attributes);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "/>");
+}
+
+/*
+ * Append an XML end tag to the buffer.
+ */
+void
+lxw_xml_buffer_end_tag(lxw_xml_buffer *buffer, const char *tag)
+{
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "</");
+    lxw_xml_buffer_append_str(buffer, tag);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, ">");
+}
+
+/*
+ * Append an XML element containing data with optional attributes to the
+ * buffer.
+ */
+void
+lxw_xml_buffer_data_element(lxw_xml_buffer *buffer, const char *tag,
+                            const char *data, lxw_attributes *attributes)
+{
+    lxw_xml_buffer_start_tag(buffer, tag, attributes);
+    lxw_xml_buffer_append_escaped(buffer, data, LXW_FALSE);
+    lxw_xml_buffer_end_tag(buffer, tag);
+}
+
+/*****************************************************************************
+ *
+ * XML writing functions.
+ *
+ ****************************************************************************/
+
+/*
+ * Write the XML declaration.
+ */
+void
+lxw_xml_declaration(FILE *xmlfile)
+{
+    static const char declaration[] = "<?xml version=\"1.0\" "
+        "encoding=\"UTF-8\" standalone=\"yes\"?>\n";
+
+    (void) fwrite(declaration, 1, sizeof(declaration) - 1, xmlfile);
+}
+
+/*
+ * Write an XML start tag with optional attributes.
+ */
+void
+lxw_xml_start_tag(FILE *xmlfile,
+                  const char *tag, struct xml_attribute_list *attributes)
+{
+    lxw_xml_buffer buffer;
+
+    lxw_xml_buffer_init(&buffer, xmlfile);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "<");
+    lxw_xml_buffer_append_str(&buffer, tag);
+    _append_attributes(&buffer, attributes, LXW_TRUE);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, ">");
+    lxw_xml_buffer_flush(&buffer);
+}
+
+/*
+ * Write an XML start tag with optional, unencoded, attributes.
+ * This is a minor speed optimization for elements that don't need encoding.
+ */
+void
+lxw_xml_start_tag_unencoded(FILE *xmlfile,
+                            const char *tag,
+                            struct xml_attribute_list *attributes)
+{
+    lxw_xml_buffer buffer;
+
+    lxw_xml_buffer_init(&buffer, xmlfile);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "<");
+    lxw_xml_buffer_append_str(&buffer, tag);
+    _append_attributes(&buffer, attributes, LXW_FALSE);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, ">");
+    lxw_xml_buffer_flush(&buffer);
+}
+
+/*
+ * Write an XML end tag.
+ */
+void
+lxw_xml_end_tag(FILE *xmlfile, const char *tag)
+{
+    lxw_xml_buffer buffer;
+
+    lxw_xml_buffer_init(&buffer, xmlfile);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "</");
+    lxw_xml_buffer_append_str(&buffer, tag);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, ">");
+    lxw_xml_buffer_flush(&buffer);
+}
+
+/*
+ * Write an empty XML tag with optional attributes.
+ */
+void
+lxw_xml_empty_tag(FILE *xmlfile,
+                  const char *tag, struct xml_attribute_list *attributes)
+{
+    lxw_xml_buffer buffer;
+
+    lxw_xml_buffer_init(&buffer, xmlfile);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "<");
+    lxw_xml_buffer_append_str(&buffer, tag);
+    _append_attributes(&buffer, attributes, LXW_TRUE);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "/>");
+    lxw_xml_buffer_flush(&buffer);
+}
+
+/*
+ * Write an XML start tag with optional, unencoded, attributes.
+ * This is a minor speed optimization for elements that don't need encoding.
+ */
+void
+lxw_xml_empty_tag_unencoded(FILE *xmlfile,
+                            const char *tag,
+                            struct xml_attribute_list *attributes)
+{
+    lxw_xml_buffer buffer;
+
+    lxw_xml_buffer_init(&buffer, xmlfile);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "<");
+    lxw_xml_buffer_append_str(&buffer, tag);
+    _append_attributes(&buffer, attributes, LXW_FALSE);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "/>");
+    lxw_xml_buffer_flush(&buffer);
+}
+
+/*
+ * Write an XML element containing data with optional attributes.
+ */
+void
+lxw_xml_data_element(FILE *xmlfile,
+                     const char *tag,
+                     const char *data, struct xml_attribute_list *attributes)
+{
+    lxw_xml_buffer buffer;
+
+    lxw_xml_buffer_init(&buffer, xmlfile);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "<");
+    lxw_xml_buffer_append_str(&buffer, tag);
+    _append_attributes(&buffer, attributes, LXW_TRUE);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, ">");
+    lxw_xml_buffer_append_escaped(&buffer, data, LXW_FALSE);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "</");
+    lxw_xml_buffer_append_str(&buffer, tag);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, ">");
+    lxw_xml_buffer_flush(&buffer);
+}
+
+/*
+ * Write an XML <si> element for rich strings, without encoding.
+ */
+void
+lxw_xml_rich_si_element(FILE *xmlfile, const char *string)
+{
+    lxw_xml_buffer buffer;
+
+    lxw_xml_buffer_init(&buffer, xmlfile);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "<si>");
+    lxw_xml_buffer_append_str(&buffer, string);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "</si>");
+    lxw_xml_buffer_flush(&buffer);
 }
 
 /*
  * Escape XML characters in data sections of tags.
- * Note, this is different from _escape_attributes()
+ * Note, this is different from attribute escaping
  * in that double quotes are not escaped by Excel.
  */
 char *
@@ -368,47 +665,28 @@ lxw_escape_url_characters(const char *string, uint8_t escape_hash)
     return encoded;
 }
 
-/* Write out escaped attributes. */
+/* Append attributes to the buffer, optionally escaped. */
 STATIC void
-_fprint_escaped_attributes(FILE *xmlfile,
-                           struct xml_attribute_list *attributes)
+_append_attributes(lxw_xml_buffer *buffer,
+                   struct xml_attribute_list *attributes, uint8_t escape)
 {
     struct xml_attribute *attribute;
 
-    if (attributes) {
-        STAILQ_FOREACH(attribute, attributes, list_entries) {
-            fprintf(xmlfile, " %s=", attribute->key);
+    if (!attributes)
+        return;
 
-            if (!strpbrk(attribute->value, "&<>\"\n")) {
-                fprintf(xmlfile, "\"%s\"", attribute->value);
-            }
-            else {
-                char *encoded = _escape_attributes(attribute);
+    STAILQ_FOREACH(attribute, attributes, list_entries) {
+        LXW_XML_BUFFER_APPEND_LITERAL(buffer, " ");
+        lxw_xml_buffer_append_str(buffer, attribute->key);
+        LXW_XML_BUFFER_APPEND_LITERAL(buffer, "=\"");
 
-                if (encoded) {
-                    fprintf(xmlfile, "\"%s\"", encoded);
+        if (escape)
+            lxw_xml_buffer_append_escaped(buffer, attribute->value,
+                                          LXW_TRUE);
+        else
+            lxw_xml_buffer_append_str(buffer, attribute->value);
 
-                    free(encoded);
-                }
-            }
-        }
-    }
-}
-
-/* Write out escaped XML data. */
-STATIC void
-_fprint_escaped_data(FILE *xmlfile, const char *data)
-{
-    /* Escape the data section of the XML element. */
-    if (!strpbrk(data, "&<>")) {
-        fprintf(xmlfile, "%s", data);
-    }
-    else {
-        char *encoded = lxw_escape_data(data);
-        if (encoded) {
-            fprintf(xmlfile, "%s", encoded);
-            free(encoded);
-        }
+        LXW_XML_BUFFER_APPEND_LITERAL(buffer, "\"");
     }
 }
 
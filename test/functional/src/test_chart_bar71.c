@@ -0,0 +1,37 @@
+/*****************************************************************************
+ * Test cases for libxlsxwriter.
+ *
+ * Test to compare output against Excel files.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+#include "xlsxwriter.h"
+
+int main() {
+
+    lxw_workbook  *workbook  = workbook_new("test_chart_bar71.xlsx");
+    lxw_worksheet *worksheet = workbook_add_worksheet(workbook, NULL);
+    lxw_chart     *chart     = workbook_add_chart(workbook, LXW_CHART_BAR);
+
+    /* For testing, copy the randomly generated axis ids in the target file. */
+    chart->axis_id_1 = 64052224;
+    chart->axis_id_2 = 64055552;
+
+    /* Test writing the data from a column-major array. */
+    double data[3][5] = {
+        {1, 2,  3,  4,  5},
+        {2, 4,  6,  8,  10},
+        {3, 6,  9,  12, 15}
+    };
+
+    worksheet_write_number_array(worksheet, 0, 0, 5, 3, &data[0][0], 1, 5, NULL);
+
+    chart_add_series(chart, "=Sheet1!$A$1:$A$5", "=Sheet1!$B$1:$B$5");
+    chart_add_series(chart, "=Sheet1!$A$1:$A$5", "=Sheet1!$C$1:$C$5");
+
+    worksheet_insert_chart(worksheet, CELL("E9"), chart);
+
+    return workbook_close(workbook);
+}
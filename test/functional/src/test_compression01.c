@@ -0,0 +1,26 @@
+/*****************************************************************************
+ * Test cases for libxlsxwriter.
+ *
+ * Test case for storing the xlsx file parts without compression.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "xlsxwriter.h"
+
+int main() {
+
+    lxw_workbook_options options = {LXW_FALSE, NULL, LXW_FALSE, NULL, NULL, 0,
+                                    LXW_COMPRESSION_STORE,
+                                    LXW_COMPRESSION_STRATEGY_DEFAULT, 0, 0, 0};
+
+    lxw_workbook  *workbook  = workbook_new_opt("test_compression01.xlsx", &options);
+    lxw_worksheet *worksheet = workbook_add_worksheet(workbook, NULL);
+
+    worksheet_write_string(worksheet, 0, 0, "Hello", NULL);
+    worksheet_write_number(worksheet, 1, 0, 123,     NULL);
+
+    return workbook_close(workbook);
+}
@@ -0,0 +1,33 @@
+/*****************************************************************************
+ * Test cases for libxlsxwriter.
+ *
+ * Test case for setting the compression per part type.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "xlsxwriter.h"
+
+int main() {
+
+    lxw_workbook  *workbook  = workbook_new("test_compression02.xlsx");
+    lxw_worksheet *worksheet = workbook_add_worksheet(workbook, NULL);
+
+    workbook_set_compression(workbook, LXW_PART_WORKSHEETS,
+                             LXW_COMPRESSION_BEST,
+                             LXW_COMPRESSION_STRATEGY_FILTERED);
+
+    workbook_set_compression(workbook, LXW_PART_MEDIA,
+                             LXW_COMPRESSION_FASTEST,
+                             LXW_COMPRESSION_STRATEGY_HUFFMAN_ONLY);
+
+    workbook_set_compression(workbook, LXW_PART_OTHER,
+                             LXW_COMPRESSION_STORE,
+                             LXW_COMPRESSION_STRATEGY_DEFAULT);
+
+    worksheet_insert_image(worksheet, CELL("E9"), "images/red.png");
+
+    return workbook_close(workbook);
+}
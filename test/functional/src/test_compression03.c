@@ -0,0 +1,45 @@
+/*****************************************************************************
+ * Test cases for libxlsxwriter.
+ *
+ * Test case for stored worksheets with worker threads.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "xlsxwriter.h"
+
+int main() {
+
+    lxw_workbook_options options = {LXW_FALSE, NULL, LXW_FALSE, NULL, NULL, 2,
+                                    LXW_COMPRESSION_FASTEST,
+                                    LXW_COMPRESSION_STRATEGY_RLE, 0, 0, 0};
+
+    lxw_workbook  *workbook  = workbook_new_opt("test_compression03.xlsx", &options);
+    lxw_worksheet *worksheet1 = workbook_add_worksheet(workbook, NULL);
+    lxw_worksheet *worksheet2 = workbook_add_worksheet(workbook, "Data Sheet");
+    lxw_worksheet *worksheet3 = workbook_add_worksheet(workbook, NULL);
+
+    lxw_format *bold = workbook_add_format(workbook);
+    format_set_bold(bold);
+
+    workbook_set_compression(workbook, LXW_PART_WORKSHEETS,
+                             LXW_COMPRESSION_STORE,
+                             LXW_COMPRESSION_STRATEGY_DEFAULT);
+
+    worksheet_write_string(worksheet1, CELL("A1"), "Foo" , NULL);
+    worksheet_write_number(worksheet1, CELL("A2"), 123 , NULL);
+
+    worksheet_write_string(worksheet3, CELL("B2"), "Foo" , NULL);
+    worksheet_write_string(worksheet3, CELL("B3"), "Bar", bold);
+    worksheet_write_number(worksheet3, CELL("C4"), 234 , NULL);
+
+    worksheet_activate(worksheet2);
+
+    worksheet_select(worksheet2);
+    worksheet_select(worksheet3);
+    worksheet_activate(worksheet3);
+
+    return workbook_close(workbook);
+}
@@ -0,0 +1,65 @@
+/*****************************************************************************
+ * Test cases for libxlsxwriter.
+ *
+ * Test case for writing to worksheets from different threads.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "xlsxwriter.h"
+#include "xlsxwriter/thread.h"
+
+lxw_format *format;
+
+void write_worksheet1(void *arg) {
+    lxw_worksheet *worksheet = (lxw_worksheet *) arg;
+
+    worksheet_write_string(worksheet, 0, 0, "Foo", NULL);
+    worksheet_write_number(worksheet, 1, 0, 123, NULL);
+}
+
+void write_worksheet3(void *arg) {
+    lxw_worksheet *worksheet = (lxw_worksheet *) arg;
+
+    worksheet_write_string(worksheet, 1, 1, "Foo", NULL);
+    worksheet_write_string(worksheet, 2, 1, "Bar", format);
+    worksheet_write_number(worksheet, 3, 2, 234, NULL);
+}
+
+int main() {
+
+    lxw_workbook_options options = {LXW_FALSE, NULL, LXW_FALSE, NULL, NULL, 0,
+                                    0, 0, LXW_TRUE, 0, 0};
+
+    lxw_workbook  *workbook  = workbook_new_opt("test_concurrent01.xlsx", &options);
+    lxw_worksheet *worksheet1 = workbook_add_worksheet(workbook, NULL);
+    lxw_worksheet *worksheet2 = workbook_add_worksheet(workbook, "Data Sheet");
+    lxw_worksheet *worksheet3 = workbook_add_worksheet(workbook, NULL);
+
+    lxw_format    *unused1    = workbook_add_format(workbook);
+    lxw_format    *unused2    = workbook_add_format(workbook);
+    lxw_format    *unused3    = workbook_add_format(workbook);
+    lxw_thread    *thread1;
+    lxw_thread    *thread3;
+
+    format = workbook_add_format(workbook);
+
+    (void)worksheet2;
+    (void)unused1;
+    (void)unused2;
+    (void)unused3;
+
+    format_set_bold(format);
+
+    /* The strings are stored in the shared string table in worksheet order,
+     * independent of the order the threads write them. */
+    thread3 = lxw_thread_new(write_worksheet3, worksheet3);
+    thread1 = lxw_thread_new(write_worksheet1, worksheet1);
+
+    lxw_thread_join(thread3);
+    lxw_thread_join(thread1);
+
+    return workbook_close(workbook);
+}
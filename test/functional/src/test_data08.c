@@ -14,7 +14,7 @@
 int main() {
 
     /* Test that the module works if the locale is changed. */
-#ifdef USE_DTOA_LIBRARY
+#ifndef USE_STANDARD_DOUBLE
     setlocale(LC_NUMERIC, "de_DE");
 #endif
 
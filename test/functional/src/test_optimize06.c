@@ -12,7 +12,8 @@
 
 int main() {
 
-    lxw_workbook_options options = {LXW_TRUE, NULL, LXW_FALSE, NULL, NULL};
+    lxw_workbook_options options = {LXW_TRUE, NULL, LXW_FALSE, NULL, NULL, 0,
+                                    0, 0, 0, 0, 0};
 
     lxw_workbook  *workbook  = workbook_new_opt("test_optimize06.xlsx", &options);
 
@@ -0,0 +1,32 @@
+/*****************************************************************************
+ * Test cases for libxlsxwriter.
+ *
+ * Test case for writing data in optimization mode.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+#include "xlsxwriter.h"
+
+int main() {
+
+    lxw_workbook_options options = {LXW_TRUE, NULL, LXW_FALSE, NULL, NULL, 0,
+                                    0, 0, 0, 0, 0};
+
+    lxw_workbook  *workbook  = workbook_new_opt("test_optimize52.xlsx", &options);
+    lxw_worksheet *worksheet = workbook_add_worksheet(workbook, NULL);
+
+    /* Test the bulk write functions in constant_memory mode. */
+    const char *strings[] = {"Hello"};
+    const char *later[] = {NULL, "World"};
+    double numbers[] = {123};
+
+    worksheet_write_string_row(worksheet, 0, 0, strings, 1, NULL);
+    worksheet_write_number_array(worksheet, 1, 0, 1, 1, numbers, 1, 1, NULL);
+
+    /* G1 should be ignored since a later row has already been written. */
+    worksheet_write_string_row(worksheet, CELL("F1"), later, 2, NULL);
+
+    return workbook_close(workbook);
+}
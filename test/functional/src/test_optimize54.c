@@ -0,0 +1,27 @@
+/*****************************************************************************
+ * Test cases for libxlsxwriter.
+ *
+ * Test case for writing rows out of order in optimization mode.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+#include "xlsxwriter.h"
+
+int main() {
+
+    lxw_workbook_options options = {LXW_TRUE, NULL, LXW_FALSE, NULL, NULL, 0,
+                                    0, 0, 0, 0, 0};
+
+    /* Keep 2 rows in memory so that they can be written in any order. */
+    options.constant_memory_rows = 2;
+
+    lxw_workbook  *workbook  = workbook_new_opt("test_optimize54.xlsx", &options);
+    lxw_worksheet *worksheet = workbook_add_worksheet(workbook, NULL);
+
+    worksheet_write_number(worksheet, 1, 0, 123,     NULL);
+    worksheet_write_string(worksheet, 0, 0, "Hello", NULL);
+
+    return workbook_close(workbook);
+}
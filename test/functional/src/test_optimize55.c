@@ -0,0 +1,28 @@
+/*****************************************************************************
+ * Test cases for libxlsxwriter.
+ *
+ * Test case for writing shared strings in optimization mode.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "xlsxwriter.h"
+
+int main() {
+
+    lxw_workbook_options options = {LXW_TRUE, NULL, LXW_FALSE, NULL, NULL, 0,
+                                    0, 0, 0, 0, 0};
+
+    /* Use the shared string table with a single string in memory. */
+    options.constant_memory_strings = 1;
+
+    lxw_workbook  *workbook  = workbook_new_opt("test_optimize55.xlsx", &options);
+    lxw_worksheet *worksheet = workbook_add_worksheet(workbook, NULL);
+
+    worksheet_write_string(worksheet, 0, 0, "Hello", NULL);
+    worksheet_write_number(worksheet, 1, 0, 123,     NULL);
+
+    return workbook_close(workbook);
+}
@@ -17,7 +17,13 @@ int main() {
                                     ".",
                                     LXW_FALSE,
                                     &output_buffer,
-                                    &output_buffer_size};
+                                    &output_buffer_size,
+                                    0,
+                                    0,
+                                    0,
+                                    0,
+                                    0,
+                                    0};
 
     lxw_workbook  *workbook  = workbook_new_opt(NULL, &options);
     lxw_worksheet *worksheet = workbook_add_worksheet(workbook, NULL);
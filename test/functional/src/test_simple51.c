@@ -0,0 +1,27 @@
+/*****************************************************************************
+ * Test cases for libxlsxwriter.
+ *
+ * Simple test case to test writing strings by shared string index.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "xlsxwriter.h"
+
+int main() {
+
+    lxw_workbook  *workbook  = workbook_new("test_simple51.xlsx");
+    lxw_worksheet *worksheet = workbook_add_worksheet(workbook, NULL);
+
+    const char *strings[] = {"Hello"};
+    uint32_t indices[1];
+
+    workbook_add_shared_strings(workbook, strings, 1, indices);
+
+    worksheet_write_shared_string(worksheet, 0, 0, indices[0], NULL);
+    worksheet_write_number(worksheet, 1, 0, 123, NULL);
+
+    return workbook_close(workbook);
+}
@@ -0,0 +1,35 @@
+/*****************************************************************************
+ * Test cases for libxlsxwriter.
+ *
+ * Test to compare output against Excel files.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+#include "xlsxwriter.h"
+
+int main() {
+
+    lxw_workbook  *workbook  = workbook_new("test_table58.xlsx");
+    lxw_worksheet *worksheet = workbook_add_worksheet(workbook, NULL);
+
+    worksheet_set_column(worksheet, COLS("C:F"), 10.288, NULL);
+
+    /* Test writing the strings as a row. */
+    const char *headers[] = {"Column1", "Column2", "Column3", "Column4", "Total"};
+
+    worksheet_write_string_row(worksheet, CELL("A1"), headers, 5, NULL);
+
+    lxw_table_column col1 = {.total_string = "Total"};
+    lxw_table_column col2 = {0};
+    lxw_table_column col3 = {0};
+    lxw_table_column col4 = {.total_function = LXW_TABLE_FUNCTION_COUNT};
+    lxw_table_column *columns[] = {&col1, &col2, &col3, &col4, NULL};
+
+    lxw_table_options options = {.total_row = LXW_TRUE, .columns = columns};
+
+    worksheet_add_table(worksheet, RANGE("C3:F14"), &options);
+
+    return workbook_close(workbook);
+}
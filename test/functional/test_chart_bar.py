@@ -108,3 +108,6 @@ class TestCompareXLSXFiles(base_test_class.XLSXBaseTest):
 
     def test_chart_bar70(self):
         self.run_exe_test('test_chart_bar70', 'chart_bar20.xlsx')
+
+    def test_chart_bar71(self):
+        self.run_exe_test('test_chart_bar71', 'chart_bar01.xlsx')
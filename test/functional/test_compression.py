@@ -0,0 +1,24 @@
+###############################################################################
+#
+# Tests for libxlsxwriter.
+#
+# SPDX-License-Identifier: BSD-2-Clause
+# Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+#
+
+import base_test_class
+
+class TestCompareXLSXFiles(base_test_class.XLSXBaseTest):
+    """
+    Test file created with libxlsxwriter against a file created by Excel.
+
+    """
+
+    def test_compression01(self):
+        self.run_exe_test('test_compression01', 'simple01.xlsx')
+
+    def test_compression02(self):
+        self.run_exe_test('test_compression02', 'image01.xlsx')
+
+    def test_compression03(self):
+        self.run_exe_test('test_compression03', 'simple03.xlsx')
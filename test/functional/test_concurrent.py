@@ -0,0 +1,18 @@
+###############################################################################
+#
+# Tests for libxlsxwriter.
+#
+# SPDX-License-Identifier: BSD-2-Clause
+# Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+#
+
+import base_test_class
+
+class TestCompareXLSXFiles(base_test_class.XLSXBaseTest):
+    """
+    Test file created with libxlsxwriter against a file created by Excel.
+
+    """
+
+    def test_concurrent01(self):
+        self.run_exe_test('test_concurrent01', 'format01.xlsx')
@@ -32,6 +32,20 @@ class TestCompareXLSXFiles(base_test_class.XLSXBaseTest):
     def test_optimize08(self):
         self.run_exe_test('test_optimize08')
 
+    def test_optimize52(self):
+        self.run_exe_test('test_optimize52', 'optimize02.xlsx')
+
+    def test_optimize53(self):
+        self.run_exe_test('test_optimize53', 'optimize05.xlsx')
+
+    def test_optimize54(self):
+        self.run_exe_test('test_optimize54', 'optimize02.xlsx')
+
+    def test_optimize55(self):
+        # Row spans aren't written in constant_memory mode.
+        self.ignore_elements = {'xl/worksheets/sheet1.xml': ['<row']}
+        self.run_exe_test('test_optimize55', 'simple01.xlsx')
+
     # Skip some of the XlsxWriter tests until the required functionality is ported.
 
     def test_optimize13(self):
@@ -26,4 +26,8 @@ class TestCompareXLSXFiles(base_test_class.XLSXBaseTest):
     def test_simple04(self):
         self.run_exe_test('test_simple04')
 
+    # Test writing strings by shared string index.
+    def test_simple51(self):
+        self.run_exe_test('test_simple51', 'simple01.xlsx')
+
 
@@ -111,3 +111,9 @@ class TestCompareXLSXFiles(base_test_class.XLSXBaseTest):
 
     def test_table30(self):
         self.run_exe_test('test_table30')
+
+    def test_table58(self):
+        self.ignore_files = ['xl/calcChain.xml',
+                             '[Content_Types].xml',
+                             'xl/_rels/workbook.xml.rels']
+        self.run_exe_test('test_table58', 'table08.xlsx')
@@ -83,3 +83,71 @@ CTEST(sst, sst02) {
 
     lxw_sst_free(sst);
 }
+
+// Test that strings are found after the hash table has been resized.
+CTEST(sst, sst03) {
+
+    char string[32];
+    struct sst_element *element;
+    int i;
+
+    lxw_sst *sst = lxw_sst_new();
+
+    for (i = 0; i < 5000; i++) {
+        lxw_snprintf(string, sizeof(string), "string%d", i);
+        element = lxw_get_sst_index(sst, string, LXW_FALSE);
+        ASSERT_EQUAL(i, element->index);
+    }
+
+    for (i = 4999; i >= 0; i--) {
+        lxw_snprintf(string, sizeof(string), "string%d", i);
+        element = lxw_get_sst_index(sst, string, LXW_FALSE);
+        ASSERT_EQUAL(i, element->index);
+        ASSERT_STR(string, element->string);
+    }
+
+    // Test an empty string and strings with a common prefix.
+    element = lxw_get_sst_index(sst, "", LXW_FALSE);
+    ASSERT_EQUAL(5000, element->index);
+    element = lxw_get_sst_index(sst, "string1", LXW_FALSE);
+    ASSERT_EQUAL(1, element->index);
+    element = lxw_get_sst_index(sst, "", LXW_FALSE);
+    ASSERT_EQUAL(5000, element->index);
+
+    // Test getting strings by index.
+    ASSERT_STR("string0", lxw_get_sst_string(sst, 0));
+    ASSERT_STR("string4999", lxw_get_sst_string(sst, 4999));
+    ASSERT_STR("", lxw_get_sst_string(sst, 5000));
+    ASSERT_NULL(lxw_get_sst_string(sst, 5001));
+
+    ASSERT_EQUAL(10003, sst->string_count);
+    ASSERT_EQUAL(5001, sst->unique_count);
+
+    lxw_sst_free(sst);
+}
+
+// Test that adding strings doesn't increment the string count.
+CTEST(sst, add_sst_string) {
+
+    struct sst_element *element;
+
+    lxw_sst *sst = lxw_sst_new();
+
+    element = lxw_add_sst_string(sst, "neptune", LXW_FALSE);
+    ASSERT_EQUAL(0, element->index);
+    element = lxw_add_sst_string(sst, "mars", LXW_FALSE);
+    ASSERT_EQUAL(1, element->index);
+    element = lxw_add_sst_string(sst, "neptune", LXW_FALSE);
+    ASSERT_EQUAL(0, element->index);
+
+    ASSERT_EQUAL(0, sst->string_count);
+    ASSERT_EQUAL(2, sst->unique_count);
+
+    element = lxw_get_sst_index(sst, "mars", LXW_FALSE);
+    ASSERT_EQUAL(1, element->index);
+
+    ASSERT_EQUAL(1, sst->string_count);
+    ASSERT_EQUAL(2, sst->unique_count);
+
+    lxw_sst_free(sst);
+}
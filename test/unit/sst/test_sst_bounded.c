@@ -0,0 +1,150 @@
+/*
+ * Tests for the lib_xlsx_writer library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include <string.h>
+
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/shared_strings.h"
+
+// Test assembling a SharedStrings file from a bounded table.
+CTEST(sst, bounded01) {
+
+    char* got;
+    char exp[] =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+        "<sst xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\" count=\"7\" uniqueCount=\"3\">"
+          "<si>"
+            "<t>neptune</t>"
+          "</si>"
+          "<si>"
+            "<t>mars</t>"
+          "</si>"
+          "<si>"
+            "<t>venus</t>"
+          "</si>"
+        "</sst>";
+
+    uint32_t index;
+    FILE* testfile = lxw_tmpfile(NULL);
+
+    lxw_sst *sst = lxw_sst_new();
+    sst->file = testfile;
+
+    // Keep a single string in memory so that the others are spilled.
+    sst->max_strings = 1;
+
+    lxw_get_sst_string_index(sst, "neptune", &index);
+    ASSERT_EQUAL(0, index);
+    lxw_get_sst_string_index(sst, "mars", &index);
+    ASSERT_EQUAL(1, index);
+    lxw_get_sst_string_index(sst, "neptune", &index);
+    ASSERT_EQUAL(0, index);
+    lxw_get_sst_string_index(sst, "venus", &index);
+    ASSERT_EQUAL(2, index);
+    lxw_get_sst_string_index(sst, "mars", &index);
+    ASSERT_EQUAL(1, index);
+    lxw_get_sst_string_index(sst, "neptune", &index);
+    ASSERT_EQUAL(0, index);
+    lxw_get_sst_string_index(sst, "venus", &index);
+    ASSERT_EQUAL(2, index);
+
+    ASSERT_STR("mars", lxw_get_sst_string(sst, 1));
+
+    lxw_sst_assemble_xml_file(sst);
+
+    RUN_XLSX_STREQ_SHORT(exp, got);
+
+    lxw_sst_free(sst);
+}
+
+// Test that the indices of a bounded table are stable when its on-disk
+// index is resized.
+CTEST(sst, bounded02) {
+
+    char string[32];
+    uint32_t num_strings = 40000;
+    uint32_t index;
+    uint32_t i;
+    lxw_error err;
+
+    lxw_sst *sst = lxw_sst_new();
+    sst->max_strings = 100;
+
+    for (i = 0; i < num_strings; i++) {
+        lxw_snprintf(string, sizeof(string), "string %u", i);
+        err = lxw_get_sst_string_index(sst, string, &index);
+        ASSERT_EQUAL(LXW_NO_ERROR, err);
+        ASSERT_EQUAL(i, index);
+    }
+
+    for (i = 0; i < num_strings; i += 7) {
+        lxw_snprintf(string, sizeof(string), "string %u", i);
+        err = lxw_get_sst_string_index(sst, string, &index);
+        ASSERT_EQUAL(LXW_NO_ERROR, err);
+        ASSERT_EQUAL(i, index);
+        ASSERT_STR(string, lxw_get_sst_string(sst, i));
+    }
+
+    ASSERT_EQUAL(num_strings, sst->unique_count);
+
+    lxw_sst_free(sst);
+}
+
+// Check if a string is in the in-memory part of a bounded table.
+static int _sst_in_memory(lxw_sst *sst, const char *string)
+{
+    uint32_t i;
+
+    for (i = 0; i < sst->num_elements; i++) {
+        if (strcmp(sst->elements[i]->string, string) == 0)
+            return 1;
+    }
+
+    return 0;
+}
+
+// Test that frequently repeated strings stay in memory, with a skewed
+// distribution of a few repeated strings among many unique strings.
+CTEST(sst, bounded03) {
+
+    char string[32];
+    uint32_t num_hot = 10;
+    uint32_t num_cold = 20000;
+    uint32_t num_misses = 0;
+    uint32_t index;
+    uint32_t i;
+    lxw_error err;
+
+    lxw_sst *sst = lxw_sst_new();
+    sst->max_strings = 100;
+
+    for (i = 0; i < num_cold; i++) {
+        lxw_snprintf(string, sizeof(string), "cold %u", i);
+        err = lxw_get_sst_string_index(sst, string, &index);
+        ASSERT_EQUAL(LXW_NO_ERROR, err);
+
+        lxw_snprintf(string, sizeof(string), "hot %u", i % num_hot);
+        if (!_sst_in_memory(sst, string))
+            num_misses++;
+
+        err = lxw_get_sst_string_index(sst, string, &index);
+        ASSERT_EQUAL(LXW_NO_ERROR, err);
+        ASSERT_STR(string, lxw_get_sst_string(sst, index));
+    }
+
+    // Only the first use of each string, and the first spill before it is
+    // found again, should miss the in-memory table.
+    ASSERT_TRUE(num_misses <= 2 * num_hot);
+
+    ASSERT_EQUAL(num_cold + num_hot, sst->unique_count);
+    ASSERT_TRUE(sst->num_elements <= sst->max_strings);
+
+    lxw_sst_free(sst);
+}
@@ -0,0 +1,54 @@
+/*
+ * Tests for the libxlsxwriter library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include <string.h>
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/utility.h"
+
+// Test the 128 bit digest used to find duplicate images.
+CTEST(utility, lxw_hash_digest) {
+
+    const char *data = "The quick brown fox jumps over the lazy dog";
+    uint8_t digest1[LXW_IMAGE_DIGEST_SIZE];
+    uint8_t digest2[LXW_IMAGE_DIGEST_SIZE];
+    size_t i;
+
+    // Check all of the tail lengths against a single byte change.
+    for (i = 1; i <= 40; i++) {
+        char copy[40];
+
+        memcpy(copy, data, i);
+        lxw_hash_digest(copy, i, digest1);
+        lxw_hash_digest(data, i, digest2);
+        ASSERT_DATA(digest1, LXW_IMAGE_DIGEST_SIZE, digest2,
+                    LXW_IMAGE_DIGEST_SIZE);
+
+        copy[i - 1] ^= 1;
+        lxw_hash_digest(copy, i, digest1);
+        ASSERT_TRUE(memcmp(digest1, digest2, LXW_IMAGE_DIGEST_SIZE) != 0);
+
+        lxw_hash_digest(data, i + 1, digest1);
+        ASSERT_TRUE(memcmp(digest1, digest2, LXW_IMAGE_DIGEST_SIZE) != 0);
+    }
+
+#ifndef LXW_BIG_ENDIAN
+    {
+        // The MurmurHash3 x64 128 bit reference value.
+        uint8_t expected[LXW_IMAGE_DIGEST_SIZE] = {
+            0x6c, 0x1b, 0x07, 0xbc, 0x7b, 0xbc, 0x4b, 0xe3,
+            0x47, 0x93, 0x9a, 0xc4, 0xa9, 0x3c, 0x43, 0x7a
+        };
+
+        lxw_hash_digest(data, strlen(data), digest1);
+        ASSERT_DATA(expected, LXW_IMAGE_DIGEST_SIZE, digest1,
+                    LXW_IMAGE_DIGEST_SIZE);
+    }
+#endif
+}
@@ -0,0 +1,73 @@
+/*
+ * Tests for the lib_xlsx_writer library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include <string.h>
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/hash_table.h"
+
+// Test that the hash table grows and preserves the insertion order.
+CTEST(hash_table, resize) {
+
+    lxw_hash_element *element;
+    uint32_t keys[1000];
+    uint32_t key;
+    uint32_t i;
+
+    lxw_hash_table *hash_table = lxw_hash_new(128, 0, 0);
+    ASSERT_EQUAL(128, hash_table->num_buckets);
+
+    for (i = 0; i < 1000; i++) {
+        keys[i] = i * 7919;
+        element = lxw_insert_hash_element(hash_table, &keys[i], &keys[i],
+                                          sizeof(uint32_t));
+        ASSERT_NOT_NULL(element);
+    }
+
+    ASSERT_EQUAL(1000, hash_table->unique_count);
+    ASSERT_EQUAL(2048, hash_table->num_buckets);
+
+    for (i = 0; i < 1000; i++) {
+        key = i * 7919;
+        element = lxw_hash_key_exists(hash_table, &key, sizeof(uint32_t));
+        ASSERT_NOT_NULL(element);
+        ASSERT_TRUE(element->value == &keys[i]);
+    }
+
+    key = 1;
+    ASSERT_NULL(lxw_hash_key_exists(hash_table, &key, sizeof(uint32_t)));
+
+    i = 0;
+    LXW_FOREACH_ORDERED(element, hash_table) {
+        ASSERT_TRUE(element->key == &keys[i]);
+        i++;
+    }
+    ASSERT_EQUAL(1000, i);
+
+    // Inserting an existing key updates the value.
+    key = 7919;
+    element = lxw_insert_hash_element(hash_table, &key, &keys[0],
+                                      sizeof(uint32_t));
+    ASSERT_TRUE(element->key == &keys[1]);
+    ASSERT_TRUE(element->value == &keys[0]);
+    ASSERT_EQUAL(1000, hash_table->unique_count);
+
+    lxw_hash_free(hash_table);
+}
+
+// Test hashing keys that aren't a multiple of the word size.
+CTEST(hash_table, hash_key) {
+
+    char key1[] = "abcdefghijk";
+    char key2[] = "abcdefghijl";
+
+    ASSERT_EQUAL(_generate_hash_key(key1, 11), _generate_hash_key(key1, 11));
+    ASSERT_TRUE(_generate_hash_key(key1, 11) != _generate_hash_key(key2, 11));
+    ASSERT_TRUE(_generate_hash_key(key1, 10) != _generate_hash_key(key1, 11));
+}
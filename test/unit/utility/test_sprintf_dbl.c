@@ -0,0 +1,48 @@
+/*
+ * Tests for the libxlsxwriter library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/utility.h"
+
+#define TEST_SPRINTF_DBL(number, exp)                               \
+    lxw_sprintf_dbl(got, (double) (number));                        \
+    ASSERT_STR(exp, got);
+
+// Test lxw_sprintf_dbl().
+CTEST(utility, lxw_sprintf_dbl) {
+
+    char got[LXW_ATTR_32];
+
+    TEST_SPRINTF_DBL(0, "0");
+    TEST_SPRINTF_DBL(-0.0, "-0");
+    TEST_SPRINTF_DBL(1, "1");
+    TEST_SPRINTF_DBL(-1, "-1");
+    TEST_SPRINTF_DBL(9, "9");
+    TEST_SPRINTF_DBL(10, "10");
+    TEST_SPRINTF_DBL(99, "99");
+    TEST_SPRINTF_DBL(100, "100");
+    TEST_SPRINTF_DBL(123456, "123456");
+    TEST_SPRINTF_DBL(-1048576, "-1048576");
+    TEST_SPRINTF_DBL(999999999999999.0, "999999999999999");
+    TEST_SPRINTF_DBL(1e15, "1000000000000000");
+    TEST_SPRINTF_DBL(0.5, "0.5");
+    TEST_SPRINTF_DBL(-2.5, "-2.5");
+    TEST_SPRINTF_DBL(1.2222, "1.2222");
+    TEST_SPRINTF_DBL(123.456, "123.456");
+    TEST_SPRINTF_DBL(1e20, "1E+20");
+    TEST_SPRINTF_DBL(0.7086614173228347, "0.7086614173228347");
+
+#ifndef USE_STANDARD_DOUBLE
+    /* The dtoa function uses the shortest representation. */
+    TEST_SPRINTF_DBL(0.1, "0.1");
+    TEST_SPRINTF_DBL(1.5e-7, "1.5E-7");
+    TEST_SPRINTF_DBL(5e-324, "5E-324");
+#endif
+}
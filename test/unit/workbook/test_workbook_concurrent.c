@@ -0,0 +1,129 @@
+/*
+ * Tests for the lib_xlsx_writer library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/workbook.h"
+#include "../../../include/xlsxwriter/thread.h"
+
+#define NUM_SHEETS 4
+#define NUM_ROWS   2000
+
+typedef struct concurrent_job {
+    lxw_worksheet *worksheet;
+    lxw_format **formats;
+    int sheet;
+} concurrent_job;
+
+/* Fill a worksheet with strings that are shared with the other worksheets
+ * and strings that are unique to it. */
+static void
+_fill_worksheet(void *arg)
+{
+    concurrent_job *job = (concurrent_job *) arg;
+    char string[32];
+    lxw_row_t row;
+
+    for (row = 0; row < NUM_ROWS; row++) {
+        lxw_snprintf(string, sizeof(string), "shared%d", row % 100);
+        worksheet_write_string(job->worksheet, row, 0, string,
+                               job->formats[row % NUM_SHEETS]);
+
+        lxw_snprintf(string, sizeof(string), "sheet%d_%d", job->sheet, row);
+        worksheet_write_string(job->worksheet, row, 1, string, NULL);
+
+        lxw_format_get_xf_index(job->formats[(row + job->sheet) % NUM_SHEETS]);
+    }
+}
+
+// Test writing to different worksheets from different threads.
+CTEST(workbook, concurrent_worksheets) {
+
+    lxw_workbook_options options = {0};
+    lxw_workbook *workbook;
+    lxw_format *formats[NUM_SHEETS];
+    lxw_thread *threads[NUM_SHEETS];
+    concurrent_job jobs[NUM_SHEETS];
+    lxw_worksheet *worksheet;
+    lxw_row *row;
+    lxw_cell *cell;
+    uint32_t string_id;
+    char string[32];
+    int i;
+    int j;
+
+    options.concurrent_worksheets = LXW_TRUE;
+    workbook = workbook_new_opt(NULL, &options);
+
+    ASSERT_NOT_NULL(workbook->format_mutex);
+
+    for (i = 0; i < NUM_SHEETS; i++) {
+        formats[i] = workbook_add_format(workbook);
+        format_set_font_size(formats[i], 12 + i);
+    }
+
+    for (i = 0; i < NUM_SHEETS; i++) {
+        jobs[i].worksheet = workbook_add_worksheet(workbook, NULL);
+        jobs[i].formats = formats;
+        jobs[i].sheet = i;
+
+        ASSERT_TRUE(jobs[i].worksheet->local_sst);
+        ASSERT_TRUE(jobs[i].worksheet->sst != workbook->sst);
+    }
+
+    for (i = 0; i < NUM_SHEETS; i++)
+        threads[i] = lxw_thread_new(_fill_worksheet, &jobs[i]);
+
+    for (i = 0; i < NUM_SHEETS; i++)
+        lxw_thread_join(threads[i]);
+
+    // Each format gets one of the indices after the default format.
+    for (i = 0; i < NUM_SHEETS; i++) {
+        ASSERT_TRUE(formats[i]->xf_index >= 1);
+        ASSERT_TRUE(formats[i]->xf_index <= NUM_SHEETS);
+
+        for (j = 0; j < i; j++)
+            ASSERT_TRUE(formats[i]->xf_index != formats[j]->xf_index);
+    }
+
+    // The strings are only in the worksheet string tables until merged.
+    ASSERT_EQUAL(0, workbook->sst->unique_count);
+
+    for (i = 0; i < NUM_SHEETS; i++) {
+        ASSERT_EQUAL(NUM_ROWS * 2, jobs[i].worksheet->sst->string_count);
+        ASSERT_EQUAL(100 + NUM_ROWS, jobs[i].worksheet->sst->unique_count);
+        ASSERT_EQUAL(LXW_NO_ERROR, lxw_worksheet_merge_sst(jobs[i].worksheet));
+    }
+
+    ASSERT_EQUAL(NUM_SHEETS * NUM_ROWS * 2, workbook->sst->string_count);
+    ASSERT_EQUAL(100 + NUM_SHEETS * NUM_ROWS, workbook->sst->unique_count);
+
+    // The merged strings are in worksheet order.
+    ASSERT_STR("shared0", lxw_get_sst_string(workbook->sst, 0));
+    ASSERT_STR("sheet0_0", lxw_get_sst_string(workbook->sst, 1));
+    ASSERT_STR("sheet1_0", lxw_get_sst_string(workbook->sst, 100 + NUM_ROWS));
+
+    // Check that the cells map to the correct strings.
+    for (i = 0; i < NUM_SHEETS; i++) {
+        worksheet = jobs[i].worksheet;
+        row = lxw_worksheet_find_row(worksheet, NUM_ROWS - 1);
+        ASSERT_NOT_NULL(row);
+
+        cell = lxw_worksheet_find_cell_in_row(row, 0);
+        string_id = worksheet->sst_remap[cell->u.string_id];
+        ASSERT_STR("shared99", lxw_get_sst_string(workbook->sst, string_id));
+
+        cell = lxw_worksheet_find_cell_in_row(row, 1);
+        string_id = worksheet->sst_remap[cell->u.string_id];
+        lxw_snprintf(string, sizeof(string), "sheet%d_%d", i, NUM_ROWS - 1);
+        ASSERT_STR(string, lxw_get_sst_string(workbook->sst, string_id));
+    }
+
+    lxw_workbook_free(workbook);
+}
@@ -0,0 +1,74 @@
+/*
+ * Tests for the lib_xlsx_writer library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/workbook.h"
+
+// Test that formats with the same properties have the same fingerprint and
+// XF index, independent of the order the properties were set in.
+CTEST(workbook, format_index) {
+
+    lxw_workbook *workbook = workbook_new(NULL);
+    lxw_format *format1 = workbook_add_format(workbook);
+    lxw_format *format2 = workbook_add_format(workbook);
+    lxw_format *format3 = workbook_add_format(workbook);
+    lxw_format *format4 = workbook_add_format(workbook);
+
+    format_set_bold(format1);
+    format_set_font_name(format1, "Arial");
+    format_set_font_size(format1, 12);
+
+    format_set_font_size(format2, 12);
+    format_set_font_name(format2, "Times New Roman");
+    format_set_font_name(format2, "Arial");
+    format_set_bold(format2);
+
+    format_set_bold(format3);
+    format_set_font_name(format3, "Arial");
+
+    // Setting a property back to its default restores the fingerprint.
+    format_set_italic(format4);
+    LXW_FORMAT_SET_PROPERTY(format4, italic, LXW_FALSE);
+
+    ASSERT_TRUE(format1->fingerprint == format2->fingerprint);
+    ASSERT_TRUE(format1->fingerprint != format3->fingerprint);
+    ASSERT_TRUE(format4->fingerprint == 0);
+
+    ASSERT_EQUAL(1, lxw_format_get_xf_index(format1));
+    ASSERT_EQUAL(1, lxw_format_get_xf_index(format2));
+    ASSERT_EQUAL(2, lxw_format_get_xf_index(format3));
+    ASSERT_EQUAL(0, lxw_format_get_xf_index(format4));
+
+    lxw_workbook_free(workbook);
+}
+
+// Test that different formats with the same fingerprint get different
+// XF indices.
+CTEST(workbook, format_index_collision) {
+
+    lxw_workbook *workbook = workbook_new(NULL);
+    lxw_format *format1 = workbook_add_format(workbook);
+    lxw_format *format2 = workbook_add_format(workbook);
+    lxw_format *format3 = workbook_add_format(workbook);
+
+    format_set_bold(format1);
+    format_set_italic(format2);
+    format_set_italic(format3);
+
+    // Simulate a fingerprint collision.
+    format2->fingerprint = format1->fingerprint;
+    format3->fingerprint = format1->fingerprint;
+
+    ASSERT_EQUAL(1, lxw_format_get_xf_index(format1));
+    ASSERT_EQUAL(2, lxw_format_get_xf_index(format2));
+    ASSERT_EQUAL(2, lxw_format_get_xf_index(format3));
+
+    lxw_workbook_free(workbook);
+}
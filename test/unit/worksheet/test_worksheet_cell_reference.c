@@ -0,0 +1,109 @@
+/*
+ * Tests for the lib_xlsx_writer library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include <string.h>
+
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/worksheet.h"
+
+// Test the cached cell references against lxw_rowcol_to_cell() for rows
+// written in order, including the carries from 9 to 10 etc.
+CTEST(worksheet, cell_reference_sequential) {
+
+    char got[LXW_MAX_CELL_NAME_LENGTH];
+    char exp[LXW_MAX_CELL_NAME_LENGTH];
+    lxw_row_t row;
+    lxw_col_t cols[] = {0, 25, 26, 701, 702, 16383};
+    size_t i;
+
+    lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
+
+    for (row = 0; row < 10001; row++) {
+        for (i = 0; i < sizeof(cols) / sizeof(cols[0]); i++) {
+            _get_cell_reference(worksheet, got, row, cols[i]);
+            lxw_rowcol_to_cell(exp, row, cols[i]);
+            ASSERT_STR(exp, got);
+        }
+    }
+
+    lxw_worksheet_free(worksheet);
+}
+
+// Test the cached cell references for rows that aren't in order.
+CTEST(worksheet, cell_reference_random) {
+
+    char got[LXW_MAX_CELL_NAME_LENGTH];
+    char exp[LXW_MAX_CELL_NAME_LENGTH];
+    lxw_row_t rows[] = {0, 98, 99, 1048575, 9, 8, 999999, 1000000, 5};
+    size_t i;
+
+    lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
+
+    for (i = 0; i < sizeof(rows) / sizeof(rows[0]); i++) {
+        _get_cell_reference(worksheet, got, rows[i], (lxw_col_t) i * 1000);
+        lxw_rowcol_to_cell(exp, rows[i], (lxw_col_t) i * 1000);
+        ASSERT_STR(exp, got);
+    }
+
+    lxw_worksheet_free(worksheet);
+}
+
+// Test the incremental row name cache across changes in the number of digits
+// and across jumps between rows.
+CTEST(worksheet, cell_reference_row_name) {
+
+    char exp[LXW_MAX_CELL_NAME_LENGTH];
+    lxw_row_t starts[] = {0, 7, 97, 997, 99997, 999997, 1048570};
+    lxw_row_t row;
+    size_t i;
+
+    lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
+
+    for (i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+        for (row = starts[i]; row < starts[i] + 6; row++) {
+            _set_row_name(worksheet, row);
+            lxw_snprintf(exp, sizeof(exp), "%u", (unsigned) (row + 1));
+            ASSERT_STR(exp, worksheet->row_name);
+            ASSERT_EQUAL(strlen(exp), worksheet->row_name_length);
+        }
+    }
+
+    // Going back to a shorter row number after a rollover.
+    _set_row_name(worksheet, 8);
+    ASSERT_STR("9", worksheet->row_name);
+    ASSERT_EQUAL(1, worksheet->row_name_length);
+
+    _set_row_name(worksheet, 9);
+    ASSERT_STR("10", worksheet->row_name);
+    ASSERT_EQUAL(2, worksheet->row_name_length);
+
+    lxw_worksheet_free(worksheet);
+}
+
+// Test the cell references with the column name table shared by a workbook.
+CTEST(worksheet, cell_reference_shared_col_names) {
+
+    char got[LXW_MAX_CELL_NAME_LENGTH];
+    char exp[LXW_MAX_CELL_NAME_LENGTH];
+    lxw_col_t col;
+    lxw_col_name *col_names = lxw_col_names_new();
+
+    lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
+    worksheet->col_names = col_names;
+
+    for (col = 0; col < LXW_COL_MAX; col++) {
+        _get_cell_reference(worksheet, got, 99999, col);
+        lxw_rowcol_to_cell(exp, 99999, col);
+        ASSERT_STR(exp, got);
+    }
+
+    lxw_worksheet_free(worksheet);
+    free(col_names);
+}
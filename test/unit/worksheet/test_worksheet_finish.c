@@ -0,0 +1,80 @@
+/*
+ * Tests for the lib_xlsx_writer library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/worksheet.h"
+
+// Write the same rows to a constant_memory worksheet, optionally finishing
+// it, and return the <sheetData> element.
+static char *_get_finished_sheet_data(int8_t level, lxw_row_store *store)
+{
+    lxw_worksheet_init_data init_data = {0};
+    lxw_worksheet *worksheet;
+    lxw_row_t row;
+    char *data;
+    long size;
+
+    init_data.optimize = LXW_TRUE;
+    init_data.deflate_level = level;
+    init_data.row_store = store;
+
+    worksheet = lxw_worksheet_new(&init_data);
+
+    for (row = 0; row < 5000; row++) {
+        worksheet_write_number(worksheet, row, 0, row, NULL);
+        worksheet_write_number(worksheet, row, 1, row * 0.5, NULL);
+    }
+
+    if (store) {
+        ASSERT_EQUAL(LXW_NO_ERROR, worksheet_finish(worksheet));
+        ASSERT_NULL(worksheet->optimize_tmpfile);
+        ASSERT_NULL(worksheet->optimize_deflated_file);
+
+        // No rows can be added after the worksheet is finished.
+        ASSERT_EQUAL(LXW_ERROR_WORKSHEET_INDEX_OUT_OF_RANGE,
+                     worksheet_write_number(worksheet, 5000, 0, 1, NULL));
+    }
+
+    lxw_worksheet_flush_rows(worksheet);
+
+    worksheet->file = lxw_tmpfile(NULL);
+    _worksheet_write_optimized_sheet_data(worksheet);
+
+    fflush(worksheet->file);
+    size = ftell(worksheet->file);
+    data = calloc(size + 1, 1);
+
+    rewind(worksheet->file);
+    (void) fread(data, size, 1, worksheet->file);
+
+    fclose(worksheet->file);
+    lxw_worksheet_free(worksheet);
+
+    return data;
+}
+
+// Test that the rows of finished worksheets, stored uncompressed or
+// compressed, are read back from the shared row store.
+CTEST(worksheet, worksheet_finish) {
+
+    lxw_row_store *store = lxw_row_store_new(NULL);
+
+    char *exp = _get_finished_sheet_data(0, NULL);
+    char *got1 = _get_finished_sheet_data(0, store);
+    char *got2 = _get_finished_sheet_data(6, store);
+
+    ASSERT_STR(exp, got1);
+    ASSERT_STR(exp, got2);
+
+    free(exp);
+    free(got1);
+    free(got2);
+    lxw_row_store_free(store);
+}
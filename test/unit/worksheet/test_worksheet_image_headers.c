@@ -0,0 +1,222 @@
+/*
+ * Tests for the lib_xlsx_writer library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include <string.h>
+
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/worksheet.h"
+
+static const unsigned char png_data[] = {
+    0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A,
+    /* IHDR: 32 x 16. */
+    0x00, 0x00, 0x00, 0x0D, 'I', 'H', 'D', 'R',
+    0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x10,
+    0x08, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* pHYs: 5906 pixels per meter, about 150 dpi. */
+    0x00, 0x00, 0x00, 0x09, 'p', 'H', 'Y', 's',
+    0x00, 0x00, 0x17, 0x12, 0x00, 0x00, 0x17, 0x12, 0x01,
+    0x00, 0x00, 0x00, 0x00,
+    /* IEND. */
+    0x00, 0x00, 0x00, 0x00, 'I', 'E', 'N', 'D', 0x00, 0x00, 0x00, 0x00
+};
+
+static const unsigned char jpeg_data[] = {
+    0xFF, 0xD8,
+    /* APP0/JFIF: 72 x 72 dpi. */
+    0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01,
+    0x01, 0x00, 0x48, 0x00, 0x48, 0x00, 0x00,
+    /* SOF0: 16 high x 32 wide. */
+    0xFF, 0xC0, 0x00, 0x11, 0x08, 0x00, 0x10, 0x00, 0x20,
+    0x03, 0x01, 0x22, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01,
+    /* SOS. */
+    0xFF, 0xDA, 0x00, 0x0C
+};
+
+static const unsigned char bmp_data[] = {
+    'B', 'M', 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x36, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00,
+    /* 32 x 16. */
+    0x20, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00
+};
+
+static const unsigned char gif_data[] = {
+    'G', 'I', 'F', '8', '9', 'a',
+    /* 32 x 16. */
+    0x20, 0x00, 0x10, 0x00
+};
+
+static void _init_props(lxw_object_properties *props)
+{
+    memset(props, 0, sizeof(lxw_object_properties));
+    props->filename = "image";
+}
+
+// Test the bounds checked reads from an image held in memory.
+CTEST(worksheet, image_data_read) {
+
+    const unsigned char data[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06};
+    const unsigned char *bytes;
+    size_t position = 0;
+
+    bytes = _image_data_read(data, 6, &position, 4);
+    ASSERT_TRUE(bytes == data);
+    ASSERT_EQUAL(4, position);
+
+    // A short read fails and doesn't move the position.
+    bytes = _image_data_read(data, 6, &position, 3);
+    ASSERT_NULL(bytes);
+    ASSERT_EQUAL(4, position);
+
+    bytes = _image_data_read(data, 6, &position, 2);
+    ASSERT_TRUE(bytes == data + 4);
+    ASSERT_EQUAL(6, position);
+
+    bytes = _image_data_read(data, 6, &position, 1);
+    ASSERT_NULL(bytes);
+}
+
+// Test that skips are clamped to the end of the data.
+CTEST(worksheet, image_data_skip) {
+
+    const unsigned char data[] = {0x01, 0x02, 0x03, 0x04};
+    size_t position = 0;
+
+    _image_data_skip(4, &position, 3);
+    ASSERT_EQUAL(3, position);
+
+    _image_data_skip(4, &position, 0xFFFFFFFF);
+    ASSERT_EQUAL(4, position);
+
+    ASSERT_NULL(_image_data_read(data, 4, &position, 1));
+}
+
+// Test the big and little endian integer reads.
+CTEST(worksheet, image_data_integers) {
+
+    const unsigned char data[] = {0x12, 0x34, 0x56, 0x78};
+
+    ASSERT_EQUAL(0x12345678, _image_uint32_be(data));
+    ASSERT_EQUAL(0x78563412, _image_uint32_le(data));
+    ASSERT_EQUAL(0x1234, _image_uint16_be(data));
+    ASSERT_EQUAL(0x3412, _image_uint16_le(data));
+}
+
+// Test PNG headers.
+CTEST(worksheet, image_header_png) {
+
+    lxw_object_properties props;
+    unsigned char data[sizeof(png_data)];
+
+    _init_props(&props);
+    ASSERT_EQUAL(LXW_NO_ERROR, _process_png(&props, png_data,
+                                            sizeof(png_data)));
+    ASSERT_EQUAL(32, props.width);
+    ASSERT_EQUAL(16, props.height);
+    ASSERT_DBL_NEAR_TOL(150.0, props.x_dpi, 0.1);
+    ASSERT_DBL_NEAR_TOL(150.0, props.y_dpi, 0.1);
+    ASSERT_STR("png", props.extension);
+    free(props.extension);
+
+    // Truncated in the IHDR width field.
+    _init_props(&props);
+    ASSERT_EQUAL(LXW_ERROR_IMAGE_DIMENSIONS, _process_png(&props, png_data,
+                                                          18));
+
+    // A corrupt chunk length before the IHDR chunk.
+    memcpy(data, png_data, sizeof(png_data));
+    memcpy(data + 8, "\xFF\xFF\xFF\xF0" "abcd", 8);
+    _init_props(&props);
+    ASSERT_EQUAL(LXW_ERROR_IMAGE_DIMENSIONS, _process_png(&props, data,
+                                                          sizeof(data)));
+}
+
+// Test JPEG headers.
+CTEST(worksheet, image_header_jpeg) {
+
+    lxw_object_properties props;
+    unsigned char data[sizeof(jpeg_data)];
+
+    _init_props(&props);
+    ASSERT_EQUAL(LXW_NO_ERROR, _process_jpeg(&props, jpeg_data,
+                                             sizeof(jpeg_data)));
+    ASSERT_EQUAL(32, props.width);
+    ASSERT_EQUAL(16, props.height);
+    ASSERT_DBL_NEAR(72.0, props.x_dpi);
+    ASSERT_DBL_NEAR(72.0, props.y_dpi);
+    ASSERT_STR("jpeg", props.extension);
+    free(props.extension);
+
+    // Truncated in the SOF0 width field.
+    _init_props(&props);
+    ASSERT_EQUAL(LXW_ERROR_IMAGE_DIMENSIONS, _process_jpeg(&props, jpeg_data,
+                                                           28));
+
+    // A corrupt APP0 segment length that skips past the SOF0 segment.
+    memcpy(data, jpeg_data, sizeof(jpeg_data));
+    data[4] = 0x00;
+    data[5] = 0x00;
+    _init_props(&props);
+    ASSERT_EQUAL(LXW_ERROR_IMAGE_DIMENSIONS, _process_jpeg(&props, data,
+                                                           sizeof(data)));
+}
+
+// Test BMP headers.
+CTEST(worksheet, image_header_bmp) {
+
+    lxw_object_properties props;
+    unsigned char data[sizeof(bmp_data)];
+
+    _init_props(&props);
+    ASSERT_EQUAL(LXW_NO_ERROR, _process_bmp(&props, bmp_data,
+                                            sizeof(bmp_data)));
+    ASSERT_EQUAL(32, props.width);
+    ASSERT_EQUAL(16, props.height);
+    ASSERT_STR("bmp", props.extension);
+    free(props.extension);
+
+    // Truncated in the width field.
+    _init_props(&props);
+    ASSERT_EQUAL(LXW_ERROR_IMAGE_DIMENSIONS, _process_bmp(&props, bmp_data,
+                                                          21));
+
+    // A corrupt zero width.
+    memcpy(data, bmp_data, sizeof(bmp_data));
+    memset(data + 18, 0, 4);
+    _init_props(&props);
+    ASSERT_EQUAL(LXW_ERROR_IMAGE_DIMENSIONS, _process_bmp(&props, data,
+                                                          sizeof(data)));
+}
+
+// Test GIF headers.
+CTEST(worksheet, image_header_gif) {
+
+    lxw_object_properties props;
+    unsigned char data[sizeof(gif_data)];
+
+    _init_props(&props);
+    ASSERT_EQUAL(LXW_NO_ERROR, _process_gif(&props, gif_data,
+                                            sizeof(gif_data)));
+    ASSERT_EQUAL(32, props.width);
+    ASSERT_EQUAL(16, props.height);
+    ASSERT_STR("gif", props.extension);
+    free(props.extension);
+
+    // Truncated in the width field.
+    _init_props(&props);
+    ASSERT_EQUAL(LXW_ERROR_IMAGE_DIMENSIONS, _process_gif(&props, gif_data,
+                                                          7));
+
+    // A corrupt zero width.
+    memcpy(data, gif_data, sizeof(gif_data));
+    memset(data + 6, 0, 2);
+    _init_props(&props);
+    ASSERT_EQUAL(LXW_ERROR_IMAGE_DIMENSIONS, _process_gif(&props, data,
+                                                          sizeof(data)));
+}
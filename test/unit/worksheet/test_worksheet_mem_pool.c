@@ -0,0 +1,48 @@
+/*
+ * Tests for the lib_xlsx_writer library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/worksheet.h"
+
+// Test that the cell pool blocks grow and that released cells are reused.
+CTEST(worksheet, mem_pool) {
+
+    lxw_cell *cells[200];
+    lxw_cell *cell;
+    int i;
+
+    lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
+    lxw_mem_pool *pool = &worksheet->cell_pool;
+
+    for (i = 0; i < 200; i++) {
+        cells[i] = _pool_alloc(pool);
+        ASSERT_NOT_NULL(cells[i]);
+        ASSERT_EQUAL(0, cells[i]->type);
+        cells[i]->type = NUMBER_CELL;
+    }
+
+    // The blocks hold 64, 128 and 256 cells.
+    ASSERT_EQUAL(3, pool->num_blocks);
+    ASSERT_EQUAL(8, pool->used);
+    ASSERT_TRUE(cells[1] == cells[0] + 1);
+    ASSERT_TRUE(cells[65] == cells[64] + 1);
+
+    // A released cell is zeroed and returned by the next allocation.
+    _pool_release(pool, cells[10]);
+    ASSERT_EQUAL(1, pool->num_free);
+
+    cell = _pool_alloc(pool);
+    ASSERT_TRUE(cell == cells[10]);
+    ASSERT_EQUAL(0, cell->type);
+    ASSERT_EQUAL(0, pool->num_free);
+    ASSERT_EQUAL(8, pool->used);
+
+    lxw_worksheet_free(worksheet);
+}
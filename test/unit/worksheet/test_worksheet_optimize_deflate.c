@@ -0,0 +1,69 @@
+/*
+ * Tests for the lib_xlsx_writer library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/worksheet.h"
+
+// Write the same rows to a constant_memory worksheet at a compression level
+// and return the <sheetData> element.
+static char *_get_optimized_sheet_data(int8_t level, uint64_t *data_size)
+{
+    lxw_worksheet_init_data init_data = {0};
+    lxw_worksheet *worksheet;
+    lxw_row_t row;
+    char *data;
+    long size;
+
+    init_data.optimize = LXW_TRUE;
+    init_data.deflate_level = level;
+
+    worksheet = lxw_worksheet_new(&init_data);
+
+    for (row = 0; row < 5000; row++) {
+        worksheet_write_number(worksheet, row, 0, row, NULL);
+        worksheet_write_number(worksheet, row, 1, row * 0.5, NULL);
+    }
+
+    lxw_worksheet_flush_rows(worksheet);
+    *data_size = worksheet->optimize_data_size;
+
+    worksheet->file = lxw_tmpfile(NULL);
+    _worksheet_write_optimized_sheet_data(worksheet);
+
+    fflush(worksheet->file);
+    size = ftell(worksheet->file);
+    data = calloc(size + 1, 1);
+
+    rewind(worksheet->file);
+    (void) fread(data, size, 1, worksheet->file);
+
+    fclose(worksheet->file);
+    lxw_worksheet_free(worksheet);
+
+    return data;
+}
+
+// Test that rows that are compressed as they are written, in several blocks,
+// give the same sheet data as uncompressed rows when they are decompressed.
+CTEST(worksheet, optimize_deflate) {
+
+    uint64_t stored_size;
+    uint64_t deflated_size;
+
+    char *exp = _get_optimized_sheet_data(0, &stored_size);
+    char *got = _get_optimized_sheet_data(6, &deflated_size);
+
+    ASSERT_EQUAL(0, stored_size);
+    ASSERT_TRUE(deflated_size > 2 * 65536);
+    ASSERT_STR(exp, got);
+
+    free(exp);
+    free(got);
+}
@@ -0,0 +1,77 @@
+/*
+ * Tests for the lib_xlsx_writer library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/worksheet.h"
+
+// Write the rows of a constant_memory worksheet, in blocks of 4 rows that
+// are either in order or reversed, and return the <sheetData> element.
+static char *_get_window_sheet_data(uint16_t num_rows, uint8_t reverse)
+{
+    lxw_worksheet_init_data init_data = {0};
+    lxw_worksheet *worksheet;
+    lxw_row_t block;
+    lxw_row_t row;
+    lxw_col_t col;
+    char *data;
+    long size;
+    int i;
+    int j;
+
+    init_data.optimize = LXW_TRUE;
+    init_data.optimize_rows = num_rows;
+
+    worksheet = lxw_worksheet_new(&init_data);
+
+    for (block = 0; block < 100; block += 4) {
+        for (i = 0; i < 4; i++) {
+            row = reverse ? block + 3 - i : block + i;
+
+            for (j = 0; j < 3; j++) {
+                col = reverse ? 2 - j : j;
+                worksheet_write_number(worksheet, row, col, row + col, NULL);
+            }
+        }
+    }
+
+    // Rows that have left the window can't be written.
+    ASSERT_EQUAL(LXW_ERROR_WORKSHEET_INDEX_OUT_OF_RANGE,
+                 worksheet_write_number(worksheet, 90, 0, 1, NULL));
+
+    lxw_worksheet_flush_rows(worksheet);
+
+    worksheet->file = lxw_tmpfile(NULL);
+    _worksheet_write_optimized_sheet_data(worksheet);
+
+    fflush(worksheet->file);
+    size = ftell(worksheet->file);
+    data = calloc(size + 1, 1);
+
+    rewind(worksheet->file);
+    (void) fread(data, size, 1, worksheet->file);
+
+    fclose(worksheet->file);
+    lxw_worksheet_free(worksheet);
+
+    return data;
+}
+
+// Test that rows written out of order within the row window give the same
+// sheet data as rows written in order.
+CTEST(worksheet, optimize_window) {
+
+    char *exp = _get_window_sheet_data(1, LXW_FALSE);
+    char *got = _get_window_sheet_data(4, LXW_TRUE);
+
+    ASSERT_STR(exp, got);
+
+    free(exp);
+    free(got);
+}
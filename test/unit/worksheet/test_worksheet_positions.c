@@ -0,0 +1,167 @@
+/*
+ * Tests for the lib_xlsx_writer library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/worksheet.h"
+
+// Check the indexed row positions against the sum of the row heights.
+static void _check_row_positions(lxw_worksheet *worksheet, lxw_row_t max_row)
+{
+    uint32_t y_abs = 0;
+    lxw_row_t row;
+
+    for (row = 0; row <= max_row; row++) {
+        ASSERT_EQUAL(y_abs, _worksheet_row_position(worksheet, row));
+        y_abs += _worksheet_size_row(worksheet, row,
+                                     LXW_OBJECT_POSITION_DEFAULT);
+    }
+}
+
+// Check the indexed column positions against the sum of the column widths.
+static void _check_col_positions(lxw_worksheet *worksheet, lxw_col_t max_col)
+{
+    uint32_t x_abs = 0;
+    lxw_col_t col;
+
+    for (col = 0; col <= max_col; col++) {
+        ASSERT_EQUAL(x_abs, _worksheet_col_position(worksheet, col));
+        x_abs += _worksheet_size_col(worksheet, col,
+                                     LXW_OBJECT_POSITION_DEFAULT);
+    }
+}
+
+// Test the row position index with changed, hidden and new rows.
+CTEST(worksheet, row_positions) {
+
+    lxw_row_col_options hidden = {1, 0, 0};
+    lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
+
+    _check_row_positions(worksheet, 50);
+
+    worksheet_set_row(worksheet, 3, 30, NULL);
+    worksheet_set_row(worksheet, 10, 7.5, NULL);
+    worksheet_set_row_opt(worksheet, 20, 15, NULL, &hidden);
+    _check_row_positions(worksheet, 50);
+
+    // Rows added with a non-default default height change the positions.
+    worksheet_set_default_row(worksheet, 24, LXW_FALSE);
+    _check_row_positions(worksheet, 50);
+
+    worksheet_write_number(worksheet, 30, 0, 1, NULL);
+    worksheet_set_row(worksheet, 3, 15, NULL);
+    _check_row_positions(worksheet, 50);
+
+    lxw_worksheet_free(worksheet);
+}
+
+// Test the column position index with overlapping and hidden columns.
+CTEST(worksheet, col_positions) {
+
+    lxw_row_col_options hidden = {1, 0, 0};
+    lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
+
+    worksheet_set_column(worksheet, 2, 4, 20, NULL);
+    worksheet_set_column(worksheet, 3, 8, 0.5, NULL);
+    worksheet_set_column_opt(worksheet, 10, 10, 30, NULL, &hidden);
+    _check_col_positions(worksheet, 20);
+
+    worksheet_set_column(worksheet, 0, 0, 2, NULL);
+    _check_col_positions(worksheet, 20);
+
+    lxw_worksheet_free(worksheet);
+}
+
+// Test the row and column sizes from the geometry for hidden rows/columns.
+CTEST(worksheet, geometry_sizes) {
+
+    lxw_row_col_options hidden = {1, 0, 0};
+    lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
+
+    worksheet_set_row(worksheet, 1, 30, NULL);
+    worksheet_set_row_opt(worksheet, 2, 15, NULL, &hidden);
+    worksheet_set_column(worksheet, 1, 1, 20, NULL);
+    worksheet_set_column_opt(worksheet, 2, 3, 10, NULL, &hidden);
+
+    ASSERT_EQUAL(20, _worksheet_size_row(worksheet, 0, LXW_OBJECT_MOVE_AND_SIZE));
+    ASSERT_EQUAL(40, _worksheet_size_row(worksheet, 1, LXW_OBJECT_MOVE_AND_SIZE));
+    ASSERT_EQUAL(0,  _worksheet_size_row(worksheet, 2, LXW_OBJECT_MOVE_AND_SIZE));
+    ASSERT_EQUAL(20, _worksheet_size_row(worksheet, 2, LXW_OBJECT_MOVE_AND_SIZE_AFTER));
+    ASSERT_EQUAL(20, _worksheet_size_row(worksheet, 3, LXW_OBJECT_MOVE_AND_SIZE));
+
+    ASSERT_EQUAL(64,  _worksheet_size_col(worksheet, 0, LXW_OBJECT_MOVE_AND_SIZE));
+    ASSERT_EQUAL(145, _worksheet_size_col(worksheet, 1, LXW_OBJECT_MOVE_AND_SIZE));
+    ASSERT_EQUAL(0,   _worksheet_size_col(worksheet, 3, LXW_OBJECT_MOVE_AND_SIZE));
+    ASSERT_EQUAL(75,  _worksheet_size_col(worksheet, 3, LXW_OBJECT_MOVE_AND_SIZE_AFTER));
+    ASSERT_EQUAL(64,  _worksheet_size_col(worksheet, 4, LXW_OBJECT_MOVE_AND_SIZE));
+
+    ASSERT_EQUAL(60,  _worksheet_row_position(worksheet, 3));
+    ASSERT_EQUAL(209, _worksheet_col_position(worksheet, 4));
+
+    lxw_worksheet_free(worksheet);
+}
+
+// Write rows with buttons inserted between them, or after all of them.
+static lxw_worksheet *_write_rows_and_buttons(uint8_t interleave)
+{
+    lxw_row_col_options hidden = {1, 0, 0};
+    lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
+    lxw_row_t row;
+
+    worksheet_set_row(worksheet, 2, 30, NULL);
+    worksheet_set_row_opt(worksheet, 5, 15, NULL, &hidden);
+
+    for (row = 0; row < 100; row++) {
+        worksheet_write_number(worksheet, row, 0, row, NULL);
+
+        if (row % 10 == 9)
+            worksheet_set_row(worksheet, row, 7.5, NULL);
+
+        if (interleave)
+            worksheet_insert_button(worksheet, row, 1, NULL);
+    }
+
+    if (!interleave) {
+        for (row = 0; row < 100; row++)
+            worksheet_insert_button(worksheet, row, 1, NULL);
+    }
+
+    return worksheet;
+}
+
+// Test that buttons inserted between row writes are positioned the same as
+// buttons inserted after the rows, and that rows with the default height
+// don't invalidate the row geometry.
+CTEST(worksheet, interleaved_button_positions) {
+
+    lxw_worksheet *interleaved = _write_rows_and_buttons(LXW_TRUE);
+    lxw_worksheet *expected = _write_rows_and_buttons(LXW_FALSE);
+    lxw_vml_obj *button = STAILQ_FIRST(interleaved->button_objs);
+    lxw_vml_obj *expected_button = STAILQ_FIRST(expected->button_objs);
+
+    while (button && expected_button) {
+        ASSERT_EQUAL(expected_button->from.row, button->from.row);
+        ASSERT_EQUAL(expected_button->to.row, button->to.row);
+        ASSERT_DBL_NEAR(expected_button->to.row_offset, button->to.row_offset);
+        ASSERT_EQUAL(expected_button->row_absolute, button->row_absolute);
+
+        button = STAILQ_NEXT(button, list_pointers);
+        expected_button = STAILQ_NEXT(expected_button, list_pointers);
+    }
+
+    ASSERT_NULL(button);
+    ASSERT_NULL(expected_button);
+
+    ASSERT_TRUE(interleaved->row_geometry_valid);
+    worksheet_write_number(interleaved, 200, 0, 1, NULL);
+    ASSERT_TRUE(interleaved->row_geometry_valid);
+
+    lxw_worksheet_free(interleaved);
+    lxw_worksheet_free(expected);
+}
@@ -0,0 +1,51 @@
+/*
+ * Tests for the lib_xlsx_writer library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/worksheet.h"
+
+// Test that cells written out of order are stored in column order and that
+// overwritten cells are replaced.
+CTEST(worksheet, row_cells) {
+
+    lxw_row *row;
+    lxw_cell *cell;
+    lxw_col_t cols[] = {0, 1, 3, 5, 20, 16383};
+    lxw_col_t i;
+
+    lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
+
+    worksheet_write_number(worksheet, 0, 5, 5, NULL);
+    worksheet_write_number(worksheet, 0, 20, 20, NULL);
+    worksheet_write_number(worksheet, 0, 1, 1, NULL);
+    worksheet_write_number(worksheet, 0, 3, 3, NULL);
+    worksheet_write_number(worksheet, 0, 16383, 16383, NULL);
+    worksheet_write_number(worksheet, 0, 5, 5, NULL);
+    worksheet_write_number(worksheet, 0, 0, 0, NULL);
+    worksheet_write_number(worksheet, 0, 3, 3, NULL);
+
+    row = lxw_worksheet_find_row(worksheet, 0);
+    ASSERT_NOT_NULL(row);
+    ASSERT_EQUAL(6, row->num_cells);
+
+    for (i = 0; i < row->num_cells; i++) {
+        ASSERT_EQUAL(cols[i], row->cells[i]->col_num);
+        ASSERT_DBL_NEAR(cols[i], row->cells[i]->u.number);
+    }
+
+    cell = lxw_worksheet_find_cell_in_row(row, 20);
+    ASSERT_NOT_NULL(cell);
+    ASSERT_EQUAL(20, cell->col_num);
+
+    ASSERT_NULL(lxw_worksheet_find_cell_in_row(row, 2));
+    ASSERT_NULL(lxw_worksheet_find_cell_in_row(row, 21));
+
+    lxw_worksheet_free(worksheet);
+}
@@ -0,0 +1,112 @@
+/*
+ * Tests for the lib_xlsx_writer library.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/worksheet.h"
+
+// Test that a row written into a row with existing cells keeps column order.
+CTEST(worksheet, write_number_row) {
+
+    lxw_row *row;
+    lxw_col_t i;
+    double numbers[] = {2, 3, 4};
+    lxw_error err;
+
+    lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
+
+    worksheet_write_number(worksheet, 0, 5, 5, NULL);
+    worksheet_write_number(worksheet, 0, 0, 0, NULL);
+    worksheet_write_number(worksheet, 0, 3, -1, NULL);
+
+    err = worksheet_write_number_row(worksheet, 0, 2, numbers, 3, NULL);
+    ASSERT_EQUAL(LXW_NO_ERROR, err);
+
+    row = lxw_worksheet_find_row(worksheet, 0);
+    ASSERT_NOT_NULL(row);
+    ASSERT_EQUAL(5, row->num_cells);
+
+    for (i = 1; i < row->num_cells; i++) {
+        ASSERT_EQUAL(i + 1, row->cells[i]->col_num);
+        ASSERT_DBL_NEAR(i + 1, row->cells[i]->u.number);
+    }
+
+    ASSERT_EQUAL(0, worksheet->dim_rowmin);
+    ASSERT_EQUAL(0, worksheet->dim_colmin);
+    ASSERT_EQUAL(5, worksheet->dim_colmax);
+
+    // An out of range row doesn't write anything.
+    err = worksheet_write_number_row(worksheet, 1, LXW_COL_MAX - 2,
+                                     numbers, 3, NULL);
+    ASSERT_EQUAL(LXW_ERROR_WORKSHEET_INDEX_OUT_OF_RANGE, err);
+    ASSERT_NULL(lxw_worksheet_find_row(worksheet, 1));
+
+    lxw_worksheet_free(worksheet);
+}
+
+// Test that row-major and column-major arrays give the same cells.
+CTEST(worksheet, write_number_array) {
+
+    lxw_row *row;
+    lxw_row_t i;
+    lxw_col_t j;
+    double row_major[2][3] = {{1, 2, 3}, {4, 5, 6}};
+    double col_major[3][2] = {{1, 4}, {2, 5}, {3, 6}};
+
+    lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
+
+    worksheet_write_number_array(worksheet, 0, 0, 2, 3,
+                                 &row_major[0][0], 3, 1, NULL);
+    worksheet_write_number_array(worksheet, 2, 0, 2, 3,
+                                 &col_major[0][0], 1, 2, NULL);
+
+    for (i = 0; i < 4; i++) {
+        row = lxw_worksheet_find_row(worksheet, i);
+        ASSERT_NOT_NULL(row);
+        ASSERT_EQUAL(3, row->num_cells);
+
+        for (j = 0; j < 3; j++)
+            ASSERT_DBL_NEAR(row_major[i % 2][j], row->cells[j]->u.number);
+    }
+
+    ASSERT_EQUAL(3, worksheet->dim_rowmax);
+    ASSERT_EQUAL(2, worksheet->dim_colmax);
+
+    lxw_worksheet_free(worksheet);
+}
+
+// Test that NULL and empty strings are skipped when there is no format.
+CTEST(worksheet, write_string_row) {
+
+    lxw_row *row;
+    const char *strings[] = {NULL, "Foo", "", "Bar", NULL};
+    lxw_error err;
+
+    lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
+    worksheet->sst = lxw_sst_new();
+
+    err = worksheet_write_string_row(worksheet, 0, 0, strings, 5, NULL);
+    ASSERT_EQUAL(LXW_NO_ERROR, err);
+
+    row = lxw_worksheet_find_row(worksheet, 0);
+    ASSERT_NOT_NULL(row);
+    ASSERT_EQUAL(2, row->num_cells);
+    ASSERT_EQUAL(1, row->cells[0]->col_num);
+    ASSERT_EQUAL(3, row->cells[1]->col_num);
+    ASSERT_EQUAL(STRING_CELL, row->cells[0]->type);
+
+    // The dimensions only cover the written cells.
+    ASSERT_EQUAL(1, worksheet->dim_colmin);
+    ASSERT_EQUAL(3, worksheet->dim_colmax);
+
+    ASSERT_EQUAL(2, worksheet->sst->unique_count);
+
+    lxw_sst_free(worksheet->sst);
+    lxw_worksheet_free(worksheet);
+}
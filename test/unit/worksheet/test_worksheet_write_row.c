@@ -17,13 +17,16 @@ CTEST(worksheet, write_row) {
     char* got;
     char exp[] = "<row r=\"1\"/>";
     FILE* testfile = lxw_tmpfile(NULL);
+    lxw_xml_buffer buffer;
 
     lxw_worksheet *worksheet = lxw_worksheet_new(NULL);
     worksheet->file = testfile;
 
-    lxw_row *row = _get_row_list(worksheet->table, 0);
+    lxw_row *row = _get_row_list(worksheet, worksheet->table, 0);
 
-    _write_row(worksheet, row, NULL);
+    lxw_xml_buffer_init(&buffer, testfile);
+    _write_row(worksheet, &buffer, row, NULL);
+    lxw_xml_buffer_flush(&buffer);
 
     RUN_XLSX_STREQ(exp, got);
 
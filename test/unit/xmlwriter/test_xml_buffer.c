@@ -0,0 +1,164 @@
+/*
+ * Tests for the xmlwriter buffer functions.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ * Copyright 2014-2025, John McNamara, jmcnamara@cpan.org.
+ *
+ */
+
+#include <string.h>
+#include "../ctest.h"
+#include "../helper.h"
+
+#include "../../../include/xlsxwriter/xmlwriter.h"
+
+// Test lxw_xml_buffer_append_int().
+CTEST(xmlwriter, xml_buffer_append_int) {
+
+    char* got;
+    char exp[] = "0 7 -1 1048576 2147483647 -2147483648";
+    FILE* testfile = lxw_tmpfile(NULL);
+    lxw_xml_buffer buffer;
+
+    lxw_xml_buffer_init(&buffer, testfile);
+    lxw_xml_buffer_append_int(&buffer, 0);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, " ");
+    lxw_xml_buffer_append_int(&buffer, 7);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, " ");
+    lxw_xml_buffer_append_int(&buffer, -1);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, " ");
+    lxw_xml_buffer_append_int(&buffer, 1048576);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, " ");
+    lxw_xml_buffer_append_int(&buffer, INT32_MAX);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, " ");
+    lxw_xml_buffer_append_int(&buffer, INT32_MIN);
+    lxw_xml_buffer_flush(&buffer);
+
+    RUN_XLSX_STREQ(exp, got);
+}
+
+// Test lxw_xml_buffer_append_escaped() for data and attributes.
+CTEST(xmlwriter, xml_buffer_append_escaped) {
+
+    char* got;
+    char exp[] = "a&amp;b&lt;c&gt;\"\n|a&amp;b&lt;c&gt;&quot;&#xA;";
+    FILE* testfile = lxw_tmpfile(NULL);
+    lxw_xml_buffer buffer;
+
+    lxw_xml_buffer_init(&buffer, testfile);
+    lxw_xml_buffer_append_escaped(&buffer, "a&b<c>\"\n", LXW_FALSE);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "|");
+    lxw_xml_buffer_append_escaped(&buffer, "a&b<c>\"\n", LXW_TRUE);
+    lxw_xml_buffer_flush(&buffer);
+
+    RUN_XLSX_STREQ(exp, got);
+}
+
+// Test appending data that is larger than the buffer.
+CTEST(xmlwriter, xml_buffer_append_large) {
+
+    char* got;
+    char exp[LXW_XML_BUFFER_SIZE * 3 + 8];
+    char data[LXW_XML_BUFFER_SIZE * 3];
+    FILE* testfile = lxw_tmpfile(NULL);
+    lxw_xml_buffer buffer;
+    size_t i;
+
+    for (i = 0; i < sizeof(data) - 1; i++)
+        data[i] = 'a' + i % 26;
+    data[sizeof(data) - 1] = '\0';
+
+    lxw_snprintf(exp, sizeof(exp), "<t>%s</t>", data);
+
+    lxw_xml_buffer_init(&buffer, testfile);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "<t>");
+    lxw_xml_buffer_append_str(&buffer, data);
+    LXW_XML_BUFFER_APPEND_LITERAL(&buffer, "</t>");
+    lxw_xml_buffer_flush(&buffer);
+
+    RUN_XLSX_STREQ(exp, got);
+}
+
+// Test an allocated buffer that holds data larger than the local buffer
+// until it is full or flushed.
+CTEST(xmlwriter, xml_buffer_new) {
+
+    char* got;
+    char exp[LXW_XML_BUFFER_SIZE * 3 + 8];
+    char data[LXW_XML_BUFFER_SIZE * 3];
+    FILE* testfile = lxw_tmpfile(NULL);
+    lxw_xml_buffer *buffer = lxw_xml_buffer_new(testfile,
+                                                LXW_XML_BUFFER_SIZE * 4);
+    size_t i;
+
+    for (i = 0; i < sizeof(data) - 1; i++)
+        data[i] = 'a' + i % 26;
+    data[sizeof(data) - 1] = '\0';
+
+    lxw_snprintf(exp, sizeof(exp), "<t>%s</t>", data);
+
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "<t>");
+    lxw_xml_buffer_append_str(buffer, data);
+    LXW_XML_BUFFER_APPEND_LITERAL(buffer, "</t>");
+    ASSERT_EQUAL(strlen(exp), buffer->length);
+
+    lxw_xml_buffer_flush(buffer);
+    ASSERT_EQUAL(0, buffer->length);
+
+    lxw_xml_buffer_free(buffer);
+
+    RUN_XLSX_STREQ(exp, got);
+}
+
+// Test _xml_data_element() with escaped data larger than the buffer.
+CTEST(xmlwriter, xml_data_element_large_escaped) {
+
+    char* got;
+    char exp[LXW_XML_BUFFER_SIZE * 5 + 16];
+    char data[LXW_XML_BUFFER_SIZE + 1];
+    char *p_exp;
+    size_t i;
+    FILE* testfile = lxw_tmpfile(NULL);
+
+    for (i = 0; i < LXW_XML_BUFFER_SIZE; i++)
+        data[i] = '&';
+    data[LXW_XML_BUFFER_SIZE] = '\0';
+
+    p_exp = exp;
+    memcpy(p_exp, "<foo>", 5);
+    p_exp += 5;
+    for (i = 0; i < LXW_XML_BUFFER_SIZE; i++) {
+        memcpy(p_exp, "&amp;", 5);
+        p_exp += 5;
+    }
+    memcpy(p_exp, "</foo>", 7);
+
+    lxw_xml_data_element(testfile, "foo", data, NULL);
+
+    RUN_XLSX_STREQ(exp, got);
+}
+
+// Test writing tags with a lxw_attributes array.
+CTEST(xmlwriter, xml_buffer_attributes) {
+
+    char* got;
+    char exp[] = "<row r=\"1\" ht=\"30.5\" t=\"a&amp;&quot;b\">"
+                 "<f>A1&lt;1</f></row><c/>";
+    FILE* testfile = lxw_tmpfile(NULL);
+    lxw_xml_buffer buffer;
+    lxw_attributes attributes;
+
+    lxw_attributes_init(&attributes);
+    lxw_attributes_push_int(&attributes, "r", 1);
+    lxw_attributes_push_dbl(&attributes, "ht", 30.5);
+    lxw_attributes_push_str(&attributes, "t", "a&\"b");
+
+    lxw_xml_buffer_init(&buffer, testfile);
+    lxw_xml_buffer_start_tag(&buffer, "row", &attributes);
+    lxw_xml_buffer_data_element(&buffer, "f", "A1<1", NULL);
+    lxw_xml_buffer_end_tag(&buffer, "row");
+    lxw_xml_buffer_empty_tag(&buffer, "c", NULL);
+    lxw_xml_buffer_flush(&buffer);
+
+    RUN_XLSX_STREQ(exp, got);
+}
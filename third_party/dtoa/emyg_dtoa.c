@@ -278,7 +278,15 @@ static __inline unsigned CountDecimalDigit32(uint32_t n) {
 }
 
 static __inline void DigitGen(const DiyFp W, const DiyFp Mp, uint64_t delta, char* buffer, int* len, int* K) {
-	static const uint32_t kPow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+	static const uint64_t kPow10[] = {
+		UINT64_C2(0x00000000, 0x00000001), UINT64_C2(0x00000000, 0x0000000a), UINT64_C2(0x00000000, 0x00000064),
+		UINT64_C2(0x00000000, 0x000003e8), UINT64_C2(0x00000000, 0x00002710), UINT64_C2(0x00000000, 0x000186a0),
+		UINT64_C2(0x00000000, 0x000f4240), UINT64_C2(0x00000000, 0x00989680), UINT64_C2(0x00000000, 0x05f5e100),
+		UINT64_C2(0x00000000, 0x3b9aca00), UINT64_C2(0x00000002, 0x540be400), UINT64_C2(0x00000017, 0x4876e800),
+		UINT64_C2(0x000000e8, 0xd4a51000), UINT64_C2(0x00000918, 0x4e72a000), UINT64_C2(0x00005af3, 0x107a4000),
+		UINT64_C2(0x00038d7e, 0xa4c68000), UINT64_C2(0x002386f2, 0x6fc10000), UINT64_C2(0x01634578, 0x5d8a0000),
+		UINT64_C2(0x0de0b6b3, 0xa7640000), UINT64_C2(0x8ac72304, 0x89e80000)
+	};
 	const DiyFp one = DiyFp_from_parts((uint64_t )(1) << -Mp.e, Mp.e);
 	const DiyFp wp_w = DiyFp_subtract(Mp, W);
 	uint32_t p1 = (uint32_t )(Mp.f >> -one.e);
@@ -315,7 +323,7 @@ static __inline void DigitGen(const DiyFp W, const DiyFp Mp, uint64_t delta, cha
 		tmp = ((uint64_t )(p1) << -one.e) + p2;
 		if (tmp <= delta) {
 			*K += kappa;
-			GrisuRound(buffer, *len, delta, tmp, (uint64_t )(kPow10[kappa]) << -one.e, wp_w.f);
+			GrisuRound(buffer, *len, delta, tmp, kPow10[kappa] << -one.e, wp_w.f);
 			return;
 		}
 	}
@@ -331,8 +339,9 @@ static __inline void DigitGen(const DiyFp W, const DiyFp Mp, uint64_t delta, cha
 		p2 &= one.f - 1;
 		kappa--;
 		if (p2 < delta) {
+			int index = -kappa;
 			*K += kappa;
-			GrisuRound(buffer, *len, delta, p2, one.f, wp_w.f * kPow10[-kappa]);
+			GrisuRound(buffer, *len, delta, p2, one.f, wp_w.f * (index < 20 ? kPow10[index] : 0));
 			return;
 		}
 	}